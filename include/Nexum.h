@@ -4,8 +4,23 @@
 #include "NxCore.h"
 #include "NxUtils.h"
 #include "NxTensor.h"
+#include "NxGemm.h"
+#include "NxKernels.h"
+#include "NxMath.h"
+#include "NxDType.h"
+#include "NxExpr.h"
+#include "NxReduce.h"
+#include "NxSparse.h"
+#include "NxThreadPool.h"
+#include "NxMemory.h"
+#include "NxText.h"
+#include "NxCodec.h"
+#include "NxDataset.h"
+#include "NxCheckpoint.h"
+#include "NxBackend.h"
 #include "NxLayers.h"
 #include "NxLosses.h"
+#include "NxGraph.h"
 #include "NxOptimizers.h"
 #include "NxModels.h"
 
@@ -0,0 +1,72 @@
+#ifndef _NxBACKEND_H_
+#define _NxBACKEND_H_
+
+#include "NxCore.h"
+
+/// Environment variable used to pick the backend at initialization.
+#define NxBACKEND_ENV "NEXUM_BACKEND"
+/// Environment variable holding the path of a CBLAS compatible library.
+#define NxBACKEND_LIB_ENV "NEXUM_BLAS_LIB"
+
+/// The kinds of BLAS backends Nexum can dispatch to.
+typedef enum NxBackendKind {
+	NxBACKEND_NATIVE, ///< The in-tree kernels (always available).
+	NxBACKEND_OPENBLAS, ///< OpenBLAS loaded at runtime.
+	NxBACKEND_CBLAS, ///< Any CBLAS compatible library loaded at runtime.
+} NxBackendKind;
+
+/**
+ * @brief Table of the BLAS routines used by the tensor operations.
+ *
+ * Every matmul, axpy and scale of NxTensor goes through the active table,
+ * so the same build of the library can use a tuned vendor BLAS when it is
+ * available and fall back to the in-tree kernels otherwise.
+ *
+ * The routines follow the BLAS semantics but use the Nexum conventions:
+ * sizes are `u64` and matrices are described by row and column strides.
+ */
+typedef struct NxBackend {
+	NxBackendKind kind; ///< the kind of the backend.
+	char name[64]; ///< human readable name of the backend.
+	void* handle; ///< handle of the loaded library (NULL for native).
+	/// `C = alpha*A*B + beta*C`, see NxGemm_dgemm().
+	void (*dgemm)(u64 m, u64 n, u64 k, f64 alpha,
+	              const f64* A, i64 rsa, i64 csa,
+	              const f64* B, i64 rsb, i64 csb,
+	              f64 beta, f64* C, i64 rsc, i64 csc);
+	/// `y = alpha*x + y`.
+	void (*daxpy)(u64 n, f64 alpha, const f64* x, f64* y);
+	/// `x = alpha*x`.
+	void (*dscal)(u64 n, f64 alpha, f64* x);
+} NxBackend;
+
+bool              NxBackend_init      (str name);
+void              NxBackend_shutdown  (void);
+const NxBackend*  NxBackend_get       (void);
+
+#endif /* _NxBACKEND_H_ */
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxBackend.h
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
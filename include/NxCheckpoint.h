@@ -0,0 +1,100 @@
+#ifndef _NxCHECKPOINT_H_
+#define _NxCHECKPOINT_H_
+
+#include "NxCore.h"
+#include "NxTensor.h"
+
+/// First bytes of a checkpoint file.
+#define NxCHECKPOINT_MAGIC "NXCHKPNT"
+/// Version of the checkpoint format.
+#define NxCHECKPOINT_VERSION 1
+/// Alignment of the index and of every tensor in the file.
+#define NxCHECKPOINT_ALIGN 64
+/// Size of the name field of an entry, the terminating null included.
+#define NxCHECKPOINT_NAME_SIZE 64
+
+/// Header at the start of a checkpoint file, in native byte order.
+typedef struct NxCheckpointHeader {
+	char magic[8]; ///< NxCHECKPOINT_MAGIC, not null-terminated.
+	u32 version; ///< NxCHECKPOINT_VERSION.
+	u32 count; ///< number of tensors.
+	u64 file_size; ///< size of the whole file.
+	u64 index_checksum; ///< NxCheckpoint_checksum() of the index.
+} NxCheckpointHeader;
+
+/// Entry of the index that follows the header.
+typedef struct NxCheckpointEntry {
+	char name[NxCHECKPOINT_NAME_SIZE]; ///< name of the tensor, null-terminated.
+	u32 dtype; ///< NxDType of the elements.
+	u32 ndim; ///< number of dimensions.
+	u64 shape[NxMAX_DIMS]; ///< size of every dimension, 0 past ndim.
+	u64 offset; ///< position of the contiguous elements in the file, multiple of NxCHECKPOINT_ALIGN.
+	u64 bytes; ///< size of the elements.
+	u64 checksum; ///< NxCheckpoint_checksum() of the elements.
+} NxCheckpointEntry;
+
+/**
+ * @brief A set of named tensors stored in one file.
+ *
+ * The file holds an NxCheckpointHeader, the index of the tensors then
+ * their elements, each on a NxCHECKPOINT_ALIGN boundary. NxCheckpoint_save()
+ * writes the tensors in parallel. NxCheckpoint_open() maps the whole file
+ * once and NxCheckpoint_get() makes a tensor point straight into the
+ * mapping, so loading a model costs one `open` and one `mmap` whatever
+ * the number of layers and the pages of a tensor are only read when it is
+ * used. The tensors keep the mapping alive after NxCheckpoint_close().
+ *
+ * The checksums (xxHash64) are checked on demand by NxCheckpoint_verify().
+ *
+ * ```c
+ * str names[] = {"dense1.weights", "dense1.bias"};
+ * NxTensor* tensors[] = {&L.weights, &L.bias};
+ * NxCheckpoint_save("model.ckpt", 2, names, tensors);
+ *
+ * NxCheckpoint C;
+ * NxCheckpoint_open(&C, "model.ckpt", NxMAP_READ_ONLY);
+ * NxCheckpoint_get(&C, "dense1.weights", &L.weights);
+ * NxCheckpoint_close(&C);
+ * ```
+ */
+typedef struct NxCheckpoint {
+	NxStorage* storage; ///< the whole file.
+	const NxCheckpointHeader* header; ///< the header, inside the storage.
+	const NxCheckpointEntry* entries; ///< the index, inside the storage.
+	u32 count; ///< number of tensors.
+} NxCheckpoint;
+
+u64   NxCheckpoint_checksum   (const void* data, u64 bytes);
+void  NxCheckpoint_save       (str fname, u32 count, const str* names, NxTensor** tensors);
+void  NxCheckpoint_open       (NxCheckpoint* C, str fname, u32 flags);
+i64   NxCheckpoint_find       (NxCheckpoint* C, str name);
+bool  NxCheckpoint_get        (NxCheckpoint* C, str name, NxTensor* T);
+bool  NxCheckpoint_verify     (NxCheckpoint* C);
+void  NxCheckpoint_close      (NxCheckpoint* C);
+
+#endif /* _NxCHECKPOINT_H_ */
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxCheckpoint.h
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,81 @@
+#ifndef _NxCODEC_H_
+#define _NxCODEC_H_
+
+#include "NxCore.h"
+
+/// First bytes of a compressed frame.
+#define NxCODEC_MAGIC "NXLZ"
+/// Uncompressed bytes of a block, the unit of parallel work and of random access.
+#define NxCODEC_BLOCK (256*1024)
+
+/// Compression of the data of a binary tensor file (NxTensorFileHeader::codec).
+typedef enum NxCodecType {
+	NxCODEC_NONE = 0, ///< raw elements.
+	NxCODEC_SHUFFLE_LZ, ///< byte shuffle then LZ, in an NxCodecFrame.
+} NxCodecType;
+
+/**
+ * @brief Header of a compressed frame.
+ *
+ * Followed by `blocks` u64, the end of every compressed block counted
+ * from the end of this table, then the blocks. A block whose compressed
+ * size equals its uncompressed size is stored as is.
+ */
+typedef struct NxCodecFrame {
+	char magic[4]; ///< NxCODEC_MAGIC, not null-terminated.
+	u32 elem_size; ///< size of the elements the bytes were shuffled by.
+	u32 block_size; ///< uncompressed bytes of every block but the last.
+	u32 reserved; ///< zero.
+	u64 bytes; ///< uncompressed size.
+	u64 blocks; ///< number of blocks.
+} NxCodecFrame;
+
+/**
+ * @brief Lossless compression of tensor data, without external dependency.
+ *
+ * Every block is byte shuffled first: the k-th byte of all the elements
+ * are stored together, so the sign/exponent bytes of floats, which vary
+ * slowly, and the zero bytes of small integers form long runs. The result
+ * is compressed with a byte-aligned LZ77 (4-byte hash matches within 64
+ * KiB, LZ4-like sequences) which decodes with `memcpy`s only. Blocks are
+ * independent: the frame is compressed and decompressed on the
+ * NxThreadPool, and NxCodec_decompress_block() decodes a single block
+ * for streaming reads.
+ *
+ * The decoder checks every length and offset against the buffers, a
+ * corrupted frame makes it return false instead of reading or writing
+ * out of bounds.
+ */
+
+u64   NxCodec_bound             (u64 bytes);
+u64   NxCodec_compress          (void* dst, const void* src, u64 bytes, u32 elem_size);
+bool  NxCodec_check             (const void* frame, u64 frame_bytes);
+bool  NxCodec_decompress        (void* dst, u64 bytes, const void* frame, u64 frame_bytes);
+bool  NxCodec_decompress_block  (void* dst, const void* frame, u64 block, void* scratch);
+
+#endif /* _NxCODEC_H_ */
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxCodec.h
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
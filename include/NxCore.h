@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <assert.h>
 #include <stddef.h>
@@ -30,6 +31,22 @@ typedef char*    str;   ///< shot hand for `char*` type
 #define WRITE_BINARY_MODE  "wb" ///< weiting binary mode
 
 #define NxDTYPE f64 ///< The default data type of the tensor object.
+
+/**
+ * @brief Storage type of the tensor elements, zero (f64) is the default.
+ *
+ * The elementwise operations run in f32 for f32 tensors and for bf16/f16
+ * (widened block by block). GEMM, the reductions, the transcendental
+ * functions and the text output compute in f64 and round the result back
+ * to the storage type.
+ */
+typedef enum NxDType {
+	NxFLOAT64 = 0, ///< IEEE double precision, the `NxDTYPE` of the library.
+	NxFLOAT32,     ///< IEEE single precision.
+	NxBFLOAT16,    ///< brain float, the upper half of a f32 stored in a `u16`.
+	NxFLOAT16,     ///< IEEE half precision stored in a `u16`.
+} NxDType;
+
 #define NxCDEF ///< function definition in Nexum lib.
 #define NxASSERT(expr) assert(expr)  ///< overloading the assert function in c.
 #define NxMALLOC(size) ((NxDTYPE*)malloc(size)) ///< overloading the malloc function in c.
@@ -0,0 +1,128 @@
+#ifndef _NxDTYPE_H_
+#define _NxDTYPE_H_
+
+#include "NxCore.h"
+
+#include <string.h>
+
+u64         NxDType_size     (NxDType dtype);
+const char* NxDType_name     (NxDType dtype);
+void        NxDType_convert  (u64 n, void* dst, NxDType dst_dtype, const void* src, NxDType src_dtype);
+void        NxDType_to_f32   (u64 n, f32* dst, const void* src, NxDType src_dtype);
+void        NxDType_from_f32 (u64 n, void* dst, NxDType dst_dtype, const f32* src);
+
+/**
+ * @brief Widen a bfloat16 to f32, exact.
+ */
+static inline f32 NxBF16_to_f32(u16 h) {
+	u32 u = (u32)h << 16;
+	f32 f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+/**
+ * @brief Round a f32 to the nearest bfloat16 (ties to even), NaN stays NaN.
+ */
+static inline u16 NxF32_to_bf16(f32 f) {
+	u32 u;
+	memcpy(&u, &f, sizeof(u));
+	if((u & 0x7fffffffu) > 0x7f800000u) {
+		return (u16)((u >> 16) | 0x40);
+	}
+	u += 0x7fffu + ((u >> 16) & 1);
+	return (u16)(u >> 16);
+}
+
+/**
+ * @brief Widen an IEEE half to f32, exact (subnormals included).
+ */
+static inline f32 NxF16_to_f32(u16 h) {
+	u32 sign = (u32)(h & 0x8000) << 16;
+	u32 e = (h >> 10) & 0x1f;
+	u32 m = h & 0x3ff;
+	u32 u;
+	if(e == 0) {
+		if(m == 0) {
+			u = sign;
+		} else {
+			e = 113;
+			while(!(m & 0x400)) {
+				m <<= 1;
+				e--;
+			}
+			u = sign | (e << 23) | ((m & 0x3ff) << 13);
+		}
+	} else if(e == 31) {
+		u = sign | 0x7f800000u | (m << 13);
+	} else {
+		u = sign | ((e + 112) << 23) | (m << 13);
+	}
+	f32 f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+/**
+ * @brief Round a f32 to the nearest IEEE half (ties to even).
+ *
+ * Values from 65520 up round to infinity and values below 2^-14 are
+ * stored as half subnormals.
+ */
+static inline u16 NxF32_to_f16(f32 f) {
+	u32 x;
+	memcpy(&x, &f, sizeof(x));
+	u16 sign = (u16)((x >> 16) & 0x8000);
+	x &= 0x7fffffffu;
+	if(x >= 0x7f800000u) {
+		return sign | 0x7c00 | (x > 0x7f800000u ? (u16)(0x200 | ((x >> 13) & 0x3ff)) : 0);
+	}
+	if(x >= 0x477ff000u) {
+		return sign | 0x7c00;
+	}
+	if(x < 0x38800000u) {
+		if(x <= 0x33000000u) {
+			return sign;
+		}
+		u32 e = x >> 23;
+		u32 m = (x & 0x7fffffu) | 0x800000u;
+		u32 shift = 126 - e;
+		u32 r = m >> shift;
+		u32 rem = m & ((1u << shift) - 1);
+		u32 half = 1u << (shift - 1);
+		if(rem > half || (rem == half && (r & 1))) {
+			r++;
+		}
+		return sign | (u16)r;
+	}
+	x -= 0x38000000u;
+	x += 0xfffu + ((x >> 13) & 1);
+	return sign | (u16)(x >> 13);
+}
+
+#endif /* _NxDTYPE_H_ */
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxDType.h
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
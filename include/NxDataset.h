@@ -0,0 +1,145 @@
+#ifndef _NxDATASET_H_
+#define _NxDATASET_H_
+
+#include <pthread.h>
+
+#include "NxCore.h"
+#include "NxTensor.h"
+
+/// Default number of batch buffers (triple buffering).
+#define NxDATASET_BUFFERS 3
+/// Maximum number of batch buffers of a dataset.
+#define NxDATASET_MAX_BUFFERS 8
+
+/// One file of a stream, its first dimension is the sample.
+typedef struct NxDatasetShard {
+	char* fname; ///< path of the file.
+	bool binary; ///< written by NxTensor_write_binary(), text (NxTensor_write()) otherwise.
+	u64 rows; ///< number of samples.
+	u64 offset; ///< position of the data of a binary file.
+	u32 codec; ///< NxCodecType of the data of a binary file.
+} NxDatasetShard;
+
+/// The shards of the inputs or of the targets and the position of the loader in them.
+typedef struct NxDatasetStream {
+	NxDatasetShard* shards; ///< the files, read in order.
+	u32 count; ///< number of shards.
+	NxDType dtype; ///< dtype of the batches (f64 for text shards).
+	u32 ndim; ///< number of dimensions of a batch.
+	u64 shape[NxMAX_DIMS]; ///< shape of a sample in shape[1..ndim-1].
+	u64 sample_bytes; ///< size of a sample.
+	u64 rows; ///< number of samples of all the shards.
+	u32 shard; ///< shard being read.
+	u64 row; ///< next sample of the shard.
+	FILE* fptr; ///< open binary shard.
+	NxStorage* text; ///< mapped text shard.
+	const char* cursor; ///< next number of the text shard.
+	NxStorage* frame; ///< mapped NxCodecFrame of a compressed binary shard.
+	char* block; ///< decompressed block of the frame.
+	void* scratch; ///< work buffer of NxCodec_decompress_block().
+	i64 block_index; ///< index of the block in `block`, -1 when none.
+} NxDatasetStream;
+
+/// One buffer of the ring, filled by the loader thread.
+typedef struct NxDatasetBatch {
+	NxTensor x; ///< the inputs.
+	NxTensor y; ///< the targets.
+} NxDatasetBatch;
+
+/// Counters of a dataset.
+typedef struct NxDatasetStats {
+	u64 batches; ///< batches given to the training loop.
+	u64 samples; ///< samples given to the training loop.
+	u64 bytes; ///< bytes decoded by the loader.
+	f64 stall_seconds; ///< time NxDataset_next() waited for the loader.
+	f64 load_seconds; ///< time the loader spent reading and decoding.
+} NxDatasetStats;
+
+/**
+ * @brief Stream of mini-batches read from files larger than the memory.
+ *
+ * The inputs (and optionally the targets) are split over shards, either
+ * binary tensor files (NxTensor_write_binary(), NxTensor_write_compressed())
+ * or text matrices (NxTensor_write()); the first dimension of every shard counts the
+ * samples. Only the headers are read when the dataset is opened.
+ *
+ * A background thread reads the next batches, in order, into a ring of
+ * `buffers` batch tensors while the training loop works on the current
+ * one: with 2 buffers loading overlaps one step, with 3 (the default) it
+ * absorbs the jitter of the disk. Binary shards are read at the position
+ * of the batch, compressed shards are mapped and decompressed one block
+ * at a time, text shards are mapped and parsed as the loader reaches
+ * them, so none is ever resident as a whole. NxDatasetStats tells how
+ * long the training loop waited for data.
+ *
+ * ```c
+ * NxDataset D;
+ * NxTensor *x, *y;
+ * NxDataset_open(&D, x_files, y_files, shards, 256, NxDATASET_BUFFERS);
+ * while(NxDataset_next(&D, &x, &y)) {
+ *     // one training step on x and y
+ * }
+ * NxDataset_close(&D);
+ * ```
+ *
+ * NxDataset_wrap() gives the same interface over tensors already in
+ * memory, the batches are then views of their rows and no thread runs.
+ */
+typedef struct NxDataset {
+	NxDatasetStream x; ///< the inputs.
+	NxDatasetStream y; ///< the targets, no shards when there are none.
+	NxTensor* resident_x; ///< the inputs of NxDataset_wrap(), NULL when streaming shards.
+	NxTensor* resident_y; ///< the targets of NxDataset_wrap(), may be NULL.
+	u64 batch_size; ///< samples per batch, the last batch of an epoch may be smaller.
+	u32 buffers; ///< number of batch buffers.
+	u64 position; ///< samples loaded since the start of the epoch.
+	NxDatasetBatch slots[NxDATASET_MAX_BUFFERS]; ///< the ring of batches.
+	u32 head; ///< first batch ready for the training loop.
+	u32 ready; ///< number of batches ready.
+	bool held; ///< the training loop holds the batch before head.
+	bool loading; ///< the loader is filling a batch.
+	bool done; ///< the loader reached the end of the epoch.
+	bool stop; ///< the loader must exit.
+	NxDatasetStats stats; ///< the counters.
+	pthread_t thread; ///< the loader thread.
+	pthread_mutex_t lock; ///< protects the ring and the counters.
+	pthread_cond_t filled; ///< signaled when a batch is ready or the loader is idle.
+	pthread_cond_t space; ///< signaled when a buffer is free.
+} NxDataset;
+
+void  NxDataset_open          (NxDataset* D, const str* x_files, const str* y_files, u32 shards,
+                               u64 batch_size, u32 buffers);
+void  NxDataset_wrap          (NxDataset* D, NxTensor* x, NxTensor* y, u64 batch_size);
+bool  NxDataset_next          (NxDataset* D, NxTensor** x, NxTensor** y);
+void  NxDataset_rewind        (NxDataset* D);
+void  NxDataset_close         (NxDataset* D);
+u64   NxDataset_size          (NxDataset* D);
+void  NxDataset_stats         (NxDataset* D, NxDatasetStats* S);
+void  NxDataset_reset_stats   (NxDataset* D);
+
+#endif /* _NxDATASET_H_ */
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxDataset.h
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,107 @@
+#ifndef _NxEXPR_H_
+#define _NxEXPR_H_
+
+#include "NxCore.h"
+#include "NxTensor.h"
+
+/// Maximum number of nodes of one expression.
+#define NxEXPR_MAX_NODES 32
+/// Number of elements evaluated at once, small enough for every node to stay in L1.
+#define NxEXPR_BLOCK 128
+
+/// Operations of the expression nodes.
+typedef enum NxExprOp {
+	NxEXPR_TENSOR, ///< leaf reading a tensor.
+	NxEXPR_CONST, ///< leaf holding a scalar broadcast to every element.
+	NxEXPR_ADD, ///< `a + b`
+	NxEXPR_SUB, ///< `a - b`
+	NxEXPR_MUL, ///< `a * b`
+	NxEXPR_DIV, ///< `a / b`
+	NxEXPR_NEG, ///< `-a`
+	NxEXPR_ABS, ///< `|a|`
+	NxEXPR_SQUARE, ///< `a * a`
+	NxEXPR_EXP, ///< `exp(a)`
+	NxEXPR_LOG, ///< `log(a)`
+	NxEXPR_TANH, ///< `tanh(a)`
+	NxEXPR_SIGMOID, ///< `1/(1 + exp(-a))`
+	NxEXPR_PRELU, ///< `a` when positive, `value * a` otherwise (ReLU for a value of 0).
+	NxEXPR_ELU, ///< `a` when positive, `value * (exp(a) - 1)` otherwise.
+} NxExprOp;
+
+/// One node of an expression, its operands are indices of earlier nodes.
+typedef struct NxExprNode {
+	NxExprOp op; ///< the operation of the node.
+	u32 a; ///< first operand.
+	u32 b; ///< second operand of the binary operations.
+	NxTensor* tensor; ///< the tensor of a NxEXPR_TENSOR leaf.
+	f64 value; ///< the value of a NxEXPR_CONST leaf, the slope of NxEXPR_PRELU or the alpha of NxEXPR_ELU.
+} NxExprNode;
+
+/**
+ * @brief A deferred chain of element wize operations.
+ *
+ * The node functions only record the operation and return the index of
+ * the new node; nothing is computed until a terminal function
+ * (NxExpr_assign(), NxExpr_sum()) walks the tensors once, block by
+ * block, without allocating any full size temporary.
+ *
+ * ```c
+ * NxExpr E;
+ * NxExpr_init(&E);
+ * u32 d = NxExpr_sub(&E, NxExpr_tensor(&E, A), NxExpr_tensor(&E, B));
+ * f64 sse = NxExpr_sum(&E, NxExpr_square(&E, d));
+ * ```
+ */
+typedef struct NxExpr {
+	u32 count; ///< number of recorded nodes.
+	NxExprNode nodes[NxEXPR_MAX_NODES]; ///< the nodes in creation (topological) order.
+} NxExpr;
+
+void NxExpr_init          (NxExpr* E);
+u32  NxExpr_tensor        (NxExpr* E, NxTensor* A);
+u32  NxExpr_const         (NxExpr* E, f64 value);
+u32  NxExpr_add           (NxExpr* E, u32 a, u32 b);
+u32  NxExpr_sub           (NxExpr* E, u32 a, u32 b);
+u32  NxExpr_mul           (NxExpr* E, u32 a, u32 b);
+u32  NxExpr_div           (NxExpr* E, u32 a, u32 b);
+u32  NxExpr_neg           (NxExpr* E, u32 a);
+u32  NxExpr_abs           (NxExpr* E, u32 a);
+u32  NxExpr_square        (NxExpr* E, u32 a);
+u32  NxExpr_exp           (NxExpr* E, u32 a);
+u32  NxExpr_log           (NxExpr* E, u32 a);
+u32  NxExpr_tanh          (NxExpr* E, u32 a);
+u32  NxExpr_sigmoid       (NxExpr* E, u32 a);
+u32  NxExpr_prelu         (NxExpr* E, u32 a, f64 s);
+u32  NxExpr_elu           (NxExpr* E, u32 a, f64 alpha);
+
+void NxExpr_assign        (NxExpr* E, NxTensor* C, u32 root);
+f64  NxExpr_sum           (NxExpr* E, u32 root);
+f64  NxExpr_mean          (NxExpr* E, u32 root);
+void NxExpr_backward      (NxExpr* E, u32 root, NxTensor* grad, NxTensor* const* grads);
+
+#endif /* _NxEXPR_H_ */
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxExpr.h
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,82 @@
+#ifndef _NxGEMM_H_
+#define _NxGEMM_H_
+
+#include "NxCore.h"
+#include "NxActivations.h"
+
+/// Number of rows of the register tile computed by the micro-kernel.
+#define NxGEMM_MR 6
+/// Number of columns of the register tile computed by the micro-kernel.
+#define NxGEMM_NR 8
+/// Rows of A packed per block (sized so the packed A block stays in L2).
+#define NxGEMM_MC 144
+/// Depth of the packed blocks (sized so one A and one B micro-panel stay in L1).
+#define NxGEMM_KC 256
+/// Columns of B packed per block (sized so the packed B block stays in L3).
+#define NxGEMM_NC 3072
+/// Alignment in bytes of the packing buffers.
+#define NxGEMM_ALIGN 64
+/// Number of multiply-adds (m*n*k) above which the product is split over threads.
+#define NxGEMM_PARALLEL_WORK (1 << 21)
+/// Rows of the tile of the int8 micro-kernels.
+#define NxGEMM_Q8_MR 4
+/// Columns of the tile of the int8 micro-kernels, the rows of a block of packed weights.
+#define NxGEMM_Q8_NR 16
+
+/// Type of the output of NxGemm_q8().
+typedef enum NxGemmQ8Output {
+	NxGEMM_Q8_F32, ///< f32 values.
+	NxGEMM_Q8_F64, ///< f64 values.
+	NxGEMM_Q8_S8, ///< int8 values requantized with `out_scale`.
+} NxGemmQ8Output;
+
+/// What NxGemm_q8() does with the int32 sums of every tile.
+typedef struct NxGemmQ8Epilogue {
+	const f32* scales; ///< multiplier of every column (input scale times weight scale).
+	const f32* bias; ///< bias of every column, NULL for none.
+	NxActivation act; ///< activation applied after the bias.
+	f32 alpha; ///< slope of PReLU, scale of ELU.
+	NxGemmQ8Output output; ///< type of C.
+	f32 out_scale; ///< scale of the int8 output, C = round(value/out_scale).
+	void* C; ///< output, element (i, j) lives at `C[i*rsc + j]`.
+	i64 rsc; ///< row stride of C.
+} NxGemmQ8Epilogue;
+
+void NxGemm_dgemm (u64 m, u64 n, u64 k, f64 alpha,
+                   const f64* A, i64 rsa, i64 csa,
+                   const f64* B, i64 rsb, i64 csb,
+                   f64 beta, f64* C, i64 rsc, i64 csc);
+
+bool         NxGemm_q8_select      (str isa);
+const char*  NxGemm_q8_isa         (void);
+u64          NxGemm_q8_packed_size (u64 n, u64 k);
+void         NxGemm_q8_pack        (i8* Wp, const i8* W, i64 rsw, u64 n, u64 k);
+void         NxGemm_q8             (u64 m, u64 n, u64 k, const i8* X, i64 rsx,
+                                    const i8* Wp, const NxGemmQ8Epilogue* E);
+
+#endif /* _NxGEMM_H_ */
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxGemm.h
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
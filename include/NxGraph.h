@@ -3,9 +3,168 @@
 
 #include "NxCore.h"
 #include "NxTensor.h"
+#include "NxActivations.h"
+#include "NxExpr.h"
 
+/// Maximum number of inputs of a node, the fused elementwise nodes have the most.
+#define NxGRAPH_MAX_INPUTS 8
+/// Nodes allocated by the first recorded operation, the tape doubles from there.
+#define NxGRAPH_INITIAL_CAPACITY 64
+
+/// Operations recorded by an NxComputationalGraph.
+typedef enum NxGraphOp {
+	NxGRAPH_INPUT, ///< leaf without gradient (data, targets).
+	NxGRAPH_PARAMETER, ///< leaf whose gradient is kept by the backward pass.
+	NxGRAPH_CONSTANT, ///< leaf never read again by NxGraph_run(), also the result of constant folding.
+	NxGRAPH_ADD, ///< `a + b`
+	NxGRAPH_SUB, ///< `a - b`
+	NxGRAPH_MUL, ///< `a * b` elementwise.
+	NxGRAPH_MATMUL, ///< `a @ b`
+	NxGRAPH_MATMUL_NT, ///< `a @ b^T`, b stored like the weights of NxDense.
+	NxGRAPH_ADD_BIAS, ///< `a + b` where the n elements of b are added to every row of a.
+	NxGRAPH_SCALE, ///< `scalar * a`
+	NxGRAPH_RELU, ///< `max(a, 0)`
+	NxGRAPH_PRELU, ///< `a` when positive, `scalar * a` otherwise.
+	NxGRAPH_ELU, ///< `a` when positive, `scalar * (exp(a) - 1)` otherwise.
+	NxGRAPH_SIGMOID, ///< `1 / (1 + exp(-a))`
+	NxGRAPH_TANH, ///< `tanh(a)`
+	NxGRAPH_EXP, ///< `exp(a)`
+	NxGRAPH_LOG, ///< `log(a)`
+	NxGRAPH_SQUARE, ///< `a * a`
+	NxGRAPH_SUM, ///< sum of the elements of a, a (1, 1) tensor.
+	NxGRAPH_MEAN, ///< mean of the elements of a, a (1, 1) tensor.
+	NxGRAPH_MSE, ///< mean of `(a - b)^2`, a (1, 1) tensor.
+	NxGRAPH_LINEAR, ///< `act(x @ W + b)` or `act(x @ W^T + b)`, fused by NxGraph_optimize().
+	NxGRAPH_FUSED, ///< chain of elementwise operations run as one NxExpr, fused by NxGraph_optimize().
+} NxGraphOp;
+
+/**
+ * @brief One recorded operation of an NxComputationalGraph.
+ *
+ * Its id is its position in the tape plus one, the inputs always have
+ * smaller ids, so walking the tape backwards is a reverse topological
+ * order.
+ */
+typedef struct NxGraphNode {
+	NxGraphOp op; ///< the operation.
+	u32 n_inputs; ///< number of inputs used in `inputs`.
+	u64 inputs[NxGRAPH_MAX_INPUTS]; ///< ids of the inputs.
+	f64 scalar; ///< factor of NxGRAPH_SCALE, slope of NxGRAPH_PRELU, alpha of NxGRAPH_ELU.
+	u64 m; ///< number of rows of the value, known when the node is recorded.
+	u64 n; ///< number of columns of the value.
+	bool requires_grad; ///< whether a parameter is among the ancestors.
+	bool dead; ///< dropped by NxGraph_optimize(), never computed again.
+	u32 inplace; ///< 1 + the input whose buffer the value takes over, 0 for none.
+	NxActivation act; ///< activation of NxGRAPH_LINEAR, `scalar` holds its slope or alpha.
+	bool transposed; ///< whether NxGRAPH_LINEAR multiplies by the transpose of its weights.
+	NxExpr* expr; ///< program of NxGRAPH_FUSED, its k-th tensor leaf reads the input k.
+	NxTensor* source; ///< tensor given for a leaf, read again by NxGraph_run().
+	NxTensor value; ///< the result of the forward pass, contiguous f64.
+	NxTensor grad; ///< gradient of the loss, allocated by the first contribution of the backward pass.
+} NxGraphNode;
+
+/**
+ * @brief Tape of the operations of a forward pass, for reverse-mode autodiff.
+ *
+ * Every NxGraph_ operation computes its result right away (eager
+ * execution) and appends a node to the tape, the result is read with
+ * NxGraph_value(). The leaves are tensors given with NxGraph_input() and
+ * NxGraph_parameter(), which also set their NxTensor::id to the id of
+ * the leaf.
+ *
+ * NxGraph_backward() walks the tape backwards from the loss. The
+ * gradient of a node is allocated by its first contribution, the next
+ * ones are accumulated in place (axpy, GEMM with beta = 1), and it is
+ * freed right after the node propagated it to its inputs, since all its
+ * consumers come later in the tape and have already run. Only the
+ * gradients of the parameters are kept. Unless asked to retain them, the
+ * values of the intermediate nodes are freed the same way, so the peak
+ * memory of the backward pass stays close to the forward activations.
+ *
+ * With `deferred` set before recording, the operations only infer the
+ * shape of their result. NxGraph_optimize() then rewrites the tape for
+ * the given outputs, and NxGraph_run() computes it as many times as
+ * needed, reading the current contents of the leaf tensors:
+ *
+ * ```c
+ * G.deferred = true;
+ * u64 loss = NxGraph_mse(&G, NxGraph_dense(&G, x, W, b, NxActivation_ReLU), y);
+ * NxGraph_optimize(&G, &loss, 1);
+ * for(step=0; step<steps; step++) {
+ *     NxGraph_run(&G);
+ *     NxGraph_backward(&G, loss, true);
+ * }
+ * ```
+ */
 typedef struct NxComputationalGraph {
-	
+	NxGraphNode* nodes; ///< the tape.
+	u64 count; ///< number of recorded nodes.
+	u64 capacity; ///< number of allocated nodes.
+	u64 bytes; ///< bytes of the values and gradients owned by the graph (the leaves are not counted).
+	u64 peak_bytes; ///< largest `bytes` since NxGraph_alloc() or NxGraph_reset().
+	bool deferred; ///< record the operations without computing them, see NxGraph_run().
 } NxComputationalGraph;
 
-#endif /* _NxGRAPH_H_ */
\ No newline at end of file
+void       NxGraph_alloc       (NxComputationalGraph* G);
+void       NxGraph_reset       (NxComputationalGraph* G);
+void       NxGraph_free        (NxComputationalGraph* G);
+
+u64        NxGraph_input       (NxComputationalGraph* G, NxTensor* X);
+u64        NxGraph_parameter   (NxComputationalGraph* G, NxTensor* W);
+u64        NxGraph_constant    (NxComputationalGraph* G, NxTensor* X);
+
+u64        NxGraph_add         (NxComputationalGraph* G, u64 a, u64 b);
+u64        NxGraph_sub         (NxComputationalGraph* G, u64 a, u64 b);
+u64        NxGraph_mul         (NxComputationalGraph* G, u64 a, u64 b);
+u64        NxGraph_matmul      (NxComputationalGraph* G, u64 a, u64 b);
+u64        NxGraph_matmul_nt   (NxComputationalGraph* G, u64 a, u64 b);
+u64        NxGraph_add_bias    (NxComputationalGraph* G, u64 a, u64 b);
+u64        NxGraph_scale       (NxComputationalGraph* G, u64 a, f64 s);
+u64        NxGraph_relu        (NxComputationalGraph* G, u64 a);
+u64        NxGraph_prelu       (NxComputationalGraph* G, u64 a, f64 slope);
+u64        NxGraph_elu         (NxComputationalGraph* G, u64 a, f64 alpha);
+u64        NxGraph_sigmoid     (NxComputationalGraph* G, u64 a);
+u64        NxGraph_tanh        (NxComputationalGraph* G, u64 a);
+u64        NxGraph_exp         (NxComputationalGraph* G, u64 a);
+u64        NxGraph_log         (NxComputationalGraph* G, u64 a);
+u64        NxGraph_square      (NxComputationalGraph* G, u64 a);
+u64        NxGraph_sum         (NxComputationalGraph* G, u64 a);
+u64        NxGraph_mean        (NxComputationalGraph* G, u64 a);
+u64        NxGraph_mse         (NxComputationalGraph* G, u64 pred, u64 target);
+u64        NxGraph_activation  (NxComputationalGraph* G, u64 a, NxActivation act);
+u64        NxGraph_dense       (NxComputationalGraph* G, u64 x, u64 W, u64 b, NxActivation act);
+
+NxTensor*  NxGraph_value       (NxComputationalGraph* G, u64 id);
+NxTensor*  NxGraph_grad        (NxComputationalGraph* G, u64 id);
+void       NxGraph_backward    (NxComputationalGraph* G, u64 loss, bool retain_values);
+void       NxGraph_zero_grad   (NxComputationalGraph* G);
+
+void       NxGraph_optimize    (NxComputationalGraph* G, const u64* outputs, u64 n_outputs);
+void       NxGraph_run         (NxComputationalGraph* G);
+
+#endif /* _NxGRAPH_H_ */
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxGraph.h
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
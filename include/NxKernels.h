@@ -0,0 +1,86 @@
+#ifndef _NxKERNELS_H_
+#define _NxKERNELS_H_
+
+#include "NxCore.h"
+
+/// Environment variable used to force an instruction set (`generic`, `sse2`, `avx2`, `avx512`).
+#define NxKERNELS_ENV "NEXUM_ISA"
+
+/**
+ * @brief Table of the flat elementwise kernels.
+ *
+ * Each kernel works on `n` contiguous elements and the outputs may alias
+ * the inputs, so the same kernels serve the inplace `_` operations.
+ * The table is filled once when the library is loaded with the widest
+ * instruction set reported by `cpuid` (SSE2, AVX2 or AVX-512).
+ */
+typedef struct NxKernels {
+	const char* isa; ///< name of the instruction set of the table.
+	void (*add)        (u64 n, const f64* a, const f64* b, f64* c); ///< `c = a + b`
+	void (*sub)        (u64 n, const f64* a, const f64* b, f64* c); ///< `c = a - b`
+	void (*mul)        (u64 n, const f64* a, const f64* b, f64* c); ///< `c = a * b`
+	void (*div)        (u64 n, const f64* a, const f64* b, f64* c); ///< `c = a / b`
+	void (*add_scalar) (u64 n, const f64* a, f64 s, f64* c); ///< `c = a + s`
+	void (*mul_scalar) (u64 n, const f64* a, f64 s, f64* c); ///< `c = a * s`
+	void (*div_scalar) (u64 n, const f64* a, f64 s, f64* c); ///< `c = a / s`
+	void (*neg)        (u64 n, const f64* a, f64* c); ///< `c = -a`
+	void (*abs)        (u64 n, const f64* a, f64* c); ///< `c = |a|`
+	void (*axpy)       (u64 n, f64 alpha, const f64* x, f64* y); ///< `y = alpha*x + y`
+	void (*fill)       (u64 n, f64 s, f64* c); ///< `c = s`
+	void (*powi)       (u64 n, const f64* a, i32 p, f64* c); ///< `c = a^p` for an integer p.
+	f64  (*sum)        (u64 n, const f64* a); ///< sum of a with one accumulator per lane.
+} NxKernels;
+
+/**
+ * @brief Single precision version of the NxKernels table.
+ *
+ * Generated from the same template, used by the f32 tensors and by the
+ * bf16/f16 tensors which are widened to f32 block by block.
+ */
+typedef struct NxKernelsF32 {
+	const char* isa; ///< name of the instruction set of the table.
+	void (*add)        (u64 n, const f32* a, const f32* b, f32* c); ///< `c = a + b`
+	void (*sub)        (u64 n, const f32* a, const f32* b, f32* c); ///< `c = a - b`
+	void (*mul)        (u64 n, const f32* a, const f32* b, f32* c); ///< `c = a * b`
+	void (*div)        (u64 n, const f32* a, const f32* b, f32* c); ///< `c = a / b`
+	void (*add_scalar) (u64 n, const f32* a, f32 s, f32* c); ///< `c = a + s`
+	void (*mul_scalar) (u64 n, const f32* a, f32 s, f32* c); ///< `c = a * s`
+	void (*div_scalar) (u64 n, const f32* a, f32 s, f32* c); ///< `c = a / s`
+	void (*neg)        (u64 n, const f32* a, f32* c); ///< `c = -a`
+	void (*abs)        (u64 n, const f32* a, f32* c); ///< `c = |a|`
+	void (*axpy)       (u64 n, f32 alpha, const f32* x, f32* y); ///< `y = alpha*x + y`
+	void (*fill)       (u64 n, f32 s, f32* c); ///< `c = s`
+	void (*powi)       (u64 n, const f32* a, i32 p, f32* c); ///< `c = a^p` for an integer p.
+	f32  (*sum)        (u64 n, const f32* a); ///< sum of a with one accumulator per lane.
+} NxKernelsF32;
+
+bool                 NxKernels_select  (str isa);
+const NxKernels*     NxKernels_get     (void);
+const NxKernelsF32*  NxKernels_get_f32 (void);
+
+#endif /* _NxKERNELS_H_ */
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxKernels.h
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -3,6 +3,7 @@
 
 #include "NxCore.h"
 #include "NxTensor.h"
+#include "NxSparse.h"
 #include "NxActivations.h"
 
 /** 
@@ -24,6 +25,10 @@ typedef struct NxDense {
 
 void NxDense_alloc                     (NxDense*, u64, u64, NxActivation);
 void NxDense_forward                   (NxDense*, NxDense*, NxDense*);
+void NxDense_forward_sparse            (NxDense*, NxTensor*, NxSparseTensor*);
+void NxDense_backward_sparse           (NxDense*, NxTensor*, NxTensor*, NxTensor*, NxSparseTensor*, NxTensor*);
+void NxDense_forward_f64               (NxDense*, f64*, const f64*, u64);
+void NxDense_backward_f64              (NxDense*, f64*, f64*, f64*, f64*, const f64*, const f64*, u64);
 void NxDense_to_string                 (NxDense*);
 void NxDense_read                      (NxDense*, str);
 void NxDense_read_binary               (NxDense*, str);
@@ -31,6 +36,47 @@ void NxDense_write                     (NxDense*, str);
 void NxDense_write_binary              (NxDense*, str);
 void NxDense_free                      (NxDense*);
 
+/// First bytes of the binary files of NxDenseQ8_write_binary().
+#define NxDENSE_Q8_MAGIC "NXDENSQ8"
+/// Slope of the negative part of NxActivation_PReLU.
+#define NxPRELU_SLOPE 0.01f
+/// Scale of the negative part of NxActivation_ELU.
+#define NxELU_ALPHA 1.0f
+
+/** 
+ * @brief Int8 version of `NxDense` for inference.
+ *
+ * Made from a trained NxDense by NxDenseQ8_quantize(): the weights of
+ * every output channel are rounded to int8 with their own scale
+ * (`w = scales[j]*q`, |q| <= 127), the bias stays in f32. The inputs are
+ * rounded to int8 with `input_scale`, set by NxDenseQ8_calibrate() on
+ * representative batches, or from the largest value of every batch when
+ * it is zero. The forward pass is one NxGemm_q8() call, the bias and the
+ * activation run in its epilogue.
+ *
+ * Start from a zeroed layer (`NxDenseQ8 Q = {0};`), quantizing or
+ * reading into it again frees its previous buffers.
+ */
+typedef struct NxDenseQ8 {
+	u64 in_features; ///< Number of input features.
+	u64 out_features; ///< Number of output features.
+	NxActivation act; ///< What activation to apply to the output.
+	bool initialized; ///< whether the layer is initilized or not.
+	i8* weights; ///< int8 weights of shape (out_features, in_features).
+	i8* packed; ///< the weights packed by NxGemm_q8_pack().
+	f32* scales; ///< scale of the weights of every output channel.
+	f32* bias; ///< bias of every output channel.
+	f32 input_scale; ///< scale of the int8 inputs, 0 to compute it for every batch.
+}NxDenseQ8;
+
+void NxDenseQ8_quantize                (NxDenseQ8*, NxDense*);
+void NxDenseQ8_calibrate               (NxDenseQ8*, NxTensor*);
+void NxDenseQ8_forward                 (NxDenseQ8*, NxTensor*, NxTensor*);
+void NxDenseQ8_forward_q8              (NxDenseQ8*, i8*, f32, const i8*, u64);
+void NxDenseQ8_read_binary             (NxDenseQ8*, str);
+void NxDenseQ8_write_binary            (NxDenseQ8*, str);
+void NxDenseQ8_free                    (NxDenseQ8*);
+
 /** 
  * @brief Represent more abstraction over `NxTensor`.
  *
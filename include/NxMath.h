@@ -0,0 +1,50 @@
+#ifndef _NxMATH_H_
+#define _NxMATH_H_
+
+#include "NxCore.h"
+
+/// Accuracy modes of the vectorized math functions.
+typedef enum NxMathMode {
+	NxMATH_ACCURATE, ///< Default, errors of a few ULP (see NxMath.c for the bounds).
+	NxMATH_FAST, ///< Shorter polynomials, relative errors below 5e-7.
+} NxMathMode;
+
+void        NxMath_set_mode  (NxMathMode mode);
+NxMathMode  NxMath_get_mode  (void);
+bool        NxMath_select    (str isa);
+const char* NxMath_isa       (void);
+
+void NxMath_exp              (u64 n, const f64* a, f64* c);
+void NxMath_log              (u64 n, const f64* a, f64* c);
+void NxMath_log10            (u64 n, const f64* a, f64* c);
+void NxMath_tanh             (u64 n, const f64* a, f64* c);
+void NxMath_sigmoid          (u64 n, const f64* a, f64* c);
+void NxMath_sin              (u64 n, const f64* a, f64* c);
+void NxMath_cos              (u64 n, const f64* a, f64* c);
+
+#endif /* _NxMATH_H_ */
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxMath.h
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
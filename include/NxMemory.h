@@ -5,18 +5,226 @@
 
 /// Maximum size of memory block to allocate.
 #define NxARENA_MAX_SIZE 1024*1024*256
+/// Size of the first region of an arena, the next ones double up to NxARENA_MAX_SIZE.
+#define NxARENA_REGION_SIZE 1024*1024*4
+/// Alignment in bytes of every allocation of an arena (one cache line, one AVX-512 vector).
+#define NxARENA_ALIGN 64
 
 typedef struct NxRegion {
     struct NxRegion* next; ///< pointer to the next memory block.
     u64 count; ///< number of items allocated in the block.
     u64 capacity; ///< the maximum size of the memory block.
     u64 size; ///< the current size occupied in the block.
-    NxDTYPE* data; ///< the data of the memory block.
+    char* data; ///< the data of the memory block, aligned to NxARENA_ALIGN.
 } NxRegion;
 
+/**
+ * @brief Bump-pointer allocator for short-lived buffers.
+ *
+ * Allocations are carved from a chain of regions and are never freed one
+ * by one: NxArena_reset() rewinds the arena in O(1) and keeps the regions
+ * for the next step, NxArena_free() gives them back to the system. A
+ * request larger than NxARENA_MAX_SIZE gets a region of its own.
+ *
+ * While an arena is current (NxArena_set_current()) the buffers of the
+ * tensors allocated on the calling thread come from it, NxTensor_free()
+ * leaves them there and they become invalid at the next reset: free the
+ * tensors before the reset, or drop them without freeing them.
+ */
 typedef struct NxArena {
     NxRegion* begin; ///< pointer to the first memory block int the Arena.
     NxRegion* end; ///< pointer to the last memory block in the Arena.
+    NxRegion* current; ///< the block allocations are taken from.
 } NxArena;
 
-#endif /* _NxMEMORY_H_ */
\ No newline at end of file
+/// Size of a huge page on x86-64 and aarch64 (2 MiB).
+#define NxHUGE_PAGE_SIZE 1024*1024*2
+/// Default size from which the tensor buffers are backed by huge pages.
+#define NxHUGE_PAGE_THRESHOLD 1024*1024*2
+/// Environment variable selecting the huge page mode (`none`, `thp`, `hugetlb`).
+#define NxHUGE_PAGES_ENV "NEXUM_HUGE_PAGES"
+
+/**
+ * @brief How the buffers above the huge page threshold are backed.
+ *
+ * Every tensor buffer is 64-byte aligned. The ones above the threshold
+ * are mapped on huge page boundaries and backed by transparent or
+ * explicit huge pages (NxMemory_set_huge_pages()), which cuts the TLB
+ * misses when streaming large weight tensors.
+ */
+typedef enum NxHugePages {
+    NxHUGE_PAGES_NONE, ///< 64-byte aligned heap memory like the small buffers.
+    NxHUGE_PAGES_TRANSPARENT, ///< anonymous mapping with `madvise(MADV_HUGEPAGE)`.
+    NxHUGE_PAGES_EXPLICIT, ///< hugetlbfs pages (`MAP_HUGETLB`), transparent ones when none are reserved.
+} NxHugePages;
+
+/// How the buffer of a tensor was obtained, see NxTensor_alloc_policy().
+typedef enum NxAllocPolicy {
+    NxALLOC_NONE, ///< no buffer.
+    NxALLOC_ALIGNED, ///< heap memory aligned to 64 bytes.
+    NxALLOC_TRANSPARENT_HUGE, ///< mapping advised to use transparent huge pages.
+    NxALLOC_HUGETLB, ///< mapping of explicit huge pages.
+    NxALLOC_ARENA, ///< carved from an NxArena (64-byte aligned).
+    NxALLOC_BORROWED, ///< owned by someone else, wrapped by NxStorage_wrap() (NxTensor_set_data()).
+    NxALLOC_MAPPED, ///< mapping of a file (NxTensor_map_binary()).
+} NxAllocPolicy;
+
+/// Flags of NxStorage_map() and NxStorage_advise().
+typedef enum NxMapFlags {
+    NxMAP_READ_ONLY = 0, ///< shared read-only mapping, the operations writing to it get a new buffer.
+    NxMAP_PRIVATE = 1, ///< writable private mapping, a page is copied on its first write.
+    NxMAP_SEQUENTIAL = 2, ///< `madvise(MADV_SEQUENTIAL)`: aggressive read-ahead, pages dropped behind.
+    NxMAP_RANDOM = 4, ///< `madvise(MADV_RANDOM)`: no read-ahead.
+    NxMAP_WILLNEED = 8, ///< `madvise(MADV_WILLNEED)`: start reading the whole range now.
+} NxMapFlags;
+
+/// Smallest size class of NxCache, in bytes.
+#define NxCACHE_MIN_SIZE 64
+/// Number of size classes of NxCache: 64 bytes then 4 classes per power of two up to 4 GiB.
+#define NxCACHE_CLASSES (1 + 4*26)
+/// Default number of bytes NxCache keeps per thread.
+#define NxCACHE_DEFAULT_LIMIT 1024*1024*256
+
+/**
+ * @brief Counters of NxCache for the calling thread.
+ */
+typedef struct NxCacheStats {
+    u64 allocs; ///< number of NxCache_alloc() calls.
+    u64 hits; ///< allocations served from a free list.
+    u64 system_allocs; ///< allocations that went to the system.
+    u64 system_frees; ///< buffers given back to the system.
+    u64 cached_buffers; ///< buffers waiting in the free lists.
+    u64 cached_bytes; ///< bytes waiting in the free lists.
+} NxCacheStats;
+
+void      NxArena_init          (NxArena* A);
+void*     NxArena_alloc         (NxArena* A, u64 size);
+void      NxArena_reset         (NxArena* A);
+void      NxArena_free          (NxArena* A);
+u64       NxArena_used          (NxArena* A);
+u64       NxArena_capacity      (NxArena* A);
+NxArena*  NxArena_set_current   (NxArena* A);
+NxArena*  NxArena_get_current   (void);
+
+/**
+ * @brief Reference counted buffer shared by a tensor and its views.
+ *
+ * The buffer follows the NxStorage header in the same allocation (from
+ * the current arena or NxCache) unless it is borrowed or mapped from a
+ * file. The count is updated atomically so tensors sharing a storage may
+ * live on different threads.
+ */
+typedef struct NxStorage {
+    void* data; ///< start of the buffer, 64-byte aligned unless mapped.
+    u64 bytes; ///< size of the buffer.
+    u32 refcount; ///< number of tensors pointing into the buffer.
+    NxAllocPolicy policy; ///< how the buffer was allocated.
+    bool readonly; ///< the buffer must not be written (read-only mapping).
+    void* map; ///< start of the file mapping, page aligned (NxALLOC_MAPPED).
+    u64 map_bytes; ///< length of the file mapping.
+} NxStorage;
+
+NxStorage*   NxStorage_alloc             (u64 bytes);
+NxStorage*   NxStorage_wrap              (void* data, u64 bytes);
+NxStorage*   NxStorage_map               (str fname, u64 offset, u64 bytes, u32 flags);
+void         NxStorage_advise            (NxStorage* S, u32 flags);
+void         NxStorage_retain            (NxStorage* S);
+void         NxStorage_release           (NxStorage* S);
+bool         NxStorage_shared            (const NxStorage* S);
+
+void         NxMemory_set_huge_pages     (NxHugePages mode, u64 threshold);
+NxHugePages  NxMemory_get_huge_pages     (void);
+u64          NxMemory_get_huge_threshold (void);
+const char*  NxAllocPolicy_name          (NxAllocPolicy policy);
+
+/**
+ * @brief Per-thread cache of the tensor buffers allocated outside an arena.
+ *
+ * NxCache_free() puts a buffer on a free list of the calling thread (one
+ * list per size class, four classes per power of two) and NxCache_alloc()
+ * takes it back, so repeated calls with the same shapes stop calling
+ * malloc. Every thread keeps at most NxCache_get_limit() bytes, the rest
+ * goes back to the system, and NxCache_trim() empties the lists on demand.
+ */
+void*     NxCache_alloc         (u64 size);
+void      NxCache_free          (void* p);
+NxAllocPolicy NxCache_policy    (const void* p);
+void      NxCache_set_limit     (u64 bytes);
+u64       NxCache_get_limit     (void);
+void      NxCache_trim          (u64 keep);
+void      NxCache_stats         (NxCacheStats* S);
+void      NxCache_reset_stats   (void);
+
+/// Buffers allocated by the first NxMemoryPlan_add(), the array doubles from there.
+#define NxPLAN_INITIAL_CAPACITY 16
+
+/// One buffer of an NxMemoryPlan, live from the step it is written to the last step reading it.
+typedef struct NxPlanBuffer {
+    u64 bytes; ///< size of the buffer.
+    u64 first; ///< first step the buffer is live at.
+    u64 last; ///< last step the buffer is live at (included).
+    u64 offset; ///< position in the slab, set by NxMemoryPlan_solve().
+} NxPlanBuffer;
+
+/**
+ * @brief Static placement of buffers with known sizes and lifetimes in one slab.
+ *
+ * The buffers are described up front with NxMemoryPlan_add(), then
+ * NxMemoryPlan_solve() gives each one an offset so that two buffers live
+ * at the same step never overlap (interval coloring), and
+ * NxMemoryPlan_alloc() allocates the slab once. The buffers of a training
+ * step are then used without any allocation:
+ *
+ * ```c
+ * NxMemoryPlan P;
+ * NxMemoryPlan_init(&P);
+ * u64 x = NxMemoryPlan_add(&P, 1024, 0, 3);
+ * u64 y = NxMemoryPlan_add(&P, 2048, 1, 2);
+ * NxMemoryPlan_solve(&P);
+ * NxMemoryPlan_alloc(&P);
+ * f64* data = NxMemoryPlan_data(&P, y);
+ * ```
+ */
+typedef struct NxMemoryPlan {
+    NxPlanBuffer* buffers; ///< the planned buffers.
+    u64 n_buffers; ///< number of buffers.
+    u64 capacity; ///< number of allocated buffers.
+    u64 peak; ///< size of the slab, set by NxMemoryPlan_solve().
+    u64 live; ///< largest sum of the buffers live at one step, no placement needs less than this.
+    u64 total; ///< sum of the sizes of the buffers, the memory needed without any reuse.
+    NxStorage* slab; ///< the slab, allocated by NxMemoryPlan_alloc().
+} NxMemoryPlan;
+
+void      NxMemoryPlan_init     (NxMemoryPlan* P);
+u64       NxMemoryPlan_add      (NxMemoryPlan* P, u64 bytes, u64 first, u64 last);
+u64       NxMemoryPlan_solve    (NxMemoryPlan* P);
+void      NxMemoryPlan_alloc    (NxMemoryPlan* P);
+void*     NxMemoryPlan_data     (NxMemoryPlan* P, u64 id);
+void      NxMemoryPlan_free     (NxMemoryPlan* P);
+
+#endif /* _NxMEMORY_H_ */
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxMemory.h
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -2,21 +2,75 @@
 #define _NxMODEL_H_
 
 #include "NxCore.h"
+#include "NxTensor.h"
+#include "NxMemory.h"
+#include "NxDataset.h"
+#include "NxLayers.h"
 #include "NxActivations.h"
 
+/// Layers allocated by the first append, the array doubles from there.
+#define NxMODEL_INITIAL_CAPACITY 8
+/// Learning rate of a new model.
+#define NxMODEL_DEFAULT_LR 0.01
+/// Number of passes over the data of NxModelSequential_train() for a new model.
+#define NxMODEL_DEFAULT_EPOCHS 1
 
-/// Define a Sequential Model like the one in Keras Tensorflow models.
+/// Ids in the memory plan of the buffers of one layer during a training step.
+typedef struct NxModelBuffers {
+	u64 output; ///< the activated outputs.
+	u64 grad; ///< gradient of the loss with respect to the outputs.
+	u64 dweights; ///< gradient of the weights.
+	u64 dbias; ///< gradient of the bias.
+} NxModelBuffers;
+
+/**
+ * @brief Define a Sequential Model like the one in Keras Tensorflow models.
+ *
+ * A stack of Dense layers trained on the mean squared error with SGD.
+ * For a batch size every buffer of a training step has a known size and
+ * lifetime, so NxModelSequential_plan() places all of them in one slab
+ * (NxMemoryPlan) before the first step, and the steps run without any
+ * allocation:
+ *
+ * ```c
+ * NxModelSequential model;
+ * NxModelSequential_init(&model, "mlp");
+ * NxModelSequential_append_Dense(&model, 784, 256, NxActivation_ReLU);
+ * NxModelSequential_append_Dense(&model, 256, 10, NxActivation_None);
+ * printf("%" PRIu64 " bytes\n", NxModelSequential_plan(&model, 128));
+ * NxModelSequential_train(&model, &x_train, &y_train, 128);
+ * NxModelSequential_free(&model);
+ * ```
+ *
+ * Data that does not fit in memory is streamed from files with
+ * NxModelSequential_train_dataset() and an NxDataset.
+ */
 typedef struct NxModelSequential {
 	str name; ///< The name of the model.
+	NxDense* layers; ///< the layers, from the inputs to the outputs.
+	u64 n_layers; ///< number of layers.
+	u64 capacity; ///< number of allocated layers.
+	f64 lr; ///< learning rate of the SGD updates.
+	u64 epochs; ///< passes over the data of NxModelSequential_train().
+	f64 loss; ///< mean squared error of the last epoch, `0.5*mean((y - p)^2)` like NxLoss_mse().
+	u64 batch_size; ///< batch size of the memory plan, 0 when there is none.
+	NxMemoryPlan plan; ///< placement of the buffers of a training step.
+	u64 input; ///< id of the buffer of the inputs of a batch.
+	NxModelBuffers* buffers; ///< buffers of every layer.
 }NxModelSequential;
 
-void NxModelSequential_append_Dense     (u64 in_feature, u64 out_features, NxActivation act);
-void NxModelSequential_append_Conv1D    (u64 n_filters, u64 kernel_size, u8 stride, u8 padding);
-void NxModelSequential_append_Conv2D    (u64 n_filters, u64 kernel_size, u8 stride, u8 padding);
-void NxModelSequential_append_MaxPool1D (u64 pool_size);
-void NxModelSequential_append_MaxPool2D (u64 pool_size);
+void NxModelSequential_init             (NxModelSequential* model, str name);
+void NxModelSequential_free             (NxModelSequential* model);
+
+void NxModelSequential_append_Dense     (NxModelSequential* model, u64 in_features, u64 out_features, NxActivation act);
+void NxModelSequential_append_Conv1D    (NxModelSequential* model, u64 n_filters, u64 kernel_size, u8 stride, u8 padding);
+void NxModelSequential_append_Conv2D    (NxModelSequential* model, u64 n_filters, u64 kernel_size, u8 stride, u8 padding);
+void NxModelSequential_append_MaxPool1D (NxModelSequential* model, u64 pool_size);
+void NxModelSequential_append_MaxPool2D (NxModelSequential* model, u64 pool_size);
 
+u64  NxModelSequential_plan             (NxModelSequential* model, u64 batch_size);
 void NxModelSequential_train            (NxModelSequential* model, NxTensor* x_train, NxTensor* y_train, u64 batch_size);
+void NxModelSequential_train_dataset    (NxModelSequential* model, NxDataset* data);
 void NxModelSequential_evaluate         (NxModelSequential* model);
 void NxModelSequential_predict          (NxModelSequential* model);
 
@@ -0,0 +1,65 @@
+#ifndef _NxREDUCE_H_
+#define _NxREDUCE_H_
+
+#include "NxCore.h"
+
+/// Environment variable enabling the deterministic mode when set to `1`.
+#define NxREDUCE_DETERMINISTIC_ENV "NEXUM_DETERMINISTIC"
+/// Number of partial results of the deterministic mode, whatever the number of threads.
+#define NxREDUCE_PARTS 64
+/// Minimum number of elements given to one thread (or to one part).
+#define NxREDUCE_MIN_WORK 32768
+/// Below this size the pairwise sum switches to the SIMD sum kernel.
+#define NxREDUCE_LEAF 256
+
+/**
+ * @brief Sum reductions over f64 buffers.
+ *
+ * The sums are pairwise: the buffer is split in halves down to blocks of
+ * NxREDUCE_LEAF elements that are summed with one SIMD accumulator per
+ * lane, which keeps the error growing as O(log n) instead of O(n). The
+ * axis sums of a matrix accumulate blocks of rows with the vector kernels
+ * and fold them into the result with Kahan compensation.
+ *
+ * Large inputs are split over the NxThreadPool threads. By default there is one part per
+ * thread, so the rounding of NxReduce_sum() and NxReduce_sum_over_rows()
+ * depends on the number of threads. In deterministic mode the input is
+ * always cut into the same parts (at most NxREDUCE_PARTS, depending only on
+ * the size) which are combined in the same order, so the results are bit
+ * identical for any number of threads. NxReduce_sum_over_cols() is
+ * deterministic in both modes.
+ */
+
+void  NxReduce_set_deterministic    (bool deterministic);
+bool  NxReduce_is_deterministic     (void);
+
+f64   NxReduce_sum                  (u64 n, const f64* a);
+void  NxReduce_sum_over_rows        (u64 m, u64 n, const f64* A, i64 rs, f64* c);
+void  NxReduce_sum_over_cols        (u64 m, u64 n, const f64* A, i64 rs, f64* c);
+
+#endif /* _NxREDUCE_H_ */
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxReduce.h
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,78 @@
+#ifndef _NxSPARSE_H_
+#define _NxSPARSE_H_
+
+#include "NxCore.h"
+#include "NxTensor.h"
+
+/// Rows or columns of C per chunk of the parallel products.
+#define NxSPARSE_GRAIN 16
+
+/// Compressed dimension of an NxSparseTensor.
+typedef enum NxSparseFormat {
+	NxSPARSE_CSR, ///< compressed sparse rows, `ptr` has m + 1 entries.
+	NxSPARSE_CSC, ///< compressed sparse columns, `ptr` has n + 1 entries.
+} NxSparseFormat;
+
+/**
+ * @brief Sparse f64 matrix in CSR or CSC format.
+ *
+ * In CSR the nonzeros of row i are `values[ptr[i] .. ptr[i+1])` and their
+ * columns are `indices[ptr[i] .. ptr[i+1])`, sorted in increasing order.
+ * CSC is the same with the roles of the rows and the columns swapped, so
+ * a CSR matrix read as CSC is its transpose.
+ *
+ * Meant for inputs that are mostly zeros (one-hot, bag-of-words): the
+ * products of NxSparse_spmm() cost in proportion to the nonzeros times
+ * the columns of the dense operand, not to the full width of the matrix.
+ */
+typedef struct NxSparseTensor {
+	u64 m; ///< number of rows.
+	u64 n; ///< number of columns.
+	u64 nnz; ///< number of stored elements.
+	NxSparseFormat format; ///< which dimension is compressed.
+	u64* ptr; ///< start of every compressed row (column) in `indices` and `values`.
+	u64* indices; ///< column (row) of every stored element.
+	f64* values; ///< the stored elements.
+	bool allocated; ///< whether the buffers are allocated.
+} NxSparseTensor;
+
+void  NxSparseTensor_alloc       (NxSparseTensor* S, u64 m, u64 n, u64 nnz, NxSparseFormat format);
+void  NxSparseTensor_from_dense  (NxSparseTensor* S, NxTensor* A, NxSparseFormat format);
+void  NxSparseTensor_from_coo    (NxSparseTensor* S, u64 m, u64 n, u64 nnz, const u64* rows,
+                                  const u64* cols, const f64* values, NxSparseFormat format);
+void  NxSparseTensor_to_dense    (NxTensor* C, NxSparseTensor* S);
+void  NxSparseTensor_convert     (NxSparseTensor* C, NxSparseTensor* S, NxSparseFormat format);
+void  NxSparseTensor_matmul      (NxTensor* C, NxSparseTensor* A, NxTensor* B);
+f64   NxSparseTensor_density     (NxSparseTensor* S);
+void  NxSparseTensor_free        (NxSparseTensor* S);
+
+void  NxSparse_spmm              (bool trans, u64 n, f64 alpha, NxSparseTensor* A,
+                                  const f64* B, i64 rsb, i64 csb,
+                                  f64 beta, f64* C, i64 rsc, i64 csc);
+
+#endif /* _NxSPARSE_H_ */
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxSparse.h
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -3,9 +3,12 @@
 
 #include <string.h>
 #include "NxCore.h"
+#include "NxCodec.h"
+#include "NxDType.h"
+#include "NxMemory.h"
 
-/// Return the element at position i, j
-#define NxTensor_AT(M, i, j) (M)->data[(i)*(M)->n + (j)]
+/// Return the element at position i, j (follows the strides, so it also works on views).
+#define NxTensor_AT(M, i, j) (M)->data[(i)*(M)->rs + (j)*(M)->cs]
 /// Return the position of an element mapped from 2D to 1D
 /// Where N is the number of columns of the tensor.
 #define NxIDX(N, i, j) ((i) * (N) + (j))
@@ -13,6 +16,23 @@
 #define NxAXIS_ROW 0
 /// Broadcast the Tensor over the Columns (Peform the Operation over the Columns).
 #define NxAXIS_COL 1
+/// Element wize operations of NxTensor_broadcast().
+typedef enum NxBinaryOp {
+	NxOP_ADD, ///< `c = a + b`
+	NxOP_SUB, ///< `c = a - b`
+	NxOP_MUL, ///< `c = a * b`
+	NxOP_DIV, ///< `c = a / b`
+} NxBinaryOp;
+
+/// Maximum number of dimensions of a tensor.
+#define NxMAX_DIMS 6
+
+/// Memory layout of the 4-D image tensors.
+typedef enum NxLayout {
+	NxLAYOUT_NONE = 0, ///< no particular meaning of the dimensions.
+	NxLAYOUT_NCHW, ///< (batch, channels, height, width).
+	NxLAYOUT_NHWC, ///< (batch, height, width, channels).
+} NxLayout;
 
 /** 
  * @brief Represents our main data type in our Neural Networks.
@@ -25,18 +45,78 @@
  * Consider it as more like NumPy ndarrays where it also abstracted alot of the
  * math functions to be used directly into the data of the tensor which helps us
  * not bather with for loops.
+ *
+ * A tensor has `ndim` dimensions (up to NxMAX_DIMS) described by `shape`
+ * and `strides`. The 2-D functions see it as a (m, n) matrix where `n` is
+ * the last dimension and `m` the product of the others, e.g. a (batch,
+ * time, features) tensor is a (batch*time, features) matrix.
+ *
+ * Element (i, j) lives at `data[i*rs + j*cs]`. Tensors created by the alloc
+ * functions are contiguous (`rs == n`, `cs == 1`); transpose, reshape and
+ * slicing return views so they cost O(1).
+ *
+ * The buffer belongs to a reference counted NxStorage: a view, or a copy
+ * of a contiguous tensor (NxTensor_copy_data()), points into the storage of
+ * its source, and the buffer lives as long as one of them. Writes are
+ * copy-on-write: an operation writing into a tensor whose storage is
+ * shared (an inplace `_` operation, or any result stored in a view) gives
+ * it a buffer of its own first, so the other tensors never see the write.
+ * Code writing through `data` directly calls NxTensor_unshare() first.
  */
 typedef struct NxTensor {
 	u64 id; ///< id of the tensor helpful in AutoDiff later. 
 	u64 m; ///< number of rows. 
 	u64 n; ///< number of columns. 
-	NxDTYPE* data; ///< the actual data of the tensor stored as 1D array in the Heap. with size (m*n) 
+	union {
+		NxDTYPE* data; ///< the actual data of the tensor stored as 1D array in the Heap. with size (m*n) 
+		f32* data_f32; ///< the data viewed as f32 when `dtype == NxFLOAT32`.
+		u16* data_u16; ///< the raw bits of the data when `dtype` is NxBFLOAT16 or NxFLOAT16.
+		void* raw; ///< the data without a type.
+	};
+	NxDType dtype; ///< storage type of the elements, NxFLOAT64 for a zero-initialized tensor.
+	u32 ndim; ///< number of dimensions, 2 for the tensors of the 2-D API.
+	u64 shape[NxMAX_DIMS]; ///< size of every dimension.
+	i64 strides[NxMAX_DIMS]; ///< stride in elements of every dimension.
+	NxLayout layout; ///< meaning of the dimensions of 4-D image tensors.
+	i64 rs; ///< row stride in elements.
+	i64 cs; ///< column stride in elements.
+	u64 offset; ///< number of elements between the start of the storage and `data`.
+	NxStorage* storage; ///< reference counted buffer `data` points into.
+	bool arena; ///< whether the buffer lives in an NxArena (released by NxArena_reset()).
 	bool allocated; ///< whether this tensor is allocated (initialized) or not. 
-    u32 refcount; ///< how many times the object used in (useful in memory deallocation later).
 }NxTensor;
 
+/// First bytes of the binary tensor files written by NxTensor_write_binary().
+#define NxTENSOR_FILE_MAGIC "NXTENSOR"
+/// Version of the binary tensor file format.
+#define NxTENSOR_FILE_VERSION 2
+/// Alignment of the data in the binary tensor files so it can be mapped in place.
+#define NxTENSOR_FILE_ALIGN 4096
+
+/**
+ * @brief Header of the binary tensor files.
+ *
+ * Stored at the start of the file in native byte order, followed by
+ * padding up to `offset` then the contiguous row-major elements, or
+ * their NxCodecFrame when `codec` is NxCODEC_SHUFFLE_LZ (version 2). The
+ * files of the first format (two u64 then f64 elements) have no header
+ * and are still read by NxTensor_read_binary().
+ */
+typedef struct NxTensorFileHeader {
+	char magic[8]; ///< NxTENSOR_FILE_MAGIC, not null-terminated.
+	u32 version; ///< format version, NxTENSOR_FILE_VERSION.
+	u32 dtype; ///< NxDType of the elements.
+	u32 ndim; ///< number of dimensions.
+	u32 codec; ///< NxCodecType of the data, always NxCODEC_NONE in version 1.
+	u64 shape[NxMAX_DIMS]; ///< size of every dimension, 0 past ndim.
+	u64 offset; ///< position of the data in the file, multiple of NxTENSOR_FILE_ALIGN.
+	u64 bytes; ///< size of the uncompressed data.
+} NxTensorFileHeader;
+
 
 NxCDEF void NxTensor_alloc            (NxTensor* A, u64 m, u64 n);
+NxCDEF void NxTensor_alloc_dtype      (NxTensor* A, u64 m, u64 n, NxDType dtype);
+NxCDEF void NxTensor_alloc_nd         (NxTensor* A, u32 ndim, const u64* shape, NxDType dtype);
 NxCDEF void NxTensor_alloc_zeros      (NxTensor* A, u64 m, u64 n);
 NxCDEF void NxTensor_alloc_ones       (NxTensor* A, u64 m, u64 n); 
 NxCDEF void NxTensor_alloc_rand       (NxTensor* A, u64 m, u64 n); 
@@ -47,14 +127,22 @@ NxCDEF void NxTensor_alloc_linspace   (NxTensor* A, NxDTYPE start, NxDTYPE end,
 NxCDEF void NxTensor_alloc_ones_like  (NxTensor* C, NxTensor* A);
 NxCDEF void NxTensor_alloc_full       (NxTensor* C, NxTensor* A);
 NxCDEF void NxTensor_alloc_zeros_like (NxTensor* C, NxTensor* A);
+NxCDEF NxStorage* NxTensor_hold       (NxTensor* C, NxTensor* A, u64 size, NxDType dtype);
+NxCDEF void NxTensor_unhold           (NxStorage* S);
 
 NxCDEF void NxTensor_set_data         (NxTensor* A, NxDTYPE* data); 
+NxCDEF void NxTensor_from_storage     (NxTensor* A, NxStorage* S, u64 bytes_offset, NxDType dtype,
+                                      u32 ndim, const u64* shape);
 NxCDEF void NxTensor_copy_data        (NxTensor* C, NxTensor* A);
+NxCDEF void NxTensor_astype           (NxTensor* C, NxTensor* A, NxDType dtype);
 
 NxCDEF void NxTensor_read             (NxTensor* A, str fname); 
 NxCDEF void NxTensor_read_binary      (NxTensor* A, str fname); 
 NxCDEF void NxTensor_write            (NxTensor* A, str fname); 
 NxCDEF void NxTensor_write_binary     (NxTensor* A, str fname); 
+NxCDEF void NxTensor_write_compressed (NxTensor* A, str fname);
+NxCDEF void NxTensor_map_binary       (NxTensor* A, str fname, u32 flags);
+NxCDEF bool NxTensor_read_header      (FILE* fptr, NxTensorFileHeader* H, str fname);
 
 NxCDEF void NxTensor_add_tensor       (NxTensor* C, NxTensor* A, NxTensor* B); 
 NxCDEF void NxTensor_sub_tensor       (NxTensor* C, NxTensor* A, NxTensor* B); 
@@ -65,6 +153,7 @@ NxCDEF void NxTensor_add_tensor_boradcast  (NxTensor* C, NxTensor* A, NxTensor*
 NxCDEF void NxTensor_sub_tensor_boradcast  (NxTensor* C, NxTensor* A, NxTensor* B, u8); 
 NxCDEF void NxTensor_mul_tensor_broadcast  (NxTensor* C, NxTensor* A, NxTensor* B, u8); 
 NxCDEF void NxTensor_div_tensor_broadcast  (NxTensor* C, NxTensor* A, NxTensor* B, u8); 
+NxCDEF void NxTensor_broadcast             (NxTensor* C, NxTensor* A, NxTensor* B, NxBinaryOp op);
 
 NxCDEF void NxTensor_matmul_tensor    (NxTensor* C, NxTensor* A, NxTensor* B); 
 
@@ -81,6 +170,18 @@ NxCDEF void NxTensor_transpose        (NxTensor* C, NxTensor* A);
 NxCDEF void NxTensor_transpose_       (NxTensor* A);
 NxCDEF void NxTensor_reshape          (NxTensor* C, NxTensor* A, u64 m, u64 n);
 NxCDEF void NxTensor_reshape_         (NxTensor* A, u64 m, u64 n);
+NxCDEF void NxTensor_slice            (NxTensor* C, NxTensor* A, u64 r0, u64 r1, u64 c0, u64 c1);
+NxCDEF void NxTensor_rows             (NxTensor* C, NxTensor* A, u64 r0, u64 r1);
+NxCDEF void NxTensor_cols             (NxTensor* C, NxTensor* A, u64 c0, u64 c1);
+NxCDEF void NxTensor_contiguous       (NxTensor* C, NxTensor* A);
+NxCDEF void NxTensor_reshape_nd       (NxTensor* C, NxTensor* A, u32 ndim, const u64* shape);
+NxCDEF void NxTensor_permute          (NxTensor* C, NxTensor* A, const u32* axes);
+NxCDEF void NxTensor_narrow           (NxTensor* C, NxTensor* A, u32 axis, u64 start, u64 end);
+NxCDEF void NxTensor_to_layout        (NxTensor* C, NxTensor* A, NxLayout layout);
+NxCDEF bool NxTensor_is_contiguous    (NxTensor* A);
+NxCDEF NxAllocPolicy NxTensor_alloc_policy (NxTensor* A);
+NxCDEF bool NxTensor_is_shared        (NxTensor* A);
+NxCDEF void NxTensor_unshare          (NxTensor* A);
 
 NxCDEF void NxTensor_sum_tensor       (NxTensor* C, NxTensor* A, u32 axis);
 NxCDEF void NxTensor_expand           (NxTensor* C, NxTensor* A, u8 axis, u64 n_copies);
@@ -101,6 +202,8 @@ NxCDEF void NxTensor_log              (NxTensor* C, NxTensor* A);
 NxCDEF void NxTensor_log10            (NxTensor* C, NxTensor* A);
 NxCDEF void NxTensor_cos              (NxTensor* C, NxTensor* A);
 NxCDEF void NxTensor_sin              (NxTensor* C, NxTensor* A);
+NxCDEF void NxTensor_tanh             (NxTensor* C, NxTensor* A);
+NxCDEF void NxTensor_sigmoid          (NxTensor* C, NxTensor* A);
 
 NxCDEF void NxTensor_apply_           (NxTensor* A, NxDTYPE(*pfunc)(NxDTYPE));
 NxCDEF void NxTensor_neg_             (NxTensor* A);
@@ -113,6 +216,8 @@ NxCDEF void NxTensor_log_             (NxTensor* A);
 NxCDEF void NxTensor_log10_           (NxTensor* A);
 NxCDEF void NxTensor_cos_             (NxTensor* A);
 NxCDEF void NxTensor_sin_             (NxTensor* A);
+NxCDEF void NxTensor_tanh_            (NxTensor* A);
+NxCDEF void NxTensor_sigmoid_         (NxTensor* A);
 
 NxCDEF u64  NxTensor_size             (NxTensor* A);
 NxDTYPE  NxTensor_sum                 (NxTensor* A);
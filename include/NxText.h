@@ -0,0 +1,65 @@
+#ifndef _NxTEXT_H_
+#define _NxTEXT_H_
+
+#include "NxCore.h"
+#include "NxMemory.h"
+
+/// Size of a buffer large enough for NxText_format_f64() and a separator.
+#define NxTEXT_F64_SIZE 32
+/// Bytes of text handled by one task of NxText_parse_f64s().
+#define NxTEXT_CHUNK (1024*1024)
+/// Elements formatted by one task of NxText_write_f64s().
+#define NxTEXT_WRITE_BLOCK 4096
+
+/**
+ * @brief Fast conversions between doubles and text.
+ *
+ * The parser reads the numbers of a text buffer without `fscanf`: the
+ * common decimal forms (up to 19 significant digits, exponents up to
+ * 10^19) are converted exactly with integer arithmetic, the rest (long
+ * mantissas, huge exponents, `nan`, `inf`) goes through `strtod`. The
+ * numbers are separated by spaces, tabs, new lines, commas or semicolons
+ * so CSV matrices read as well.
+ *
+ * The formatter writes the shortest of 15, 16 or 17 significant digits
+ * that reads back to the same double, so a text round trip keeps the
+ * values bit for bit.
+ *
+ * NxText_parse_f64s() and NxText_write_f64s() split the work over the
+ * NxThreadPool.
+ */
+
+NxStorage*   NxText_load         (str fname);
+const char*  NxText_parse_u64s   (const char* s, const char* end, u32 count, u64* out);
+f64          NxText_parse_f64    (const char* s, const char* end, const char** stop);
+bool         NxText_parse_f64s   (const char* text, u64 len, u64 n, f64* out);
+const char*  NxText_parse_next   (const char* s, const char* end, u64 n, f64* out);
+u32          NxText_format_f64   (char* buf, f64 x);
+void         NxText_write_f64s   (FILE* fptr, u64 m, u64 n, const f64* a, i64 rs, i64 cs);
+
+#endif /* _NxTEXT_H_ */
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxText.h
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,68 @@
+#ifndef _NxTHREADPOOL_H_
+#define _NxTHREADPOOL_H_
+
+#include "NxCore.h"
+
+/// Environment variable holding the default number of threads.
+#define NxTHREADS_ENV "NEXUM_NUM_THREADS"
+/// Maximum number of threads of the pool (the calling thread included).
+#define NxTHREADS_MAX 256
+/// Elements per chunk of the elementwise operations, smaller tensors stay on one thread.
+#define NxPARALLEL_GRAIN 32768
+
+/// Body of a parallel loop, runs the iterations [begin, end).
+typedef void (*NxParallelFn)(void* ctx, u64 begin, u64 end);
+/// Body of a parallel reduction, returns the partial result of [begin, end).
+typedef f64 (*NxParallelReduceFn)(void* ctx, u64 begin, u64 end);
+
+/**
+ * @brief Persistent work-stealing pool of worker threads.
+ *
+ * A parallel loop over n iterations is cut into chunks of `grain`
+ * iterations. Every thread starts with a contiguous range of chunks and
+ * takes them from the front, a thread that runs out steals the back half
+ * of the range of another thread, so uneven chunks stay balanced without
+ * a shared queue. The calling thread works as one of the threads and the
+ * workers sleep between the loops. A parallel loop started from inside a
+ * loop body runs serially on the calling thread.
+ *
+ * The number of threads comes from NxTHREADS_ENV (default: the online
+ * CPUs), can be changed with NxThreadPool_set_threads() and overridden per
+ * call with the `_n` variants.
+ */
+
+void  NxThreadPool_set_threads        (u32 threads);
+u32   NxThreadPool_get_threads        (void);
+void  NxThreadPool_shutdown           (void);
+
+void  NxThreadPool_parallel_for       (u64 n, u64 grain, NxParallelFn fn, void* ctx);
+void  NxThreadPool_parallel_for_n     (u32 threads, u64 n, u64 grain, NxParallelFn fn, void* ctx);
+f64   NxThreadPool_parallel_reduce    (u64 n, u64 grain, NxParallelReduceFn fn, void* ctx);
+f64   NxThreadPool_parallel_reduce_n  (u32 threads, u64 n, u64 grain, NxParallelReduceFn fn, void* ctx);
+
+#endif /* _NxTHREADPOOL_H_ */
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxThreadPool.h
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,291 @@
+#include "NxBackend.h"
+#include "NxGemm.h"
+#include "NxKernels.h"
+
+#include <string.h>
+#include <limits.h>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+
+/// CBLAS enum values (identical in every CBLAS implementation).
+#define NxCBLAS_ROW_MAJOR 101
+#define NxCBLAS_NO_TRANS  111
+#define NxCBLAS_TRANS     112
+
+typedef void (*NxCblasDgemm)(int, int, int, int, int, int, double,
+                             const double*, int, const double*, int,
+                             double, double*, int);
+typedef void (*NxCblasDaxpy)(int, double, const double*, int, double*, int);
+typedef void (*NxCblasDscal)(int, double, double*, int);
+
+/// The routines resolved from the loaded CBLAS library.
+static struct {
+    NxCblasDgemm dgemm;
+    NxCblasDaxpy daxpy;
+    NxCblasDscal dscal;
+} NxCblas;
+
+/**
+ * @brief Native `y = alpha*x + y` using the SIMD kernels.
+ */
+static void NxBackend_native_daxpy(u64 n, f64 alpha, const f64* x, f64* y) {
+    NxKernels_get()->axpy(n, alpha, x, y);
+}
+
+/**
+ * @brief Native `x = alpha*x` using the SIMD kernels.
+ */
+static void NxBackend_native_dscal(u64 n, f64 alpha, f64* x) {
+    NxKernels_get()->mul_scalar(n, x, alpha, x);
+}
+
+/**
+ * @brief Describe a strided matrix as a row-major CBLAS operand.
+ *
+ * @param rs row stride of the operand.
+ * @param cs column stride of the operand.
+ * @param cols number of columns of the operand.
+ * @param trans set to the CBLAS transpose flag.
+ * @param ld set to the leading dimension.
+ *
+ * @return false if the strides cannot be expressed with a leading dimension.
+ */
+static bool NxBackend_cblas_operand(i64 rs, i64 cs, u64 rows, u64 cols, int* trans, int* ld) {
+    if(cs == 1 && rs >= (i64)(cols > 1 ? cols : 1) && rs <= INT_MAX) {
+        *trans = NxCBLAS_NO_TRANS; *ld = (int)rs;
+        return true;
+    }
+    if(rs == 1 && cs >= (i64)(rows > 1 ? rows : 1) && cs <= INT_MAX) {
+        *trans = NxCBLAS_TRANS; *ld = (int)cs;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief `C = alpha*A*B + beta*C` through the loaded CBLAS library.
+ *
+ * Falls back to NxGemm_dgemm() when an operand cannot be described to
+ * CBLAS (general strides or sizes above `INT_MAX`).
+ */
+static void NxBackend_cblas_dgemm(u64 m, u64 n, u64 k, f64 alpha,
+                                  const f64* A, i64 rsa, i64 csa,
+                                  const f64* B, i64 rsb, i64 csb,
+                                  f64 beta, f64* C, i64 rsc, i64 csc) {
+    int ta, tb, lda, ldb, ldc, tc;
+    bool fits = m <= INT_MAX && n <= INT_MAX && k <= INT_MAX
+        && NxBackend_cblas_operand(rsa, csa, m, k, &ta, &lda)
+        && NxBackend_cblas_operand(rsb, csb, k, n, &tb, &ldb)
+        && NxBackend_cblas_operand(rsc, csc, m, n, &tc, &ldc);
+    if(!fits) {
+        NxGemm_dgemm(m, n, k, alpha, A, rsa, csa, B, rsb, csb, beta, C, rsc, csc);
+        return ;
+    }
+    if(tc == NxCBLAS_NO_TRANS) {
+        NxCblas.dgemm(NxCBLAS_ROW_MAJOR, ta, tb, (int)m, (int)n, (int)k,
+                      alpha, A, lda, B, ldb, beta, C, ldc);
+    } else {
+        /* C is column-major, compute C^T = B^T * A^T instead. */
+        ta = ta == NxCBLAS_NO_TRANS ? NxCBLAS_TRANS : NxCBLAS_NO_TRANS;
+        tb = tb == NxCBLAS_NO_TRANS ? NxCBLAS_TRANS : NxCBLAS_NO_TRANS;
+        NxCblas.dgemm(NxCBLAS_ROW_MAJOR, tb, ta, (int)n, (int)m, (int)k,
+                      alpha, B, ldb, A, lda, beta, C, ldc);
+    }
+}
+
+/**
+ * @brief `y = alpha*x + y` through the loaded CBLAS library.
+ */
+static void NxBackend_cblas_daxpy(u64 n, f64 alpha, const f64* x, f64* y) {
+    while(n > 0) {
+        int chunk = n > INT_MAX ? INT_MAX : (int)n;
+        NxCblas.daxpy(chunk, alpha, x, 1, y, 1);
+        x += chunk; y += chunk; n -= (u64)chunk;
+    }
+}
+
+/**
+ * @brief `x = alpha*x` through the loaded CBLAS library.
+ */
+static void NxBackend_cblas_dscal(u64 n, f64 alpha, f64* x) {
+    while(n > 0) {
+        int chunk = n > INT_MAX ? INT_MAX : (int)n;
+        NxCblas.dscal(chunk, alpha, x, 1);
+        x += chunk; n -= (u64)chunk;
+    }
+}
+
+/// The in-tree kernels, published whenever no library is loaded.
+static const NxBackend NxBackend_native = {
+    .kind = NxBACKEND_NATIVE,
+    .name = "native",
+    .handle = NULL,
+    .dgemm = NxGemm_dgemm,
+    .daxpy = NxBackend_native_daxpy,
+    .dscal = NxBackend_native_dscal,
+};
+
+/// The table of the loaded CBLAS library, only rewritten while NxBackend_native is published.
+static NxBackend NxBackend_loaded;
+
+/// The table returned by NxBackend_get(), always a complete table swapped in one store.
+static const NxBackend* NxBackend_active = &NxBackend_native;
+
+/**
+ * @brief Make T the table seen by the following NxBackend_get() calls.
+ */
+static void NxBackend_publish(const NxBackend* T) {
+    __atomic_store_n(&NxBackend_active, T, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Load a CBLAS library and resolve the routines used by Nexum.
+ *
+ * The table is filled completely before it is published, so a concurrent
+ * NxBackend_get() sees either the native table or the loaded one.
+ *
+ * @param path the file name given to `dlopen`.
+ * @param kind the kind recorded in the table.
+ *
+ * @return true if the library was loaded and every routine was found.
+ */
+static bool NxBackend_load_cblas(const char* path, NxBackendKind kind) {
+#ifdef _WIN32
+    (void) path;
+    (void) kind;
+    return false;
+#else
+    void* handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if(handle == NULL) {
+        return false;
+    }
+    *(void**)(&NxCblas.dgemm) = dlsym(handle, "cblas_dgemm");
+    *(void**)(&NxCblas.daxpy) = dlsym(handle, "cblas_daxpy");
+    *(void**)(&NxCblas.dscal) = dlsym(handle, "cblas_dscal");
+    if(NxCblas.dgemm == NULL || NxCblas.daxpy == NULL || NxCblas.dscal == NULL) {
+        dlclose(handle);
+        return false;
+    }
+    NxBackend T = {
+        .kind = kind,
+        .handle = handle,
+        .dgemm = NxBackend_cblas_dgemm,
+        .daxpy = NxBackend_cblas_daxpy,
+        .dscal = NxBackend_cblas_dscal,
+    };
+    snprintf(T.name, sizeof(T.name), "%s", path);
+    NxBackend_loaded = T;
+    NxBackend_publish(&NxBackend_loaded);
+    return true;
+#endif
+}
+
+/**
+ * @brief Select the BLAS backend used by the tensor operations.
+ *
+ * The name can be:
+ *  - `"native"` for the in-tree kernels,
+ *  - `"openblas"` to load `libopenblas.so` at runtime,
+ *  - `"cblas"` to load the library named by the `NEXUM_BLAS_LIB` variable,
+ *  - a path to any CBLAS compatible shared library.
+ *
+ * When name is `NULL` the `NEXUM_BACKEND` environment variable is used and
+ * the native backend is the default. If the requested library cannot be
+ * loaded the native backend is selected, so the library always works.
+ *
+ * The backend is selected from the environment when the library is
+ * loaded. NxBackend_get() is safe from any thread, but switching unloads
+ * the previous library, so no operation may be running on it.
+ *
+ * @param name the name of the backend or `NULL`.
+ *
+ * @return true if the requested backend is the active one.
+ */
+bool NxBackend_init(str name) {
+    static const char* openblas[] = {"libopenblas.so.0", "libopenblas.so"};
+    bool loaded = false;
+    u64 i;
+
+    NxBackend_shutdown();
+    if(name == NULL) {
+        name = getenv(NxBACKEND_ENV);
+    }
+    if(name == NULL || name[0] == '\0' || strcmp(name, "native") == 0) {
+        return true;
+    }
+
+    if(strcmp(name, "openblas") == 0) {
+        NxLOOP(i, sizeof(openblas)/sizeof(openblas[0])) {
+            if((loaded = NxBackend_load_cblas(openblas[i], NxBACKEND_OPENBLAS))) {
+                break;
+            }
+        }
+    } else if(strcmp(name, "cblas") == 0) {
+        const char* path = getenv(NxBACKEND_LIB_ENV);
+        loaded = path != NULL && NxBackend_load_cblas(path, NxBACKEND_CBLAS);
+    } else {
+        loaded = NxBackend_load_cblas(name, NxBACKEND_CBLAS);
+    }
+
+    if(!loaded) {
+        NxMESSAGE("WARNING", "cannot load the requested BLAS backend, using native");
+    }
+    return loaded;
+}
+
+/**
+ * @brief Unload the active backend library and go back to native.
+ *
+ * The native table is published before the library is closed.
+ */
+void NxBackend_shutdown(void) {
+    const NxBackend* T = __atomic_load_n(&NxBackend_active, __ATOMIC_ACQUIRE);
+    NxBackend_publish(&NxBackend_native);
+#ifndef _WIN32
+    if(T->handle != NULL) {
+        dlclose(T->handle);
+    }
+#endif
+}
+
+/**
+ * @brief Return the active backend table.
+ */
+const NxBackend* NxBackend_get(void) {
+    return __atomic_load_n(&NxBackend_active, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Select the backend named by the environment when the library is loaded.
+ */
+__attribute__((constructor))
+static void NxBackend_startup(void) {
+    NxBackend_init(NULL);
+}
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxBackend.c
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,449 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "NxCheckpoint.h"
+#include "NxDType.h"
+#include "NxThreadPool.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define NxXXH_P1 11400714785074694791ULL
+#define NxXXH_P2 14029467366897019727ULL
+#define NxXXH_P3 1609587929392839161ULL
+#define NxXXH_P4 9650029242287828579ULL
+#define NxXXH_P5 2870177450012600261ULL
+
+static inline u64 NxCheckpoint_rotl(u64 x, u32 r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline u64 NxCheckpoint_read64(const unsigned char* p) {
+    u64 v;
+    memcpy(&v, p, sizeof (v));
+    return v;
+}
+
+static inline u64 NxCheckpoint_round(u64 acc, u64 input) {
+    acc += input*NxXXH_P2;
+    return NxCheckpoint_rotl(acc, 31)*NxXXH_P1;
+}
+
+static inline u64 NxCheckpoint_merge(u64 h, u64 v) {
+    h ^= NxCheckpoint_round(0, v);
+    return h*NxXXH_P1 + NxXXH_P4;
+}
+
+/**
+ * @brief xxHash64 (seed 0) of a buffer, the checksum of the checkpoint files.
+ *
+ * Runs at several GB/s so checking a whole model costs about as much as
+ * reading it from the page cache.
+ *
+ * @param data start of the buffer.
+ * @param bytes size of the buffer.
+ * @return the hash, read in the little-endian order of the reference implementation.
+ */
+u64 NxCheckpoint_checksum(const void* data, u64 bytes) {
+    const unsigned char* p = data;
+    const unsigned char* end = p + bytes;
+    u64 h;
+    if(bytes >= 32) {
+        u64 v1 = NxXXH_P1 + NxXXH_P2, v2 = NxXXH_P2, v3 = 0, v4 = 0 - NxXXH_P1;
+        for(; p + 32 <= end; p += 32) {
+            v1 = NxCheckpoint_round(v1, NxCheckpoint_read64(p));
+            v2 = NxCheckpoint_round(v2, NxCheckpoint_read64(p + 8));
+            v3 = NxCheckpoint_round(v3, NxCheckpoint_read64(p + 16));
+            v4 = NxCheckpoint_round(v4, NxCheckpoint_read64(p + 24));
+        }
+        h = NxCheckpoint_rotl(v1, 1) + NxCheckpoint_rotl(v2, 7) + NxCheckpoint_rotl(v3, 12) + NxCheckpoint_rotl(v4, 18);
+        h = NxCheckpoint_merge(h, v1);
+        h = NxCheckpoint_merge(h, v2);
+        h = NxCheckpoint_merge(h, v3);
+        h = NxCheckpoint_merge(h, v4);
+    } else {
+        h = NxXXH_P5;
+    }
+    h += bytes;
+    for(; p + 8 <= end; p += 8) {
+        h ^= NxCheckpoint_round(0, NxCheckpoint_read64(p));
+        h = NxCheckpoint_rotl(h, 27)*NxXXH_P1 + NxXXH_P4;
+    }
+    if(p + 4 <= end) {
+        u32 k;
+        memcpy(&k, p, sizeof (k));
+        h ^= (u64)k*NxXXH_P1;
+        h = NxCheckpoint_rotl(h, 23)*NxXXH_P2 + NxXXH_P3;
+        p += 4;
+    }
+    for(; p < end; p++) {
+        h ^= (u64)*p*NxXXH_P5;
+        h = NxCheckpoint_rotl(h, 11)*NxXXH_P1;
+    }
+    h ^= h >> 33;
+    h *= NxXXH_P2;
+    h ^= h >> 29;
+    h *= NxXXH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+/// State shared by the workers of NxCheckpoint_save().
+typedef struct NxCheckpointWrite {
+    NxCheckpointEntry* entries;
+    const void** data;
+#ifdef __linux__
+    int fd;
+#else
+    FILE* fptr;
+#endif
+    bool failed;
+} NxCheckpointWrite;
+
+/**
+ * @brief Checksum and write the tensors [begin, end) at their offsets.
+ */
+static void NxCheckpoint_write_range(void* ctx, u64 begin, u64 end) {
+    NxCheckpointWrite* W = ctx;
+    u64 k;
+    for(k=begin; k<end; k++) {
+        NxCheckpointEntry* E = &W->entries[k];
+        const char* p = W->data[k];
+        E->checksum = NxCheckpoint_checksum(p, E->bytes);
+#ifdef __linux__
+        u64 done = 0;
+        while(done < E->bytes) {
+            ssize_t r = pwrite(W->fd, p + done, E->bytes - done, (off_t)(E->offset + done));
+            if(r <= 0) {
+                __atomic_store_n(&W->failed, true, __ATOMIC_RELAXED);
+                return ;
+            }
+            done += (u64)r;
+        }
+#else
+        if(fseek(W->fptr, (long)E->offset, SEEK_SET) != 0 ||
+           fwrite(p, 1, E->bytes, W->fptr) != E->bytes) {
+            W->failed = true;
+            return ;
+        }
+#endif
+    }
+}
+
+/**
+ * @brief Write a set of named tensors to one checkpoint file.
+ *
+ * The offsets of all the tensors are known before anything is written,
+ * so the file is sized once and the workers of the NxThreadPool checksum
+ * and write the tensors concurrently with `pwrite`. The file is written
+ * under `<fname>.tmp` then renamed, an interrupted save leaves the
+ * previous checkpoint intact. The tensors may be views, of any dtype.
+ *
+ * @param fname filename.
+ * @param count number of tensors.
+ * @param names unique names of the tensors, shorter than NxCHECKPOINT_NAME_SIZE.
+ * @param tensors the tensors.
+ */
+void NxCheckpoint_save(str fname, u32 count, const str* names, NxTensor** tensors) {
+    NxCheckpointHeader H = {0};
+    u64 index = (sizeof (H) + NxCHECKPOINT_ALIGN - 1) / NxCHECKPOINT_ALIGN * NxCHECKPOINT_ALIGN;
+    u64 position = index + (u64)count*sizeof (NxCheckpointEntry);
+    NxCheckpointEntry* entries = calloc(count ? count : 1, sizeof (NxCheckpointEntry));
+    NxTensor* packed = calloc(count ? count : 1, sizeof (NxTensor));
+    const void** data = calloc(count ? count : 1, sizeof (void*));
+    NxASSERT(entries != NULL && packed != NULL && data != NULL);
+    u32 k, j;
+
+    NxLOOP(k, count) {
+        NxTensor* A = tensors[k];
+        NxCheckpointEntry* E = &entries[k];
+        NxASSERT(A->allocated);
+        if(strlen(names[k]) >= NxCHECKPOINT_NAME_SIZE) {
+            fprintf(stderr, "Cannot save tensor %s the name is longer than %d characters.\n",
+                    names[k], NxCHECKPOINT_NAME_SIZE - 1);
+            exit(EXIT_FAILURE);
+        }
+        NxLOOP(j, k) {
+            if(strcmp(names[j], names[k]) == 0) {
+                fprintf(stderr, "Cannot save tensor %s the name is used twice.\n", names[k]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        strcpy(E->name, names[k]);
+        E->dtype = A->dtype;
+        E->ndim = A->ndim;
+        memcpy(E->shape, A->shape, A->ndim*sizeof (u64));
+        E->bytes = NxTensor_size(A)*NxDType_size(A->dtype);
+        position = (position + NxCHECKPOINT_ALIGN - 1) / NxCHECKPOINT_ALIGN * NxCHECKPOINT_ALIGN;
+        E->offset = position;
+        position += E->bytes;
+        /* Packing uses the thread pool itself, so it is done before the parallel write. */
+        if(NxTensor_is_contiguous(A)) {
+            data[k] = A->raw;
+        } else {
+            NxTensor_contiguous(&packed[k], A);
+            data[k] = packed[k].raw;
+        }
+    }
+    memcpy(H.magic, NxCHECKPOINT_MAGIC, sizeof (H.magic));
+    H.version = NxCHECKPOINT_VERSION;
+    H.count = count;
+    H.file_size = position;
+
+    u64 len = strlen(fname);
+    char* tmp = malloc(len + 5);
+    NxASSERT(tmp != NULL);
+    memcpy(tmp, fname, len);
+    memcpy(tmp + len, ".tmp", 5);
+
+    NxCheckpointWrite W = {.entries = entries, .data = data, .failed = false};
+#ifdef __linux__
+    W.fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(W.fd < 0) {
+        fprintf(stderr, "Cannot open file %s for writing.\n", tmp);
+        exit(EXIT_FAILURE);
+    }
+    W.failed = ftruncate(W.fd, (off_t)position) != 0;
+    if(!W.failed) {
+        NxThreadPool_parallel_for(count, 1, NxCheckpoint_write_range, &W);
+    }
+#else
+    W.fptr = fopen(tmp, WRITE_BINARY_MODE);
+    if(W.fptr == NULL) {
+        fprintf(stderr, "Cannot open file %s for writing.\n", tmp);
+        exit(EXIT_FAILURE);
+    }
+    /* A single stream cannot be shared by the workers. */
+    NxCheckpoint_write_range(&W, 0, count);
+#endif
+    H.index_checksum = NxCheckpoint_checksum(entries, (u64)count*sizeof (NxCheckpointEntry));
+
+    char pad[NxCHECKPOINT_ALIGN] = {0};
+#ifdef __linux__
+    W.failed = W.failed ||
+               pwrite(W.fd, &H, sizeof (H), 0) != (ssize_t)sizeof (H) ||
+               pwrite(W.fd, pad, index - sizeof (H), (off_t)sizeof (H)) != (ssize_t)(index - sizeof (H)) ||
+               pwrite(W.fd, entries, (u64)count*sizeof (NxCheckpointEntry), (off_t)index) !=
+                   (ssize_t)((u64)count*sizeof (NxCheckpointEntry));
+    W.failed = close(W.fd) != 0 || W.failed;
+#else
+    W.failed = W.failed || fseek(W.fptr, 0, SEEK_SET) != 0 ||
+               fwrite(&H, sizeof (H), 1, W.fptr) != 1 ||
+               fwrite(pad, 1, index - sizeof (H), W.fptr) != index - sizeof (H) ||
+               fwrite(entries, sizeof (NxCheckpointEntry), count, W.fptr) != count;
+    W.failed = fclose(W.fptr) != 0 || W.failed;
+#endif
+    if(W.failed || rename(tmp, fname) != 0) {
+        fprintf(stderr, "Cannot write file %s.\n", fname);
+        remove(tmp);
+        exit(EXIT_FAILURE);
+    }
+
+    NxLOOP(k, count) {
+        NxTensor_free(&packed[k]);
+    }
+    free(tmp);
+    free(data);
+    free(packed);
+    free(entries);
+}
+
+/**
+ * @brief Exit with an error about the checkpoint file fname.
+ */
+static void NxCheckpoint_corrupted(str fname, str reason) {
+    fprintf(stderr, "Cannot open checkpoint %s %s.\n", fname, reason);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Open a checkpoint file written by NxCheckpoint_save().
+ *
+ * The file is mapped once, with the NxMapFlags of NxStorage_map(), and
+ * only the header and the index are read: the pages of a tensor are
+ * loaded when the tensor is used. Falls back to reading the whole file
+ * where it cannot be mapped. The index is checked (magic, version,
+ * checksum, offsets inside the file and aligned), the checksums of the
+ * tensors are not, see NxCheckpoint_verify().
+ *
+ * @param C pointer to the checkpoint object.
+ * @param fname filename.
+ * @param flags NxMapFlags of the mapping.
+ */
+void NxCheckpoint_open(NxCheckpoint* C, str fname, u32 flags) {
+    struct stat st;
+    if(stat(fname, &st) != 0) {
+        fprintf(stderr, "Cannot open file %s file does not exists.\n", fname);
+        exit(EXIT_FAILURE);
+    }
+    u64 fsize = (u64)st.st_size;
+    if(fsize < sizeof (NxCheckpointHeader)) {
+        NxCheckpoint_corrupted(fname, "the file is truncated");
+    }
+    NxStorage* S = NxStorage_map(fname, 0, fsize, flags);
+    if(S == NULL) {
+        FILE* fptr = fopen(fname, READ_BINARY_MODE);
+        if(fptr == NULL) {
+            fprintf(stderr, "Cannot open file %s file does not exists.\n", fname);
+            exit(EXIT_FAILURE);
+        }
+        S = NxStorage_alloc(fsize);
+        if(fread(S->data, 1, fsize, fptr) != fsize) {
+            NxCheckpoint_corrupted(fname, "the file is truncated");
+        }
+        fclose(fptr);
+    }
+
+    const NxCheckpointHeader* H = S->data;
+    u64 index = (sizeof (*H) + NxCHECKPOINT_ALIGN - 1) / NxCHECKPOINT_ALIGN * NxCHECKPOINT_ALIGN;
+    if(memcmp(H->magic, NxCHECKPOINT_MAGIC, sizeof (H->magic)) != 0) {
+        NxCheckpoint_corrupted(fname, "the file is not a checkpoint");
+    }
+    if(H->version != NxCHECKPOINT_VERSION) {
+        NxCheckpoint_corrupted(fname, "the version is not supported");
+    }
+    if(H->file_size != fsize || fsize < index || H->count > (fsize - index) / sizeof (NxCheckpointEntry)) {
+        NxCheckpoint_corrupted(fname, "the file is truncated");
+    }
+    const NxCheckpointEntry* entries = (const NxCheckpointEntry*)((const char*)S->data + index);
+    if(NxCheckpoint_checksum(entries, (u64)H->count*sizeof (NxCheckpointEntry)) != H->index_checksum) {
+        NxCheckpoint_corrupted(fname, "the index is corrupted");
+    }
+    u32 k, d;
+    NxLOOP(k, H->count) {
+        const NxCheckpointEntry* E = &entries[k];
+        u32 ndim = E->ndim <= NxMAX_DIMS ? E->ndim : 0;
+        u64 size = 1;
+        NxLOOP(d, ndim) {
+            size *= E->shape[d];
+        }
+        if(E->dtype > NxFLOAT16 || E->ndim < 1 || E->ndim > NxMAX_DIMS ||
+           memchr(E->name, '\0', NxCHECKPOINT_NAME_SIZE) == NULL ||
+           E->offset % NxCHECKPOINT_ALIGN != 0 || E->offset > fsize || fsize - E->offset < E->bytes ||
+           size*NxDType_size((NxDType)E->dtype) != E->bytes) {
+            NxCheckpoint_corrupted(fname, "the index is corrupted");
+        }
+    }
+    C->storage = S;
+    C->header = H;
+    C->entries = entries;
+    C->count = H->count;
+}
+
+/**
+ * @brief Position of the tensor `name` in the index, -1 when missing.
+ */
+i64 NxCheckpoint_find(NxCheckpoint* C, str name) {
+    u32 k;
+    NxLOOP(k, C->count) {
+        if(strcmp(C->entries[k].name, name) == 0) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Point T at the tensor `name` of the checkpoint, without copying it.
+ *
+ * T shares the mapping of the file, like NxTensor_map_binary(): with
+ * NxMAP_READ_ONLY the operations writing to T give it a heap buffer
+ * first. T stays valid after NxCheckpoint_close().
+ *
+ * @param C pointer to the checkpoint object.
+ * @param name name of the tensor.
+ * @param T pointer to the output tensor.
+ * @return false when the checkpoint has no tensor named `name`, T is untouched.
+ */
+bool NxCheckpoint_get(NxCheckpoint* C, str name, NxTensor* T) {
+    i64 k = NxCheckpoint_find(C, name);
+    if(k < 0) {
+        return false;
+    }
+    const NxCheckpointEntry* E = &C->entries[k];
+    NxTensor_from_storage(T, C->storage, E->offset, (NxDType)E->dtype, E->ndim, E->shape);
+    return true;
+}
+
+/// State shared by the workers of NxCheckpoint_verify().
+typedef struct NxCheckpointVerify {
+    NxCheckpoint* C;
+    bool* valid;
+} NxCheckpointVerify;
+
+static void NxCheckpoint_verify_range(void* ctx, u64 begin, u64 end) {
+    NxCheckpointVerify* V = ctx;
+    u64 k;
+    for(k=begin; k<end; k++) {
+        const NxCheckpointEntry* E = &V->C->entries[k];
+        V->valid[k] = NxCheckpoint_checksum((const char*)V->C->storage->data + E->offset, E->bytes) == E->checksum;
+    }
+}
+
+/**
+ * @brief Check the checksums of all the tensors of the checkpoint, in parallel.
+ *
+ * Reads the whole file, the names of the corrupted tensors are printed
+ * to stderr.
+ *
+ * @param C pointer to the checkpoint object.
+ * @return whether every tensor matches its checksum.
+ */
+bool NxCheckpoint_verify(NxCheckpoint* C) {
+    bool* valid = calloc(C->count ? C->count : 1, sizeof (bool));
+    NxASSERT(valid != NULL);
+    NxCheckpointVerify V = {.C = C, .valid = valid};
+    NxStorage_advise(C->storage, NxMAP_SEQUENTIAL);
+    NxThreadPool_parallel_for(C->count, 1, NxCheckpoint_verify_range, &V);
+    NxStorage_advise(C->storage, NxMAP_RANDOM);
+
+    bool ok = true;
+    u32 k;
+    NxLOOP(k, C->count) {
+        if(!valid[k]) {
+            fprintf(stderr, "Checksum mismatch for tensor %s.\n", C->entries[k].name);
+            ok = false;
+        }
+    }
+    free(valid);
+    return ok;
+}
+
+/**
+ * @brief Release the checkpoint, the tensors taken from it stay valid.
+ */
+void NxCheckpoint_close(NxCheckpoint* C) {
+    NxStorage_release(C->storage);
+    C->storage = NULL;
+    C->header = NULL;
+    C->entries = NULL;
+    C->count = 0;
+}
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxCheckpoint.c
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
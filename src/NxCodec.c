@@ -0,0 +1,511 @@
+#include "NxCodec.h"
+#include "NxThreadPool.h"
+
+#include <string.h>
+
+/// Shortest match encoded.
+#define NxLZ_MIN_MATCH 4
+/// Longest distance of a match (16-bit offsets).
+#define NxLZ_MAX_OFFSET 65535
+/// log2 of the number of entries of the hash table of the encoder.
+#define NxLZ_HASH_LOG 14
+/// The last bytes of a block are always literals, so the encoder can read 8 bytes at a time.
+#define NxLZ_TAIL 12
+
+typedef unsigned char byte;
+
+static inline u32 NxCodec_read32(const byte* p) {
+    u32 v;
+    memcpy(&v, p, sizeof (v));
+    return v;
+}
+
+static inline u64 NxCodec_read64(const byte* p) {
+    u64 v;
+    memcpy(&v, p, sizeof (v));
+    return v;
+}
+
+static inline u32 NxCodec_hash(u32 v) {
+    return (v*2654435761u) >> (32 - NxLZ_HASH_LOG);
+}
+
+/**
+ * @brief Worst-case size of a block of `bytes` bytes once compressed.
+ */
+static inline u64 NxCodec_block_bound(u64 bytes) {
+    return bytes + bytes/255 + 16;
+}
+
+/**
+ * @brief Write a length of the LZ format: the part over 15 as bytes of 255 and a remainder.
+ */
+static inline byte* NxCodec_write_length(byte* op, u64 len) {
+    for(; len >= 255; len -= 255) {
+        *op++ = 255;
+    }
+    *op++ = (byte)len;
+    return op;
+}
+
+/**
+ * @brief Write one sequence: `lit` literals then a match of `len` bytes `offset` back.
+ *
+ * A zero `len` writes the last literals of the block, without match.
+ */
+static inline byte* NxCodec_write_sequence(byte* op, const byte* lit, u64 nlit, u64 offset, u64 len) {
+    byte* token = op++;
+    u64 mlen = len ? len - NxLZ_MIN_MATCH : 0;
+    *token = (byte)(((nlit < 15 ? nlit : 15) << 4) | (mlen < 15 ? mlen : 15));
+    if(nlit >= 15) {
+        op = NxCodec_write_length(op, nlit - 15);
+    }
+    memcpy(op, lit, nlit);
+    op += nlit;
+    if(len) {
+        *op++ = (byte)(offset & 0xFF);
+        *op++ = (byte)(offset >> 8);
+        if(mlen >= 15) {
+            op = NxCodec_write_length(op, mlen - 15);
+        }
+    }
+    return op;
+}
+
+/**
+ * @brief LZ compress n bytes, return the compressed size.
+ *
+ * Greedy parsing: the 4 bytes at the current position are looked up in
+ * a hash table of the last positions seen, a hit is extended both ways.
+ * Incompressible data is skipped faster and faster until the next match.
+ */
+static u64 NxCodec_lz_encode(byte* dst, const byte* src, u64 n, u32* table) {
+    byte* op = dst;
+    u64 ip = 0, anchor = 0;
+    if(n > NxLZ_TAIL) {
+        u64 limit = n - NxLZ_TAIL;
+        memset(table, 0, sizeof (u32) << NxLZ_HASH_LOG);
+        while(ip < limit) {
+            u32 v = NxCodec_read32(src + ip), h = NxCodec_hash(v);
+            /* Positions are stored plus one, zero is an empty slot. */
+            u64 ref = table[h];
+            table[h] = (u32)ip + 1;
+            if(ref == 0 || ip - (ref - 1) > NxLZ_MAX_OFFSET || NxCodec_read32(src + ref - 1) != v) {
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+            ref--;
+            while(ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                ip--;
+                ref--;
+            }
+            u64 len = NxLZ_MIN_MATCH;
+            while(ip + len + 8 <= limit) {
+                u64 diff = NxCodec_read64(src + ip + len) ^ NxCodec_read64(src + ref + len);
+                if(diff) {
+                    len += (u64)__builtin_ctzll(diff) >> 3;
+                    goto found;
+                }
+                len += 8;
+            }
+            while(ip + len < limit && src[ip + len] == src[ref + len]) {
+                len++;
+            }
+        found:
+            op = NxCodec_write_sequence(op, src + anchor, ip - anchor, ip - ref, len);
+            ip += len;
+            anchor = ip;
+            if(ip >= 2 && ip < limit) {
+                table[NxCodec_hash(NxCodec_read32(src + ip - 2))] = (u32)(ip - 2) + 1;
+            }
+        }
+    }
+    op = NxCodec_write_sequence(op, src + anchor, n - anchor, 0, 0);
+    return (u64)(op - dst);
+}
+
+/**
+ * @brief Read a length of the LZ format, false past the end of the input.
+ */
+static inline bool NxCodec_read_length(const byte** ip, const byte* end, u64* len) {
+    byte b;
+    do {
+        if(*ip == end) {
+            return false;
+        }
+        b = *(*ip)++;
+        *len += b;
+    } while(b == 255);
+    return true;
+}
+
+/**
+ * @brief Decode the LZ stream src into exactly n bytes of dst.
+ */
+static bool NxCodec_lz_decode(byte* dst, u64 n, const byte* src, u64 src_bytes) {
+    const byte* ip = src;
+    const byte* end = src + src_bytes;
+    byte* op = dst;
+    byte* oend = dst + n;
+    while(ip < end) {
+        byte token = *ip++;
+        u64 nlit = token >> 4;
+        if(nlit == 15 && !NxCodec_read_length(&ip, end, &nlit)) {
+            return false;
+        }
+        if(nlit > (u64)(end - ip) || nlit > (u64)(oend - op)) {
+            return false;
+        }
+        memcpy(op, ip, nlit);
+        op += nlit;
+        ip += nlit;
+        if(ip == end) {
+            break;
+        }
+        if(end - ip < 2) {
+            return false;
+        }
+        u64 offset = ip[0] | ((u64)ip[1] << 8);
+        ip += 2;
+        u64 len = token & 15;
+        if(len == 15 && !NxCodec_read_length(&ip, end, &len)) {
+            return false;
+        }
+        len += NxLZ_MIN_MATCH;
+        if(offset == 0 || offset > (u64)(op - dst) || len > (u64)(oend - op)) {
+            return false;
+        }
+        const byte* match = op - offset;
+        if(offset >= len) {
+            memcpy(op, match, len);
+            op += len;
+        } else {
+            /* The source overlaps the output: the copied period doubles at every step. */
+            while(len > 0) {
+                u64 step = (u64)(op - match) < len ? (u64)(op - match) : len;
+                memcpy(op, match, step);
+                op += step;
+                len -= step;
+            }
+        }
+    }
+    return op == oend;
+}
+
+/**
+ * @brief Gather the k-th byte of the n elements of size es in plane k of dst.
+ */
+static void NxCodec_shuffle(byte* dst, const byte* src, u64 n, u32 es) {
+    u64 i;
+    u32 k;
+    switch(es) {
+    case 8:
+        NxLOOP(i, n) {
+            dst[i] = src[i*8];
+            dst[n + i] = src[i*8 + 1];
+            dst[2*n + i] = src[i*8 + 2];
+            dst[3*n + i] = src[i*8 + 3];
+            dst[4*n + i] = src[i*8 + 4];
+            dst[5*n + i] = src[i*8 + 5];
+            dst[6*n + i] = src[i*8 + 6];
+            dst[7*n + i] = src[i*8 + 7];
+        }
+        break;
+    case 4:
+        NxLOOP(i, n) {
+            dst[i] = src[i*4];
+            dst[n + i] = src[i*4 + 1];
+            dst[2*n + i] = src[i*4 + 2];
+            dst[3*n + i] = src[i*4 + 3];
+        }
+        break;
+    case 2:
+        NxLOOP(i, n) {
+            dst[i] = src[i*2];
+            dst[n + i] = src[i*2 + 1];
+        }
+        break;
+    default:
+        NxLOOP(i, n) {
+            NxLOOP(k, es) {
+                dst[k*n + i] = src[i*es + k];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Inverse of NxCodec_shuffle().
+ */
+static void NxCodec_unshuffle(byte* dst, const byte* src, u64 n, u32 es) {
+    u64 i;
+    u32 k;
+    switch(es) {
+    case 8:
+        NxLOOP(i, n) {
+            dst[i*8] = src[i];
+            dst[i*8 + 1] = src[n + i];
+            dst[i*8 + 2] = src[2*n + i];
+            dst[i*8 + 3] = src[3*n + i];
+            dst[i*8 + 4] = src[4*n + i];
+            dst[i*8 + 5] = src[5*n + i];
+            dst[i*8 + 6] = src[6*n + i];
+            dst[i*8 + 7] = src[7*n + i];
+        }
+        break;
+    case 4:
+        NxLOOP(i, n) {
+            dst[i*4] = src[i];
+            dst[i*4 + 1] = src[n + i];
+            dst[i*4 + 2] = src[2*n + i];
+            dst[i*4 + 3] = src[3*n + i];
+        }
+        break;
+    case 2:
+        NxLOOP(i, n) {
+            dst[i*2] = src[i];
+            dst[i*2 + 1] = src[n + i];
+        }
+        break;
+    default:
+        NxLOOP(i, n) {
+            NxLOOP(k, es) {
+                dst[i*es + k] = src[k*n + i];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Compress one block, return its compressed size (`bytes` when it is stored as is).
+ *
+ * The trailing bytes that do not fill an element are left unshuffled.
+ */
+static u64 NxCodec_encode_block(byte* dst, const byte* src, u64 bytes, u32 es, byte* scratch, u32* table) {
+    const byte* in = src;
+    if(es > 1) {
+        u64 n = bytes / es;
+        NxCodec_shuffle(scratch, src, n, es);
+        memcpy(scratch + n*es, src + n*es, bytes - n*es);
+        in = scratch;
+    }
+    u64 size = NxCodec_lz_encode(dst, in, bytes, table);
+    if(size >= bytes) {
+        memcpy(dst, src, bytes);
+        return bytes;
+    }
+    return size;
+}
+
+/**
+ * @brief Decompress one block of `bytes` bytes from `size` compressed ones.
+ */
+static bool NxCodec_decode_block(byte* dst, u64 bytes, const byte* src, u64 size, u32 es, byte* scratch) {
+    if(size == bytes) {
+        memcpy(dst, src, bytes);
+        return true;
+    }
+    if(es <= 1) {
+        return NxCodec_lz_decode(dst, bytes, src, size);
+    }
+    if(!NxCodec_lz_decode(scratch, bytes, src, size)) {
+        return false;
+    }
+    u64 n = bytes / es;
+    NxCodec_unshuffle(dst, scratch, n, es);
+    memcpy(dst + n*es, scratch + n*es, bytes - n*es);
+    return true;
+}
+
+/**
+ * @brief Table of the block ends of a frame.
+ */
+static inline const u64* NxCodec_ends(const void* frame) {
+    return (const u64*)((const byte*)frame + sizeof (NxCodecFrame));
+}
+
+/**
+ * @brief Worst-case size of the frame of `bytes` uncompressed bytes.
+ *
+ * The buffer given to NxCodec_compress() must hold that many bytes.
+ */
+u64 NxCodec_bound(u64 bytes) {
+    u64 blocks = (bytes + NxCODEC_BLOCK - 1) / NxCODEC_BLOCK;
+    return sizeof (NxCodecFrame) + blocks*sizeof (u64) + blocks*NxCodec_block_bound(NxCODEC_BLOCK);
+}
+
+/// State shared by the workers of NxCodec_compress() and NxCodec_decompress().
+typedef struct NxCodecJob {
+    byte* dst;
+    const byte* src;
+    u64 bytes;
+    u32 elem_size;
+    u64* sizes;
+    const u64* ends;
+    bool failed;
+} NxCodecJob;
+
+static void NxCodec_compress_range(void* ctx, u64 begin, u64 end) {
+    NxCodecJob* J = ctx;
+    byte* scratch = malloc(NxCODEC_BLOCK);
+    u32* table = malloc(sizeof (u32) << NxLZ_HASH_LOG);
+    NxASSERT(scratch != NULL && table != NULL);
+    u64 k;
+    for(k=begin; k<end; k++) {
+        u64 start = k*NxCODEC_BLOCK;
+        u64 bytes = J->bytes - start < NxCODEC_BLOCK ? J->bytes - start : NxCODEC_BLOCK;
+        /* Every block is compressed into its worst-case slot, the slots are packed afterwards. */
+        J->sizes[k] = NxCodec_encode_block(J->dst + k*NxCodec_block_bound(NxCODEC_BLOCK),
+                                           J->src + start, bytes, J->elem_size, scratch, table);
+    }
+    free(table);
+    free(scratch);
+}
+
+/**
+ * @brief Compress `bytes` bytes of elements of `elem_size` bytes into a frame.
+ *
+ * The blocks are compressed in parallel. `elem_size` is the size of the
+ * dtype of the tensor (1 disables the shuffle).
+ *
+ * @param dst output buffer of NxCodec_bound(bytes) bytes.
+ * @param src the data.
+ * @param bytes size of the data.
+ * @param elem_size size of the elements of the data.
+ * @return the size of the frame.
+ */
+u64 NxCodec_compress(void* dst, const void* src, u64 bytes, u32 elem_size) {
+    NxCodecFrame F = {0};
+    memcpy(F.magic, NxCODEC_MAGIC, sizeof (F.magic));
+    F.elem_size = elem_size ? elem_size : 1;
+    F.block_size = NxCODEC_BLOCK;
+    F.bytes = bytes;
+    F.blocks = (bytes + NxCODEC_BLOCK - 1) / NxCODEC_BLOCK;
+
+    byte* out = dst;
+    u64* ends = (u64*)(out + sizeof (F));
+    byte* data = out + sizeof (F) + F.blocks*sizeof (u64);
+    NxCodecJob J = {.dst = data, .src = src, .bytes = bytes, .elem_size = F.elem_size, .sizes = ends};
+    NxThreadPool_parallel_for(F.blocks, 1, NxCodec_compress_range, &J);
+
+    u64 k, position = 0;
+    NxLOOP(k, F.blocks) {
+        u64 size = ends[k];
+        memmove(data + position, data + k*NxCodec_block_bound(NxCODEC_BLOCK), size);
+        position += size;
+        ends[k] = position;
+    }
+    memcpy(out, &F, sizeof (F));
+    return sizeof (F) + F.blocks*sizeof (u64) + position;
+}
+
+/**
+ * @brief Check the header and the table of blocks of a frame of `frame_bytes` bytes.
+ *
+ * The frame given to the other NxCodec functions must pass this check,
+ * the content of the blocks is checked while they are decoded.
+ */
+bool NxCodec_check(const void* frame, u64 frame_bytes) {
+    NxCodecFrame F;
+    if(frame_bytes < sizeof (F)) {
+        return false;
+    }
+    memcpy(&F, frame, sizeof (F));
+    if(memcmp(F.magic, NxCODEC_MAGIC, sizeof (F.magic)) != 0 || F.elem_size == 0 ||
+       F.block_size == 0 || F.block_size > NxCODEC_BLOCK ||
+       F.blocks != (F.bytes + F.block_size - 1) / F.block_size ||
+       F.blocks > (frame_bytes - sizeof (F)) / sizeof (u64)) {
+        return false;
+    }
+    const u64* ends = NxCodec_ends(frame);
+    u64 k, start = 0, data = frame_bytes - sizeof (F) - F.blocks*sizeof (u64);
+    NxLOOP(k, F.blocks) {
+        u64 bytes = F.bytes - k*F.block_size < F.block_size ? F.bytes - k*F.block_size : F.block_size;
+        if(ends[k] < start || ends[k] > data || ends[k] - start > NxCodec_block_bound(bytes)) {
+            return false;
+        }
+        start = ends[k];
+    }
+    return true;
+}
+
+/**
+ * @brief Decompress the block k of a frame.
+ *
+ * Used to read part of a compressed tensor: the block k holds the
+ * uncompressed bytes from `k*block_size`.
+ *
+ * @param dst output buffer of `block_size` bytes.
+ * @param frame a frame that passed NxCodec_check().
+ * @param block index of the block.
+ * @param scratch buffer of `block_size` bytes.
+ * @return false when the block is corrupted.
+ */
+bool NxCodec_decompress_block(void* dst, const void* frame, u64 block, void* scratch) {
+    NxCodecFrame F;
+    memcpy(&F, frame, sizeof (F));
+    NxASSERT(block < F.blocks);
+    const u64* ends = NxCodec_ends(frame);
+    const byte* data = (const byte*)frame + sizeof (F) + F.blocks*sizeof (u64);
+    u64 start = block ? ends[block - 1] : 0;
+    u64 bytes = F.bytes - block*F.block_size < F.block_size ? F.bytes - block*F.block_size : F.block_size;
+    return NxCodec_decode_block(dst, bytes, data + start, ends[block] - start, F.elem_size, scratch);
+}
+
+static void NxCodec_decompress_range(void* ctx, u64 begin, u64 end) {
+    NxCodecJob* J = ctx;
+    const NxCodecFrame* F = (const NxCodecFrame*)J->src;
+    byte* scratch = malloc(F->block_size);
+    NxASSERT(scratch != NULL);
+    u64 k;
+    for(k=begin; k<end; k++) {
+        if(!NxCodec_decompress_block(J->dst + k*F->block_size, J->src, k, scratch)) {
+            __atomic_store_n(&J->failed, true, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    free(scratch);
+}
+
+/**
+ * @brief Decompress a whole frame, in parallel.
+ *
+ * @param dst output buffer.
+ * @param bytes size of the output buffer, must be the uncompressed size of the frame.
+ * @param frame the frame.
+ * @param frame_bytes size of the frame.
+ * @return false when the frame is corrupted or does not hold `bytes` bytes.
+ */
+bool NxCodec_decompress(void* dst, u64 bytes, const void* frame, u64 frame_bytes) {
+    if(!NxCodec_check(frame, frame_bytes) || ((const NxCodecFrame*)frame)->bytes != bytes) {
+        return false;
+    }
+    NxCodecJob J = {.dst = dst, .src = frame, .failed = false};
+    NxThreadPool_parallel_for(((const NxCodecFrame*)frame)->blocks, 1, NxCodec_decompress_range, &J);
+    return !J.failed;
+}
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxCodec.c
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,260 @@
+#include "NxDType.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NxDTYPE_X86
+#endif
+
+/// Number of elements converted at once through the f32 scratch buffer.
+#define NxDTYPE_BLOCK 256
+
+static bool NxDType_f16c = false;
+static bool NxDType_avx2 = false;
+
+/**
+ * @brief Query the conversion instructions when the library is loaded.
+ */
+__attribute__((constructor))
+static void NxDType_init(void) {
+#ifdef NxDTYPE_X86
+    __builtin_cpu_init();
+    NxDType_f16c = __builtin_cpu_supports("f16c") && __builtin_cpu_supports("avx");
+    NxDType_avx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+
+#ifdef NxDTYPE_X86
+
+#pragma GCC push_options
+#pragma GCC target("avx,f16c")
+static u64 NxDType_f16_to_f32_f16c(u64 n, f32* dst, const u16* src) {
+    u64 i = 0;
+    for(; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+    }
+    return i;
+}
+
+static u64 NxDType_f32_to_f16_f16c(u64 n, u16* dst, const f32* src) {
+    u64 i = 0;
+    for(; i + 8 <= n; i += 8) {
+        _mm_storeu_si128((__m128i*)(dst + i),
+                         _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+    }
+    return i;
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+static u64 NxDType_bf16_to_f32_avx2(u64 n, f32* dst, const u16* src) {
+    u64 i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m256i w = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_castsi256_ps(_mm256_slli_epi32(w, 16)));
+    }
+    return i;
+}
+
+static u64 NxDType_f32_to_bf16_avx2(u64 n, u16* dst, const f32* src) {
+    const __m256i bias = _mm256_set1_epi32(0x7fff);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i quiet = _mm256_set1_epi32(0x400000);
+    u64 i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(src + i);
+        __m256i u = _mm256_castps_si256(x);
+        __m256i r = _mm256_add_epi32(u, _mm256_add_epi32(bias, _mm256_and_si256(_mm256_srli_epi32(u, 16), one)));
+        /* NaN lanes are truncated with the quiet bit set instead of rounded. */
+        __m256i nan = _mm256_castps_si256(_mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+        r = _mm256_blendv_epi8(r, _mm256_or_si256(u, quiet), nan);
+        r = _mm256_srli_epi32(r, 16);
+        __m128i lo = _mm256_castsi256_si128(r), hi = _mm256_extracti128_si256(r, 1);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi32(lo, hi));
+    }
+    return i;
+}
+#pragma GCC pop_options
+
+#endif /* NxDTYPE_X86 */
+
+/**
+ * @brief Return the size in bytes of one element of the given type.
+ */
+u64 NxDType_size(NxDType dtype) {
+    switch(dtype) {
+    case NxFLOAT64:  return sizeof(f64);
+    case NxFLOAT32:  return sizeof(f32);
+    case NxBFLOAT16: return sizeof(u16);
+    case NxFLOAT16:  return sizeof(u16);
+    }
+    fprintf(stderr, "Unknown dtype %d.\n", (int)dtype);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Return the name of the type (`"f64"`, `"f32"`, `"bf16"`, `"f16"`).
+ */
+const char* NxDType_name(NxDType dtype) {
+    switch(dtype) {
+    case NxFLOAT64:  return "f64";
+    case NxFLOAT32:  return "f32";
+    case NxBFLOAT16: return "bf16";
+    case NxFLOAT16:  return "f16";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Widen n elements of any type to f32.
+ *
+ * bf16 and f16 are exact in f32, f64 is rounded to nearest. Uses F16C and
+ * AVX2 when the CPU has them.
+ */
+void NxDType_to_f32(u64 n, f32* dst, const void* src, NxDType src_dtype) {
+    u64 i = 0;
+    switch(src_dtype) {
+    case NxFLOAT64: {
+        const f64* s = src;
+        for(; i < n; i++) {
+            dst[i] = (f32)s[i];
+        }
+        break;
+    }
+    case NxFLOAT32:
+        memmove(dst, src, n*sizeof(f32));
+        break;
+    case NxBFLOAT16: {
+        const u16* s = src;
+#ifdef NxDTYPE_X86
+        if(NxDType_avx2) {
+            i = NxDType_bf16_to_f32_avx2(n, dst, s);
+        }
+#endif
+        for(; i < n; i++) {
+            dst[i] = NxBF16_to_f32(s[i]);
+        }
+        break;
+    }
+    case NxFLOAT16: {
+        const u16* s = src;
+#ifdef NxDTYPE_X86
+        if(NxDType_f16c) {
+            i = NxDType_f16_to_f32_f16c(n, dst, s);
+        }
+#endif
+        for(; i < n; i++) {
+            dst[i] = NxF16_to_f32(s[i]);
+        }
+        break;
+    }
+    }
+}
+
+/**
+ * @brief Narrow (or widen for f64) n f32 elements to any type.
+ *
+ * Rounds to nearest, ties to even, for bf16 and f16.
+ */
+void NxDType_from_f32(u64 n, void* dst, NxDType dst_dtype, const f32* src) {
+    u64 i = 0;
+    switch(dst_dtype) {
+    case NxFLOAT64: {
+        f64* d = dst;
+        for(; i < n; i++) {
+            d[i] = (f64)src[i];
+        }
+        break;
+    }
+    case NxFLOAT32:
+        memmove(dst, src, n*sizeof(f32));
+        break;
+    case NxBFLOAT16: {
+        u16* d = dst;
+#ifdef NxDTYPE_X86
+        if(NxDType_avx2) {
+            i = NxDType_f32_to_bf16_avx2(n, d, src);
+        }
+#endif
+        for(; i < n; i++) {
+            d[i] = NxF32_to_bf16(src[i]);
+        }
+        break;
+    }
+    case NxFLOAT16: {
+        u16* d = dst;
+#ifdef NxDTYPE_X86
+        if(NxDType_f16c) {
+            i = NxDType_f32_to_f16_f16c(n, d, src);
+        }
+#endif
+        for(; i < n; i++) {
+            d[i] = NxF32_to_f16(src[i]);
+        }
+        break;
+    }
+    }
+}
+
+/**
+ * @brief Convert n elements between two types.
+ *
+ * f64 <-> f32 are converted directly, every other pair goes through a
+ * small f32 buffer, so f64 to bf16/f16 is rounded twice (first to f32).
+ * dst and src may be the same buffer only when both types have the same
+ * size.
+ *
+ * @param n number of elements.
+ * @param dst output buffer of `n*NxDType_size(dst_dtype)` bytes.
+ * @param dst_dtype type of the output elements.
+ * @param src input buffer.
+ * @param src_dtype type of the input elements.
+ */
+void NxDType_convert(u64 n, void* dst, NxDType dst_dtype, const void* src, NxDType src_dtype) {
+    if(dst_dtype == src_dtype) {
+        memmove(dst, src, n*NxDType_size(src_dtype));
+        return ;
+    }
+    if(src_dtype == NxFLOAT64 && dst_dtype == NxFLOAT32) {
+        NxDType_to_f32(n, dst, src, src_dtype);
+        return ;
+    }
+    if(src_dtype == NxFLOAT32) {
+        NxDType_from_f32(n, dst, dst_dtype, src);
+        return ;
+    }
+
+    f32 buf[NxDTYPE_BLOCK];
+    u64 ssize = NxDType_size(src_dtype), dsize = NxDType_size(dst_dtype);
+    u64 i;
+    for(i=0; i<n; i+=NxDTYPE_BLOCK) {
+        u64 len = n - i < NxDTYPE_BLOCK ? n - i : NxDTYPE_BLOCK;
+        NxDType_to_f32(len, buf, (const char*)src + i*ssize, src_dtype);
+        NxDType_from_f32(len, (char*)dst + i*dsize, dst_dtype, buf);
+    }
+}
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxDType.c
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,553 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "NxDataset.h"
+#include "NxText.h"
+
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief Seconds of the monotonic clock.
+ */
+static f64 NxDataset_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (f64)t.tv_sec + (f64)t.tv_nsec*1e-9;
+}
+
+/**
+ * @brief Read the header of the shard k of S, check that its samples match the ones of the first shard.
+ */
+static void NxDataset_open_shard(NxDatasetStream* S, u32 k, str fname) {
+    NxDatasetShard* H = &S->shards[k];
+    u64 len = strlen(fname), shape[NxMAX_DIMS] = {0};
+    H->fname = malloc(len + 1);
+    NxASSERT(H->fname != NULL);
+    memcpy(H->fname, fname, len + 1);
+
+    FILE* fptr = fopen(fname, READ_BINARY_MODE);
+    if(fptr == NULL) {
+        fprintf(stderr, "Cannot open file %s file does not exists.\n", fname);
+        exit(EXIT_FAILURE);
+    }
+    NxTensorFileHeader F;
+    NxDType dtype;
+    u32 ndim, d;
+    if(NxTensor_read_header(fptr, &F, fname)) {
+        H->binary = true;
+        H->offset = F.offset;
+        H->codec = F.codec;
+        dtype = (NxDType)F.dtype;
+        ndim = F.ndim;
+        memcpy(shape, F.shape, sizeof(shape));
+    } else {
+        char head[256];
+        u64 got = fread(head, 1, sizeof(head), fptr);
+        if(NxText_parse_u64s(head, head + got, 2, shape) == NULL) {
+            fprintf(stderr, "Cannot read file %s it is neither a binary nor a text tensor.\n", fname);
+            exit(EXIT_FAILURE);
+        }
+        H->binary = false;
+        H->offset = 0;
+        H->codec = NxCODEC_NONE;
+        dtype = NxFLOAT64;
+        ndim = 2;
+    }
+    fclose(fptr);
+    H->rows = shape[0];
+
+    if(k == 0) {
+        S->dtype = dtype;
+        S->ndim = ndim;
+        memcpy(S->shape, shape, sizeof(shape));
+        S->sample_bytes = NxDType_size(dtype);
+        for(d=1; d<ndim; d++) {
+            S->sample_bytes *= shape[d];
+        }
+    } else if(dtype != S->dtype || ndim != S->ndim ||
+              memcmp(shape + 1, S->shape + 1, (ndim - 1)*sizeof(u64)) != 0) {
+        fprintf(stderr, "Cannot stream file %s its samples differ from the ones of %s.\n",
+                fname, S->shards[0].fname);
+        exit(EXIT_FAILURE);
+    }
+    S->rows += H->rows;
+}
+
+/**
+ * @brief Read the headers of the shards of a stream.
+ */
+static void NxDataset_stream_init(NxDatasetStream* S, const str* files, u32 count) {
+    u32 k;
+    memset(S, 0, sizeof(NxDatasetStream));
+    if(files == NULL || count == 0) {
+        return ;
+    }
+    S->shards = calloc(count, sizeof(NxDatasetShard));
+    NxASSERT(S->shards != NULL);
+    S->count = count;
+    NxLOOP(k, count) {
+        NxDataset_open_shard(S, k, files[k]);
+    }
+}
+
+/**
+ * @brief Close the shard being read.
+ */
+static void NxDataset_stream_close(NxDatasetStream* S) {
+    if(S->fptr != NULL) {
+        fclose(S->fptr);
+        S->fptr = NULL;
+    }
+    if(S->text != NULL) {
+        NxStorage_release(S->text);
+        S->text = NULL;
+    }
+    if(S->frame != NULL) {
+        NxStorage_release(S->frame);
+        free(S->block);
+        free(S->scratch);
+        S->frame = NULL;
+        S->block = NULL;
+        S->scratch = NULL;
+    }
+}
+
+/**
+ * @brief Map the compressed data of the binary shard H, read it where it cannot be mapped.
+ */
+static void NxDataset_open_frame(NxDatasetStream* S, NxDatasetShard* H) {
+    FILE* fptr = fopen(H->fname, READ_BINARY_MODE);
+    if(fptr == NULL) {
+        fprintf(stderr, "Cannot open file %s file does not exists.\n", H->fname);
+        exit(EXIT_FAILURE);
+    }
+    fseek(fptr, 0, SEEK_END);
+    u64 fsize = (u64)ftell(fptr);
+    u64 bytes = fsize > H->offset ? fsize - H->offset : 0;
+    S->frame = NxStorage_map(H->fname, H->offset, bytes, NxMAP_SEQUENTIAL);
+    if(S->frame == NULL) {
+        S->frame = NxStorage_alloc(bytes);
+        if(fseek(fptr, (long)H->offset, SEEK_SET) != 0 ||
+           fread(S->frame->data, 1, bytes, fptr) != bytes) {
+            fprintf(stderr, "Cannot read file %s the file is truncated.\n", H->fname);
+            exit(EXIT_FAILURE);
+        }
+    }
+    fclose(fptr);
+    const NxCodecFrame* F = S->frame->data;
+    if(!NxCodec_check(F, bytes) || F->bytes != H->rows*S->sample_bytes) {
+        fprintf(stderr, "Cannot read file %s the compressed data is corrupted.\n", H->fname);
+        exit(EXIT_FAILURE);
+    }
+    S->block = malloc(F->block_size);
+    S->scratch = malloc(F->block_size);
+    NxASSERT(S->block != NULL && S->scratch != NULL);
+    S->block_index = -1;
+}
+
+/**
+ * @brief Copy `bytes` bytes from the position `position` of the compressed shard being read.
+ *
+ * The blocks are decompressed as the copy reaches them, the last one is
+ * kept for the next batch.
+ */
+static void NxDataset_read_frame(NxDatasetStream* S, NxDatasetShard* H, char* out, u64 position, u64 bytes) {
+    const NxCodecFrame* F = S->frame->data;
+    while(bytes > 0) {
+        u64 k = position / F->block_size, start = position - k*F->block_size;
+        u64 size = F->bytes - k*F->block_size < F->block_size ? F->bytes - k*F->block_size : F->block_size;
+        if(S->block_index != (i64)k) {
+            if(!NxCodec_decompress_block(S->block, F, k, S->scratch)) {
+                fprintf(stderr, "Cannot read file %s the compressed data is corrupted.\n", H->fname);
+                exit(EXIT_FAILURE);
+            }
+            S->block_index = (i64)k;
+        }
+        u64 take = size - start < bytes ? size - start : bytes;
+        memcpy(out, S->block + start, take);
+        out += take;
+        position += take;
+        bytes -= take;
+    }
+}
+
+/**
+ * @brief Go back to the first sample of the stream.
+ */
+static void NxDataset_stream_rewind(NxDatasetStream* S) {
+    NxDataset_stream_close(S);
+    S->shard = 0;
+    S->row = 0;
+}
+
+/**
+ * @brief Read the next `rows` samples of a stream into T, going through the shards.
+ *
+ * Binary shards are read at the position of the samples, compressed ones
+ * are decompressed block by block, text shards are mapped and parsed from
+ * where the previous batch stopped.
+ */
+static void NxDataset_stream_read(NxDatasetStream* S, NxTensor* T, u64 rows) {
+    u64 shape[NxMAX_DIMS], done = 0;
+    memcpy(shape, S->shape, sizeof(shape));
+    shape[0] = rows;
+    NxTensor_alloc_nd(T, S->ndim, shape, S->dtype);
+
+    char* out = T->raw;
+    while(done < rows) {
+        NxDatasetShard* H = &S->shards[S->shard];
+        if(S->row == H->rows) {
+            NxDataset_stream_close(S);
+            S->shard++;
+            S->row = 0;
+            continue;
+        }
+        if(H->binary && H->codec != NxCODEC_NONE) {
+            if(S->frame == NULL) {
+                NxDataset_open_frame(S, H);
+            }
+        } else if(H->binary && S->fptr == NULL) {
+            S->fptr = fopen(H->fname, READ_BINARY_MODE);
+            if(S->fptr == NULL || fseek(S->fptr, (long)H->offset, SEEK_SET) != 0) {
+                fprintf(stderr, "Cannot open file %s file does not exists.\n", H->fname);
+                exit(EXIT_FAILURE);
+            }
+        } else if(!H->binary && S->text == NULL) {
+            u64 dims[2];
+            S->text = NxText_load(H->fname);
+            if(S->text == NULL) {
+                fprintf(stderr, "Cannot open file %s file does not exists.\n", H->fname);
+                exit(EXIT_FAILURE);
+            }
+            S->cursor = NxText_parse_u64s(S->text->data, (char*)S->text->data + S->text->bytes, 2, dims);
+        }
+
+        u64 take = rows - done < H->rows - S->row ? rows - done : H->rows - S->row;
+        if(H->binary && H->codec != NxCODEC_NONE) {
+            NxDataset_read_frame(S, H, out, S->row*S->sample_bytes, take*S->sample_bytes);
+        } else if(H->binary) {
+            if(fread(out, S->sample_bytes, take, S->fptr) != take) {
+                fprintf(stderr, "Cannot read file %s the file is truncated.\n", H->fname);
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            const char* end = (char*)S->text->data + S->text->bytes;
+            S->cursor = NxText_parse_next(S->cursor, end, take*(S->sample_bytes / sizeof(f64)), (f64*)out);
+            if(S->cursor == NULL) {
+                fprintf(stderr, "Cannot read file %s expected %" PRIu64 " numbers.\n", H->fname, H->rows*S->shape[1]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        out += take*S->sample_bytes;
+        done += take;
+        S->row += take;
+    }
+}
+
+/**
+ * @brief Body of the loader thread: fill the free buffers of the ring with the next batches.
+ */
+static void* NxDataset_loader(void* arg) {
+    NxDataset* D = arg;
+    pthread_mutex_lock(&D->lock);
+    for(;;) {
+        while(!D->stop && (D->done || D->ready + D->held >= D->buffers)) {
+            pthread_cond_wait(&D->space, &D->lock);
+        }
+        if(D->stop) {
+            break;
+        }
+        if(D->position == D->x.rows) {
+            D->done = true;
+            pthread_cond_broadcast(&D->filled);
+            continue;
+        }
+        NxDatasetBatch* B = &D->slots[(D->head + D->ready) % D->buffers];
+        u64 rows = D->x.rows - D->position < D->batch_size ? D->x.rows - D->position : D->batch_size;
+        D->loading = true;
+        pthread_mutex_unlock(&D->lock);
+
+        f64 start = NxDataset_now();
+        NxDataset_stream_read(&D->x, &B->x, rows);
+        if(D->y.count > 0) {
+            NxDataset_stream_read(&D->y, &B->y, rows);
+        }
+        f64 elapsed = NxDataset_now() - start;
+
+        pthread_mutex_lock(&D->lock);
+        D->loading = false;
+        D->position += rows;
+        D->ready++;
+        D->stats.bytes += rows*(D->x.sample_bytes + D->y.sample_bytes);
+        D->stats.load_seconds += elapsed;
+        pthread_cond_broadcast(&D->filled);
+    }
+    pthread_mutex_unlock(&D->lock);
+    return NULL;
+}
+
+/**
+ * @brief Open a dataset and start loading its first batches.
+ *
+ * The headers of the shards are checked now: the samples must have the
+ * same shape and dtype in every shard of a stream, and there must be as
+ * many targets as inputs (the shards themselves may be cut differently).
+ *
+ * @param D the dataset.
+ * @param x_files the shards of the inputs.
+ * @param y_files the shards of the targets, NULL for none.
+ * @param shards number of shards of each stream.
+ * @param batch_size samples per batch.
+ * @param buffers number of batch buffers, from 2 to NxDATASET_MAX_BUFFERS.
+ */
+void NxDataset_open(NxDataset* D, const str* x_files, const str* y_files, u32 shards,
+                    u64 batch_size, u32 buffers) {
+    NxASSERT(batch_size > 0 && shards > 0);
+    memset(D, 0, sizeof(NxDataset));
+    NxDataset_stream_init(&D->x, x_files, shards);
+    NxDataset_stream_init(&D->y, y_files, shards);
+    if(D->y.count > 0 && D->y.rows != D->x.rows) {
+        fprintf(stderr, "Cannot stream %" PRIu64 " inputs with %" PRIu64 " targets.\n", D->x.rows, D->y.rows);
+        exit(EXIT_FAILURE);
+    }
+    D->batch_size = batch_size;
+    D->buffers = buffers < 2 ? 2 : buffers > NxDATASET_MAX_BUFFERS ? NxDATASET_MAX_BUFFERS : buffers;
+    pthread_mutex_init(&D->lock, NULL);
+    pthread_cond_init(&D->filled, NULL);
+    pthread_cond_init(&D->space, NULL);
+    if(pthread_create(&D->thread, NULL, NxDataset_loader, D) != 0) {
+        fprintf(stderr, "Cannot start the loader thread of the dataset.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Describe a resident tensor like the shards of a stream.
+ */
+static void NxDataset_stream_wrap(NxDatasetStream* S, NxTensor* T) {
+    memset(S, 0, sizeof(NxDatasetStream));
+    if(T == NULL) {
+        return ;
+    }
+    NxASSERT(T->allocated);
+    if(T->ndim != 2) {
+        fprintf(stderr, "Cannot make batches of a tensor of %u dimensions.\n", T->ndim);
+        exit(EXIT_FAILURE);
+    }
+    S->dtype = T->dtype;
+    S->ndim = T->ndim;
+    memcpy(S->shape, T->shape, sizeof(S->shape));
+    S->sample_bytes = T->shape[1]*NxDType_size(T->dtype);
+    S->rows = T->shape[0];
+}
+
+/**
+ * @brief Make a dataset of the rows of tensors already in memory.
+ *
+ * The batches are views of the rows of x and y (NxTensor_rows()), so
+ * nothing is copied and no loader thread is started. The tensors must
+ * outlive the dataset.
+ *
+ * @param D the dataset.
+ * @param x the inputs, of shape (samples, features).
+ * @param y the targets, of shape (samples, outputs), NULL for none.
+ * @param batch_size samples per batch.
+ */
+void NxDataset_wrap(NxDataset* D, NxTensor* x, NxTensor* y, u64 batch_size) {
+    NxASSERT(batch_size > 0 && x != NULL);
+    memset(D, 0, sizeof(NxDataset));
+    NxDataset_stream_wrap(&D->x, x);
+    NxDataset_stream_wrap(&D->y, y);
+    if(y != NULL && D->y.rows != D->x.rows) {
+        fprintf(stderr, "Cannot stream %" PRIu64 " inputs with %" PRIu64 " targets.\n", D->x.rows, D->y.rows);
+        exit(EXIT_FAILURE);
+    }
+    D->resident_x = x;
+    D->resident_y = y;
+    D->batch_size = batch_size;
+    D->buffers = 1;
+    pthread_mutex_init(&D->lock, NULL);
+    pthread_cond_init(&D->filled, NULL);
+    pthread_cond_init(&D->space, NULL);
+}
+
+/**
+ * @brief NxDataset_next() of a dataset made by NxDataset_wrap().
+ */
+static bool NxDataset_next_resident(NxDataset* D, NxTensor** x, NxTensor** y) {
+    pthread_mutex_lock(&D->lock);
+    if(D->position == D->x.rows) {
+        pthread_mutex_unlock(&D->lock);
+        return false;
+    }
+    NxDatasetBatch* B = &D->slots[0];
+    u64 start = D->position;
+    u64 rows = D->x.rows - start < D->batch_size ? D->x.rows - start : D->batch_size;
+    D->position += rows;
+    D->stats.batches++;
+    D->stats.samples += rows;
+    pthread_mutex_unlock(&D->lock);
+
+    NxTensor_rows(&B->x, D->resident_x, start, start + rows);
+    if(D->resident_y != NULL) {
+        NxTensor_rows(&B->y, D->resident_y, start, start + rows);
+    }
+    *x = &B->x;
+    if(y != NULL) {
+        *y = D->resident_y != NULL ? &B->y : NULL;
+    }
+    return true;
+}
+
+/**
+ * @brief Get the next batch of the epoch.
+ *
+ * The batch stays valid until the next call, which hands its buffer back
+ * to the loader. Waits when the loader is behind, the time is added to
+ * NxDatasetStats::stall_seconds.
+ *
+ * @param D the dataset.
+ * @param x set to the inputs, (batch, ...) in the dtype of the shards.
+ * @param y set to the targets (NULL when there are none), may be NULL.
+ *
+ * @return (bool) false at the end of the epoch, see NxDataset_rewind().
+ */
+bool NxDataset_next(NxDataset* D, NxTensor** x, NxTensor** y) {
+    if(D->resident_x != NULL) {
+        return NxDataset_next_resident(D, x, y);
+    }
+    pthread_mutex_lock(&D->lock);
+    if(D->held) {
+        D->held = false;
+        pthread_cond_signal(&D->space);
+    }
+    if(D->ready == 0 && !D->done) {
+        f64 start = NxDataset_now();
+        while(D->ready == 0 && !D->done) {
+            pthread_cond_wait(&D->filled, &D->lock);
+        }
+        D->stats.stall_seconds += NxDataset_now() - start;
+    }
+    if(D->ready == 0) {
+        pthread_mutex_unlock(&D->lock);
+        return false;
+    }
+    NxDatasetBatch* B = &D->slots[D->head];
+    D->head = (D->head + 1) % D->buffers;
+    D->ready--;
+    D->held = true;
+    D->stats.batches++;
+    D->stats.samples += B->x.shape[0];
+    pthread_mutex_unlock(&D->lock);
+
+    *x = &B->x;
+    if(y != NULL) {
+        *y = D->y.count > 0 ? &B->y : NULL;
+    }
+    return true;
+}
+
+/**
+ * @brief Start a new epoch from the first sample.
+ *
+ * May be called in the middle of an epoch, the batches already loaded
+ * are dropped and the batch returned last becomes invalid.
+ */
+void NxDataset_rewind(NxDataset* D) {
+    pthread_mutex_lock(&D->lock);
+    while(D->loading) {
+        pthread_cond_wait(&D->filled, &D->lock);
+    }
+    NxDataset_stream_rewind(&D->x);
+    NxDataset_stream_rewind(&D->y);
+    D->position = 0;
+    D->head = 0;
+    D->ready = 0;
+    D->held = false;
+    D->done = false;
+    pthread_cond_signal(&D->space);
+    pthread_mutex_unlock(&D->lock);
+}
+
+/**
+ * @brief Stop the loader and free the batches and the shards.
+ */
+void NxDataset_close(NxDataset* D) {
+    u32 k;
+    if(D->resident_x == NULL) {
+        pthread_mutex_lock(&D->lock);
+        D->stop = true;
+        pthread_cond_signal(&D->space);
+        pthread_mutex_unlock(&D->lock);
+        pthread_join(D->thread, NULL);
+    }
+    pthread_mutex_destroy(&D->lock);
+    pthread_cond_destroy(&D->filled);
+    pthread_cond_destroy(&D->space);
+
+    NxLOOP(k, NxDATASET_MAX_BUFFERS) {
+        NxTensor_free(&D->slots[k].x);
+        NxTensor_free(&D->slots[k].y);
+    }
+    NxDatasetStream* streams[2] = {&D->x, &D->y};
+    u32 s;
+    NxLOOP(s, 2) {
+        NxDataset_stream_close(streams[s]);
+        NxLOOP(k, streams[s]->count) {
+            free(streams[s]->shards[k].fname);
+        }
+        free(streams[s]->shards);
+        streams[s]->shards = NULL;
+        streams[s]->count = 0;
+    }
+}
+
+/**
+ * @brief Number of samples of an epoch.
+ */
+u64 NxDataset_size(NxDataset* D) {
+    return D->x.rows;
+}
+
+/**
+ * @brief Copy the counters of the dataset.
+ */
+void NxDataset_stats(NxDataset* D, NxDatasetStats* S) {
+    pthread_mutex_lock(&D->lock);
+    *S = D->stats;
+    pthread_mutex_unlock(&D->lock);
+}
+
+/**
+ * @brief Set the counters of the dataset to zero.
+ */
+void NxDataset_reset_stats(NxDataset* D) {
+    pthread_mutex_lock(&D->lock);
+    memset(&D->stats, 0, sizeof(NxDatasetStats));
+    pthread_mutex_unlock(&D->lock);
+}
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxDataset.c
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,549 @@
+#include "NxExpr.h"
+#include "NxKernels.h"
+#include "NxMath.h"
+#include "NxReduce.h"
+
+#include <math.h>
+#include <string.h>
+
+/**
+ * @brief Append a node to the expression and return its index.
+ */
+static u32 NxExpr_push(NxExpr* E, NxExprOp op, u32 a, u32 b, NxTensor* tensor, f64 value) {
+    if(E->count == NxEXPR_MAX_NODES) {
+        fprintf(stderr, "Expression has more than %d nodes.\n", NxEXPR_MAX_NODES);
+        exit(EXIT_FAILURE);
+    }
+    if(op > NxEXPR_CONST && (a >= E->count || (op <= NxEXPR_DIV && b >= E->count))) {
+        fprintf(stderr, "Expression node refers to an unknown operand.\n");
+        exit(EXIT_FAILURE);
+    }
+    NxExprNode* node = &E->nodes[E->count];
+    node->op = op;
+    node->a = a;
+    node->b = b;
+    node->tensor = tensor;
+    node->value = value;
+    return E->count++;
+}
+
+/**
+ * @brief Start an empty expression.
+ */
+void NxExpr_init(NxExpr* E) {
+    E->count = 0;
+}
+
+/**
+ * @brief Leaf reading the elements of a f64 tensor.
+ *
+ * All the tensors of an expression must have the same number of elements.
+ * The tensor is only read by the terminal functions, it may be allocated
+ * after the expression is built.
+ */
+u32 NxExpr_tensor(NxExpr* E, NxTensor* A) {
+    NxASSERT(A != NULL);
+    return NxExpr_push(E, NxEXPR_TENSOR, 0, 0, A, 0.0);
+}
+
+/**
+ * @brief Leaf holding a scalar used for every element.
+ */
+u32 NxExpr_const(NxExpr* E, f64 value) {
+    return NxExpr_push(E, NxEXPR_CONST, 0, 0, NULL, value);
+}
+
+u32 NxExpr_add(NxExpr* E, u32 a, u32 b)     { return NxExpr_push(E, NxEXPR_ADD, a, b, NULL, 0.0); }
+u32 NxExpr_sub(NxExpr* E, u32 a, u32 b)     { return NxExpr_push(E, NxEXPR_SUB, a, b, NULL, 0.0); }
+u32 NxExpr_mul(NxExpr* E, u32 a, u32 b)     { return NxExpr_push(E, NxEXPR_MUL, a, b, NULL, 0.0); }
+u32 NxExpr_div(NxExpr* E, u32 a, u32 b)     { return NxExpr_push(E, NxEXPR_DIV, a, b, NULL, 0.0); }
+u32 NxExpr_neg(NxExpr* E, u32 a)            { return NxExpr_push(E, NxEXPR_NEG, a, 0, NULL, 0.0); }
+u32 NxExpr_abs(NxExpr* E, u32 a)            { return NxExpr_push(E, NxEXPR_ABS, a, 0, NULL, 0.0); }
+u32 NxExpr_square(NxExpr* E, u32 a)         { return NxExpr_push(E, NxEXPR_SQUARE, a, 0, NULL, 0.0); }
+u32 NxExpr_exp(NxExpr* E, u32 a)            { return NxExpr_push(E, NxEXPR_EXP, a, 0, NULL, 0.0); }
+u32 NxExpr_log(NxExpr* E, u32 a)            { return NxExpr_push(E, NxEXPR_LOG, a, 0, NULL, 0.0); }
+u32 NxExpr_tanh(NxExpr* E, u32 a)           { return NxExpr_push(E, NxEXPR_TANH, a, 0, NULL, 0.0); }
+u32 NxExpr_sigmoid(NxExpr* E, u32 a)        { return NxExpr_push(E, NxEXPR_SIGMOID, a, 0, NULL, 0.0); }
+u32 NxExpr_prelu(NxExpr* E, u32 a, f64 s)   { return NxExpr_push(E, NxEXPR_PRELU, a, 0, NULL, s); }
+u32 NxExpr_elu(NxExpr* E, u32 a, f64 alpha) { return NxExpr_push(E, NxEXPR_ELU, a, 0, NULL, alpha); }
+
+/**
+ * @brief State of one evaluation: the leaves and the per node block buffers.
+ */
+typedef struct NxExprEval {
+    u64 size; ///< number of elements of every tensor leaf.
+    NxTensor* like; ///< first tensor leaf, gives the shape of NxExpr_assign().
+    bool live[NxEXPR_MAX_NODES]; ///< nodes the root depends on.
+    const f64* base[NxEXPR_MAX_NODES]; ///< data of the tensor leaves.
+    NxTensor packed[NxEXPR_MAX_NODES]; ///< contiguous copies of the strided leaves.
+    const f64* vals[NxEXPR_MAX_NODES]; ///< block of values of every vector node.
+    f64 scalar[NxEXPR_MAX_NODES]; ///< value of the nodes that only depend on constants.
+    bool is_scalar[NxEXPR_MAX_NODES]; ///< whether the node is a scalar.
+    f64 block[NxEXPR_MAX_NODES][NxEXPR_BLOCK]; ///< output block of every vector node.
+} NxExprEval;
+
+/**
+ * @brief Check the expression, find the live nodes and take the data of the leaves.
+ */
+static void NxExpr_prepare(NxExpr* E, u32 root, NxExprEval* V) {
+    u32 k;
+    if(root >= E->count) {
+        fprintf(stderr, "Expression has no node %u.\n", root);
+        exit(EXIT_FAILURE);
+    }
+    memset(V->live, 0, sizeof(V->live));
+    memset(V->packed, 0, sizeof(V->packed));
+    V->live[root] = true;
+    V->like = NULL;
+    for(k=root+1; k-- > 0; ) {
+        NxExprNode* node = &E->nodes[k];
+        if(!V->live[k]) {
+            continue;
+        }
+        if(node->op == NxEXPR_TENSOR) {
+            continue;
+        }
+        if(node->op != NxEXPR_CONST) {
+            V->live[node->a] = true;
+        }
+        if(node->op >= NxEXPR_ADD && node->op <= NxEXPR_DIV) {
+            V->live[node->b] = true;
+        }
+    }
+    NxLOOP(k, root+1) {
+        NxTensor* A = E->nodes[k].tensor;
+        if(!V->live[k] || E->nodes[k].op != NxEXPR_TENSOR) {
+            continue;
+        }
+        NxASSERT(A->allocated);
+        if(A->dtype != NxFLOAT64) {
+            fprintf(stderr, "Expressions only support f64 tensors, got %s.\n", NxDType_name(A->dtype));
+            exit(EXIT_FAILURE);
+        }
+        if(V->like == NULL) {
+            V->like = A;
+            V->size = NxTensor_size(A);
+        } else if(NxTensor_size(A) != V->size) {
+            fprintf(stderr, "Cannot evaluate an expression over tensors with %" PRIu64 " and %" PRIu64 " elements.\n",
+                    V->size, NxTensor_size(A));
+            exit(EXIT_FAILURE);
+        }
+        if(NxTensor_is_contiguous(A)) {
+            V->base[k] = A->data;
+        } else {
+            NxTensor_contiguous(&V->packed[k], A);
+            V->base[k] = V->packed[k].data;
+        }
+    }
+    if(V->like == NULL) {
+        fprintf(stderr, "Expression has no tensor.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Apply a scalar operation, used when every operand is a constant.
+ */
+static f64 NxExpr_scalar_op(const NxExprNode* node, f64 a, f64 b) {
+    switch(node->op) {
+    case NxEXPR_ADD:     return a + b;
+    case NxEXPR_SUB:     return a - b;
+    case NxEXPR_MUL:     return a * b;
+    case NxEXPR_DIV:     return a / b;
+    case NxEXPR_NEG:     return -a;
+    case NxEXPR_ABS:     return fabs(a);
+    case NxEXPR_SQUARE:  return a * a;
+    case NxEXPR_EXP:     return exp(a);
+    case NxEXPR_LOG:     return log(a);
+    case NxEXPR_TANH:    return tanh(a);
+    case NxEXPR_SIGMOID: return 1.0 / (1.0 + exp(-a));
+    case NxEXPR_PRELU:   return a > 0.0 ? a : node->value*a;
+    case NxEXPR_ELU:     return a > 0.0 ? a : node->value*expm1(a);
+    default:             return a;
+    }
+}
+
+/**
+ * @brief Run a binary node over one block, either operand may be a scalar.
+ */
+static void NxExpr_binary(NxExprOp op, u64 len, const f64* a, f64 sa, bool a_scalar,
+                          const f64* b, f64 sb, bool b_scalar, f64* c) {
+    const NxKernels* K = NxKernels_get();
+    u64 j;
+    if(!a_scalar && !b_scalar) {
+        switch(op) {
+        case NxEXPR_ADD: K->add(len, a, b, c); break;
+        case NxEXPR_SUB: K->sub(len, a, b, c); break;
+        case NxEXPR_MUL: K->mul(len, a, b, c); break;
+        default:         K->div(len, a, b, c); break;
+        }
+    } else if(b_scalar) {
+        switch(op) {
+        case NxEXPR_ADD: K->add_scalar(len, a, sb, c); break;
+        case NxEXPR_SUB: K->add_scalar(len, a, -sb, c); break;
+        case NxEXPR_MUL: K->mul_scalar(len, a, sb, c); break;
+        default:         K->div_scalar(len, a, sb, c); break;
+        }
+    } else {
+        switch(op) {
+        case NxEXPR_ADD: K->add_scalar(len, b, sa, c); break;
+        case NxEXPR_SUB: K->neg(len, b, c); K->add_scalar(len, c, sa, c); break;
+        case NxEXPR_MUL: K->mul_scalar(len, b, sa, c); break;
+        default:         NxLOOP(j, len) { c[j] = sa / b[j]; } break;
+        }
+    }
+}
+
+/**
+ * @brief Evaluate the live nodes over the elements [i, i+len).
+ *
+ * The root is written to `out` when it is not NULL, the returned pointer
+ * holds the block of the root (NULL if the root is a scalar).
+ */
+static const f64* NxExpr_block(NxExpr* E, u32 root, NxExprEval* V, u64 i, u64 len, f64* out) {
+    const NxKernels* K = NxKernels_get();
+    u64 j;
+    u32 k;
+    NxLOOP(k, root+1) {
+        NxExprNode* node = &E->nodes[k];
+        if(!V->live[k]) {
+            continue;
+        }
+        if(node->op == NxEXPR_TENSOR) {
+            V->vals[k] = V->base[k] + i;
+            V->is_scalar[k] = false;
+            continue;
+        }
+        if(node->op == NxEXPR_CONST) {
+            V->scalar[k] = node->value;
+            V->is_scalar[k] = true;
+            continue;
+        }
+        bool binary = node->op <= NxEXPR_DIV;
+        u32 a = node->a, b = binary ? node->b : node->a;
+        if(V->is_scalar[a] && V->is_scalar[b]) {
+            V->scalar[k] = NxExpr_scalar_op(node, V->scalar[a], V->scalar[b]);
+            V->is_scalar[k] = true;
+            continue;
+        }
+        f64* c = k == root && out != NULL ? out : V->block[k];
+        const f64* va = V->vals[a];
+        switch(node->op) {
+        case NxEXPR_NEG:     K->neg(len, va, c); break;
+        case NxEXPR_ABS:     K->abs(len, va, c); break;
+        case NxEXPR_SQUARE:  K->mul(len, va, va, c); break;
+        case NxEXPR_EXP:     NxMath_exp(len, va, c); break;
+        case NxEXPR_LOG:     NxMath_log(len, va, c); break;
+        case NxEXPR_TANH:    NxMath_tanh(len, va, c); break;
+        case NxEXPR_SIGMOID: NxMath_sigmoid(len, va, c); break;
+        case NxEXPR_PRELU:
+            NxLOOP(j, len) {
+                c[j] = va[j] > 0.0 ? va[j] : node->value*va[j];
+            }
+            break;
+        case NxEXPR_ELU:
+            NxLOOP(j, len) {
+                c[j] = va[j] > 0.0 ? va[j] : node->value*expm1(va[j]);
+            }
+            break;
+        default:
+            NxExpr_binary(node->op, len, va, V->scalar[a], V->is_scalar[a],
+                          V->vals[b], V->scalar[b], V->is_scalar[b], c);
+            break;
+        }
+        V->vals[k] = c;
+        V->is_scalar[k] = false;
+    }
+    return V->is_scalar[root] ? NULL : V->vals[root];
+}
+
+/**
+ * @brief Free the packed copies of the strided leaves.
+ */
+static void NxExpr_release(NxExprEval* V) {
+    u32 k;
+    NxLOOP(k, NxEXPR_MAX_NODES) {
+        NxTensor_free(&V->packed[k]);
+    }
+}
+
+/**
+ * @brief Evaluate the expression into C in a single pass.
+ *
+ * C gets the shape of the first tensor of the expression and may be one
+ * of its tensors, e.g. `A = A*s + B` updates A in place.
+ *
+ * @param E the expression.
+ * @param C pointer to the output tensor.
+ * @param root index of the node to evaluate.
+ */
+void NxExpr_assign(NxExpr* E, NxTensor* C, u32 root) {
+    NxExprEval V;
+    NxExpr_prepare(E, root, &V);
+
+    u64 shape[NxMAX_DIMS], size = V.size, i;
+    u32 ndim = V.like->ndim, k;
+    memcpy(shape, V.like->shape, sizeof(shape));
+    /* A leaf read in place from C keeps its buffer alive until the end. */
+    NxStorage* H = NULL;
+    NxLOOP(k, root+1) {
+        if(H == NULL && V.live[k] && E->nodes[k].op == NxEXPR_TENSOR && !V.packed[k].allocated) {
+            H = NxTensor_hold(C, E->nodes[k].tensor, size, NxFLOAT64);
+        }
+    }
+    NxTensor_alloc_nd(C, ndim, shape, NxFLOAT64);
+    for(i=0; i<size; i+=NxEXPR_BLOCK) {
+        u64 len = size - i < NxEXPR_BLOCK ? size - i : NxEXPR_BLOCK;
+        const f64* r = NxExpr_block(E, root, &V, i, len, C->data + i);
+        if(r == NULL) {
+            NxKernels_get()->fill(len, V.scalar[root], C->data + i);
+        } else if(r != C->data + i) {
+            memmove(C->data + i, r, len*sizeof(f64));
+        }
+    }
+    NxTensor_unhold(H);
+    NxExpr_release(&V);
+}
+
+/**
+ * @brief Sum the root over all the elements, every block is reduced as soon as it is computed.
+ */
+static f64 NxExpr_reduce(NxExpr* E, u32 root, NxExprEval* V) {
+    u64 size = V->size, i;
+    f64 sum = 0.0, comp = 0.0;
+    for(i=0; i<size; i+=NxEXPR_BLOCK) {
+        u64 len = size - i < NxEXPR_BLOCK ? size - i : NxEXPR_BLOCK;
+        const f64* r = NxExpr_block(E, root, V, i, len, NULL);
+        f64 part = r == NULL ? V->scalar[root]*(f64)len : NxReduce_sum(len, r);
+        /* Kahan summation of the block sums. */
+        f64 y = part - comp, t = sum + y;
+        comp = (t - sum) - y;
+        sum = t;
+    }
+    return sum;
+}
+
+/**
+ * @brief Evaluate the expression and return the sum of its elements.
+ *
+ * Nothing is stored, no temporary tensor is allocated for the inner nodes.
+ */
+f64 NxExpr_sum(NxExpr* E, u32 root) {
+    NxExprEval V;
+    NxExpr_prepare(E, root, &V);
+    f64 sum = NxExpr_reduce(E, root, &V);
+    NxExpr_release(&V);
+    return sum;
+}
+
+/**
+ * @brief Evaluate the expression and return the mean of its elements.
+ */
+f64 NxExpr_mean(NxExpr* E, u32 root) {
+    NxExprEval V;
+    NxExpr_prepare(E, root, &V);
+    f64 mean = V.size ? NxExpr_reduce(E, root, &V) / (f64)V.size : 0.0;
+    NxExpr_release(&V);
+    return mean;
+}
+
+/**
+ * @brief Values of the node k over the block, a scalar node is broadcast into `scratch`.
+ */
+static const f64* NxExpr_values(NxExprEval* V, u32 k, u64 len, f64* scratch) {
+    if(V->is_scalar[k]) {
+        NxKernels_get()->fill(len, V->scalar[k], scratch);
+        return scratch;
+    }
+    return V->vals[k];
+}
+
+/**
+ * @brief Add the adjoints of the operands of a node from its own adjoint g over one block.
+ *
+ * da and db are NULL for the scalar operands, which get no gradient.
+ */
+static void NxExpr_adjoint(NxExprEval* V, NxExprNode* node, u32 k, u64 len, const f64* g, f64* da, f64* db) {
+    f64 sa[NxEXPR_BLOCK], sb[NxEXPR_BLOCK];
+    const f64* c = V->vals[k];
+    const f64* va = NxExpr_values(V, node->a, len, sa);
+    const f64* vb = node->op <= NxEXPR_DIV ? NxExpr_values(V, node->b, len, sb) : va;
+    u64 j;
+    switch(node->op) {
+    case NxEXPR_ADD:
+    case NxEXPR_SUB:
+        if(da != NULL) {
+            NxLOOP(j, len) {
+                da[j] += g[j];
+            }
+        }
+        if(db != NULL) {
+            f64 sign = node->op == NxEXPR_ADD ? 1.0 : -1.0;
+            NxLOOP(j, len) {
+                db[j] += sign*g[j];
+            }
+        }
+        break;
+    case NxEXPR_MUL:
+        if(da != NULL) {
+            NxLOOP(j, len) {
+                da[j] += g[j]*vb[j];
+            }
+        }
+        if(db != NULL) {
+            NxLOOP(j, len) {
+                db[j] += g[j]*va[j];
+            }
+        }
+        break;
+    case NxEXPR_DIV:
+        if(da != NULL) {
+            NxLOOP(j, len) {
+                da[j] += g[j] / vb[j];
+            }
+        }
+        if(db != NULL) {
+            NxLOOP(j, len) {
+                db[j] -= g[j]*c[j] / vb[j];
+            }
+        }
+        break;
+    case NxEXPR_NEG:
+        NxLOOP(j, len) {
+            da[j] -= g[j];
+        }
+        break;
+    case NxEXPR_ABS:
+        NxLOOP(j, len) {
+            f64 x = va[j];
+            da[j] += x > 0.0 ? g[j] : (x < 0.0 ? -g[j] : 0.0);
+        }
+        break;
+    case NxEXPR_SQUARE:
+        NxLOOP(j, len) {
+            da[j] += 2.0*va[j]*g[j];
+        }
+        break;
+    case NxEXPR_EXP:
+        NxLOOP(j, len) {
+            da[j] += g[j]*c[j];
+        }
+        break;
+    case NxEXPR_LOG:
+        NxLOOP(j, len) {
+            da[j] += g[j] / va[j];
+        }
+        break;
+    case NxEXPR_TANH:
+        NxLOOP(j, len) {
+            da[j] += g[j]*(1.0 - c[j]*c[j]);
+        }
+        break;
+    case NxEXPR_SIGMOID:
+        NxLOOP(j, len) {
+            da[j] += g[j]*c[j]*(1.0 - c[j]);
+        }
+        break;
+    case NxEXPR_PRELU:
+        NxLOOP(j, len) {
+            da[j] += va[j] > 0.0 ? g[j] : node->value*g[j];
+        }
+        break;
+    case NxEXPR_ELU:
+        NxLOOP(j, len) {
+            da[j] += va[j] > 0.0 ? g[j] : g[j]*(c[j] + node->value);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Accumulate the gradient of the root into the gradients of the tensor leaves.
+ *
+ * Reverse mode block by block: every block is evaluated like in
+ * NxExpr_assign(), which keeps the values of all the nodes, then the
+ * adjoints flow from the root back to the leaves in the reverse order of
+ * the nodes. Like the forward pass no full size temporary is allocated,
+ * only one block of adjoints per node.
+ *
+ * @param E the expression.
+ * @param root index of the node to differentiate.
+ * @param grad contiguous gradient with respect to the root, one element per element of the tensors.
+ * @param grads contiguous gradient of every tensor leaf, in the order the
+ * leaves were added, NULL to skip one. The gradients are added to them.
+ */
+void NxExpr_backward(NxExpr* E, u32 root, NxTensor* grad, NxTensor* const* grads) {
+    const NxKernels* K = NxKernels_get();
+    NxExprEval V;
+    f64 adj[NxEXPR_MAX_NODES][NxEXPR_BLOCK];
+    u32 slot[NxEXPR_MAX_NODES], leaves = 0, k;
+    u64 i;
+    NxExpr_prepare(E, root, &V);
+    NxASSERT(NxTensor_is_contiguous(grad));
+    if(NxTensor_size(grad) != V.size) {
+        fprintf(stderr, "Cannot backward an expression over %" PRIu64 " elements with a gradient of %" PRIu64 ".\n",
+                V.size, NxTensor_size(grad));
+        exit(EXIT_FAILURE);
+    }
+    NxLOOP(k, root+1) {
+        slot[k] = E->nodes[k].op == NxEXPR_TENSOR ? leaves++ : 0;
+    }
+
+    for(i=0; i<V.size; i+=NxEXPR_BLOCK) {
+        u64 len = V.size - i < NxEXPR_BLOCK ? V.size - i : NxEXPR_BLOCK;
+        if(NxExpr_block(E, root, &V, i, len, NULL) == NULL) {
+            break; /* a root made of constants only has no gradient */
+        }
+        NxLOOP(k, root) {
+            if(V.live[k] && !V.is_scalar[k]) {
+                memset(adj[k], 0, len*sizeof(f64));
+            }
+        }
+        memcpy(adj[root], grad->data + i, len*sizeof(f64));
+        for(k=root+1; k-- > 0; ) {
+            NxExprNode* node = &E->nodes[k];
+            if(!V.live[k] || V.is_scalar[k]) {
+                continue;
+            }
+            if(node->op == NxEXPR_TENSOR) {
+                if(grads[slot[k]] != NULL) {
+                    f64* d = grads[slot[k]]->data + i;
+                    K->add(len, d, adj[k], d);
+                }
+                continue;
+            }
+            u32 a = node->a, b = node->op <= NxEXPR_DIV ? node->b : node->a;
+            f64* da = V.is_scalar[a] ? NULL : adj[a];
+            f64* db = node->op <= NxEXPR_DIV && !V.is_scalar[b] ? adj[b] : NULL;
+            NxExpr_adjoint(&V, node, k, len, adj[k], da, db);
+        }
+    }
+    NxExpr_release(&V);
+}
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxExpr.c
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,798 @@
+#include "NxGemm.h"
+#include "NxThreadPool.h"
+#include "NxMemory.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NxGEMM_X86
+#endif
+
+/// Signature of the register-tiled micro-kernels.
+typedef void (*NxGemmKernel)(u64 kc, const f64* a, const f64* b, f64* ab);
+
+static inline u64 NxGemm_min(u64 a, u64 b) {
+    return a < b ? a : b;
+}
+
+/**
+ * @brief Allocate a packing buffer aligned to NxGEMM_ALIGN.
+ *
+ * Taken from NxCache, so the products of a training loop reuse the same
+ * buffers instead of going to the system at every call.
+ *
+ * @param count number of `f64` elements.
+ */
+static f64* NxGemm_alloc_buffer(u64 count) {
+    u64 bytes = count*sizeof(f64);
+    bytes = (bytes + NxGEMM_ALIGN - 1) / NxGEMM_ALIGN * NxGEMM_ALIGN;
+    f64* buffer = NxCache_alloc(bytes);
+    NxASSERT(buffer != NULL);
+    return buffer;
+}
+
+/**
+ * @brief Pack a (mc x kc) block of A into row micro-panels.
+ *
+ * Every micro-panel holds NxGEMM_MR rows stored column after column so the
+ * micro-kernel reads it with unit stride. The last panel is zero padded.
+ *
+ * @param Ap the packing buffer.
+ * @param A pointer to the first element of the block.
+ * @param rsa row stride of A.
+ * @param csa column stride of A.
+ */
+static void NxGemm_pack_A(f64* Ap, const f64* A, i64 rsa, i64 csa, u64 mc, u64 kc) {
+    u64 i, p, r;
+    for(i=0; i<mc; i+=NxGEMM_MR) {
+        u64 mr = NxGemm_min(NxGEMM_MR, mc - i);
+        const f64* a = A + (i64)i*rsa;
+        if(mr == NxGEMM_MR && csa == 1) {
+            NxLOOP(p, kc) {
+                NxLOOP(r, NxGEMM_MR) {
+                    Ap[r] = a[(i64)r*rsa + (i64)p];
+                }
+                Ap += NxGEMM_MR;
+            }
+            continue;
+        }
+        NxLOOP(p, kc) {
+            NxLOOP(r, mr) {
+                Ap[r] = a[(i64)r*rsa + (i64)p*csa];
+            }
+            for(r=mr; r<NxGEMM_MR; r++) {
+                Ap[r] = 0.0;
+            }
+            Ap += NxGEMM_MR;
+        }
+    }
+}
+
+/**
+ * @brief Pack a (kc x nc) block of B into column micro-panels.
+ *
+ * Every micro-panel holds NxGEMM_NR columns stored row after row. The last
+ * panel is zero padded.
+ *
+ * @param Bp the packing buffer.
+ * @param B pointer to the first element of the block.
+ * @param rsb row stride of B.
+ * @param csb column stride of B.
+ */
+static void NxGemm_pack_B(f64* Bp, const f64* B, i64 rsb, i64 csb, u64 kc, u64 nc) {
+    u64 j, p, r;
+    for(j=0; j<nc; j+=NxGEMM_NR) {
+        u64 nr = NxGemm_min(NxGEMM_NR, nc - j);
+        const f64* b = B + (i64)j*csb;
+        if(nr == NxGEMM_NR && csb == 1) {
+            NxLOOP(p, kc) {
+                memcpy(Bp, b + (i64)p*rsb, NxGEMM_NR*sizeof(f64));
+                Bp += NxGEMM_NR;
+            }
+            continue;
+        }
+        NxLOOP(p, kc) {
+            NxLOOP(r, nr) {
+                Bp[r] = b[(i64)p*rsb + (i64)r*csb];
+            }
+            for(r=nr; r<NxGEMM_NR; r++) {
+                Bp[r] = 0.0;
+            }
+            Bp += NxGEMM_NR;
+        }
+    }
+}
+
+/**
+ * @brief Portable micro-kernel computing a (MR x NR) tile of A*B.
+ *
+ * @param kc depth of the packed micro-panels.
+ * @param a packed micro-panel of A.
+ * @param b packed micro-panel of B.
+ * @param ab output tile stored row-major with NxGEMM_NR columns.
+ */
+static void NxGemm_kernel_generic(u64 kc, const f64* a, const f64* b, f64* ab) {
+    f64 acc[NxGEMM_MR][NxGEMM_NR] = {{0.0}};
+    u64 p, i, j;
+    NxLOOP(p, kc) {
+        NxLOOP(i, NxGEMM_MR) {
+            f64 ai = a[i];
+            NxLOOP(j, NxGEMM_NR) {
+                acc[i][j] += ai * b[j];
+            }
+        }
+        a += NxGEMM_MR;
+        b += NxGEMM_NR;
+    }
+    memcpy(ab, acc, sizeof(acc));
+}
+
+#ifdef NxGEMM_X86
+/**
+ * @brief AVX2/FMA micro-kernel computing a (6 x 8) tile of A*B.
+ *
+ * Keeps the whole tile in twelve ymm accumulators and issues two
+ * FMAs per broadcast element of A.
+ */
+__attribute__((target("avx2,fma")))
+static void NxGemm_kernel_avx2(u64 kc, const f64* a, const f64* b, f64* ab) {
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+    __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+    u64 p;
+    NxLOOP(p, kc) {
+        __m256d b0 = _mm256_load_pd(b);
+        __m256d b1 = _mm256_load_pd(b + 4);
+        __m256d ai;
+        ai = _mm256_broadcast_sd(a + 0);
+        c00 = _mm256_fmadd_pd(ai, b0, c00); c01 = _mm256_fmadd_pd(ai, b1, c01);
+        ai = _mm256_broadcast_sd(a + 1);
+        c10 = _mm256_fmadd_pd(ai, b0, c10); c11 = _mm256_fmadd_pd(ai, b1, c11);
+        ai = _mm256_broadcast_sd(a + 2);
+        c20 = _mm256_fmadd_pd(ai, b0, c20); c21 = _mm256_fmadd_pd(ai, b1, c21);
+        ai = _mm256_broadcast_sd(a + 3);
+        c30 = _mm256_fmadd_pd(ai, b0, c30); c31 = _mm256_fmadd_pd(ai, b1, c31);
+        ai = _mm256_broadcast_sd(a + 4);
+        c40 = _mm256_fmadd_pd(ai, b0, c40); c41 = _mm256_fmadd_pd(ai, b1, c41);
+        ai = _mm256_broadcast_sd(a + 5);
+        c50 = _mm256_fmadd_pd(ai, b0, c50); c51 = _mm256_fmadd_pd(ai, b1, c51);
+        a += NxGEMM_MR;
+        b += NxGEMM_NR;
+    }
+    _mm256_storeu_pd(ab +  0, c00); _mm256_storeu_pd(ab +  4, c01);
+    _mm256_storeu_pd(ab +  8, c10); _mm256_storeu_pd(ab + 12, c11);
+    _mm256_storeu_pd(ab + 16, c20); _mm256_storeu_pd(ab + 20, c21);
+    _mm256_storeu_pd(ab + 24, c30); _mm256_storeu_pd(ab + 28, c31);
+    _mm256_storeu_pd(ab + 32, c40); _mm256_storeu_pd(ab + 36, c41);
+    _mm256_storeu_pd(ab + 40, c50); _mm256_storeu_pd(ab + 44, c51);
+}
+#endif /* NxGEMM_X86 */
+
+/**
+ * @brief Pick the fastest micro-kernel supported by the running CPU.
+ */
+static NxGemmKernel NxGemm_select_kernel(void) {
+#ifdef NxGEMM_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return NxGemm_kernel_avx2;
+    }
+#endif
+    return NxGemm_kernel_generic;
+}
+
+/// Micro-kernel of NxGemm_dgemm(), picked once when the library is loaded.
+static NxGemmKernel NxGemm_kernel = NxGemm_kernel_generic;
+
+__attribute__((constructor))
+static void NxGemm_init(void) {
+    NxGemm_kernel = NxGemm_select_kernel();
+}
+
+/**
+ * @brief Merge a computed tile into C as `C = alpha*AB + beta*C`.
+ *
+ * C is never read when beta is zero, so it may hold garbage.
+ */
+static void NxGemm_store_tile(const f64* ab, f64* C, i64 rsc, i64 csc,
+                              u64 mr, u64 nr, f64 alpha, f64 beta) {
+    u64 i, j;
+    if(beta == 0.0) {
+        NxLOOP(i, mr) {
+            NxLOOP(j, nr) {
+                C[(i64)i*rsc + (i64)j*csc] = alpha*ab[i*NxGEMM_NR + j];
+            }
+        }
+        return ;
+    }
+    NxLOOP(i, mr) {
+        NxLOOP(j, nr) {
+            f64* c = &C[(i64)i*rsc + (i64)j*csc];
+            *c = alpha*ab[i*NxGEMM_NR + j] + beta*(*c);
+        }
+    }
+}
+
+/**
+ * @brief Scale C by beta, used when the product term vanishes.
+ */
+static void NxGemm_scale(u64 m, u64 n, f64 beta, f64* C, i64 rsc, i64 csc) {
+    u64 i, j;
+    NxLOOP(i, m) {
+        NxLOOP(j, n) {
+            f64* c = &C[(i64)i*rsc + (i64)j*csc];
+            *c = beta == 0.0 ? 0.0 : beta*(*c);
+        }
+    }
+}
+
+/**
+ * @brief Serial blocked `C = alpha*A*B + beta*C` with a given micro-kernel.
+ */
+static void NxGemm_blocked(NxGemmKernel kernel, u64 m, u64 n, u64 k, f64 alpha,
+                           const f64* A, i64 rsa, i64 csa,
+                           const f64* B, i64 rsb, i64 csb,
+                           f64 beta, f64* C, i64 rsc, i64 csc) {
+    f64* Ap = NxGemm_alloc_buffer(NxGEMM_MC*NxGEMM_KC);
+    f64* Bp = NxGemm_alloc_buffer(NxGEMM_KC*NxGemm_min(NxGEMM_NC, (n + NxGEMM_NR - 1)/NxGEMM_NR*NxGEMM_NR));
+    f64 ab[NxGEMM_MR*NxGEMM_NR];
+
+    u64 jc, pc, ic, jr, ir;
+    for(jc=0; jc<n; jc+=NxGEMM_NC) {
+        u64 nc = NxGemm_min(NxGEMM_NC, n - jc);
+        for(pc=0; pc<k; pc+=NxGEMM_KC) {
+            u64 kc = NxGemm_min(NxGEMM_KC, k - pc);
+            f64 beta_pc = pc == 0 ? beta : 1.0;
+            NxGemm_pack_B(Bp, B + (i64)pc*rsb + (i64)jc*csb, rsb, csb, kc, nc);
+            for(ic=0; ic<m; ic+=NxGEMM_MC) {
+                u64 mc = NxGemm_min(NxGEMM_MC, m - ic);
+                NxGemm_pack_A(Ap, A + (i64)ic*rsa + (i64)pc*csa, rsa, csa, mc, kc);
+                for(jr=0; jr<nc; jr+=NxGEMM_NR) {
+                    u64 nr = NxGemm_min(NxGEMM_NR, nc - jr);
+                    for(ir=0; ir<mc; ir+=NxGEMM_MR) {
+                        u64 mr = NxGemm_min(NxGEMM_MR, mc - ir);
+                        kernel(kc, Ap + ir*kc, Bp + jr*kc, ab);
+                        NxGemm_store_tile(ab, C + (i64)(ic + ir)*rsc + (i64)(jc + jr)*csc,
+                                          rsc, csc, mr, nr, alpha, beta_pc);
+                    }
+                }
+            }
+        }
+    }
+    NxCache_free(Ap);
+    NxCache_free(Bp);
+}
+
+/// Arguments of the parallel chunks of NxGemm_dgemm().
+typedef struct NxGemmJob {
+    NxGemmKernel kernel;
+    bool by_rows; ///< chunks of rows of C, otherwise chunks of columns.
+    u64 m, n, k;
+    f64 alpha, beta;
+    const f64* A; i64 rsa, csa;
+    const f64* B; i64 rsb, csb;
+    f64* C; i64 rsc, csc;
+} NxGemmJob;
+
+static void NxGemm_job_range(void* ctx, u64 begin, u64 end) {
+    NxGemmJob* J = ctx;
+    if(J->by_rows) {
+        NxGemm_blocked(J->kernel, end - begin, J->n, J->k, J->alpha,
+                       J->A + (i64)begin*J->rsa, J->rsa, J->csa, J->B, J->rsb, J->csb,
+                       J->beta, J->C + (i64)begin*J->rsc, J->rsc, J->csc);
+    } else {
+        NxGemm_blocked(J->kernel, J->m, end - begin, J->k, J->alpha,
+                       J->A, J->rsa, J->csa, J->B + (i64)begin*J->csb, J->rsb, J->csb,
+                       J->beta, J->C + (i64)begin*J->csc, J->rsc, J->csc);
+    }
+}
+
+/**
+ * @brief General matrix multiplication `C = alpha*A*B + beta*C`.
+ *
+ * This is the native GEMM engine of Nexum that every layer ends up calling.
+ * It follows the classical Goto/BLIS design:
+ *  - the columns of B are split into NxGEMM_NC wide blocks (L3),
+ *  - the depth is split into NxGEMM_KC deep blocks and B is packed (L1/L3),
+ *  - the rows of A are split into NxGEMM_MC tall blocks and A is packed (L2),
+ *  - every (MR x NR) tile is computed by a register-tiled micro-kernel that
+ *    is picked at runtime from the CPU features.
+ *
+ * Above NxGEMM_PARALLEL_WORK multiply-adds the rows (or the columns) of
+ * C are split into NxGEMM_MC wide chunks run by NxThreadPool, every
+ * thread packing its own blocks.
+ *
+ * Every operand is described by a pointer and a row/column stride in elements,
+ * so transposed or strided inputs are handled by the packing routines without
+ * any extra copy.
+ *
+ * @param m number of rows of A and C.
+ * @param n number of columns of B and C.
+ * @param k number of columns of A and rows of B.
+ * @param alpha scale of the product.
+ * @param A pointer to A, element (i, p) lives at `A[i*rsa + p*csa]`.
+ * @param B pointer to B, element (p, j) lives at `B[p*rsb + j*csb]`.
+ * @param beta scale of C, when it is 0 C is not read.
+ * @param C pointer to C, element (i, j) lives at `C[i*rsc + j*csc]`.
+ */
+void NxGemm_dgemm(u64 m, u64 n, u64 k, f64 alpha,
+                  const f64* A, i64 rsa, i64 csa,
+                  const f64* B, i64 rsb, i64 csb,
+                  f64 beta, f64* C, i64 rsc, i64 csc) {
+    NxGemmKernel kernel = NxGemm_kernel;
+    if(m == 0 || n == 0) {
+        return ;
+    }
+    if(k == 0 || alpha == 0.0) {
+        NxGemm_scale(m, n, beta, C, rsc, csc);
+        return ;
+    }
+    if(m*n*k < NxGEMM_PARALLEL_WORK || NxThreadPool_get_threads() == 1) {
+        NxGemm_blocked(kernel, m, n, k, alpha, A, rsa, csa, B, rsb, csb, beta, C, rsc, csc);
+        return ;
+    }
+    NxGemmJob J = {kernel, m >= n, m, n, k, alpha, beta, A, rsa, csa, B, rsb, csb, C, rsc, csc};
+    NxThreadPool_parallel_for(J.by_rows ? m : n, NxGEMM_MC, NxGemm_job_range, &J);
+}
+
+/// Signature of the int8 micro-kernels, see NxGemm_q8().
+typedef void (*NxGemmQ8Kernel)(u64 k, const i8* const* x, const i8* w, const i32* sums, i32* acc);
+
+/**
+ * @brief The 4 inputs of the group g of a row of k int8, zero past k.
+ *
+ * Only the last group of a row may be partial, the kernels load the full
+ * ones directly and call this once for the tail.
+ */
+static inline u32 NxGemm_q8_group(const i8* x, u64 g, u64 k) {
+    u32 v = 0;
+    memcpy(&v, x + 4*g, 4*g + 4 <= k ? 4 : k - 4*g);
+    return v;
+}
+
+/**
+ * @brief The 4 inputs of the full group g of a row.
+ */
+static inline u32 NxGemm_q8_full(const i8* x, u64 g) {
+    u32 v;
+    memcpy(&v, x + 4*g, 4);
+    return v;
+}
+
+/**
+ * @brief Portable int8 micro-kernel computing a (MR x NR) tile of int32 sums.
+ *
+ * @param k depth of the rows.
+ * @param x NxGEMM_Q8_MR pointers to rows of int8 inputs.
+ * @param w block of NxGEMM_Q8_NR packed weight rows.
+ * @param sums sums of the weight rows (unused, the products are signed).
+ * @param acc output tile stored row-major with NxGEMM_Q8_NR columns.
+ */
+static void NxGemm_q8_kernel_generic(u64 k, const i8* const* x, const i8* w, const i32* sums, i32* acc) {
+    u64 groups = (k + 3) / 4, g, r, j, q;
+    (void)sums;
+    memset(acc, 0, NxGEMM_Q8_MR*NxGEMM_Q8_NR*sizeof(i32));
+    NxLOOP(g, groups) {
+        NxLOOP(r, NxGEMM_Q8_MR) {
+            u32 v = NxGemm_q8_group(x[r], g, k);
+            i8 xv[4];
+            memcpy(xv, &v, sizeof(xv));
+            NxLOOP(j, NxGEMM_Q8_NR) {
+                i32 s = 0;
+                NxLOOP(q, 4) {
+                    s += (i32)xv[q]*w[j*4 + q];
+                }
+                acc[r*NxGEMM_Q8_NR + j] += s;
+            }
+        }
+        w += NxGEMM_Q8_NR*4;
+    }
+}
+
+#ifdef NxGEMM_X86
+/**
+ * @brief AVX2 int8 micro-kernel.
+ *
+ * `vpmaddubsw` multiplies unsigned by signed bytes, so the inputs go in
+ * as |x| and the weights take the sign of x: the pairs of products stay
+ * below 2*128*127 and never saturate the int16 sums, which `vpmaddwd`
+ * widens to int32.
+ */
+__attribute__((target("avx2")))
+static void NxGemm_q8_kernel_avx2(u64 k, const i8* const* x, const i8* w, const i32* sums, i32* acc) {
+    __m256i ones = _mm256_set1_epi16(1);
+    __m256i c00 = _mm256_setzero_si256(), c01 = _mm256_setzero_si256();
+    __m256i c10 = _mm256_setzero_si256(), c11 = _mm256_setzero_si256();
+    __m256i c20 = _mm256_setzero_si256(), c21 = _mm256_setzero_si256();
+    __m256i c30 = _mm256_setzero_si256(), c31 = _mm256_setzero_si256();
+    u64 g;
+    (void)sums;
+#define NxGEMM_Q8_AVX2_ROW(v, c0, c1) \
+    xb = _mm256_set1_epi32((int)(v)); \
+    ax = _mm256_abs_epi8(xb); \
+    c0 = _mm256_add_epi32(c0, _mm256_madd_epi16(_mm256_maddubs_epi16(ax, _mm256_sign_epi8(w0, xb)), ones)); \
+    c1 = _mm256_add_epi32(c1, _mm256_madd_epi16(_mm256_maddubs_epi16(ax, _mm256_sign_epi8(w1, xb)), ones));
+#define NxGEMM_Q8_AVX2_GROUP(load) { \
+    __m256i w0 = _mm256_loadu_si256((const __m256i*)w); \
+    __m256i w1 = _mm256_loadu_si256((const __m256i*)(w + 32)); \
+    __m256i xb, ax; \
+    NxGEMM_Q8_AVX2_ROW(load(x[0]), c00, c01) \
+    NxGEMM_Q8_AVX2_ROW(load(x[1]), c10, c11) \
+    NxGEMM_Q8_AVX2_ROW(load(x[2]), c20, c21) \
+    NxGEMM_Q8_AVX2_ROW(load(x[3]), c30, c31) \
+    w += NxGEMM_Q8_NR*4; }
+#define NxGEMM_Q8_FULL(p) NxGemm_q8_full(p, g)
+#define NxGEMM_Q8_TAIL(p) NxGemm_q8_group(p, g, k)
+    NxLOOP(g, k / 4) {
+        NxGEMM_Q8_AVX2_GROUP(NxGEMM_Q8_FULL)
+    }
+    if(k % 4) {
+        NxGEMM_Q8_AVX2_GROUP(NxGEMM_Q8_TAIL)
+    }
+#undef NxGEMM_Q8_AVX2_GROUP
+#undef NxGEMM_Q8_AVX2_ROW
+    _mm256_storeu_si256((__m256i*)(acc +  0), c00); _mm256_storeu_si256((__m256i*)(acc +  8), c01);
+    _mm256_storeu_si256((__m256i*)(acc + 16), c10); _mm256_storeu_si256((__m256i*)(acc + 24), c11);
+    _mm256_storeu_si256((__m256i*)(acc + 32), c20); _mm256_storeu_si256((__m256i*)(acc + 40), c21);
+    _mm256_storeu_si256((__m256i*)(acc + 48), c30); _mm256_storeu_si256((__m256i*)(acc + 56), c31);
+}
+
+/**
+ * @brief AVX-VNNI int8 micro-kernel.
+ *
+ * `vpdpbusd` sums 4 unsigned by signed byte products into each int32
+ * lane in one instruction. The inputs are biased to unsigned (x + 128)
+ * and `128*sum(w)` is removed from every column at the end.
+ */
+__attribute__((target("avx2,avxvnni")))
+static void NxGemm_q8_kernel_avxvnni(u64 k, const i8* const* x, const i8* w, const i32* sums, i32* acc) {
+    __m256i c00 = _mm256_setzero_si256(), c01 = _mm256_setzero_si256();
+    __m256i c10 = _mm256_setzero_si256(), c11 = _mm256_setzero_si256();
+    __m256i c20 = _mm256_setzero_si256(), c21 = _mm256_setzero_si256();
+    __m256i c30 = _mm256_setzero_si256(), c31 = _mm256_setzero_si256();
+    __m256i bias = _mm256_set1_epi8((char)0x80);
+    u64 g;
+#define NxGEMM_Q8_VNNI_ROW(v, c0, c1) \
+    xb = _mm256_xor_si256(_mm256_set1_epi32((int)(v)), bias); \
+    c0 = _mm256_dpbusd_avx_epi32(c0, xb, w0); \
+    c1 = _mm256_dpbusd_avx_epi32(c1, xb, w1);
+#define NxGEMM_Q8_VNNI_GROUP(load) { \
+    __m256i w0 = _mm256_loadu_si256((const __m256i*)w); \
+    __m256i w1 = _mm256_loadu_si256((const __m256i*)(w + 32)); \
+    __m256i xb; \
+    NxGEMM_Q8_VNNI_ROW(load(x[0]), c00, c01) \
+    NxGEMM_Q8_VNNI_ROW(load(x[1]), c10, c11) \
+    NxGEMM_Q8_VNNI_ROW(load(x[2]), c20, c21) \
+    NxGEMM_Q8_VNNI_ROW(load(x[3]), c30, c31) \
+    w += NxGEMM_Q8_NR*4; }
+    NxLOOP(g, k / 4) {
+        NxGEMM_Q8_VNNI_GROUP(NxGEMM_Q8_FULL)
+    }
+    if(k % 4) {
+        NxGEMM_Q8_VNNI_GROUP(NxGEMM_Q8_TAIL)
+    }
+#undef NxGEMM_Q8_VNNI_GROUP
+#undef NxGEMM_Q8_VNNI_ROW
+    __m256i s0 = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i*)sums), 7);
+    __m256i s1 = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i*)(sums + 8)), 7);
+    _mm256_storeu_si256((__m256i*)(acc +  0), _mm256_sub_epi32(c00, s0));
+    _mm256_storeu_si256((__m256i*)(acc +  8), _mm256_sub_epi32(c01, s1));
+    _mm256_storeu_si256((__m256i*)(acc + 16), _mm256_sub_epi32(c10, s0));
+    _mm256_storeu_si256((__m256i*)(acc + 24), _mm256_sub_epi32(c11, s1));
+    _mm256_storeu_si256((__m256i*)(acc + 32), _mm256_sub_epi32(c20, s0));
+    _mm256_storeu_si256((__m256i*)(acc + 40), _mm256_sub_epi32(c21, s1));
+    _mm256_storeu_si256((__m256i*)(acc + 48), _mm256_sub_epi32(c30, s0));
+    _mm256_storeu_si256((__m256i*)(acc + 56), _mm256_sub_epi32(c31, s1));
+}
+
+/**
+ * @brief AVX-512 VNNI int8 micro-kernel, one zmm holds the 16 columns of a row.
+ *
+ * Same input bias and correction as NxGemm_q8_kernel_avxvnni().
+ */
+__attribute__((target("avx512f,avx512vnni")))
+static void NxGemm_q8_kernel_avx512vnni(u64 k, const i8* const* x, const i8* w, const i32* sums, i32* acc) {
+    __m512i c0 = _mm512_setzero_si512(), c1 = _mm512_setzero_si512();
+    __m512i c2 = _mm512_setzero_si512(), c3 = _mm512_setzero_si512();
+    __m512i bias = _mm512_set1_epi8((char)0x80);
+    u64 g;
+#define NxGEMM_Q8_VNNI512_GROUP(load) { \
+    __m512i wv = _mm512_loadu_si512((const void*)w); \
+    c0 = _mm512_dpbusd_epi32(c0, _mm512_xor_si512(_mm512_set1_epi32((int)load(x[0])), bias), wv); \
+    c1 = _mm512_dpbusd_epi32(c1, _mm512_xor_si512(_mm512_set1_epi32((int)load(x[1])), bias), wv); \
+    c2 = _mm512_dpbusd_epi32(c2, _mm512_xor_si512(_mm512_set1_epi32((int)load(x[2])), bias), wv); \
+    c3 = _mm512_dpbusd_epi32(c3, _mm512_xor_si512(_mm512_set1_epi32((int)load(x[3])), bias), wv); \
+    w += NxGEMM_Q8_NR*4; }
+    NxLOOP(g, k / 4) {
+        NxGEMM_Q8_VNNI512_GROUP(NxGEMM_Q8_FULL)
+    }
+    if(k % 4) {
+        NxGEMM_Q8_VNNI512_GROUP(NxGEMM_Q8_TAIL)
+    }
+#undef NxGEMM_Q8_VNNI512_GROUP
+#undef NxGEMM_Q8_FULL
+#undef NxGEMM_Q8_TAIL
+    __m512i s = _mm512_slli_epi32(_mm512_loadu_si512((const void*)sums), 7);
+    _mm512_storeu_si512((void*)(acc +  0), _mm512_sub_epi32(c0, s));
+    _mm512_storeu_si512((void*)(acc + 16), _mm512_sub_epi32(c1, s));
+    _mm512_storeu_si512((void*)(acc + 32), _mm512_sub_epi32(c2, s));
+    _mm512_storeu_si512((void*)(acc + 48), _mm512_sub_epi32(c3, s));
+}
+#endif /* NxGEMM_X86 */
+
+static NxGemmQ8Kernel NxGemm_q8_kernel = NxGemm_q8_kernel_generic;
+static const char* NxGemm_q8_name = "generic";
+
+/**
+ * @brief Force the instruction set of the int8 kernels.
+ *
+ * The requested set is only used when the running CPU supports it.
+ *
+ * @param isa one of `"generic"`, `"avx2"`, `"avxvnni"`, `"avx512vnni"`, or
+ *            `NULL` to pick the fastest supported set.
+ *
+ * @return true if the requested set is the active one.
+ */
+bool NxGemm_q8_select(str isa) {
+    bool any = isa == NULL || isa[0] == '\0';
+    NxGemm_q8_kernel = NxGemm_q8_kernel_generic;
+    NxGemm_q8_name = "generic";
+    if(!any && strcmp(isa, "generic") == 0) {
+        return true;
+    }
+#ifdef NxGEMM_X86
+    __builtin_cpu_init();
+    if((any || strcmp(isa, "avx512vnni") == 0) &&
+       __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vnni")) {
+        NxGemm_q8_kernel = NxGemm_q8_kernel_avx512vnni;
+        NxGemm_q8_name = "avx512vnni";
+        return true;
+    }
+    if((any || strcmp(isa, "avxvnni") == 0) &&
+       __builtin_cpu_supports("avx2") && __builtin_cpu_supports("avxvnni")) {
+        NxGemm_q8_kernel = NxGemm_q8_kernel_avxvnni;
+        NxGemm_q8_name = "avxvnni";
+        return true;
+    }
+    if((any || strcmp(isa, "avx2") == 0) && __builtin_cpu_supports("avx2")) {
+        NxGemm_q8_kernel = NxGemm_q8_kernel_avx2;
+        NxGemm_q8_name = "avx2";
+        return true;
+    }
+#endif
+    return any;
+}
+
+/**
+ * @brief Name of the instruction set of the active int8 kernel.
+ */
+const char* NxGemm_q8_isa(void) {
+    return NxGemm_q8_name;
+}
+
+__attribute__((constructor))
+static void NxGemm_q8_init(void) {
+    NxGemm_q8_select(NULL);
+}
+
+/**
+ * @brief Bytes of the packed form of n rows of k int8 weights.
+ */
+u64 NxGemm_q8_packed_size(u64 n, u64 k) {
+    u64 np = (n + NxGEMM_Q8_NR - 1) / NxGEMM_Q8_NR * NxGEMM_Q8_NR;
+    u64 kp = (k + 3) / 4 * 4;
+    return np*kp + np*sizeof(i32);
+}
+
+/**
+ * @brief Pack n rows of k int8 weights for NxGemm_q8().
+ *
+ * The rows go by blocks of NxGEMM_Q8_NR; inside a block the weights are
+ * interleaved by groups of 4 along k, so one 64-byte load feeds the 16
+ * int32 lanes of `vpdpbusd`. Rows and depth are padded with zeros, the
+ * sums of the rows used by the VNNI kernels follow the blocks. The
+ * weights must be in [-127, 127].
+ *
+ * @param Wp output buffer of NxGemm_q8_packed_size() bytes.
+ * @param W pointer to the weights, row j starts at `W + j*rsw`.
+ * @param rsw row stride of W.
+ * @param n number of rows (output channels).
+ * @param k number of columns (input features).
+ */
+void NxGemm_q8_pack(i8* Wp, const i8* W, i64 rsw, u64 n, u64 k) {
+    u64 np = (n + NxGEMM_Q8_NR - 1) / NxGEMM_Q8_NR * NxGEMM_Q8_NR;
+    u64 kp = (k + 3) / 4 * 4;
+    i32* sums = (i32*)(Wp + np*kp);
+    u64 j, p;
+    memset(Wp, 0, np*kp);
+    NxLOOP(j, np) {
+        i8* block = Wp + (j / NxGEMM_Q8_NR)*NxGEMM_Q8_NR*kp + (j % NxGEMM_Q8_NR)*4;
+        sums[j] = 0;
+        if(j >= n) {
+            continue;
+        }
+        NxLOOP(p, k) {
+            i8 v = W[(i64)j*rsw + (i64)p];
+            NxASSERT(v != -128);
+            block[(p / 4)*NxGEMM_Q8_NR*4 + p % 4] = v;
+            sums[j] += v;
+        }
+    }
+}
+
+/**
+ * @brief Apply an activation to the nr outputs of a row of a tile.
+ *
+ * One loop per activation, written without branches: the signs of the
+ * outputs are random and a mispredicted compare per element costs more
+ * than the GEMM of small layers.
+ */
+static inline void NxGemm_q8_activate(f32* v, u64 nr, NxActivation act, f32 alpha) {
+    u64 c;
+    switch(act) {
+    case NxActivation_ReLU:
+        NxLOOP(c, nr) {
+            v[c] = fmaxf(v[c], 0.0f);
+        }
+        break;
+    case NxActivation_Sigmoid:
+        NxLOOP(c, nr) {
+            v[c] = 1.0f/(1.0f + expf(-v[c]));
+        }
+        break;
+    case NxActivation_Tanh:
+        NxLOOP(c, nr) {
+            v[c] = tanhf(v[c]);
+        }
+        break;
+    case NxActivation_ELU:
+        NxLOOP(c, nr) {
+            v[c] = fmaxf(v[c], 0.0f) + alpha*(expf(fminf(v[c], 0.0f)) - 1.0f);
+        }
+        break;
+    case NxActivation_PReLU:
+        NxLOOP(c, nr) {
+            v[c] = fmaxf(v[c], 0.0f) + alpha*fminf(v[c], 0.0f);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Scale, bias, activate and store a computed tile.
+ */
+static void NxGemm_q8_store(const i32* acc, u64 i, u64 j, u64 mr, u64 nr, const NxGemmQ8Epilogue* E) {
+    static const f32 zeros[NxGEMM_Q8_NR] = {0.0f};
+    const f32* scales = E->scales + j;
+    const f32* bias = E->bias != NULL ? E->bias + j : zeros;
+    f32 inv = E->out_scale > 0.0f ? 1.0f/E->out_scale : 0.0f;
+    f32 v[NxGEMM_Q8_NR];
+    u64 r, c;
+    NxLOOP(r, mr) {
+        const i32* a = acc + r*NxGEMM_Q8_NR;
+        i64 row = (i64)(i + r)*E->rsc + (i64)j;
+        NxLOOP(c, nr) {
+            v[c] = (f32)a[c]*scales[c] + bias[c];
+        }
+        NxGemm_q8_activate(v, nr, E->act, E->alpha);
+        if(E->output == NxGEMM_Q8_F64) {
+            f64* out = (f64*)E->C + row;
+            NxLOOP(c, nr) {
+                out[c] = v[c];
+            }
+        } else if(E->output == NxGEMM_Q8_S8) {
+            i8* out = (i8*)E->C + row;
+            NxLOOP(c, nr) {
+                out[c] = (i8)fminf(fmaxf(nearbyintf(v[c]*inv), -127.0f), 127.0f);
+            }
+        } else {
+            f32* out = (f32*)E->C + row;
+            NxLOOP(c, nr) {
+                out[c] = v[c];
+            }
+        }
+    }
+}
+
+/// Arguments of the parallel chunks of NxGemm_q8().
+typedef struct NxGemmQ8Job {
+    NxGemmQ8Kernel kernel;
+    u64 m, n, k;
+    const i8* X; i64 rsx;
+    const i8* Wp;
+    const NxGemmQ8Epilogue* E;
+} NxGemmQ8Job;
+
+/**
+ * @brief Compute the blocks of NxGEMM_Q8_NR columns [begin, end) for all the rows.
+ */
+static void NxGemm_q8_range(void* ctx, u64 begin, u64 end) {
+    NxGemmQ8Job* J = ctx;
+    u64 np = (J->n + NxGEMM_Q8_NR - 1) / NxGEMM_Q8_NR * NxGEMM_Q8_NR;
+    u64 kp = (J->k + 3) / 4 * 4;
+    const i32* sums = (const i32*)(J->Wp + np*kp);
+    i32 acc[NxGEMM_Q8_MR*NxGEMM_Q8_NR];
+    u64 b, i, r;
+    for(b=begin; b<end; b++) {
+        u64 j = b*NxGEMM_Q8_NR;
+        u64 nr = NxGemm_min(NxGEMM_Q8_NR, J->n - j);
+        for(i=0; i<J->m; i+=NxGEMM_Q8_MR) {
+            u64 mr = NxGemm_min(NxGEMM_Q8_MR, J->m - i);
+            const i8* x[NxGEMM_Q8_MR];
+            /* The missing rows of the last tile repeat the last row, their sums are dropped. */
+            NxLOOP(r, NxGEMM_Q8_MR) {
+                x[r] = J->X + (i64)(i + (r < mr ? r : mr - 1))*J->rsx;
+            }
+            J->kernel(J->k, x, J->Wp + j*kp, sums + j, acc);
+            NxGemm_q8_store(acc, i, j, mr, nr, J->E);
+        }
+    }
+}
+
+/**
+ * @brief Quantized matrix multiplication `C = act(scales*(X*W^T) + bias)`.
+ *
+ * X holds m rows of k int8 inputs and Wp the n rows of k int8 weights
+ * packed by NxGemm_q8_pack(), the int8 x int8 products are summed exactly
+ * in int32 by a micro-kernel picked from the CPU features (AVX-512 VNNI,
+ * AVX-VNNI, AVX2 or portable, see NxGemm_q8_select()). The epilogue runs
+ * on every tile as soon as it is computed: the int32 sums are scaled per
+ * column, biased, activated and stored as f32, f64 or requantized to int8
+ * for the next quantized layer, so the int32 matrix is never written.
+ *
+ * Above NxGEMM_PARALLEL_WORK multiply-adds the blocks of columns are
+ * split over the NxThreadPool, the packed weights are read once per
+ * block whatever the number of rows.
+ *
+ * @param m number of rows of X and C.
+ * @param n number of output columns.
+ * @param k depth, number of columns of X.
+ * @param X pointer to the inputs, row i starts at `X + i*rsx`, values in [-128, 127].
+ * @param rsx row stride of X.
+ * @param Wp packed weights.
+ * @param E epilogue and output.
+ */
+void NxGemm_q8(u64 m, u64 n, u64 k, const i8* X, i64 rsx, const i8* Wp, const NxGemmQ8Epilogue* E) {
+    if(m == 0 || n == 0) {
+        return ;
+    }
+    NxGemmQ8Job J = {NxGemm_q8_kernel, m, n, k, X, rsx, Wp, E};
+    u64 blocks = (n + NxGEMM_Q8_NR - 1) / NxGEMM_Q8_NR;
+    if(m*n*k < NxGEMM_PARALLEL_WORK || NxThreadPool_get_threads() == 1) {
+        NxGemm_q8_range(&J, 0, blocks);
+        return ;
+    }
+    NxThreadPool_parallel_for(blocks, 1, NxGemm_q8_range, &J);
+}
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxGemm.c
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,1465 @@
+#include "NxGraph.h"
+#include "NxBackend.h"
+#include "NxKernels.h"
+#include "NxLayers.h"
+#include "NxMath.h"
+
+#include <math.h>
+#include <string.h>
+
+/// Write `expr` (of the element k) to the n elements of g when it is fresh, accumulate it otherwise.
+#define NxGRAPH_ACCUMULATE(g, fresh, n, k, expr) do { \
+        if(fresh) {                                   \
+            NxLOOP(k, n) {                            \
+                (g)[k] = (expr);                      \
+            }                                         \
+        } else {                                      \
+            NxLOOP(k, n) {                            \
+                (g)[k] += (expr);                     \
+            }                                         \
+        }                                             \
+    } while(0)
+
+/// Names of the operations for the error messages.
+static const char* NxGraph_names[] = {
+    "input", "parameter", "constant", "add", "sub", "mul", "matmul", "matmul_nt", "add_bias", "scale",
+    "relu", "prelu", "elu", "sigmoid", "tanh", "exp", "log", "square", "sum", "mean", "mse",
+    "linear", "fused",
+};
+
+static NxGraphNode* NxGraph_node(NxComputationalGraph* G, u64 id) {
+    if(id == 0 || id > G->count) {
+        fprintf(stderr, "Cannot find the node %" PRIu64 " in a graph of %" PRIu64 " nodes.\n", id, G->count);
+        exit(EXIT_FAILURE);
+    }
+    return &G->nodes[id - 1];
+}
+
+static inline u64 NxGraph_bytes(const NxTensor* A) {
+    return A->m*A->n*sizeof (f64);
+}
+
+/// Whether the value of a node is the tensor given by the caller, which the graph does not own.
+static inline bool NxGraph_shared(const NxGraphNode* node) {
+    return node->source != NULL;
+}
+
+/// Account for `bytes` more (or less) memory owned by the graph.
+static void NxGraph_track(NxComputationalGraph* G, const NxTensor* A, bool allocated) {
+    if(allocated) {
+        G->bytes += NxGraph_bytes(A);
+        G->peak_bytes = G->bytes > G->peak_bytes ? G->bytes : G->peak_bytes;
+    } else {
+        G->bytes -= NxGraph_bytes(A);
+    }
+}
+
+static void NxGraph_release(NxComputationalGraph* G, NxTensor* A, bool tracked) {
+    if(A->allocated) {
+        if(tracked) {
+            NxGraph_track(G, A, false);
+        }
+        NxTensor_free(A);
+    }
+}
+
+/**
+ * @brief Initialize an empty graph.
+ */
+void NxGraph_alloc(NxComputationalGraph* G) {
+    G->nodes = NULL;
+    G->count = 0;
+    G->capacity = 0;
+    G->bytes = 0;
+    G->peak_bytes = 0;
+    G->deferred = false;
+}
+
+/**
+ * @brief Drop every recorded node, the tape keeps its capacity.
+ *
+ * A training loop records the forward pass of every step in the same
+ * graph, resetting it at the start of the step. The tensors given as
+ * leaves are not touched.
+ */
+void NxGraph_reset(NxComputationalGraph* G) {
+    u64 i;
+    NxLOOP(i, G->count) {
+        NxGraphNode* node = &G->nodes[i];
+        NxGraph_release(G, &node->value, !NxGraph_shared(node));
+        NxGraph_release(G, &node->grad, true);
+        free(node->expr);
+    }
+    G->count = 0;
+    G->bytes = 0;
+    G->peak_bytes = 0;
+}
+
+/**
+ * @brief Free the nodes and the tape of a graph.
+ */
+void NxGraph_free(NxComputationalGraph* G) {
+    NxGraph_reset(G);
+    free(G->nodes);
+    NxGraph_alloc(G);
+}
+
+/**
+ * @brief Append a node to the tape and return its id.
+ */
+static u64 NxGraph_push(NxComputationalGraph* G, NxGraphOp op, u32 n_inputs, u64 a, u64 b, f64 scalar) {
+    u32 i;
+    if(G->count == G->capacity) {
+        u64 capacity = G->capacity ? 2*G->capacity : NxGRAPH_INITIAL_CAPACITY;
+        NxGraphNode* nodes = realloc(G->nodes, capacity*sizeof (NxGraphNode));
+        NxASSERT(nodes != NULL);
+        G->nodes = nodes;
+        G->capacity = capacity;
+    }
+    NxGraphNode* node = &G->nodes[G->count];
+    memset(node, 0, sizeof (NxGraphNode));
+    node->op = op;
+    node->n_inputs = n_inputs;
+    node->inputs[0] = a;
+    node->inputs[1] = b;
+    node->scalar = scalar;
+    node->requires_grad = op == NxGRAPH_PARAMETER;
+    NxLOOP(i, n_inputs) {
+        node->requires_grad |= G->nodes[node->inputs[i] - 1].requires_grad;
+    }
+    return ++G->count;
+}
+
+/**
+ * @brief Bind the value of an input or parameter leaf to the buffer of X.
+ *
+ * The value borrows the data of X through a storage of its own, so the
+ * count of the storage of X does not change and an optimizer updating X
+ * in place writes to it without a copy. A value already borrowing the
+ * data of X is kept, a strided X is copied.
+ */
+static void NxGraph_borrow(NxTensor* V, NxTensor* X) {
+    if(!NxTensor_is_contiguous(X)) {
+        NxTensor_copy_data(V, X);
+        return ;
+    }
+    if(V->allocated && V->raw == X->raw && V->storage->policy == NxALLOC_BORROWED && V->m == X->m && V->n == X->n) {
+        return ;
+    }
+    NxStorage* S = NxStorage_wrap(X->raw, NxTensor_size(X)*NxDType_size(X->dtype));
+    NxTensor_from_storage(V, S, 0, X->dtype, X->ndim, X->shape);
+    NxStorage_release(S);
+}
+
+static u64 NxGraph_leaf(NxComputationalGraph* G, NxTensor* X, NxGraphOp op) {
+    NxASSERT(X->allocated);
+    if(X->dtype != NxFLOAT64) {
+        fprintf(stderr, "NxGraph only supports f64 tensors, got %s.\n", NxDType_name(X->dtype));
+        exit(EXIT_FAILURE);
+    }
+    u64 id = NxGraph_push(G, op, 0, 0, 0, 0.0);
+    NxGraphNode* node = NxGraph_node(G, id);
+    if(op == NxGRAPH_CONSTANT) {
+        NxTensor_copy_data(&node->value, X);
+    } else {
+        NxGraph_borrow(&node->value, X);
+    }
+    node->value.id = id;
+    node->m = node->value.m;
+    node->n = node->value.n;
+    node->source = X;
+    X->id = id;
+    return id;
+}
+
+/**
+ * @brief Add a leaf without gradient (the data, the targets) to the graph.
+ *
+ * The graph reads the buffer of X without taking a reference to it (a
+ * strided X is copied), X gets the id of the leaf in NxTensor::id.
+ * NxGraph_run() reads X again, so X must outlive the graph and keep its
+ * contents until NxGraph_backward() is done with them.
+ *
+ * @return the id of the leaf.
+ */
+u64 NxGraph_input(NxComputationalGraph* G, NxTensor* X) {
+    return NxGraph_leaf(G, X, NxGRAPH_INPUT);
+}
+
+/**
+ * @brief Add a leaf whose gradient is computed to the graph (weights, biases).
+ *
+ * Same as NxGraph_input(), the gradient is read after the backward pass
+ * with `NxGraph_grad(G, W->id)`.
+ *
+ * @return the id of the leaf.
+ */
+u64 NxGraph_parameter(NxComputationalGraph* G, NxTensor* W) {
+    return NxGraph_leaf(G, W, NxGRAPH_PARAMETER);
+}
+
+/**
+ * @brief Add a leaf whose value is fixed when it is recorded (masks, fixed scales).
+ *
+ * Unlike NxGraph_input(), the graph shares the storage of X (a write to
+ * X then copies it) and NxGraph_run() does not read X again, and
+ * NxGraph_optimize() computes the operations depending only on constants
+ * once.
+ *
+ * @return the id of the leaf.
+ */
+u64 NxGraph_constant(NxComputationalGraph* G, NxTensor* X) {
+    return NxGraph_leaf(G, X, NxGRAPH_CONSTANT);
+}
+
+static void NxGraph_shape_error(NxGraphNode* node, NxGraphNode* A, NxGraphNode* B) {
+    fprintf(stderr, "Cannot record %s of (%" PRIu64 ", %" PRIu64 ") and (%" PRIu64 ", %" PRIu64 ").\n",
+            NxGraph_names[node->op], A->m, A->n, B->m, B->n);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Check the shapes of the inputs of a node and set the shape of its value.
+ */
+static void NxGraph_infer(NxComputationalGraph* G, NxGraphNode* node) {
+    NxGraphNode* A = &G->nodes[node->inputs[0] - 1];
+    NxGraphNode* B = node->n_inputs > 1 ? &G->nodes[node->inputs[1] - 1] : A;
+    bool valid = true;
+
+    node->m = A->m;
+    node->n = A->n;
+    switch(node->op) {
+    case NxGRAPH_ADD:
+    case NxGRAPH_SUB:
+    case NxGRAPH_MUL:
+        valid = A->m == B->m && A->n == B->n;
+        break;
+    case NxGRAPH_MATMUL:
+        valid = A->n == B->m;
+        node->n = B->n;
+        break;
+    case NxGRAPH_MATMUL_NT:
+        valid = A->n == B->n;
+        node->n = B->m;
+        break;
+    case NxGRAPH_ADD_BIAS:
+        valid = A->n == B->m*B->n;
+        break;
+    case NxGRAPH_MSE:
+        valid = A->m == B->m && A->n == B->n;
+        node->m = node->n = 1;
+        break;
+    case NxGRAPH_SUM:
+    case NxGRAPH_MEAN:
+        node->m = node->n = 1;
+        break;
+    default:
+        break;
+    }
+    if(!valid) {
+        NxGraph_shape_error(node, A, B);
+    }
+}
+
+/**
+ * @brief Value of the input k of a node.
+ *
+ * When the node took over the buffer of that input (NxGraphNode::inplace)
+ * it is the value of the node itself.
+ */
+static NxTensor* NxGraph_input_value(NxComputationalGraph* G, NxGraphNode* node, u32 k) {
+    if(node->inplace != 0 && node->inputs[k] == node->inputs[node->inplace - 1]) {
+        return &node->value;
+    }
+    return &G->nodes[node->inputs[k] - 1].value;
+}
+
+/// Activation computed by an operation, NxActivation_None for the others.
+static NxActivation NxGraph_activation_of(NxGraphOp op) {
+    switch(op) {
+    case NxGRAPH_RELU:
+        return NxActivation_ReLU;
+    case NxGRAPH_PRELU:
+        return NxActivation_PReLU;
+    case NxGRAPH_ELU:
+        return NxActivation_ELU;
+    case NxGRAPH_SIGMOID:
+        return NxActivation_Sigmoid;
+    case NxGRAPH_TANH:
+        return NxActivation_Tanh;
+    default:
+        return NxActivation_None;
+    }
+}
+
+/**
+ * @brief Compute `c = act(a)` over n elements, c may be a.
+ *
+ * @param s the slope of PReLU or the alpha of ELU.
+ */
+static void NxGraph_activate(u64 n, const f64* a, f64* c, NxActivation act, f64 s) {
+    u64 i;
+    switch(act) {
+    case NxActivation_ReLU:
+        NxLOOP(i, n) {
+            c[i] = a[i] > 0.0 ? a[i] : 0.0;
+        }
+        break;
+    case NxActivation_PReLU:
+        NxLOOP(i, n) {
+            c[i] = a[i] > 0.0 ? a[i] : s*a[i];
+        }
+        break;
+    case NxActivation_ELU:
+        NxLOOP(i, n) {
+            c[i] = a[i] > 0.0 ? a[i] : s*expm1(a[i]);
+        }
+        break;
+    case NxActivation_Sigmoid:
+        NxMath_sigmoid(n, a, c);
+        break;
+    case NxActivation_Tanh:
+        NxMath_tanh(n, a, c);
+        break;
+    default:
+        if(c != a) {
+            memcpy(c, a, n*sizeof (f64));
+        }
+        break;
+    }
+}
+
+/**
+ * @brief Write (fresh) or add `g * act'` to d, the derivative is taken from the activated values c.
+ */
+static void NxGraph_activate_grad(u64 n, const f64* g, const f64* c, f64* d, bool fresh, NxActivation act, f64 s) {
+    u64 i;
+    switch(act) {
+    case NxActivation_ReLU:
+        NxGRAPH_ACCUMULATE(d, fresh, n, i, c[i] > 0.0 ? g[i] : 0.0);
+        break;
+    case NxActivation_PReLU:
+        NxGRAPH_ACCUMULATE(d, fresh, n, i, c[i] > 0.0 ? g[i] : s*g[i]);
+        break;
+    case NxActivation_ELU:
+        NxGRAPH_ACCUMULATE(d, fresh, n, i, c[i] > 0.0 ? g[i] : g[i]*(c[i] + s));
+        break;
+    case NxActivation_Sigmoid:
+        NxGRAPH_ACCUMULATE(d, fresh, n, i, g[i]*c[i]*(1.0 - c[i]));
+        break;
+    case NxActivation_Tanh:
+        NxGRAPH_ACCUMULATE(d, fresh, n, i, g[i]*(1.0 - c[i]*c[i]));
+        break;
+    default:
+        NxGRAPH_ACCUMULATE(d, fresh, n, i, g[i]);
+        break;
+    }
+}
+
+/**
+ * @brief Point the tensor leaves of a fused node at the values of its inputs.
+ */
+static void NxGraph_bind(NxComputationalGraph* G, NxGraphNode* node) {
+    u32 k, slot = 0;
+    NxLOOP(k, node->expr->count) {
+        if(node->expr->nodes[k].op == NxEXPR_TENSOR) {
+            node->expr->nodes[k].tensor = NxGraph_input_value(G, node, slot++);
+        }
+    }
+}
+
+/**
+ * @brief Compute a fused Dense layer.
+ *
+ * The rows are prefilled with the bias and the GEMM adds the product to
+ * them (beta = 1), the activation then runs in place, so the output is
+ * written twice instead of three times with a separate bias pass.
+ */
+static void NxGraph_eval_linear(NxComputationalGraph* G, NxGraphNode* node) {
+    NxTensor* X = &G->nodes[node->inputs[0] - 1].value;
+    NxTensor* W = &G->nodes[node->inputs[1] - 1].value;
+    const f64* b = node->n_inputs > 2 ? G->nodes[node->inputs[2] - 1].value.data : NULL;
+    u64 m = node->m, n = node->n, k = X->n, i;
+    NxTensor* C = &node->value;
+
+    NxTensor_alloc(C, m, n);
+    if(b != NULL) {
+        NxLOOP(i, m) {
+            memcpy(C->data + i*n, b, n*sizeof (f64));
+        }
+    }
+    NxBackend_get()->dgemm(m, n, k, 1.0, X->data, (i64)k, 1, W->data,
+                           node->transposed ? 1 : (i64)n, node->transposed ? (i64)k : 1,
+                           b != NULL ? 1.0 : 0.0, C->data, (i64)n, 1);
+    NxGraph_activate(m*n, C->data, C->data, node->act, node->scalar);
+}
+
+/**
+ * @brief Compute the value of a node from the values of its inputs.
+ */
+static void NxGraph_eval(NxComputationalGraph* G, NxGraphNode* node) {
+    const NxKernels* K = NxKernels_get();
+    NxTensor* C = &node->value;
+    u64 i;
+    f64 s = node->scalar;
+
+    if(node->op == NxGRAPH_LINEAR) {
+        NxGraph_eval_linear(G, node);
+        return ;
+    }
+    if(node->op == NxGRAPH_FUSED) {
+        NxGraph_bind(G, node);
+        NxExpr_assign(node->expr, C, node->expr->count - 1);
+        return ;
+    }
+
+    NxTensor* A = NxGraph_input_value(G, node, 0);
+    NxTensor* B = node->n_inputs > 1 ? NxGraph_input_value(G, node, 1) : NULL;
+    u64 size = A->m*A->n;
+    switch(node->op) {
+    case NxGRAPH_MATMUL:
+        NxTensor_alloc(C, A->m, B->n);
+        NxBackend_get()->dgemm(A->m, B->n, A->n, 1.0, A->data, (i64)A->n, 1, B->data, (i64)B->n, 1,
+                               0.0, C->data, (i64)B->n, 1);
+        return ;
+    case NxGRAPH_MATMUL_NT:
+        NxTensor_alloc(C, A->m, B->m);
+        NxBackend_get()->dgemm(A->m, B->m, A->n, 1.0, A->data, (i64)A->n, 1, B->data, 1, (i64)B->n,
+                               0.0, C->data, (i64)B->m, 1);
+        return ;
+    default:
+        /* in place, A or B is C and keeps its buffer */
+        NxTensor_alloc(C, node->m, node->n);
+        break;
+    }
+
+    f64* a = A->data;
+    f64* c = C->data;
+    switch(node->op) {
+    case NxGRAPH_ADD:
+        K->add(size, a, B->data, c);
+        break;
+    case NxGRAPH_SUB:
+        K->sub(size, a, B->data, c);
+        break;
+    case NxGRAPH_MUL:
+        K->mul(size, a, B->data, c);
+        break;
+    case NxGRAPH_ADD_BIAS:
+        NxLOOP(i, A->m) {
+            K->add(A->n, a + i*A->n, B->data, c + i*A->n);
+        }
+        break;
+    case NxGRAPH_SCALE:
+        K->mul_scalar(size, a, s, c);
+        break;
+    case NxGRAPH_RELU:
+    case NxGRAPH_PRELU:
+    case NxGRAPH_ELU:
+    case NxGRAPH_SIGMOID:
+    case NxGRAPH_TANH:
+        NxGraph_activate(size, a, c, NxGraph_activation_of(node->op), s);
+        break;
+    case NxGRAPH_EXP:
+        NxMath_exp(size, a, c);
+        break;
+    case NxGRAPH_LOG:
+        NxMath_log(size, a, c);
+        break;
+    case NxGRAPH_SQUARE:
+        K->mul(size, a, a, c);
+        break;
+    case NxGRAPH_SUM:
+        c[0] = K->sum(size, a);
+        break;
+    case NxGRAPH_MEAN:
+        c[0] = size ? K->sum(size, a) / (f64)size : 0.0;
+        break;
+    case NxGRAPH_MSE:
+        c[0] = 0.0;
+        NxLOOP(i, size) {
+            f64 d = a[i] - B->data[i];
+            c[0] += d*d;
+        }
+        c[0] = size ? c[0] / (f64)size : 0.0;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Compute the value of a recorded node and account for it.
+ */
+static void NxGraph_compute(NxComputationalGraph* G, NxGraphNode* node) {
+    bool allocated = node->value.allocated;
+    NxGraph_eval(G, node);
+    node->value.id = (u64)(node - G->nodes) + 1;
+    if(!allocated) {
+        NxGraph_track(G, &node->value, true);
+    }
+}
+
+/**
+ * @brief Record an operation: check its inputs, compute its value (unless deferred) and append it to the tape.
+ */
+static u64 NxGraph_record(NxComputationalGraph* G, NxGraphOp op, u32 n_inputs, u64 a, u64 b, f64 scalar) {
+    NxGraph_node(G, a);
+    if(n_inputs > 1) {
+        NxGraph_node(G, b);
+    }
+    u64 id = NxGraph_push(G, op, n_inputs, a, b, scalar);
+    NxGraphNode* node = NxGraph_node(G, id);
+    NxGraph_infer(G, node);
+    if(!G->deferred) {
+        NxGraph_compute(G, node);
+    }
+    return id;
+}
+
+/// Record `a + b`, both of the same shape.
+u64 NxGraph_add(NxComputationalGraph* G, u64 a, u64 b) {
+    return NxGraph_record(G, NxGRAPH_ADD, 2, a, b, 0.0);
+}
+
+/// Record `a - b`, both of the same shape.
+u64 NxGraph_sub(NxComputationalGraph* G, u64 a, u64 b) {
+    return NxGraph_record(G, NxGRAPH_SUB, 2, a, b, 0.0);
+}
+
+/// Record the elementwise product `a * b`, both of the same shape.
+u64 NxGraph_mul(NxComputationalGraph* G, u64 a, u64 b) {
+    return NxGraph_record(G, NxGRAPH_MUL, 2, a, b, 0.0);
+}
+
+/// Record the matrix product `a @ b`.
+u64 NxGraph_matmul(NxComputationalGraph* G, u64 a, u64 b) {
+    return NxGraph_record(G, NxGRAPH_MATMUL, 2, a, b, 0.0);
+}
+
+/// Record the matrix product `a @ b^T`, for weights of shape (out_features, in_features).
+u64 NxGraph_matmul_nt(NxComputationalGraph* G, u64 a, u64 b) {
+    return NxGraph_record(G, NxGRAPH_MATMUL_NT, 2, a, b, 0.0);
+}
+
+/// Record `a + b` where b holds one element per column of a (a (1, n) or (n, 1) bias).
+u64 NxGraph_add_bias(NxComputationalGraph* G, u64 a, u64 b) {
+    return NxGraph_record(G, NxGRAPH_ADD_BIAS, 2, a, b, 0.0);
+}
+
+/// Record `s * a`.
+u64 NxGraph_scale(NxComputationalGraph* G, u64 a, f64 s) {
+    return NxGraph_record(G, NxGRAPH_SCALE, 1, a, 0, s);
+}
+
+/// Record `max(a, 0)`.
+u64 NxGraph_relu(NxComputationalGraph* G, u64 a) {
+    return NxGraph_record(G, NxGRAPH_RELU, 1, a, 0, 0.0);
+}
+
+/// Record the leaky ReLU of a, `slope*a` for the negative elements (slope > 0).
+u64 NxGraph_prelu(NxComputationalGraph* G, u64 a, f64 slope) {
+    return NxGraph_record(G, NxGRAPH_PRELU, 1, a, 0, slope);
+}
+
+/// Record the ELU of a, `alpha*(exp(a) - 1)` for the negative elements.
+u64 NxGraph_elu(NxComputationalGraph* G, u64 a, f64 alpha) {
+    return NxGraph_record(G, NxGRAPH_ELU, 1, a, 0, alpha);
+}
+
+/// Record `1 / (1 + exp(-a))`.
+u64 NxGraph_sigmoid(NxComputationalGraph* G, u64 a) {
+    return NxGraph_record(G, NxGRAPH_SIGMOID, 1, a, 0, 0.0);
+}
+
+/// Record `tanh(a)`.
+u64 NxGraph_tanh(NxComputationalGraph* G, u64 a) {
+    return NxGraph_record(G, NxGRAPH_TANH, 1, a, 0, 0.0);
+}
+
+/// Record `exp(a)`.
+u64 NxGraph_exp(NxComputationalGraph* G, u64 a) {
+    return NxGraph_record(G, NxGRAPH_EXP, 1, a, 0, 0.0);
+}
+
+/// Record `log(a)`.
+u64 NxGraph_log(NxComputationalGraph* G, u64 a) {
+    return NxGraph_record(G, NxGRAPH_LOG, 1, a, 0, 0.0);
+}
+
+/// Record `a * a`.
+u64 NxGraph_square(NxComputationalGraph* G, u64 a) {
+    return NxGraph_record(G, NxGRAPH_SQUARE, 1, a, 0, 0.0);
+}
+
+/// Record the sum of the elements of a, a (1, 1) tensor.
+u64 NxGraph_sum(NxComputationalGraph* G, u64 a) {
+    return NxGraph_record(G, NxGRAPH_SUM, 1, a, 0, 0.0);
+}
+
+/// Record the mean of the elements of a, a (1, 1) tensor.
+u64 NxGraph_mean(NxComputationalGraph* G, u64 a) {
+    return NxGraph_record(G, NxGRAPH_MEAN, 1, a, 0, 0.0);
+}
+
+/// Record the mean squared error between pred and target, a (1, 1) tensor.
+u64 NxGraph_mse(NxComputationalGraph* G, u64 pred, u64 target) {
+    return NxGraph_record(G, NxGRAPH_MSE, 2, pred, target, 0.0);
+}
+
+/**
+ * @brief Record the activation of a layer, NxActivation_None records nothing.
+ *
+ * PReLU and ELU use the constants of the layers (NxPRELU_SLOPE, NxELU_ALPHA).
+ */
+u64 NxGraph_activation(NxComputationalGraph* G, u64 a, NxActivation act) {
+    switch(act) {
+    case NxActivation_ReLU:
+        return NxGraph_relu(G, a);
+    case NxActivation_Sigmoid:
+        return NxGraph_sigmoid(G, a);
+    case NxActivation_Tanh:
+        return NxGraph_tanh(G, a);
+    case NxActivation_ELU:
+        return NxGraph_elu(G, a, NxELU_ALPHA);
+    case NxActivation_PReLU:
+        return NxGraph_prelu(G, a, NxPRELU_SLOPE);
+    default:
+        return a;
+    }
+}
+
+/**
+ * @brief Record the forward pass of a Dense layer, `act(x @ W^T + b)`.
+ *
+ * @param G the graph.
+ * @param x the inputs, (batch, in_features).
+ * @param W the weights, (out_features, in_features) like in NxDense.
+ * @param b the bias, out_features elements, 0 for none.
+ * @param act the activation.
+ */
+u64 NxGraph_dense(NxComputationalGraph* G, u64 x, u64 W, u64 b, NxActivation act) {
+    u64 y = NxGraph_matmul_nt(G, x, W);
+    if(b != 0) {
+        y = NxGraph_add_bias(G, y, b);
+    }
+    return NxGraph_activation(G, y, act);
+}
+
+/**
+ * @brief Value of a node.
+ *
+ * After NxGraph_optimize() only the values of the outputs and the leaves
+ * are guaranteed, the inner nodes may be fused or share their buffer.
+ */
+NxTensor* NxGraph_value(NxComputationalGraph* G, u64 id) {
+    return &NxGraph_node(G, id)->value;
+}
+
+/**
+ * @brief Gradient of the loss with respect to a node, NULL when it has none.
+ */
+NxTensor* NxGraph_grad(NxComputationalGraph* G, u64 id) {
+    NxGraphNode* node = NxGraph_node(G, id);
+    return node->grad.allocated ? &node->grad : NULL;
+}
+
+/**
+ * @brief Gradient buffer of a node, allocated by the first contribution.
+ *
+ * @param fresh set when the buffer was just allocated, the contribution
+ * then writes it instead of accumulating, so it is never zeroed.
+ */
+static f64* NxGraph_grad_data(NxComputationalGraph* G, u64 id, bool* fresh) {
+    NxGraphNode* node = &G->nodes[id - 1];
+    *fresh = !node->grad.allocated;
+    if(*fresh) {
+        NxTensor_alloc(&node->grad, node->m, node->n);
+        NxGraph_track(G, &node->grad, true);
+    }
+    return node->grad.data;
+}
+
+/// Whether the backward pass propagates to the input k of a node.
+static inline bool NxGraph_wants(NxComputationalGraph* G, NxGraphNode* node, u32 k) {
+    return node->n_inputs > k && G->nodes[node->inputs[k] - 1].requires_grad;
+}
+
+/**
+ * @brief Propagate g, the gradient of a matrix product, to its two inputs.
+ *
+ * @param transposed whether the product is `A @ B^T` (B of shape (n, k)).
+ */
+static void NxGraph_backward_matmul(NxComputationalGraph* G, NxGraphNode* node, const f64* g, bool transposed) {
+    const NxBackend* E = NxBackend_get();
+    const f64* a = G->nodes[node->inputs[0] - 1].value.data;
+    const f64* b = G->nodes[node->inputs[1] - 1].value.data;
+    u64 m = node->m, n = node->n, k = G->nodes[node->inputs[0] - 1].n;
+    bool fresh;
+
+    if(NxGraph_wants(G, node, 0)) {
+        /* dA = dC @ B^T, or dC @ B when transposed */
+        f64* ga = NxGraph_grad_data(G, node->inputs[0], &fresh);
+        E->dgemm(m, k, n, 1.0, g, (i64)n, 1, b, transposed ? (i64)k : 1, transposed ? 1 : (i64)n,
+                 fresh ? 0.0 : 1.0, ga, (i64)k, 1);
+    }
+    if(NxGraph_wants(G, node, 1)) {
+        f64* gb = NxGraph_grad_data(G, node->inputs[1], &fresh);
+        if(transposed) {
+            /* dB (n, k) = dC^T @ A */
+            E->dgemm(n, k, m, 1.0, g, 1, (i64)n, a, (i64)k, 1, fresh ? 0.0 : 1.0, gb, (i64)k, 1);
+        } else {
+            /* dB (k, n) = A^T @ dC */
+            E->dgemm(k, n, m, 1.0, a, 1, (i64)k, g, (i64)n, 1, fresh ? 0.0 : 1.0, gb, (i64)n, 1);
+        }
+    }
+}
+
+/**
+ * @brief Add the column sums of g (m, n) to the gradient of a bias.
+ */
+static void NxGraph_backward_bias(NxComputationalGraph* G, u64 id, const f64* g, u64 m, u64 n) {
+    const NxKernels* K = NxKernels_get();
+    u64 i;
+    bool fresh;
+    f64* gb = NxGraph_grad_data(G, id, &fresh);
+    if(fresh) {
+        memset(gb, 0, n*sizeof (f64));
+    }
+    NxLOOP(i, m) {
+        K->add(n, gb, g + i*n, gb);
+    }
+}
+
+/**
+ * @brief Backward pass of a fused Dense layer.
+ *
+ * The gradient before the activation is computed once into a temporary,
+ * then it feeds the two GEMMs of the product and the sums of the bias.
+ */
+static void NxGraph_backward_linear(NxComputationalGraph* G, NxGraphNode* node) {
+    const f64* g = node->grad.data;
+    NxTensor D = {0};
+    if(node->act != NxActivation_None) {
+        NxTensor_alloc(&D, node->m, node->n);
+        NxGraph_track(G, &D, true);
+        NxGraph_activate_grad(node->m*node->n, g, node->value.data, D.data, true, node->act, node->scalar);
+        g = D.data;
+    }
+    NxGraph_backward_matmul(G, node, g, node->transposed);
+    if(NxGraph_wants(G, node, 2)) {
+        NxGraph_backward_bias(G, node->inputs[2], g, node->m, node->n);
+    }
+    NxGraph_release(G, &D, true);
+}
+
+/**
+ * @brief Backward pass of a fused elementwise chain, see NxExpr_backward().
+ */
+static void NxGraph_backward_fused(NxComputationalGraph* G, NxGraphNode* node) {
+    NxTensor* grads[NxGRAPH_MAX_INPUTS];
+    u32 k;
+    bool fresh;
+    NxLOOP(k, node->n_inputs) {
+        grads[k] = NULL;
+        if(NxGraph_wants(G, node, k)) {
+            f64* gk = NxGraph_grad_data(G, node->inputs[k], &fresh);
+            if(fresh) {
+                memset(gk, 0, node->m*node->n*sizeof (f64));
+            }
+            grads[k] = &G->nodes[node->inputs[k] - 1].grad;
+        }
+    }
+    NxGraph_bind(G, node);
+    NxExpr_backward(node->expr, node->expr->count - 1, &node->grad, grads);
+}
+
+/**
+ * @brief Propagate the gradient of a node to the gradients of its inputs.
+ */
+static void NxGraph_backward_node(NxComputationalGraph* G, NxGraphNode* node) {
+    NxGraphNode* I = &G->nodes[node->inputs[0] - 1];
+    NxTensor* B = node->n_inputs > 1 ? NxGraph_input_value(G, node, 1) : NULL;
+    const f64* g = node->grad.data;
+    const f64* a = NxGraph_input_value(G, node, 0)->data;
+    const f64* b = B != NULL ? B->data : NULL;
+    const f64* c = node->value.data;
+    u64 size = I->m*I->n, i, j;
+    f64 s = node->scalar;
+    bool fresh;
+
+    switch(node->op) {
+    case NxGRAPH_MATMUL:
+    case NxGRAPH_MATMUL_NT:
+        NxGraph_backward_matmul(G, node, g, node->op == NxGRAPH_MATMUL_NT);
+        return ;
+    case NxGRAPH_LINEAR:
+        NxGraph_backward_linear(G, node);
+        return ;
+    case NxGRAPH_FUSED:
+        NxGraph_backward_fused(G, node);
+        return ;
+    default:
+        break;
+    }
+
+    f64* ga = NxGraph_wants(G, node, 0) ? NxGraph_grad_data(G, node->inputs[0], &fresh) : NULL;
+    bool fresh_a = ga != NULL && fresh;
+    switch(node->op) {
+    case NxGRAPH_ADD:
+    case NxGRAPH_SUB:
+        if(ga != NULL) {
+            NxGRAPH_ACCUMULATE(ga, fresh_a, size, i, g[i]);
+        }
+        if(NxGraph_wants(G, node, 1)) {
+            f64* gb = NxGraph_grad_data(G, node->inputs[1], &fresh);
+            f64 sign = node->op == NxGRAPH_ADD ? 1.0 : -1.0;
+            NxGRAPH_ACCUMULATE(gb, fresh, size, i, sign*g[i]);
+        }
+        break;
+    case NxGRAPH_MUL:
+        if(ga != NULL) {
+            NxGRAPH_ACCUMULATE(ga, fresh_a, size, i, g[i]*b[i]);
+        }
+        if(NxGraph_wants(G, node, 1)) {
+            f64* gb = NxGraph_grad_data(G, node->inputs[1], &fresh);
+            NxGRAPH_ACCUMULATE(gb, fresh, size, i, g[i]*a[i]);
+        }
+        break;
+    case NxGRAPH_ADD_BIAS:
+        if(ga != NULL) {
+            NxGRAPH_ACCUMULATE(ga, fresh_a, size, i, g[i]);
+        }
+        if(NxGraph_wants(G, node, 1)) {
+            NxGraph_backward_bias(G, node->inputs[1], g, I->m, I->n);
+        }
+        break;
+    case NxGRAPH_SCALE:
+        NxGRAPH_ACCUMULATE(ga, fresh_a, size, i, s*g[i]);
+        break;
+    case NxGRAPH_RELU:
+    case NxGRAPH_PRELU:
+    case NxGRAPH_ELU:
+    case NxGRAPH_SIGMOID:
+    case NxGRAPH_TANH:
+        NxGraph_activate_grad(size, g, c, ga, fresh_a, NxGraph_activation_of(node->op), s);
+        break;
+    case NxGRAPH_EXP:
+        NxGRAPH_ACCUMULATE(ga, fresh_a, size, i, g[i]*c[i]);
+        break;
+    case NxGRAPH_LOG:
+        NxGRAPH_ACCUMULATE(ga, fresh_a, size, i, g[i] / a[i]);
+        break;
+    case NxGRAPH_SQUARE:
+        NxGRAPH_ACCUMULATE(ga, fresh_a, size, i, 2.0*a[i]*g[i]);
+        break;
+    case NxGRAPH_SUM:
+    case NxGRAPH_MEAN: {
+        f64 d = node->op == NxGRAPH_SUM ? g[0] : g[0] / (f64)size;
+        NxGRAPH_ACCUMULATE(ga, fresh_a, size, i, d);
+        break;
+    }
+    case NxGRAPH_MSE: {
+        f64 d = 2.0*g[0] / (f64)size;
+        if(ga != NULL) {
+            NxGRAPH_ACCUMULATE(ga, fresh_a, size, i, d*(a[i] - b[i]));
+        }
+        if(NxGraph_wants(G, node, 1)) {
+            f64* gb = NxGraph_grad_data(G, node->inputs[1], &fresh);
+            NxGRAPH_ACCUMULATE(gb, fresh, size, j, d*(b[j] - a[j]));
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Reverse-mode pass from a loss to the parameters.
+ *
+ * The gradient of the loss is seeded with ones (the gradient of the sum
+ * of its elements for a non-scalar loss). The nodes between the loss and
+ * the parameters are visited from the last recorded to the first, each
+ * one adds its contributions into the gradients of its inputs then
+ * frees its own gradient, and also its value unless `retain_values` is
+ * set. The gradients of the parameters accumulate over the calls until
+ * NxGraph_zero_grad() or NxGraph_reset().
+ *
+ * @param G the graph.
+ * @param loss id of the loss.
+ * @param retain_values keep the values of the intermediate nodes, to read
+ * them or run another backward pass. NxGraph_run() then reuses their
+ * buffers instead of allocating them again.
+ */
+void NxGraph_backward(NxComputationalGraph* G, u64 loss, bool retain_values) {
+    NxGraphNode* L = NxGraph_node(G, loss);
+    u64 i;
+    u32 k;
+    if(!L->requires_grad || L->dead) {
+        return ;
+    }
+
+    /* the nodes between the loss and the parameters */
+    bool* needed = calloc(loss, sizeof (bool));
+    NxASSERT(needed != NULL);
+    needed[loss - 1] = true;
+    for(i=loss; i-- > 0;) {
+        NxGraphNode* node = &G->nodes[i];
+        if(!needed[i]) {
+            continue;
+        }
+        NxLOOP(k, node->n_inputs) {
+            if(G->nodes[node->inputs[k] - 1].requires_grad) {
+                needed[node->inputs[k] - 1] = true;
+            }
+        }
+    }
+
+    bool fresh;
+    f64* seed = NxGraph_grad_data(G, loss, &fresh);
+    NxGRAPH_ACCUMULATE(seed, fresh, L->m*L->n, i, 1.0);
+
+    for(i=loss; i-- > 0;) {
+        NxGraphNode* node = &G->nodes[i];
+        if(!needed[i] || !node->grad.allocated || node->op == NxGRAPH_PARAMETER) {
+            continue;
+        }
+        NxGraph_backward_node(G, node);
+        NxGraph_release(G, &node->grad, true);
+        if(!retain_values && i != loss - 1) {
+            NxGraph_release(G, &node->value, true);
+        }
+    }
+    free(needed);
+}
+
+/**
+ * @brief Free the gradients of the parameters.
+ *
+ * The next backward pass writes them instead of accumulating.
+ */
+void NxGraph_zero_grad(NxComputationalGraph* G) {
+    u64 i;
+    NxLOOP(i, G->count) {
+        NxGraph_release(G, &G->nodes[i].grad, true);
+    }
+}
+
+static inline bool NxGraph_is_leaf(NxGraphOp op) {
+    return op == NxGRAPH_INPUT || op == NxGRAPH_PARAMETER || op == NxGRAPH_CONSTANT;
+}
+
+/// Whether an operation maps every element of its inputs to the same element of its value.
+static bool NxGraph_is_elementwise(NxGraphOp op) {
+    switch(op) {
+    case NxGRAPH_ADD:
+    case NxGRAPH_SUB:
+    case NxGRAPH_MUL:
+    case NxGRAPH_SCALE:
+    case NxGRAPH_RELU:
+    case NxGRAPH_PRELU:
+    case NxGRAPH_ELU:
+    case NxGRAPH_SIGMOID:
+    case NxGRAPH_TANH:
+    case NxGRAPH_EXP:
+    case NxGRAPH_LOG:
+    case NxGRAPH_SQUARE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// Whether the backward pass of an operation reads the values of its inputs.
+static bool NxGraph_reads_inputs(NxGraphOp op) {
+    switch(op) {
+    case NxGRAPH_MUL:
+    case NxGRAPH_MATMUL:
+    case NxGRAPH_MATMUL_NT:
+    case NxGRAPH_LOG:
+    case NxGRAPH_SQUARE:
+    case NxGRAPH_MSE:
+    case NxGRAPH_LINEAR:
+    case NxGRAPH_FUSED:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// Whether the backward pass of an operation reads its own value.
+static bool NxGraph_reads_output(NxGraphOp op) {
+    return NxGraph_activation_of(op) != NxActivation_None || op == NxGRAPH_EXP || op == NxGRAPH_LINEAR;
+}
+
+/**
+ * @brief Drop a node from the graph with its buffers.
+ */
+static void NxGraph_kill(NxComputationalGraph* G, NxGraphNode* node) {
+    node->dead = true;
+    node->inplace = 0;
+    NxGraph_release(G, &node->value, !NxGraph_shared(node));
+    NxGraph_release(G, &node->grad, true);
+    free(node->expr);
+    node->expr = NULL;
+}
+
+/**
+ * @brief Dead-node elimination: drop the nodes no output depends on.
+ */
+static void NxGraph_prune(NxComputationalGraph* G, const bool* output) {
+    bool* live = calloc(G->count, sizeof (bool));
+    u64 i;
+    u32 k;
+    NxASSERT(live != NULL);
+    for(i=G->count; i-- > 0;) {
+        NxGraphNode* node = &G->nodes[i];
+        if(node->dead || !(output[i] || live[i])) {
+            continue;
+        }
+        live[i] = true;
+        NxLOOP(k, node->n_inputs) {
+            live[node->inputs[k] - 1] = true;
+        }
+    }
+    NxLOOP(i, G->count) {
+        if(!live[i] && !G->nodes[i].dead) {
+            NxGraph_kill(G, &G->nodes[i]);
+        }
+    }
+    free(live);
+}
+
+/**
+ * @brief Constant folding: compute once the nodes whose inputs are all constants.
+ *
+ * They become constants themselves, so whole constant subgraphs fold in
+ * one pass over the tape, and their inputs are left to NxGraph_prune().
+ */
+static void NxGraph_fold(NxComputationalGraph* G) {
+    u64 i;
+    u32 k;
+    NxLOOP(i, G->count) {
+        NxGraphNode* node = &G->nodes[i];
+        bool constant = !node->dead && !NxGraph_is_leaf(node->op);
+        NxLOOP(k, node->n_inputs) {
+            constant &= G->nodes[node->inputs[k] - 1].op == NxGRAPH_CONSTANT;
+        }
+        if(!constant) {
+            continue;
+        }
+        if(!node->value.allocated) {
+            NxGraph_compute(G, node);
+        }
+        node->op = NxGRAPH_CONSTANT;
+        node->n_inputs = 0;
+        node->inplace = 0;
+        free(node->expr);
+        node->expr = NULL;
+    }
+}
+
+/**
+ * @brief Count the live consumers of every node and remember the last one.
+ */
+static void NxGraph_count_uses(NxComputationalGraph* G, u64* uses, u64* last) {
+    u64 i;
+    u32 k;
+    memset(uses, 0, G->count*sizeof (u64));
+    memset(last, 0, G->count*sizeof (u64));
+    NxLOOP(i, G->count) {
+        NxGraphNode* node = &G->nodes[i];
+        if(node->dead) {
+            continue;
+        }
+        NxLOOP(k, node->n_inputs) {
+            uses[node->inputs[k] - 1]++;
+            last[node->inputs[k] - 1] = i + 1;
+        }
+    }
+}
+
+/**
+ * @brief The only consumer of a node, NULL when it has several or is an output.
+ */
+static NxGraphNode* NxGraph_consumer(NxComputationalGraph* G, u64 id, const u64* uses, const u64* last,
+                                     const bool* output) {
+    if(uses[id - 1] != 1 || output[id - 1]) {
+        return NULL;
+    }
+    return &G->nodes[last[id - 1] - 1];
+}
+
+/**
+ * @brief Fuse every matrix product followed by a bias and/or an activation into one NxGRAPH_LINEAR.
+ *
+ * The fused node takes the place of the last node of the pattern, which
+ * keeps its id for its consumers, the other nodes are dropped. The
+ * intermediate results must have no other consumer and not be outputs.
+ */
+static void NxGraph_fuse_linear(NxComputationalGraph* G, const u64* uses, const u64* last, const bool* output) {
+    u64 i;
+    NxLOOP(i, G->count) {
+        NxGraphNode* M = &G->nodes[i];
+        if(M->dead || (M->op != NxGRAPH_MATMUL && M->op != NxGRAPH_MATMUL_NT)) {
+            continue;
+        }
+        NxGraphNode* tail = M;
+        NxGraphNode* bias = NULL;
+        NxGraphNode* next = NxGraph_consumer(G, i + 1, uses, last, output);
+        if(next != NULL && next->op == NxGRAPH_ADD_BIAS && next->inputs[0] == i + 1) {
+            bias = tail = next;
+        }
+        next = NxGraph_consumer(G, (u64)(tail - G->nodes) + 1, uses, last, output);
+        NxActivation act = next != NULL ? NxGraph_activation_of(next->op) : NxActivation_None;
+        if(act != NxActivation_None) {
+            tail = next;
+        }
+        if(tail == M) {
+            continue;
+        }
+
+        tail->inputs[2] = bias != NULL ? bias->inputs[1] : 0;
+        tail->inputs[0] = M->inputs[0];
+        tail->inputs[1] = M->inputs[1];
+        tail->n_inputs = bias != NULL ? 3 : 2;
+        tail->transposed = M->op == NxGRAPH_MATMUL_NT;
+        tail->act = act;
+        tail->scalar = act != NxActivation_None ? tail->scalar : 0.0;
+        tail->op = NxGRAPH_LINEAR;
+        NxGraph_kill(G, M);
+        if(bias != NULL && bias != tail) {
+            NxGraph_kill(G, bias);
+        }
+    }
+}
+
+/// Nodes of an NxExpr emitted by the fusion of one elementwise operation.
+static u32 NxGraph_expr_cost(NxGraphOp op) {
+    return op == NxGRAPH_SCALE ? 2 : 1;
+}
+
+/**
+ * @brief A group of elementwise nodes being fused into one NxExpr.
+ */
+typedef struct NxGraphFusion {
+    NxExpr* expr; ///< the program being emitted.
+    u64 members[NxEXPR_MAX_NODES]; ///< ids of the fused nodes, the first one is the root.
+    u32 n_members; ///< number of fused nodes.
+    u64 externals[NxGRAPH_MAX_INPUTS]; ///< ids read by the group, in the order of the tensor leaves.
+    u32 n_externals; ///< number of external inputs.
+    u64 emitted[2*NxEXPR_MAX_NODES]; ///< ids already emitted.
+    u32 index[2*NxEXPR_MAX_NODES]; ///< expression node of every emitted id.
+    u32 n_emitted; ///< number of emitted ids.
+} NxGraphFusion;
+
+static bool NxGraph_is_member(const NxGraphFusion* F, u64 id) {
+    u32 k;
+    NxLOOP(k, F->n_members) {
+        if(F->members[k] == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Whether a group fits in one NxExpr: its nodes, constants and distinct external inputs.
+ */
+static bool NxGraph_fits(NxComputationalGraph* G, const NxGraphFusion* F) {
+    u64 externals[2*NxEXPR_MAX_NODES];
+    u32 cost = 0, n_externals = 0, i, k, e;
+    NxLOOP(i, F->n_members) {
+        NxGraphNode* node = &G->nodes[F->members[i] - 1];
+        cost += NxGraph_expr_cost(node->op);
+        NxLOOP(k, node->n_inputs) {
+            u64 id = node->inputs[k];
+            bool seen = NxGraph_is_member(F, id);
+            NxLOOP(e, n_externals) {
+                seen |= externals[e] == id;
+            }
+            if(!seen) {
+                externals[n_externals++] = id;
+            }
+        }
+    }
+    return cost + n_externals <= NxEXPR_MAX_NODES && n_externals <= NxGRAPH_MAX_INPUTS;
+}
+
+/**
+ * @brief Emit a node of the group (or a leaf for an external input) and return its expression node.
+ */
+static u32 NxGraph_emit(NxComputationalGraph* G, NxGraphFusion* F, u64 id) {
+    NxExpr* E = F->expr;
+    u32 k, r;
+    NxLOOP(k, F->n_emitted) {
+        if(F->emitted[k] == id) {
+            return F->index[k];
+        }
+    }
+
+    NxGraphNode* node = &G->nodes[id - 1];
+    if(!NxGraph_is_member(F, id)) {
+        r = NxExpr_tensor(E, &node->value);
+        F->externals[F->n_externals++] = id;
+    } else {
+        u32 a = NxGraph_emit(G, F, node->inputs[0]);
+        u32 b = node->n_inputs > 1 ? NxGraph_emit(G, F, node->inputs[1]) : a;
+        switch(node->op) {
+        case NxGRAPH_ADD:
+            r = NxExpr_add(E, a, b);
+            break;
+        case NxGRAPH_SUB:
+            r = NxExpr_sub(E, a, b);
+            break;
+        case NxGRAPH_MUL:
+            r = NxExpr_mul(E, a, b);
+            break;
+        case NxGRAPH_SCALE:
+            r = NxExpr_mul(E, a, NxExpr_const(E, node->scalar));
+            break;
+        case NxGRAPH_RELU:
+            r = NxExpr_prelu(E, a, 0.0);
+            break;
+        case NxGRAPH_PRELU:
+            r = NxExpr_prelu(E, a, node->scalar);
+            break;
+        case NxGRAPH_ELU:
+            r = NxExpr_elu(E, a, node->scalar);
+            break;
+        case NxGRAPH_SIGMOID:
+            r = NxExpr_sigmoid(E, a);
+            break;
+        case NxGRAPH_TANH:
+            r = NxExpr_tanh(E, a);
+            break;
+        case NxGRAPH_EXP:
+            r = NxExpr_exp(E, a);
+            break;
+        case NxGRAPH_LOG:
+            r = NxExpr_log(E, a);
+            break;
+        default:
+            r = NxExpr_square(E, a);
+            break;
+        }
+    }
+    F->emitted[F->n_emitted] = id;
+    F->index[F->n_emitted++] = r;
+    return r;
+}
+
+/**
+ * @brief Fuse the chains of elementwise operations into NxGRAPH_FUSED nodes.
+ *
+ * The tape is walked backwards, every elementwise node not fused yet
+ * roots a group which absorbs its elementwise inputs as long as they
+ * have no other consumer, are not outputs and the group fits in one
+ * NxExpr. The root becomes the fused node and keeps its id, its value is
+ * then computed in a single pass over the memory, block by block.
+ */
+static void NxGraph_fuse_elementwise(NxComputationalGraph* G, const u64* uses, const u64* last, const bool* output) {
+    NxGraphFusion F;
+    u64 i;
+    u32 j, k;
+    for(i=G->count; i-- > 0;) {
+        NxGraphNode* root = &G->nodes[i];
+        if(root->dead || !NxGraph_is_elementwise(root->op)) {
+            continue;
+        }
+        F.members[0] = i + 1;
+        F.n_members = 1;
+        for(j=0; j<F.n_members; j++) {
+            NxGraphNode* node = &G->nodes[F.members[j] - 1];
+            NxLOOP(k, node->n_inputs) {
+                u64 id = node->inputs[k];
+                NxGraphNode* I = &G->nodes[id - 1];
+                if(!NxGraph_is_elementwise(I->op) || NxGraph_consumer(G, id, uses, last, output) == NULL ||
+                   I->m != root->m || I->n != root->n || F.n_members == NxEXPR_MAX_NODES) {
+                    continue;
+                }
+                F.members[F.n_members++] = id;
+                if(!NxGraph_fits(G, &F)) {
+                    F.n_members--;
+                }
+            }
+        }
+        if(F.n_members < 2) {
+            continue;
+        }
+
+        F.expr = malloc(sizeof (NxExpr));
+        NxASSERT(F.expr != NULL);
+        NxExpr_init(F.expr);
+        F.n_externals = 0;
+        F.n_emitted = 0;
+        NxGraph_emit(G, &F, i + 1);
+        for(j=1; j<F.n_members; j++) {
+            NxGraph_kill(G, &G->nodes[F.members[j] - 1]);
+        }
+        root->op = NxGRAPH_FUSED;
+        root->expr = F.expr;
+        root->n_inputs = F.n_externals;
+        memcpy(root->inputs, F.externals, F.n_externals*sizeof (u64));
+    }
+}
+
+/**
+ * @brief In-place selection: let elementwise nodes take over the buffer of a dying input.
+ *
+ * The input must be computed by the graph (not a leaf), have the same
+ * shape, not be an output, and this node must be its last consumer.
+ * When gradients flow through them, the buffer is only reused if no
+ * backward pass reads the overwritten value: neither a consumer that
+ * needs its inputs (MUL, LOG, ...) nor the input itself when its
+ * derivative is computed from its own value (activations, EXP).
+ */
+static void NxGraph_select_inplace(NxComputationalGraph* G, const u64* last, const bool* output) {
+    bool* read = calloc(G->count, sizeof (bool));
+    u64 i;
+    u32 k;
+    NxASSERT(read != NULL);
+    NxLOOP(i, G->count) {
+        NxGraphNode* node = &G->nodes[i];
+        node->inplace = 0;
+        if(node->dead || !node->requires_grad || !NxGraph_reads_inputs(node->op)) {
+            continue;
+        }
+        NxLOOP(k, node->n_inputs) {
+            read[node->inputs[k] - 1] = true;
+        }
+    }
+
+    NxLOOP(i, G->count) {
+        NxGraphNode* node = &G->nodes[i];
+        if(node->dead || !(NxGraph_is_elementwise(node->op) || node->op == NxGRAPH_FUSED ||
+                           node->op == NxGRAPH_ADD_BIAS)) {
+            continue;
+        }
+        NxLOOP(k, node->n_inputs) {
+            u64 id = node->inputs[k];
+            NxGraphNode* I = &G->nodes[id - 1];
+            if(NxGraph_is_leaf(I->op) || output[id - 1] || last[id - 1] != i + 1 ||
+               I->m != node->m || I->n != node->n || read[id - 1] ||
+               (I->requires_grad && NxGraph_reads_output(I->op))) {
+                continue;
+            }
+            node->inplace = k + 1;
+            break;
+        }
+    }
+    free(read);
+}
+
+/**
+ * @brief Rewrite the graph for the given outputs.
+ *
+ * The passes run in this order:
+ *  - dead-node elimination, nothing the outputs do not depend on is kept;
+ *  - constant folding of the nodes depending only on NxGraph_constant() leaves;
+ *  - fusion of the matrix products with their bias and activation (NxGRAPH_LINEAR);
+ *  - fusion of the chains of elementwise operations into one NxExpr (NxGRAPH_FUSED);
+ *  - in-place selection, a node reuses the buffer of an input nobody reads afterwards.
+ *
+ * The fused nodes keep the id of the last node they replace, so the ids
+ * of the outputs (and of the loss given to NxGraph_backward()) stay
+ * valid. The values of the outputs are computed by the next
+ * NxGraph_run(), the other inner values may not exist anymore.
+ *
+ * @param G the graph.
+ * @param outputs ids of the nodes whose values are read, with the loss.
+ * @param n_outputs number of outputs.
+ */
+void NxGraph_optimize(NxComputationalGraph* G, const u64* outputs, u64 n_outputs) {
+    bool* output = calloc(G->count, sizeof (bool));
+    u64* uses = malloc(G->count*sizeof (u64));
+    u64* last = malloc(G->count*sizeof (u64));
+    u64 i;
+    NxASSERT(output != NULL && uses != NULL && last != NULL);
+    NxLOOP(i, n_outputs) {
+        NxGraph_node(G, outputs[i]);
+        output[outputs[i] - 1] = true;
+    }
+
+    NxGraph_prune(G, output);
+    NxGraph_fold(G);
+    NxGraph_prune(G, output);
+    NxGraph_count_uses(G, uses, last);
+    NxGraph_fuse_linear(G, uses, last, output);
+    NxGraph_count_uses(G, uses, last);
+    NxGraph_fuse_elementwise(G, uses, last, output);
+    NxGraph_count_uses(G, uses, last);
+    NxGraph_select_inplace(G, last, output);
+
+    free(output);
+    free(uses);
+    free(last);
+}
+
+/**
+ * @brief Compute every live node of the graph again.
+ *
+ * The input and parameter leaves read the current contents of the
+ * tensors they were recorded from (which must keep their shape), the
+ * constants keep their value. The leaves borrow the buffers of their
+ * tensors without copying them, and a node keeps the buffer of its
+ * previous run. A node chosen by the in-place pass takes the buffer of
+ * its input instead, so that input allocates a new one on the next run:
+ * every run allocates one buffer per in-place node, on top of what
+ * NxGraph_backward() freed.
+ */
+void NxGraph_run(NxComputationalGraph* G) {
+    u64 i;
+    NxLOOP(i, G->count) {
+        NxGraphNode* node = &G->nodes[i];
+        if(node->dead || node->op == NxGRAPH_CONSTANT) {
+            continue;
+        }
+        if(node->op == NxGRAPH_INPUT || node->op == NxGRAPH_PARAMETER) {
+            NxTensor* X = node->source;
+            if(X->m != node->m || X->n != node->n) {
+                fprintf(stderr, "The leaf %" PRIu64 " changed from (%" PRIu64 ", %" PRIu64 ") to (%" PRIu64 ", %" PRIu64 "), record the graph again.\n",
+                        i + 1, node->m, node->n, X->m, X->n);
+                exit(EXIT_FAILURE);
+            }
+            NxGraph_borrow(&node->value, X);
+            node->value.id = i + 1;
+            continue;
+        }
+        if(node->inplace != 0) {
+            NxTensor* T = &G->nodes[node->inputs[node->inplace - 1] - 1].value;
+            if(T->allocated) {
+                NxGraph_release(G, &node->value, true);
+                node->value = *T;
+                *T = (NxTensor){0};
+            }
+        }
+        NxGraph_compute(G, node);
+    }
+}
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxGraph.c
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
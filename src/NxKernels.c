@@ -0,0 +1,307 @@
+#include "NxKernels.h"
+
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NxKERNELS_X86
+#endif
+
+/**
+ * @brief Integer power of a scalar by repeated squaring.
+ *
+ * Used for the tails of the vector kernels so every lane gets
+ * exactly the same result as the scalar path.
+ */
+static inline f64 NxKernel_powi_scalar(f64 x, i32 p) {
+    u32 k = p < 0 ? (u32)0 - (u32)p : (u32)p;
+    f64 r = 1.0;
+    for(; k; k>>=1) {
+        if(k & 1) {
+            r *= x;
+        }
+        x *= x;
+    }
+    return p < 0 ? 1.0 / r : r;
+}
+
+/**
+ * @brief Single precision version of NxKernel_powi_scalar().
+ */
+static inline f32 NxKernel_powi_scalar_f32(f32 x, i32 p) {
+    u32 k = p < 0 ? (u32)0 - (u32)p : (u32)p;
+    f32 r = 1.0f;
+    for(; k; k>>=1) {
+        if(k & 1) {
+            r *= x;
+        }
+        x *= x;
+    }
+    return p < 0 ? 1.0f / r : r;
+}
+
+/* Portable kernels, one element per iteration. */
+#define NxK_ISA        "generic"
+#define NxK_FN(name)   NxKernel_##name##_generic
+#define NxK_T          f64
+#define NxK_TABLE      NxKernels
+#define NxK_VEC        f64
+#define NxK_W          1
+#define NxK_LOAD(p)    (*(p))
+#define NxK_STORE(p, v) (*(p) = (v))
+#define NxK_SET1(s)    (s)
+#define NxK_ADD(x, y)  ((x) + (y))
+#define NxK_SUB(x, y)  ((x) - (y))
+#define NxK_MUL(x, y)  ((x) * (y))
+#define NxK_DIV(x, y)  ((x) / (y))
+#define NxK_NEG(x)     (-(x))
+#define NxK_ABS(x)     fabs(x)
+#define NxK_FABS(x)    fabs(x)
+#define NxK_POWI(x, p) NxKernel_powi_scalar(x, p)
+#include "NxKernels.inc"
+
+#define NxK_ISA        "generic"
+#define NxK_FN(name)   NxKernel_##name##_f32_generic
+#define NxK_T          f32
+#define NxK_TABLE      NxKernelsF32
+#define NxK_VEC        f32
+#define NxK_W          1
+#define NxK_LOAD(p)    (*(p))
+#define NxK_STORE(p, v) (*(p) = (v))
+#define NxK_SET1(s)    (s)
+#define NxK_ADD(x, y)  ((x) + (y))
+#define NxK_SUB(x, y)  ((x) - (y))
+#define NxK_MUL(x, y)  ((x) * (y))
+#define NxK_DIV(x, y)  ((x) / (y))
+#define NxK_NEG(x)     (-(x))
+#define NxK_ABS(x)     fabsf(x)
+#define NxK_FABS(x)    fabsf(x)
+#define NxK_POWI(x, p) NxKernel_powi_scalar_f32(x, p)
+#include "NxKernels.inc"
+
+#ifdef NxKERNELS_X86
+
+/* SSE2 kernels, two lanes (four in f32). */
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#define NxK_ISA        "sse2"
+#define NxK_FN(name)   NxKernel_##name##_sse2
+#define NxK_T          f64
+#define NxK_TABLE      NxKernels
+#define NxK_VEC        __m128d
+#define NxK_W          2
+#define NxK_LOAD(p)    _mm_loadu_pd(p)
+#define NxK_STORE(p, v) _mm_storeu_pd(p, v)
+#define NxK_SET1(s)    _mm_set1_pd(s)
+#define NxK_ADD(x, y)  _mm_add_pd(x, y)
+#define NxK_SUB(x, y)  _mm_sub_pd(x, y)
+#define NxK_MUL(x, y)  _mm_mul_pd(x, y)
+#define NxK_DIV(x, y)  _mm_div_pd(x, y)
+#define NxK_NEG(x)     _mm_xor_pd(x, _mm_set1_pd(-0.0))
+#define NxK_ABS(x)     _mm_andnot_pd(_mm_set1_pd(-0.0), x)
+#define NxK_FABS(x)    fabs(x)
+#define NxK_POWI(x, p) NxKernel_powi_scalar(x, p)
+#include "NxKernels.inc"
+
+#define NxK_ISA        "sse2"
+#define NxK_FN(name)   NxKernel_##name##_f32_sse2
+#define NxK_T          f32
+#define NxK_TABLE      NxKernelsF32
+#define NxK_VEC        __m128
+#define NxK_W          4
+#define NxK_LOAD(p)    _mm_loadu_ps(p)
+#define NxK_STORE(p, v) _mm_storeu_ps(p, v)
+#define NxK_SET1(s)    _mm_set1_ps(s)
+#define NxK_ADD(x, y)  _mm_add_ps(x, y)
+#define NxK_SUB(x, y)  _mm_sub_ps(x, y)
+#define NxK_MUL(x, y)  _mm_mul_ps(x, y)
+#define NxK_DIV(x, y)  _mm_div_ps(x, y)
+#define NxK_NEG(x)     _mm_xor_ps(x, _mm_set1_ps(-0.0f))
+#define NxK_ABS(x)     _mm_andnot_ps(_mm_set1_ps(-0.0f), x)
+#define NxK_FABS(x)    fabsf(x)
+#define NxK_POWI(x, p) NxKernel_powi_scalar_f32(x, p)
+#include "NxKernels.inc"
+#pragma GCC pop_options
+
+/* AVX2 kernels, four lanes (eight in f32). */
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define NxK_ISA        "avx2"
+#define NxK_FN(name)   NxKernel_##name##_avx2
+#define NxK_T          f64
+#define NxK_TABLE      NxKernels
+#define NxK_VEC        __m256d
+#define NxK_W          4
+#define NxK_LOAD(p)    _mm256_loadu_pd(p)
+#define NxK_STORE(p, v) _mm256_storeu_pd(p, v)
+#define NxK_SET1(s)    _mm256_set1_pd(s)
+#define NxK_ADD(x, y)  _mm256_add_pd(x, y)
+#define NxK_SUB(x, y)  _mm256_sub_pd(x, y)
+#define NxK_MUL(x, y)  _mm256_mul_pd(x, y)
+#define NxK_DIV(x, y)  _mm256_div_pd(x, y)
+#define NxK_NEG(x)     _mm256_xor_pd(x, _mm256_set1_pd(-0.0))
+#define NxK_ABS(x)     _mm256_andnot_pd(_mm256_set1_pd(-0.0), x)
+#define NxK_FABS(x)    fabs(x)
+#define NxK_POWI(x, p) NxKernel_powi_scalar(x, p)
+#include "NxKernels.inc"
+
+#define NxK_ISA        "avx2"
+#define NxK_FN(name)   NxKernel_##name##_f32_avx2
+#define NxK_T          f32
+#define NxK_TABLE      NxKernelsF32
+#define NxK_VEC        __m256
+#define NxK_W          8
+#define NxK_LOAD(p)    _mm256_loadu_ps(p)
+#define NxK_STORE(p, v) _mm256_storeu_ps(p, v)
+#define NxK_SET1(s)    _mm256_set1_ps(s)
+#define NxK_ADD(x, y)  _mm256_add_ps(x, y)
+#define NxK_SUB(x, y)  _mm256_sub_ps(x, y)
+#define NxK_MUL(x, y)  _mm256_mul_ps(x, y)
+#define NxK_DIV(x, y)  _mm256_div_ps(x, y)
+#define NxK_NEG(x)     _mm256_xor_ps(x, _mm256_set1_ps(-0.0f))
+#define NxK_ABS(x)     _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x)
+#define NxK_FABS(x)    fabsf(x)
+#define NxK_POWI(x, p) NxKernel_powi_scalar_f32(x, p)
+#include "NxKernels.inc"
+#pragma GCC pop_options
+
+/* AVX-512 kernels, eight lanes (sixteen in f32). */
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#define NxK_ISA        "avx512"
+#define NxK_FN(name)   NxKernel_##name##_avx512
+#define NxK_T          f64
+#define NxK_TABLE      NxKernels
+#define NxK_VEC        __m512d
+#define NxK_W          8
+#define NxK_LOAD(p)    _mm512_loadu_pd(p)
+#define NxK_STORE(p, v) _mm512_storeu_pd(p, v)
+#define NxK_SET1(s)    _mm512_set1_pd(s)
+#define NxK_ADD(x, y)  _mm512_add_pd(x, y)
+#define NxK_SUB(x, y)  _mm512_sub_pd(x, y)
+#define NxK_MUL(x, y)  _mm512_mul_pd(x, y)
+#define NxK_DIV(x, y)  _mm512_div_pd(x, y)
+#define NxK_NEG(x)     _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(x), \
+                                           _mm512_set1_epi64((i64)0x8000000000000000ULL)))
+#define NxK_ABS(x)     _mm512_abs_pd(x)
+#define NxK_FABS(x)    fabs(x)
+#define NxK_POWI(x, p) NxKernel_powi_scalar(x, p)
+#include "NxKernels.inc"
+
+#define NxK_ISA        "avx512"
+#define NxK_FN(name)   NxKernel_##name##_f32_avx512
+#define NxK_T          f32
+#define NxK_TABLE      NxKernelsF32
+#define NxK_VEC        __m512
+#define NxK_W          16
+#define NxK_LOAD(p)    _mm512_loadu_ps(p)
+#define NxK_STORE(p, v) _mm512_storeu_ps(p, v)
+#define NxK_SET1(s)    _mm512_set1_ps(s)
+#define NxK_ADD(x, y)  _mm512_add_ps(x, y)
+#define NxK_SUB(x, y)  _mm512_sub_ps(x, y)
+#define NxK_MUL(x, y)  _mm512_mul_ps(x, y)
+#define NxK_DIV(x, y)  _mm512_div_ps(x, y)
+#define NxK_NEG(x)     _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(x), \
+                                           _mm512_set1_epi32((i32)0x80000000U)))
+#define NxK_ABS(x)     _mm512_abs_ps(x)
+#define NxK_FABS(x)    fabsf(x)
+#define NxK_POWI(x, p) NxKernel_powi_scalar_f32(x, p)
+#include "NxKernels.inc"
+#pragma GCC pop_options
+
+#endif /* NxKERNELS_X86 */
+
+static const NxKernels* NxKernels_active = &NxKernel_table_generic;
+static const NxKernelsF32* NxKernels_active_f32 = &NxKernel_table_f32_generic;
+
+/**
+ * @brief Force the instruction set of the elementwise kernels.
+ *
+ * The requested set is only used when the running CPU supports it.
+ *
+ * @param isa the instruction set to use: `"generic"`, `"sse2"`, `"avx2"` or `"avx512"`.
+ *            `NULL` or an empty string picks the widest set the CPU supports.
+ *
+ * @return true if the requested set is the active one.
+ */
+bool NxKernels_select(str isa) {
+    bool any = isa == NULL || isa[0] == '\0';
+    NxKernels_active = &NxKernel_table_generic;
+    NxKernels_active_f32 = &NxKernel_table_f32_generic;
+    if(!any && strcmp(isa, "generic") == 0) {
+        return true;
+    }
+#ifdef NxKERNELS_X86
+    __builtin_cpu_init();
+    if((any || strcmp(isa, "avx512") == 0) && __builtin_cpu_supports("avx512f")) {
+        NxKernels_active = &NxKernel_table_avx512;
+        NxKernels_active_f32 = &NxKernel_table_f32_avx512;
+        return true;
+    }
+    if((any || strcmp(isa, "avx2") == 0) && __builtin_cpu_supports("avx2")) {
+        NxKernels_active = &NxKernel_table_avx2;
+        NxKernels_active_f32 = &NxKernel_table_f32_avx2;
+        return true;
+    }
+    if((any || strcmp(isa, "sse2") == 0) && __builtin_cpu_supports("sse2")) {
+        NxKernels_active = &NxKernel_table_sse2;
+        NxKernels_active_f32 = &NxKernel_table_f32_sse2;
+        return true;
+    }
+#endif
+    return any;
+}
+
+/**
+ * @brief Pick the kernels when the library is loaded.
+ *
+ * Uses the `NEXUM_ISA` environment variable when it is set, otherwise the
+ * widest instruction set reported by the CPU.
+ */
+__attribute__((constructor))
+static void NxKernels_init(void) {
+    NxKernels_select(getenv(NxKERNELS_ENV));
+}
+
+/**
+ * @brief Return the active table of elementwise kernels.
+ */
+const NxKernels* NxKernels_get(void) {
+    return NxKernels_active;
+}
+
+/**
+ * @brief Return the active table of single precision kernels.
+ *
+ * Selected together with NxKernels_get(), the f32 kernels process twice
+ * as many lanes per instruction.
+ */
+const NxKernelsF32* NxKernels_get_f32(void) {
+    return NxKernels_active_f32;
+}
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxKernels.c
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
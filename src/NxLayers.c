@@ -1,4 +1,7 @@
 #include "NxLayers.h"
+#include "NxGemm.h"
+#include "NxBackend.h"
+#include "NxText.h"
 
 #include <time.h>
 #include <math.h>
@@ -38,29 +41,256 @@ void NxDense_forward(NxDense* L3, NxDense* L1, NxDense* L2) {
 	(void) L2;
 }
 
+/**
+ * @brief Apply the activation of a layer inplace to n outputs.
+ */
+static void NxDense_activate(f64* y, u64 n, NxActivation act) {
+	u64 i;
+	switch(act) {
+	case NxActivation_ReLU:
+		NxLOOP(i, n) {
+			y[i] = y[i] > 0.0 ? y[i] : 0.0;
+		}
+		break;
+	case NxActivation_Sigmoid:
+		NxLOOP(i, n) {
+			y[i] = 1.0 / (1.0 + exp(-y[i]));
+		}
+		break;
+	case NxActivation_Tanh:
+		NxLOOP(i, n) {
+			y[i] = tanh(y[i]);
+		}
+		break;
+	case NxActivation_ELU:
+		NxLOOP(i, n) {
+			y[i] = y[i] > 0.0 ? y[i] : NxELU_ALPHA*expm1(y[i]);
+		}
+		break;
+	case NxActivation_PReLU:
+		NxLOOP(i, n) {
+			y[i] = y[i] > 0.0 ? y[i] : NxPRELU_SLOPE*y[i];
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * @brief Gradient through the activation, `dz = dy * act'(z)` written from the outputs y = act(z).
+ *
+ * dz may be dy itself.
+ */
+static void NxDense_activate_grad(f64* dz, const f64* dy, const f64* y, u64 n, NxActivation act) {
+	u64 i;
+	switch(act) {
+	case NxActivation_ReLU:
+		NxLOOP(i, n) {
+			dz[i] = y[i] > 0.0 ? dy[i] : 0.0;
+		}
+		break;
+	case NxActivation_Sigmoid:
+		NxLOOP(i, n) {
+			dz[i] = dy[i]*y[i]*(1.0 - y[i]);
+		}
+		break;
+	case NxActivation_Tanh:
+		NxLOOP(i, n) {
+			dz[i] = dy[i]*(1.0 - y[i]*y[i]);
+		}
+		break;
+	case NxActivation_ELU:
+		NxLOOP(i, n) {
+			dz[i] = y[i] > 0.0 ? dy[i] : dy[i]*(y[i] + NxELU_ALPHA);
+		}
+		break;
+	case NxActivation_PReLU:
+		NxLOOP(i, n) {
+			dz[i] = y[i] > 0.0 ? dy[i] : dy[i]*NxPRELU_SLOPE;
+		}
+		break;
+	default:
+		if(dz != dy) {
+			memcpy(dz, dy, n*sizeof (f64));
+		}
+		break;
+	}
+}
+
+/**
+ * @brief Forward pass of a Dense layer over a sparse input batch.
+ *
+ * Computes `Y = act(X*W^T + b^T)` with NxSparse_spmm(), reading the
+ * weights in place as the transpose of the (out_features, in_features)
+ * matrix. The cost is O(nnz(X)*out_features), a one-hot or bag-of-words
+ * batch never goes through its full input width.
+ *
+ * @param L the layer.
+ * @param Y output of shape (batch, out_features).
+ * @param X inputs of shape (batch, in_features), CSR or CSC.
+ */
+void NxDense_forward_sparse(NxDense* L, NxTensor* Y, NxSparseTensor* X) {
+	NxASSERT(L->initialized && X->allocated);
+	if(X->n != L->in_features) {
+		fprintf(stderr, "Cannot forward inputs of shape (%" PRIu64 ", %" PRIu64 ") through a Dense layer of %" PRIu64 " inputs.\n",
+				X->m, X->n, L->in_features);
+		exit(EXIT_FAILURE);
+	}
+	u64 batch = X->m, out = L->out_features, i;
+	NxTensor_alloc(Y, batch, out);
+	NxLOOP(i, batch) {
+		memcpy(Y->data + i*out, L->bias.data, out*sizeof (f64));
+	}
+	NxSparse_spmm(false, out, 1.0, X, L->weights.data, L->weights.cs, L->weights.rs,
+	              1.0, Y->data, Y->rs, Y->cs);
+	NxDense_activate(Y->data, batch*out, L->act);
+}
+
+/**
+ * @brief Backward pass of a Dense layer over a sparse input batch.
+ *
+ * With `dZ = dY * act'(Z)` the gradients are `dW = dZ^T*X` and `db` the
+ * column sums of dZ. dW is the sparse-times-dense product of X read as
+ * its transpose, so only the columns of the inputs seen in the batch
+ * cost any FLOPs, O(nnz(X)*out_features) in total. The gradient of the
+ * inputs is not computed: a sparse batch is always the data itself.
+ *
+ * @param L the layer.
+ * @param dW gradient of the weights, of shape (out_features, in_features).
+ * @param db gradient of the bias, of shape (out_features, 1).
+ * @param dY gradient of the loss with respect to the outputs Y.
+ * @param X the inputs given to NxDense_forward_sparse().
+ * @param Y the outputs returned by NxDense_forward_sparse().
+ */
+void NxDense_backward_sparse(NxDense* L, NxTensor* dW, NxTensor* db, NxTensor* dY,
+                             NxSparseTensor* X, NxTensor* Y) {
+	NxASSERT(L->initialized && X->allocated && dY->allocated && Y->allocated);
+	u64 batch = X->m, out = L->out_features, i, j;
+	if(X->n != L->in_features || dY->m != batch || dY->n != out || Y->m != batch || Y->n != out
+	   || dY->dtype != NxFLOAT64 || Y->dtype != NxFLOAT64) {
+		fprintf(stderr, "Cannot backward a Dense layer of shape (%" PRIu64 ", %" PRIu64 ") over a batch of %" PRIu64 ".\n",
+				L->in_features, out, batch);
+		exit(EXIT_FAILURE);
+	}
+	NxTensor TY = {0}, TdY = {0};
+	if(!NxTensor_is_contiguous(Y)) {
+		NxTensor_contiguous(&TY, Y);
+		Y = &TY;
+	}
+	if(!NxTensor_is_contiguous(dY)) {
+		NxTensor_contiguous(&TdY, dY);
+		dY = &TdY;
+	}
+
+	NxTensor dZ = {0};
+	NxTensor_alloc(&dZ, batch, out);
+	NxDense_activate_grad(dZ.data, dY->data, Y->data, batch*out, L->act);
+
+	NxTensor_alloc(dW, out, L->in_features);
+	NxSparse_spmm(true, out, 1.0, X, dZ.data, dZ.rs, dZ.cs, 0.0, dW->data, dW->cs, dW->rs);
+
+	NxTensor_alloc_zeros(db, out, 1);
+	NxLOOP(i, batch) {
+		NxLOOP(j, out) {
+			db->data[j] += dZ.data[i*out + j];
+		}
+	}
+	NxTensor_free(&dZ);
+	NxTensor_free(&TdY);
+	NxTensor_free(&TY);
+}
+
+/**
+ * @brief Forward pass of a Dense layer between row-major f64 buffers: `Y = act(X*W^T + b^T)`.
+ *
+ * Nothing is allocated, the caller owns both buffers (NxModelSequential
+ * takes them from its memory plan).
+ *
+ * @param L the layer.
+ * @param Y output of batch*out_features elements.
+ * @param X inputs of batch*in_features elements.
+ * @param batch number of samples.
+ */
+void NxDense_forward_f64(NxDense* L, f64* Y, const f64* X, u64 batch) {
+	NxASSERT(L->initialized);
+	u64 in = L->in_features, out = L->out_features, i, j;
+	NxLOOP(i, batch) {
+		NxLOOP(j, out) {
+			Y[i*out + j] = NxTensor_AT(&(L->bias), j, 0);
+		}
+	}
+	NxBackend_get()->dgemm(batch, out, in, 1.0, X, (i64)in, 1, L->weights.data, L->weights.cs, L->weights.rs,
+	                       1.0, Y, (i64)out, 1);
+	NxDense_activate(Y, batch*out, L->act);
+}
+
+/**
+ * @brief Backward pass of a Dense layer between row-major f64 buffers.
+ *
+ * dY is overwritten with `dZ = dY * act'(Z)`, then `dW = dZ^T*X`, `db`
+ * gets the column sums of dZ and `dX = dZ*W`. Nothing is allocated.
+ *
+ * @param L the layer.
+ * @param dX gradient of the inputs, batch*in_features elements, NULL to skip it.
+ * @param dW gradient of the weights, out_features*in_features elements.
+ * @param db gradient of the bias, out_features elements.
+ * @param dY gradient of the outputs, batch*out_features elements (overwritten).
+ * @param X the inputs given to NxDense_forward_f64().
+ * @param Y the outputs written by NxDense_forward_f64().
+ * @param batch number of samples.
+ */
+void NxDense_backward_f64(NxDense* L, f64* dX, f64* dW, f64* db, f64* dY, const f64* X, const f64* Y, u64 batch) {
+	NxASSERT(L->initialized);
+	const NxBackend* E = NxBackend_get();
+	u64 in = L->in_features, out = L->out_features, i, j;
+	NxDense_activate_grad(dY, dY, Y, batch*out, L->act);
+	E->dgemm(out, in, batch, 1.0, dY, 1, (i64)out, X, (i64)in, 1, 0.0, dW, (i64)in, 1);
+	memset(db, 0, out*sizeof (f64));
+	NxLOOP(i, batch) {
+		NxLOOP(j, out) {
+			db[j] += dY[i*out + j];
+		}
+	}
+	if(dX != NULL) {
+		E->dgemm(batch, in, out, 1.0, dY, (i64)out, 1, L->weights.data, L->weights.rs, L->weights.cs,
+		         0.0, dX, (i64)in, 1);
+	}
+}
+
 void NxDense_to_string(NxDense* L) {
 	NxTensor_to_string(&(L->weights));
 	NxTensor_to_string(&(L->bias));
 }
 
+/**
+ * @brief Read a layer written by NxDense_write().
+ *
+ * The weights and the bias are parsed in one pass with NxText_parse_f64s().
+ */
 void NxDense_read(NxDense* L, str fname) {
-	FILE* fptr = fopen(fname, READ_MODE);
-	u64 in_features, out_features;
-	NxActivation act;
-	if(fptr == NULL) {
+	NxStorage* S = NxText_load(fname);
+	u64 header[3];
+	if(S == NULL) {
 		return ;
 	}
-	fscanf(fptr, "%I64u %I64u %u", &in_features, &out_features, &act);
-	NxDense_alloc(L, in_features, out_features, act);
-	for(u64 i=0; i<L->in_features; i++) {
-		for(u64 j=0; j<L->out_features; j++) {
-			fscanf(fptr, "%lf", &(L->weights.data[L->in_features*i + j]));
-		}
+	const char* text = S->data;
+	const char* end = text + S->bytes;
+	const char* p = NxText_parse_u64s(text, end, 3, header);
+	if(p == NULL) {
+		NxStorage_release(S);
+		return ;
 	}
-	for(u64 j=0; j<L->out_features; j++) {
-		fscanf(fptr, "%lf", &(L->bias.data[j]));
+	u64 in_features = header[0], out_features = header[1];
+	NxDense_alloc(L, in_features, out_features, (NxActivation)header[2]);
+	f64* values = malloc((in_features*out_features + out_features)*sizeof(f64));
+	NxASSERT(values != NULL);
+	if(NxText_parse_f64s(p, (u64)(end - p), in_features*out_features + out_features, values)) {
+		memcpy(L->weights.data, values, in_features*out_features*sizeof(f64));
+		memcpy(L->bias.data, values + in_features*out_features, out_features*sizeof(f64));
 	}
-	fclose(fptr);
+	free(values);
+	NxStorage_release(S);
 }
 
 void NxDense_read_binary(NxDense* L, str fname) {
@@ -79,26 +309,36 @@ void NxDense_read_binary(NxDense* L, str fname) {
 	fclose(fptr);
 }
 
+/**
+ * @brief Write a layer as text, read back by NxDense_read().
+ *
+ * The parameters are written in their logical order through their
+ * strides, non-f64 parameters are widened to f64 first.
+ */
 void NxDense_write(NxDense* L, str fname) {
 	FILE* fptr = fopen(fname, WRITE_MODE);
 
 	if(fptr == NULL) {
 		return ;
 	}
-	fprintf(fptr, "%I64u %I64u %u\n", L->in_features, L->out_features, L->act);
-	for(u64 i=0; i<L->in_features; i++) {
-		for(u64 j=0; j<L->out_features; j++) {
-			fprintf(fptr, "%.3e ", L->weights.data[L->in_features*i + j]);
-		}
-		fprintf(fptr, "\n");
+	NxTensor TW = {0}, TB = {0};
+	NxTensor* W = &(L->weights);
+	NxTensor* B = &(L->bias);
+	if(W->dtype != NxFLOAT64) {
+		NxTensor_astype(&TW, W, NxFLOAT64);
+		W = &TW;
 	}
-	fprintf(fptr, "\n");
-	
-	for(u64 j=0; j<L->out_features; j++) {
-		fprintf(fptr, "%.3e ", L->bias.data[j]);
+	if(B->dtype != NxFLOAT64) {
+		NxTensor_astype(&TB, B, NxFLOAT64);
+		B = &TB;
 	}
+	fprintf(fptr, "%" PRIu64 " %" PRIu64 " %u\n", L->in_features, L->out_features, L->act);
+	NxText_write_f64s(fptr, W->m, W->n, W->data, W->rs, W->cs);
 	fprintf(fptr, "\n");
+	NxText_write_f64s(fptr, 1, L->out_features, B->data, 0, B->rs);
 	fclose(fptr);
+	NxTensor_free(&TW);
+	NxTensor_free(&TB);
 }
 
 void NxDense_write_binary(NxDense* L, str fname) {
@@ -110,8 +350,8 @@ void NxDense_write_binary(NxDense* L, str fname) {
 	fwrite(&(L->in_features), sizeof (u64), 1, fptr);
 	fwrite(&(L->out_features), sizeof (u64), 1, fptr);
 	fwrite(&(L->act), sizeof (NxActivation), 1, fptr);
-	fwrite(&(L->weights.data[0]), sizeof (u64), L->in_features*L->out_features, fptr);
-	fwrite(&(L->bias.data[0]), sizeof (u64), L->out_features, fptr);
+	fwrite(&(L->weights.data[0]), sizeof (f64), L->in_features*L->out_features, fptr);
+	fwrite(&(L->bias.data[0]), sizeof (f64), L->out_features, fptr);
 	fclose(fptr);
 }
 
@@ -123,6 +363,272 @@ void NxDense_free(NxDense* L) {
 	L->out_features = 0;
 }
 
+/**
+ * @brief Round v to int8 in [-127, 127].
+ */
+static inline i8 NxDenseQ8_round(f32 v) {
+	f32 q = nearbyintf(v);
+	return (i8)(q > 127.0f ? 127.0f : q < -127.0f ? -127.0f : q);
+}
+
+/**
+ * @brief Element (i, j) of a f64 or f32 matrix.
+ */
+static inline f32 NxDenseQ8_input(NxTensor* X, u64 i, u64 j) {
+	i64 at = (i64)i*X->rs + (i64)j*X->cs;
+	return X->dtype == NxFLOAT32 ? X->data_f32[at] : (f32)X->data[at];
+}
+
+/**
+ * @brief Check that X is a (batch, in_features) f64 or f32 matrix.
+ */
+static void NxDenseQ8_check_input(NxDenseQ8* Q, NxTensor* X) {
+	NxASSERT(Q->initialized && X->allocated);
+	if(X->ndim != 2 || X->n != Q->in_features) {
+		fprintf(stderr, "Cannot apply a Dense layer of %" PRIu64 " inputs to a tensor of %" PRIu64 " columns.\n",
+		        Q->in_features, X->ndim == 2 ? X->n : 0);
+		exit(EXIT_FAILURE);
+	}
+	if(X->dtype != NxFLOAT64 && X->dtype != NxFLOAT32) {
+		fprintf(stderr, "Cannot quantize a tensor of dtype %s.\n", NxDType_name(X->dtype));
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * @brief Largest absolute value of a f64 or f32 matrix.
+ */
+static f32 NxDenseQ8_max_abs(NxTensor* X) {
+	f32 m = 0.0f;
+	u64 i, j;
+	NxLOOP(i, X->m) {
+		NxLOOP(j, X->n) {
+			f32 v = fabsf(NxDenseQ8_input(X, i, j));
+			m = v > m ? v : m;
+		}
+	}
+	return m;
+}
+
+/**
+ * @brief Allocate the buffers of a quantized layer.
+ *
+ * The buffers of a layer that was already initialized are freed first.
+ */
+static void NxDenseQ8_alloc(NxDenseQ8* Q, u64 in_features, u64 out_features, NxActivation act) {
+	u64 packed = NxGemm_q8_packed_size(out_features, in_features);
+	NxDenseQ8_free(Q);
+	Q->in_features = in_features;
+	Q->out_features = out_features;
+	Q->act = act;
+	Q->initialized = true;
+	Q->input_scale = 0.0f;
+	Q->weights = malloc(out_features*in_features + 1);
+	Q->packed = aligned_alloc(64, (packed + 63) / 64 * 64);
+	Q->scales = malloc((out_features ? out_features : 1)*sizeof(f32));
+	Q->bias = malloc((out_features ? out_features : 1)*sizeof(f32));
+	NxASSERT(Q->weights != NULL && Q->packed != NULL && Q->scales != NULL && Q->bias != NULL);
+}
+
+/**
+ * @brief Quantize the weights of a trained Dense layer to int8.
+ *
+ * Every output channel j gets the scale `max|W[j, :]|/127`, so the
+ * largest weight of the channel maps to 127 and the rounding error stays
+ * below half a step of that channel. The input scale is reset to dynamic,
+ * see NxDenseQ8_calibrate().
+ *
+ * @param Q the quantized layer to initialize, zeroed or quantized before
+ *        (its previous buffers are freed).
+ * @param L the trained layer, weights of shape (out_features, in_features).
+ */
+void NxDenseQ8_quantize(NxDenseQ8* Q, NxDense* L) {
+	NxASSERT(L->initialized);
+	if(L->weights.dtype != NxFLOAT64) {
+		fprintf(stderr, "Cannot quantize a Dense layer of dtype %s.\n", NxDType_name(L->weights.dtype));
+		exit(EXIT_FAILURE);
+	}
+	u64 in = L->in_features, out = L->out_features, i, j;
+	NxDenseQ8_alloc(Q, in, out, L->act);
+	NxLOOP(j, out) {
+		f64 m = 0.0;
+		NxLOOP(i, in) {
+			f64 v = fabs(NxTensor_AT(&(L->weights), j, i));
+			m = v > m ? v : m;
+		}
+		Q->scales[j] = (f32)(m / 127.0);
+		NxLOOP(i, in) {
+			Q->weights[j*in + i] = m > 0.0 ? NxDenseQ8_round((f32)(NxTensor_AT(&(L->weights), j, i) / m * 127.0)) : 0;
+		}
+		Q->bias[j] = (f32)NxTensor_AT(&(L->bias), j, 0);
+	}
+	NxGemm_q8_pack(Q->packed, Q->weights, (i64)in, out, in);
+}
+
+/**
+ * @brief Fix the scale of the inputs from a representative batch.
+ *
+ * Keeps the largest absolute input seen over the calls, so the layer can
+ * be calibrated on several batches. A calibrated layer saves the scan of
+ * every batch and is required by NxDenseQ8_forward_q8().
+ *
+ * @param Q the quantized layer.
+ * @param X batch of inputs of shape (batch, in_features).
+ */
+void NxDenseQ8_calibrate(NxDenseQ8* Q, NxTensor* X) {
+	NxDenseQ8_check_input(Q, X);
+	f32 scale = NxDenseQ8_max_abs(X) / 127.0f;
+	Q->input_scale = scale > Q->input_scale ? scale : Q->input_scale;
+}
+
+/**
+ * @brief Forward a batch through the quantized layer: `Y = act(X*W^T + bias)`.
+ *
+ * X is rounded to int8, multiplied with the int8 weights by NxGemm_q8()
+ * and the epilogue writes Y in the dtype of X.
+ *
+ * @param Q the quantized layer.
+ * @param Y output of shape (batch, out_features).
+ * @param X inputs of shape (batch, in_features), f64 or f32.
+ */
+void NxDenseQ8_forward(NxDenseQ8* Q, NxTensor* Y, NxTensor* X) {
+	NxDenseQ8_check_input(Q, X);
+	u64 batch = X->m, in = Q->in_features, out = Q->out_features, i, j;
+	f32 scale = Q->input_scale > 0.0f ? Q->input_scale : NxDenseQ8_max_abs(X) / 127.0f;
+	f32 inv = scale > 0.0f ? 1.0f / scale : 0.0f;
+	i8* x = malloc(batch*in + 1);
+	f32* scales = malloc((out ? out : 1)*sizeof(f32));
+	NxASSERT(x != NULL && scales != NULL);
+	NxLOOP(i, batch) {
+		NxLOOP(j, in) {
+			x[i*in + j] = NxDenseQ8_round(NxDenseQ8_input(X, i, j)*inv);
+		}
+	}
+	NxLOOP(j, out) {
+		scales[j] = scale*Q->scales[j];
+	}
+
+	u64 shape[2] = {batch, out};
+	NxDType dtype = X->dtype;
+	NxTensor_alloc_nd(Y, 2, shape, dtype);
+	NxGemmQ8Epilogue E = {
+		.scales = scales, .bias = Q->bias, .act = Q->act,
+		.alpha = Q->act == NxActivation_ELU ? NxELU_ALPHA : NxPRELU_SLOPE,
+		.output = dtype == NxFLOAT32 ? NxGEMM_Q8_F32 : NxGEMM_Q8_F64,
+		.C = Y->raw, .rsc = (i64)out,
+	};
+	NxGemm_q8(batch, out, in, x, (i64)in, Q->packed, &E);
+	free(scales);
+	free(x);
+}
+
+/**
+ * @brief Forward int8 inputs to int8 outputs, for a chain of quantized layers.
+ *
+ * The epilogue requantizes the outputs with `y_scale`, which is the
+ * `input_scale` of the next layer, so no f32 activations are written
+ * between the layers.
+ *
+ * @param Q the quantized layer, calibrated (its `input_scale` is the scale of X).
+ * @param Y output of batch*out_features int8.
+ * @param y_scale scale of the outputs.
+ * @param X inputs of batch*in_features int8, row-major.
+ * @param batch number of samples.
+ */
+void NxDenseQ8_forward_q8(NxDenseQ8* Q, i8* Y, f32 y_scale, const i8* X, u64 batch) {
+	NxASSERT(Q->initialized && Q->input_scale > 0.0f && y_scale > 0.0f);
+	u64 out = Q->out_features, j;
+	f32* scales = malloc((out ? out : 1)*sizeof(f32));
+	NxASSERT(scales != NULL);
+	NxLOOP(j, out) {
+		scales[j] = Q->input_scale*Q->scales[j];
+	}
+	NxGemmQ8Epilogue E = {
+		.scales = scales, .bias = Q->bias, .act = Q->act,
+		.alpha = Q->act == NxActivation_ELU ? NxELU_ALPHA : NxPRELU_SLOPE,
+		.output = NxGEMM_Q8_S8, .out_scale = y_scale,
+		.C = Y, .rsc = (i64)out,
+	};
+	NxGemm_q8(batch, out, Q->in_features, X, (i64)Q->in_features, Q->packed, &E);
+	free(scales);
+}
+
+/**
+ * @brief Read a quantized layer written by NxDenseQ8_write_binary().
+ *
+ * A file of NxDense_write_binary() is read as well and quantized on the
+ * fly, so f64 checkpoints load straight into the int8 path.
+ */
+void NxDenseQ8_read_binary(NxDenseQ8* Q, str fname) {
+	FILE* fptr = fopen(fname, READ_BINARY_MODE);
+	char magic[8];
+	u64 in_features, out_features;
+	NxActivation act;
+	if(fptr == NULL) {
+		return ;
+	}
+	if(fread(magic, sizeof (magic), 1, fptr) != 1 || memcmp(magic, NxDENSE_Q8_MAGIC, sizeof (magic)) != 0) {
+		NxDense L = {0};
+		fclose(fptr);
+		NxDense_read_binary(&L, fname);
+		if(L.initialized) {
+			NxDenseQ8_quantize(Q, &L);
+			NxDense_free(&L);
+		}
+		return ;
+	}
+	fread(&in_features, sizeof (u64), 1, fptr);
+	fread(&out_features, sizeof (u64), 1, fptr);
+	fread(&act, sizeof (NxActivation), 1, fptr);
+	NxDenseQ8_alloc(Q, in_features, out_features, act);
+	fread(&(Q->input_scale), sizeof (f32), 1, fptr);
+	fread(Q->scales, sizeof (f32), out_features, fptr);
+	fread(Q->bias, sizeof (f32), out_features, fptr);
+	fread(Q->weights, sizeof (i8), in_features*out_features, fptr);
+	fclose(fptr);
+	NxGemm_q8_pack(Q->packed, Q->weights, (i64)in_features, out_features, in_features);
+}
+
+/**
+ * @brief Write a quantized layer to binary file.
+ *
+ * The file holds NxDENSE_Q8_MAGIC, the sizes and the activation like
+ * NxDense_write_binary(), the input scale, the f32 scales and bias then
+ * the int8 weights row by row (unpacked, the packing is redone on read).
+ */
+void NxDenseQ8_write_binary(NxDenseQ8* Q, str fname) {
+	FILE* fptr = fopen(fname, WRITE_BINARY_MODE);
+
+	if(fptr == NULL) {
+		return ;
+	}
+	fwrite(NxDENSE_Q8_MAGIC, 1, 8, fptr);
+	fwrite(&(Q->in_features), sizeof (u64), 1, fptr);
+	fwrite(&(Q->out_features), sizeof (u64), 1, fptr);
+	fwrite(&(Q->act), sizeof (NxActivation), 1, fptr);
+	fwrite(&(Q->input_scale), sizeof (f32), 1, fptr);
+	fwrite(Q->scales, sizeof (f32), Q->out_features, fptr);
+	fwrite(Q->bias, sizeof (f32), Q->out_features, fptr);
+	fwrite(Q->weights, sizeof (i8), Q->in_features*Q->out_features, fptr);
+	fclose(fptr);
+}
+
+void NxDenseQ8_free(NxDenseQ8* Q) {
+	if(Q->initialized) {
+		free(Q->weights);
+		free(Q->packed);
+		free(Q->scales);
+		free(Q->bias);
+	}
+	Q->weights = NULL;
+	Q->packed = NULL;
+	Q->scales = NULL;
+	Q->bias = NULL;
+	Q->initialized = false;
+	Q->in_features = 0;
+	Q->out_features = 0;
+}
+
 /****************************************************************************
  * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
  *                                                                          *
@@ -1,4 +1,5 @@
 #include "NxLosses.h"
+#include "NxExpr.h"
 
 
 #include <stdio.h>
@@ -6,14 +7,10 @@
 
 
 f64 NxLoss_mean_squared_error(NxTensor* y_true, NxTensor* y_pred) {
-    f64 loss = 0.0;
-    NxTensor D;
-    NxTensor_sub_tensor(&D, y_true, y_pred);
-    NxTensor_pow_(&D, 2);
-    NxTensor_mul_scalar_(&D, 0.5f/NxTensor_size(&D));
-    loss = NxTensor_sum(&D);
-    NxTensor_free(&D);
-    return loss;
+    NxExpr E;
+    NxExpr_init(&E);
+    u32 d = NxExpr_sub(&E, NxExpr_tensor(&E, y_true), NxExpr_tensor(&E, y_pred));
+    return 0.5*NxExpr_mean(&E, NxExpr_square(&E, d));
 }
 
 f64 NxLoss_mse(NxTensor* y_true, NxTensor* y_pred) {
@@ -21,14 +18,10 @@ f64 NxLoss_mse(NxTensor* y_true, NxTensor* y_pred) {
 }
 
 f64 NxLoss_mean_absolute_error(NxTensor* y_true, NxTensor* y_pred) {
-    f64 loss = 0.0;
-    NxTensor D;
-    NxTensor_sub_tensor(&D, y_true, y_pred);
-    NxTensor_abs_(&D);
-    NxTensor_mul_scalar_(&D, 0.5f/NxTensor_size(&D));
-    loss = NxTensor_sum(&D);
-    NxTensor_free(&D);
-    return loss;
+    NxExpr E;
+    NxExpr_init(&E);
+    u32 d = NxExpr_sub(&E, NxExpr_tensor(&E, y_true), NxExpr_tensor(&E, y_pred));
+    return 0.5*NxExpr_mean(&E, NxExpr_abs(&E, d));
 }
 
 f64 NxLoss_mae(NxTensor* y_true, NxTensor* y_pred) {
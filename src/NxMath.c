@@ -0,0 +1,363 @@
+#include "NxMath.h"
+#include "NxKernels.h"
+
+#include <math.h>
+#include <float.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NxMATH_X86
+#endif
+
+/**
+ * @brief Table of the vectorized math kernels of one instruction set.
+ */
+typedef struct NxMathKernels {
+    const char* isa;
+    void (*exp)     (u64 n, const f64* a, f64* c, bool fast);
+    void (*log)     (u64 n, const f64* a, f64* c, bool fast);
+    void (*log10)   (u64 n, const f64* a, f64* c, bool fast);
+    void (*tanh)    (u64 n, const f64* a, f64* c, bool fast);
+    void (*sigmoid) (u64 n, const f64* a, f64* c, bool fast);
+    void (*sin)     (u64 n, const f64* a, f64* c, bool fast);
+    void (*cos)     (u64 n, const f64* a, f64* c, bool fast);
+} NxMathKernels;
+
+/// Scalar sigmoid used for the lanes outside the range of the vector code.
+static f64 NxMath_sigmoid_scalar(f64 x) {
+    return x >= 0 ? 1.0 / (1.0 + exp(-x)) : exp(x) / (1.0 + exp(x));
+}
+
+static inline u64 NxMath_asi(f64 x) {
+    u64 i;
+    memcpy(&i, &x, sizeof(i));
+    return i;
+}
+
+static inline f64 NxMath_asd(u64 i) {
+    f64 x;
+    memcpy(&x, &i, sizeof(x));
+    return x;
+}
+
+/* Portable kernels, one element per iteration. */
+#define NxM_ISA          "generic"
+#define NxM_FN(name)     NxMath_##name##_generic
+#define NxM_VEC          f64
+#define NxM_IVEC         u64
+#define NxM_MASK         int
+#define NxM_W            1
+#define NxM_LOAD(p)      (*(p))
+#define NxM_STORE(p, v)  (*(p) = (v))
+#define NxM_SET1(s)      ((f64)(s))
+#define NxM_ADD(x, y)    ((x) + (y))
+#define NxM_SUB(x, y)    ((x) - (y))
+#define NxM_MUL(x, y)    ((x) * (y))
+#define NxM_DIV(x, y)    ((x) / (y))
+#define NxM_FMA(a, b, c) ((a) * (b) + (c))
+#define NxM_MIN(x, y)    ((x) < (y) ? (x) : (y))
+#define NxM_MAX(x, y)    ((x) > (y) ? (x) : (y))
+#define NxM_ASI(x)       NxMath_asi(x)
+#define NxM_ASD(i)       NxMath_asd(i)
+#define NxM_ISET1(c)     ((u64)(c))
+#define NxM_IADD(x, y)   ((x) + (y))
+#define NxM_ISUB(x, y)   ((x) - (y))
+#define NxM_IAND(x, y)   ((x) & (y))
+#define NxM_IOR(x, y)    ((x) | (y))
+#define NxM_IXOR(x, y)   ((x) ^ (y))
+#define NxM_ISLL(x, n)   ((x) << (n))
+#define NxM_ISRL(x, n)   ((x) >> (n))
+#define NxM_LT(x, y)     ((x) < (y))
+#define NxM_OUTSIDE(x, l, h) (!((x) >= (l) && (x) <= (h)))
+#define NxM_SEL(m, a, b) ((m) ? (a) : (b))
+#define NxM_BITS(m)      (m)
+#define NxM_BIT0(i)      ((int)((i) & 1))
+#include "NxMath.inc"
+
+#ifdef NxMATH_X86
+
+/* SSE2 kernels, two lanes. */
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#define NxM_ISA          "sse2"
+#define NxM_FN(name)     NxMath_##name##_sse2
+#define NxM_VEC          __m128d
+#define NxM_IVEC         __m128i
+#define NxM_MASK         __m128d
+#define NxM_W            2
+#define NxM_LOAD(p)      _mm_loadu_pd(p)
+#define NxM_STORE(p, v)  _mm_storeu_pd(p, v)
+#define NxM_SET1(s)      _mm_set1_pd(s)
+#define NxM_ADD(x, y)    _mm_add_pd(x, y)
+#define NxM_SUB(x, y)    _mm_sub_pd(x, y)
+#define NxM_MUL(x, y)    _mm_mul_pd(x, y)
+#define NxM_DIV(x, y)    _mm_div_pd(x, y)
+#define NxM_FMA(a, b, c) _mm_add_pd(_mm_mul_pd(a, b), c)
+#define NxM_MIN(x, y)    _mm_min_pd(x, y)
+#define NxM_MAX(x, y)    _mm_max_pd(x, y)
+#define NxM_ASI(x)       _mm_castpd_si128(x)
+#define NxM_ASD(i)       _mm_castsi128_pd(i)
+#define NxM_ISET1(c)     _mm_set1_epi64x((i64)(c))
+#define NxM_IADD(x, y)   _mm_add_epi64(x, y)
+#define NxM_ISUB(x, y)   _mm_sub_epi64(x, y)
+#define NxM_IAND(x, y)   _mm_and_si128(x, y)
+#define NxM_IOR(x, y)    _mm_or_si128(x, y)
+#define NxM_IXOR(x, y)   _mm_xor_si128(x, y)
+#define NxM_ISLL(x, n)   _mm_slli_epi64(x, n)
+#define NxM_ISRL(x, n)   _mm_srli_epi64(x, n)
+#define NxM_LT(x, y)     _mm_cmplt_pd(x, y)
+#define NxM_OUTSIDE(x, l, h) _mm_or_pd(_mm_cmpnge_pd(x, _mm_set1_pd(l)), \
+                                       _mm_cmpnle_pd(x, _mm_set1_pd(h)))
+#define NxM_SEL(m, a, b) _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b))
+#define NxM_BITS(m)      _mm_movemask_pd(m)
+#define NxM_BIT0(i)      _mm_castsi128_pd(_mm_sub_epi64(_mm_setzero_si128(), \
+                                          _mm_and_si128(i, _mm_set1_epi64x(1))))
+#include "NxMath.inc"
+#pragma GCC pop_options
+
+/* AVX2/FMA kernels, four lanes. */
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#define NxM_ISA          "avx2"
+#define NxM_FN(name)     NxMath_##name##_avx2
+#define NxM_VEC          __m256d
+#define NxM_IVEC         __m256i
+#define NxM_MASK         __m256d
+#define NxM_W            4
+#define NxM_LOAD(p)      _mm256_loadu_pd(p)
+#define NxM_STORE(p, v)  _mm256_storeu_pd(p, v)
+#define NxM_SET1(s)      _mm256_set1_pd(s)
+#define NxM_ADD(x, y)    _mm256_add_pd(x, y)
+#define NxM_SUB(x, y)    _mm256_sub_pd(x, y)
+#define NxM_MUL(x, y)    _mm256_mul_pd(x, y)
+#define NxM_DIV(x, y)    _mm256_div_pd(x, y)
+#define NxM_FMA(a, b, c) _mm256_fmadd_pd(a, b, c)
+#define NxM_MIN(x, y)    _mm256_min_pd(x, y)
+#define NxM_MAX(x, y)    _mm256_max_pd(x, y)
+#define NxM_ASI(x)       _mm256_castpd_si256(x)
+#define NxM_ASD(i)       _mm256_castsi256_pd(i)
+#define NxM_ISET1(c)     _mm256_set1_epi64x((i64)(c))
+#define NxM_IADD(x, y)   _mm256_add_epi64(x, y)
+#define NxM_ISUB(x, y)   _mm256_sub_epi64(x, y)
+#define NxM_IAND(x, y)   _mm256_and_si256(x, y)
+#define NxM_IOR(x, y)    _mm256_or_si256(x, y)
+#define NxM_IXOR(x, y)   _mm256_xor_si256(x, y)
+#define NxM_ISLL(x, n)   _mm256_slli_epi64(x, n)
+#define NxM_ISRL(x, n)   _mm256_srli_epi64(x, n)
+#define NxM_LT(x, y)     _mm256_cmp_pd(x, y, _CMP_LT_OQ)
+#define NxM_OUTSIDE(x, l, h) _mm256_or_pd(_mm256_cmp_pd(x, _mm256_set1_pd(l), _CMP_NGE_UQ), \
+                                          _mm256_cmp_pd(x, _mm256_set1_pd(h), _CMP_NLE_UQ))
+#define NxM_SEL(m, a, b) _mm256_blendv_pd(b, a, m)
+#define NxM_BITS(m)      _mm256_movemask_pd(m)
+#define NxM_BIT0(i)      _mm256_castsi256_pd(_mm256_sub_epi64(_mm256_setzero_si256(), \
+                                             _mm256_and_si256(i, _mm256_set1_epi64x(1))))
+#include "NxMath.inc"
+#pragma GCC pop_options
+
+/* AVX-512 kernels, eight lanes. */
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#define NxM_ISA          "avx512"
+#define NxM_FN(name)     NxMath_##name##_avx512
+#define NxM_VEC          __m512d
+#define NxM_IVEC         __m512i
+#define NxM_MASK         __mmask8
+#define NxM_W            8
+#define NxM_LOAD(p)      _mm512_loadu_pd(p)
+#define NxM_STORE(p, v)  _mm512_storeu_pd(p, v)
+#define NxM_SET1(s)      _mm512_set1_pd(s)
+#define NxM_ADD(x, y)    _mm512_add_pd(x, y)
+#define NxM_SUB(x, y)    _mm512_sub_pd(x, y)
+#define NxM_MUL(x, y)    _mm512_mul_pd(x, y)
+#define NxM_DIV(x, y)    _mm512_div_pd(x, y)
+#define NxM_FMA(a, b, c) _mm512_fmadd_pd(a, b, c)
+#define NxM_MIN(x, y)    _mm512_min_pd(x, y)
+#define NxM_MAX(x, y)    _mm512_max_pd(x, y)
+#define NxM_ASI(x)       _mm512_castpd_si512(x)
+#define NxM_ASD(i)       _mm512_castsi512_pd(i)
+#define NxM_ISET1(c)     _mm512_set1_epi64((i64)(c))
+#define NxM_IADD(x, y)   _mm512_add_epi64(x, y)
+#define NxM_ISUB(x, y)   _mm512_sub_epi64(x, y)
+#define NxM_IAND(x, y)   _mm512_and_si512(x, y)
+#define NxM_IOR(x, y)    _mm512_or_si512(x, y)
+#define NxM_IXOR(x, y)   _mm512_xor_si512(x, y)
+#define NxM_ISLL(x, n)   _mm512_slli_epi64(x, n)
+#define NxM_ISRL(x, n)   _mm512_srli_epi64(x, n)
+#define NxM_LT(x, y)     _mm512_cmp_pd_mask(x, y, _CMP_LT_OQ)
+#define NxM_OUTSIDE(x, l, h) (_mm512_cmp_pd_mask(x, _mm512_set1_pd(l), _CMP_NGE_UQ) | \
+                              _mm512_cmp_pd_mask(x, _mm512_set1_pd(h), _CMP_NLE_UQ))
+#define NxM_SEL(m, a, b) _mm512_mask_blend_pd(m, b, a)
+#define NxM_BITS(m)      ((int)(m))
+#define NxM_BIT0(i)      _mm512_test_epi64_mask(i, _mm512_set1_epi64(1))
+#include "NxMath.inc"
+#pragma GCC pop_options
+
+#endif /* NxMATH_X86 */
+
+static const NxMathKernels* NxMath_active = &NxMath_table_generic;
+static NxMathMode NxMath_mode = NxMATH_ACCURATE;
+
+/**
+ * @brief Force the instruction set of the math kernels.
+ *
+ * @param isa one of `"generic"`, `"sse2"`, `"avx2"`, `"avx512"`, or
+ *            `NULL` to pick the widest set supported by the CPU.
+ *
+ * @return true if the requested set is the active one.
+ *
+ * @see NxKernels_select()
+ */
+bool NxMath_select(str isa) {
+    bool any = isa == NULL || isa[0] == '\0';
+    NxMath_active = &NxMath_table_generic;
+    if(!any && strcmp(isa, "generic") == 0) {
+        return true;
+    }
+#ifdef NxMATH_X86
+    __builtin_cpu_init();
+    if((any || strcmp(isa, "avx512") == 0) && __builtin_cpu_supports("avx512f")) {
+        NxMath_active = &NxMath_table_avx512;
+        return true;
+    }
+    if((any || strcmp(isa, "avx2") == 0) && __builtin_cpu_supports("avx2")
+            && __builtin_cpu_supports("fma")) {
+        NxMath_active = &NxMath_table_avx2;
+        return true;
+    }
+    if((any || strcmp(isa, "sse2") == 0) && __builtin_cpu_supports("sse2")) {
+        NxMath_active = &NxMath_table_sse2;
+        return true;
+    }
+#endif
+    return any;
+}
+
+/**
+ * @brief Pick the math kernels when the library is loaded.
+ */
+__attribute__((constructor))
+static void NxMath_init(void) {
+    NxMath_select(getenv(NxKERNELS_ENV));
+}
+
+/**
+ * @brief Return the name of the instruction set of the active kernels.
+ */
+const char* NxMath_isa(void) {
+    return NxMath_active->isa;
+}
+
+/**
+ * @brief Select the accuracy of the math functions.
+ *
+ * @param mode `NxMATH_ACCURATE` (default) or `NxMATH_FAST`.
+ */
+void NxMath_set_mode(NxMathMode mode) {
+    NxMath_mode = mode;
+}
+
+/**
+ * @brief Return the current accuracy mode.
+ */
+NxMathMode NxMath_get_mode(void) {
+    return NxMath_mode;
+}
+
+/**
+ * @brief Compute `c = exp(a)` over n elements.
+ *
+ * x = k*ln2 + r is reduced with a two part ln2 and e^r is a degree 13
+ * polynomial. Max error 1 ULP; fast mode uses degree 6, relative error
+ * < 2e-7.
+ * Arguments with |x| > 708, infinities and NaN go to libm.
+ */
+void NxMath_exp(u64 n, const f64* a, f64* c) {
+    NxMath_active->exp(n, a, c, NxMath_mode == NxMATH_FAST);
+}
+
+/**
+ * @brief Compute `c = log(a)` over n elements.
+ *
+ * x = 2^e * m with m in [sqrt(2)/2, sqrt(2)) and log(m) = 2*atanh(s) with
+ * the fdlibm minimax polynomial. Max error 1 ULP; fast mode keeps three
+ * terms, relative error < 1e-7. Zero, negative, subnormal and non finite
+ * arguments go to libm.
+ */
+void NxMath_log(u64 n, const f64* a, f64* c) {
+    NxMath_active->log(n, a, c, NxMath_mode == NxMATH_FAST);
+}
+
+/**
+ * @brief Compute `c = log10(a)` over n elements.
+ *
+ * Computed as log(x)/ln(10), max error 2 ULP.
+ */
+void NxMath_log10(u64 n, const f64* a, f64* c) {
+    NxMath_active->log10(n, a, c, NxMath_mode == NxMATH_FAST);
+}
+
+/**
+ * @brief Compute `c = tanh(a)` over n elements.
+ *
+ * tanh(x) = sign(x) * em/(em + 2) with em = expm1(2|x|), which keeps the
+ * relative accuracy near zero. Max error 3 ULP; fast mode relative error
+ * < 5e-7.
+ */
+void NxMath_tanh(u64 n, const f64* a, f64* c) {
+    NxMath_active->tanh(n, a, c, NxMath_mode == NxMATH_FAST);
+}
+
+/**
+ * @brief Compute the logistic function `c = 1/(1 + exp(-a))` over n elements.
+ *
+ * Evaluated from e^-|x| so it never overflows. Max error 3 ULP.
+ */
+void NxMath_sigmoid(u64 n, const f64* a, f64* c) {
+    NxMath_active->sigmoid(n, a, c, NxMath_mode == NxMATH_FAST);
+}
+
+/**
+ * @brief Compute `c = sin(a)` over n elements.
+ *
+ * Cody-Waite reduction by pi/2 with a three part constant and the fdlibm
+ * kernels on [-pi/4, pi/4]. Max error 2 ULP for |x| <= 1e5, larger or non
+ * finite arguments go to libm. Fast mode relative error < 5e-7.
+ */
+void NxMath_sin(u64 n, const f64* a, f64* c) {
+    NxMath_active->sin(n, a, c, NxMath_mode == NxMATH_FAST);
+}
+
+/**
+ * @brief Compute `c = cos(a)` over n elements.
+ *
+ * Same reduction and bounds as NxMath_sin().
+ */
+void NxMath_cos(u64 n, const f64* a, f64* c) {
+    NxMath_active->cos(n, a, c, NxMath_mode == NxMATH_FAST);
+}
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxMath.c
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,830 @@
+#define _DEFAULT_SOURCE
+
+#include "NxMemory.h"
+
+#include <stdint.h>
+#include <pthread.h>
+#include <string.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/// Arena the tensor buffers of the calling thread are allocated from.
+static _Thread_local NxArena* NxArena_current = NULL;
+
+/**
+ * @brief Allocate a region able to hold `capacity` bytes after its aligned start.
+ */
+static NxRegion* NxRegion_alloc(u64 capacity) {
+    NxRegion* R = malloc(sizeof(NxRegion) + NxARENA_ALIGN + capacity);
+    NxASSERT(R != NULL);
+    R->next = NULL;
+    R->count = 0;
+    R->capacity = capacity;
+    R->size = 0;
+    R->data = (char*)(((uintptr_t)(R + 1) + NxARENA_ALIGN - 1) & ~(uintptr_t)(NxARENA_ALIGN - 1));
+    return R;
+}
+
+/**
+ * @brief Initialize an empty arena, the first region is allocated on demand.
+ */
+void NxArena_init(NxArena* A) {
+    A->begin = NULL;
+    A->end = NULL;
+    A->current = NULL;
+}
+
+/**
+ * @brief Allocate `size` bytes aligned to NxARENA_ALIGN from the arena.
+ *
+ * The memory stays valid until the next NxArena_reset() or NxArena_free().
+ * When the current region is full the next one is used, and a new region
+ * twice as large as the last one is chained when there is none left.
+ *
+ * @param A pointer to the arena.
+ * @param size number of bytes.
+ */
+void* NxArena_alloc(NxArena* A, u64 size) {
+    size = (size + NxARENA_ALIGN - 1) & ~(u64)(NxARENA_ALIGN - 1);
+    NxRegion* R = A->current;
+    while(R != NULL && R->size + size > R->capacity) {
+        R = R->next;
+        if(R != NULL) {
+            R->size = 0;
+            R->count = 0;
+        }
+    }
+    if(R == NULL) {
+        u64 capacity = NxARENA_REGION_SIZE;
+        if(A->end != NULL) {
+            capacity = 2*A->end->capacity;
+            if(capacity > (u64)NxARENA_MAX_SIZE) {
+                capacity = NxARENA_MAX_SIZE;
+            }
+        }
+        if(capacity < size) {
+            capacity = size;
+        }
+        R = NxRegion_alloc(capacity);
+        if(A->end == NULL) {
+            A->begin = R;
+        } else {
+            A->end->next = R;
+        }
+        A->end = R;
+    }
+    A->current = R;
+    void* p = R->data + R->size;
+    R->size += size;
+    R->count++;
+    return p;
+}
+
+/**
+ * @brief Release every allocation of the arena at once.
+ *
+ * O(1): the arena goes back to its first region and the regions are kept,
+ * so a training step allocating the same tensors as the last one does not
+ * call malloc at all.
+ */
+void NxArena_reset(NxArena* A) {
+    A->current = A->begin;
+    if(A->begin != NULL) {
+        A->begin->size = 0;
+        A->begin->count = 0;
+    }
+}
+
+/**
+ * @brief Give the regions of the arena back to the system.
+ */
+void NxArena_free(NxArena* A) {
+    NxRegion* R = A->begin;
+    while(R != NULL) {
+        NxRegion* next = R->next;
+        free(R);
+        R = next;
+    }
+    if(NxArena_current == A) {
+        NxArena_current = NULL;
+    }
+    NxArena_init(A);
+}
+
+/**
+ * @brief Return the number of bytes allocated since the last reset.
+ */
+u64 NxArena_used(NxArena* A) {
+    u64 used = 0;
+    NxRegion* R;
+    for(R=A->begin; R != NULL && R != A->current; R=R->next) {
+        used += R->size;
+    }
+    return R != NULL ? used + R->size : used;
+}
+
+/**
+ * @brief Return the number of bytes held by the regions of the arena.
+ */
+u64 NxArena_capacity(NxArena* A) {
+    u64 capacity = 0;
+    NxRegion* R;
+    for(R=A->begin; R != NULL; R=R->next) {
+        capacity += R->capacity;
+    }
+    return capacity;
+}
+
+/**
+ * @brief Route the tensor allocations of the calling thread to an arena.
+ *
+ * @param A the arena, NULL to go back to malloc.
+ *
+ * @return (NxArena*) the previous current arena, to restore it later.
+ */
+NxArena* NxArena_set_current(NxArena* A) {
+    NxArena* previous = NxArena_current;
+    NxArena_current = A;
+    return previous;
+}
+
+/**
+ * @brief Return the arena the tensors of the calling thread are allocated from (NULL for malloc).
+ */
+NxArena* NxArena_get_current(void) {
+    return NxArena_current;
+}
+
+/// Size of the header in front of every NxCache buffer (keeps the buffer 64-byte aligned).
+#define NxCACHE_HEADER 64
+/// Class of the buffers too large for the size classes, always given back to the system.
+#define NxCACHE_NO_CLASS NxCACHE_CLASSES
+
+/// Header in front of every NxCache buffer.
+typedef struct NxCacheHeader {
+    struct NxCacheHeader* next; ///< next buffer of the free list.
+    u64 cls; ///< size class of the buffer.
+    u64 size; ///< usable size of the buffer.
+    u64 mapped; ///< length of the mapping of a huge page buffer, 0 for the heap.
+    NxAllocPolicy policy; ///< how the buffer was allocated.
+} NxCacheHeader;
+
+/// Free lists of one thread.
+typedef struct NxCacheLists {
+    NxCacheHeader* heads[NxCACHE_CLASSES];
+    bool registered; ///< whether the thread exit hook is set.
+    NxCacheStats stats;
+} NxCacheLists;
+
+static _Thread_local NxCacheLists NxCache_lists;
+static u64 NxCache_limit = NxCACHE_DEFAULT_LIMIT;
+static pthread_key_t NxCache_key;
+static pthread_once_t NxCache_once = PTHREAD_ONCE_INIT;
+static NxHugePages NxMemory_huge_pages = NxHUGE_PAGES_TRANSPARENT;
+static u64 NxMemory_huge_threshold = NxHUGE_PAGE_THRESHOLD;
+
+/**
+ * @brief Read the huge page mode from the environment (`none`, `thp` or `hugetlb`).
+ */
+__attribute__((constructor))
+static void NxMemory_init(void) {
+    const char* env = getenv(NxHUGE_PAGES_ENV);
+    if(env == NULL) {
+        return ;
+    }
+    if(strcmp(env, "none") == 0) {
+        NxMemory_huge_pages = NxHUGE_PAGES_NONE;
+    } else if(strcmp(env, "thp") == 0) {
+        NxMemory_huge_pages = NxHUGE_PAGES_TRANSPARENT;
+    } else if(strcmp(env, "hugetlb") == 0) {
+        NxMemory_huge_pages = NxHUGE_PAGES_EXPLICIT;
+    } else {
+        fprintf(stderr, "Unknown %s value %s, expected none, thp or hugetlb.\n", NxHUGE_PAGES_ENV, env);
+    }
+}
+
+/**
+ * @brief Choose how the buffers of at least `threshold` bytes are backed.
+ *
+ * @param mode NxHUGE_PAGES_NONE (aligned heap), NxHUGE_PAGES_TRANSPARENT
+ *             (`madvise(MADV_HUGEPAGE)`) or NxHUGE_PAGES_EXPLICIT (hugetlbfs
+ *             pages, falls back to transparent ones when none are reserved).
+ * @param threshold size in bytes from which the mode applies.
+ */
+void NxMemory_set_huge_pages(NxHugePages mode, u64 threshold) {
+    NxMemory_huge_pages = mode;
+    NxMemory_huge_threshold = threshold;
+}
+
+/**
+ * @brief Return the huge page mode of the large buffers.
+ */
+NxHugePages NxMemory_get_huge_pages(void) {
+    return NxMemory_huge_pages;
+}
+
+/**
+ * @brief Return the size from which the buffers may be backed by huge pages.
+ */
+u64 NxMemory_get_huge_threshold(void) {
+    return NxMemory_huge_threshold;
+}
+
+/**
+ * @brief Return the name of an allocation policy.
+ */
+const char* NxAllocPolicy_name(NxAllocPolicy policy) {
+    switch(policy) {
+    case NxALLOC_ALIGNED:          return "aligned";
+    case NxALLOC_TRANSPARENT_HUGE: return "thp";
+    case NxALLOC_HUGETLB:          return "hugetlb";
+    case NxALLOC_ARENA:            return "arena";
+    case NxALLOC_BORROWED:         return "borrowed";
+    case NxALLOC_MAPPED:           return "mapped";
+    default:                       return "none";
+    }
+}
+
+/**
+ * @brief Map `bytes` bytes backed by huge pages, NULL when the mode or the system does not allow it.
+ */
+static NxCacheHeader* NxMemory_map_huge(u64 bytes) {
+#ifdef __linux__
+    u64 length = (bytes + NxHUGE_PAGE_SIZE - 1) & ~(u64)(NxHUGE_PAGE_SIZE - 1);
+    if(NxMemory_huge_pages == NxHUGE_PAGES_EXPLICIT) {
+        void* p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(p != MAP_FAILED) {
+            NxCacheHeader* H = p;
+            H->mapped = length;
+            H->policy = NxALLOC_HUGETLB;
+            return H;
+        }
+    }
+    if(NxMemory_huge_pages != NxHUGE_PAGES_NONE) {
+        /* Over-map by one huge page and cut the ends so the buffer starts on a huge page. */
+        u64 total = length + NxHUGE_PAGE_SIZE;
+        char* p = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(p == MAP_FAILED) {
+            return NULL;
+        }
+        char* start = (char*)(((uintptr_t)p + NxHUGE_PAGE_SIZE - 1) & ~(uintptr_t)(NxHUGE_PAGE_SIZE - 1));
+        if(start > p) {
+            munmap(p, start - p);
+        }
+        if(start + length < p + total) {
+            munmap(start + length, p + total - (start + length));
+        }
+        madvise(start, length, MADV_HUGEPAGE);
+        NxCacheHeader* H = (NxCacheHeader*)start;
+        H->mapped = length;
+        H->policy = NxALLOC_TRANSPARENT_HUGE;
+        return H;
+    }
+#else
+    (void)bytes;
+#endif
+    return NULL;
+}
+
+/**
+ * @brief Give a buffer back to the system.
+ */
+static void NxCache_release(NxCacheHeader* H) {
+#ifdef __linux__
+    if(H->mapped != 0) {
+        munmap(H, H->mapped);
+        return ;
+    }
+#endif
+    free(H);
+}
+
+/**
+ * @brief Allocate a buffer from the system with the policy matching its size.
+ */
+static NxCacheHeader* NxCache_system_alloc(u64 bytes) {
+    NxCacheHeader* H = NULL;
+    if(bytes >= NxMemory_huge_threshold && NxMemory_huge_pages != NxHUGE_PAGES_NONE) {
+        H = NxMemory_map_huge(bytes);
+    }
+    if(H == NULL) {
+        H = aligned_alloc(NxCACHE_HEADER, bytes);
+        if(H != NULL) {
+            H->mapped = 0;
+            H->policy = NxALLOC_ALIGNED;
+        }
+    }
+    return H;
+}
+
+/**
+ * @brief Return the size class of a request and its size in bytes.
+ */
+static u64 NxCache_class(u64 size, u64* class_size) {
+    if(size <= NxCACHE_MIN_SIZE) {
+        *class_size = NxCACHE_MIN_SIZE;
+        return 0;
+    }
+    u64 k = 63 - (u64)__builtin_clzll(size - 1), step = (u64)1 << (k - 2);
+    u64 q = (size - ((u64)1 << k) + step - 1) / step;
+    u64 cls = 1 + (k - 6)*4 + (q - 1);
+    if(cls >= NxCACHE_CLASSES) {
+        *class_size = (size + NxCACHE_HEADER - 1) & ~(u64)(NxCACHE_HEADER - 1);
+        return NxCACHE_NO_CLASS;
+    }
+    *class_size = ((u64)1 << k) + q*step;
+    return cls;
+}
+
+/**
+ * @brief Give the cached buffers of a thread back when it exits.
+ */
+static void NxCache_thread_exit(void* arg) {
+    (void)arg;
+    NxCache_trim(0);
+}
+
+static void NxCache_create_key(void) {
+    pthread_key_create(&NxCache_key, NxCache_thread_exit);
+}
+
+/**
+ * @brief Allocate a 64-byte aligned buffer of at least `size` bytes.
+ *
+ * Served from the free list of its size class when the calling thread has
+ * one cached, from the system otherwise.
+ */
+void* NxCache_alloc(u64 size) {
+    NxCacheLists* L = &NxCache_lists;
+    u64 class_size, cls = NxCache_class(size, &class_size);
+    L->stats.allocs++;
+    if(cls != NxCACHE_NO_CLASS && L->heads[cls] != NULL) {
+        NxCacheHeader* H = L->heads[cls];
+        L->heads[cls] = H->next;
+        L->stats.hits++;
+        L->stats.cached_buffers--;
+        L->stats.cached_bytes -= class_size;
+        return (char*)H + NxCACHE_HEADER;
+    }
+    /* aligned_alloc() wants a multiple of the alignment. */
+    u64 bytes = NxCACHE_HEADER + ((class_size + NxCACHE_HEADER - 1) & ~(u64)(NxCACHE_HEADER - 1));
+    NxCacheHeader* H = NxCache_system_alloc(bytes);
+    if(H == NULL) {
+        /* Give the cached memory back and try once more. */
+        NxCache_trim(0);
+        H = NxCache_system_alloc(bytes);
+        if(H == NULL) {
+            return NULL;
+        }
+    }
+    H->next = NULL;
+    H->cls = cls;
+    H->size = class_size;
+    L->stats.system_allocs++;
+    return (char*)H + NxCACHE_HEADER;
+}
+
+/**
+ * @brief Return a buffer of NxCache_alloc() to the free lists of the calling thread.
+ *
+ * The buffer goes back to the system when it is too large for the size
+ * classes or when the thread already caches NxCache_get_limit() bytes.
+ */
+void NxCache_free(void* p) {
+    if(p == NULL) {
+        return ;
+    }
+    NxCacheLists* L = &NxCache_lists;
+    NxCacheHeader* H = (NxCacheHeader*)((char*)p - NxCACHE_HEADER);
+    if(H->cls == NxCACHE_NO_CLASS || L->stats.cached_bytes + H->size > NxCache_limit) {
+        NxCache_release(H);
+        L->stats.system_frees++;
+        return ;
+    }
+    if(!L->registered) {
+        pthread_once(&NxCache_once, NxCache_create_key);
+        pthread_setspecific(NxCache_key, L);
+        L->registered = true;
+    }
+    H->next = L->heads[H->cls];
+    L->heads[H->cls] = H;
+    L->stats.cached_buffers++;
+    L->stats.cached_bytes += H->size;
+}
+
+/**
+ * @brief Return how a buffer of NxCache_alloc() is backed.
+ */
+NxAllocPolicy NxCache_policy(const void* p) {
+    if(p == NULL) {
+        return NxALLOC_NONE;
+    }
+    return ((const NxCacheHeader*)((const char*)p - NxCACHE_HEADER))->policy;
+}
+
+/**
+ * @brief Set the number of bytes every thread may keep in its free lists (0 disables the cache).
+ *
+ * The threads above the new limit shrink with NxCache_trim().
+ */
+void NxCache_set_limit(u64 bytes) {
+    NxCache_limit = bytes;
+}
+
+/**
+ * @brief Return the number of bytes every thread may keep in its free lists.
+ */
+u64 NxCache_get_limit(void) {
+    return NxCache_limit;
+}
+
+/**
+ * @brief Give cached buffers of the calling thread back to the system.
+ *
+ * The largest buffers go first, until at most `keep` bytes are cached.
+ */
+void NxCache_trim(u64 keep) {
+    NxCacheLists* L = &NxCache_lists;
+    u64 cls;
+    for(cls=NxCACHE_CLASSES; cls-- > 0 && L->stats.cached_bytes > keep; ) {
+        while(L->heads[cls] != NULL && L->stats.cached_bytes > keep) {
+            NxCacheHeader* H = L->heads[cls];
+            L->heads[cls] = H->next;
+            L->stats.cached_buffers--;
+            L->stats.cached_bytes -= H->size;
+            L->stats.system_frees++;
+            NxCache_release(H);
+        }
+    }
+}
+
+/**
+ * @brief Read the counters of the calling thread.
+ */
+void NxCache_stats(NxCacheStats* S) {
+    *S = NxCache_lists.stats;
+}
+
+/**
+ * @brief Zero the event counters of the calling thread (the cached amounts are kept).
+ */
+void NxCache_reset_stats(void) {
+    NxCacheStats* S = &NxCache_lists.stats;
+    S->allocs = 0;
+    S->hits = 0;
+    S->system_allocs = 0;
+    S->system_frees = 0;
+}
+
+/// Space reserved for the NxStorage header in front of its buffer (keeps the buffer 64-byte aligned).
+#define NxSTORAGE_HEADER 64
+
+/**
+ * @brief Allocate a storage of `bytes` bytes with a count of 1.
+ *
+ * Taken from the current arena of the thread when there is one, from
+ * NxCache otherwise.
+ */
+NxStorage* NxStorage_alloc(u64 bytes) {
+    NxArena* arena = NxArena_current;
+    NxStorage* S = arena != NULL ? NxArena_alloc(arena, NxSTORAGE_HEADER + bytes)
+                                 : NxCache_alloc(NxSTORAGE_HEADER + bytes);
+    NxASSERT(S != NULL);
+    S->data = (char*)S + NxSTORAGE_HEADER;
+    S->bytes = bytes;
+    S->refcount = 1;
+    S->policy = arena != NULL ? NxALLOC_ARENA : NxCache_policy(S);
+    S->readonly = false;
+    S->map = NULL;
+    S->map_bytes = 0;
+    return S;
+}
+
+/**
+ * @brief Wrap a buffer owned by the caller in a storage with a count of 1.
+ *
+ * Releasing the storage frees the header only, never `data`.
+ */
+NxStorage* NxStorage_wrap(void* data, u64 bytes) {
+    NxStorage* S = NxCache_alloc(sizeof(NxStorage));
+    NxASSERT(S != NULL);
+    S->data = data;
+    S->bytes = bytes;
+    S->refcount = 1;
+    S->policy = NxALLOC_BORROWED;
+    S->readonly = false;
+    S->map = NULL;
+    S->map_bytes = 0;
+    return S;
+}
+
+/**
+ * @brief Map `bytes` bytes of a file from `offset` in a storage with a count of 1.
+ *
+ * The data is read by the kernel on first touch instead of being copied
+ * into the heap, so loading a large file costs no memory beyond the page
+ * cache. With NxMAP_READ_ONLY the pages are shared with the page cache
+ * and the storage is read-only (NxStorage_shared() reports it so the
+ * tensor operations write to a new buffer); NxMAP_PRIVATE maps them
+ * copy-on-write. An offset that is not page aligned is supported, the
+ * mapping starts at the page holding it.
+ *
+ * @param fname path of the file.
+ * @param offset position of the data in the file.
+ * @param bytes size of the data.
+ * @param flags combination of NxMapFlags.
+ *
+ * @return (NxStorage*) the storage, NULL when the file cannot be mapped.
+ */
+NxStorage* NxStorage_map(str fname, u64 offset, u64 bytes, u32 flags) {
+#ifdef __linux__
+    int fd = open(fname, O_RDONLY);
+    if(fd < 0) {
+        return NULL;
+    }
+    u64 page = (u64)sysconf(_SC_PAGESIZE);
+    u64 start = offset & ~(page - 1), delta = offset - start;
+    /* An empty range still maps one byte so data is a valid pointer. */
+    u64 length = delta + (bytes ? bytes : 1);
+    bool writable = flags & NxMAP_PRIVATE;
+    void* p = mmap(NULL, length, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                   writable ? MAP_PRIVATE : MAP_SHARED, fd, (off_t)start);
+    close(fd);
+    if(p == MAP_FAILED) {
+        return NULL;
+    }
+    NxStorage* S = NxCache_alloc(sizeof(NxStorage));
+    NxASSERT(S != NULL);
+    S->data = (char*)p + delta;
+    S->bytes = bytes;
+    S->refcount = 1;
+    S->policy = NxALLOC_MAPPED;
+    S->readonly = !writable;
+    S->map = p;
+    S->map_bytes = length;
+    NxStorage_advise(S, flags);
+    return S;
+#else
+    (void)fname; (void)offset; (void)bytes; (void)flags;
+    return NULL;
+#endif
+}
+
+/**
+ * @brief Tell the kernel how a mapped storage will be read.
+ *
+ * Only the access flags of NxMapFlags are used (NxMAP_SEQUENTIAL,
+ * NxMAP_RANDOM, NxMAP_WILLNEED), the hints may change during the life of
+ * the storage, e.g. sequential while checking a checksum then random.
+ * Does nothing for the storages that are not mapped.
+ */
+void NxStorage_advise(NxStorage* S, u32 flags) {
+#ifdef __linux__
+    if(S->policy != NxALLOC_MAPPED) {
+        return ;
+    }
+    if(flags & NxMAP_SEQUENTIAL) {
+        madvise(S->map, S->map_bytes, MADV_SEQUENTIAL);
+    } else if(flags & NxMAP_RANDOM) {
+        madvise(S->map, S->map_bytes, MADV_RANDOM);
+    } else {
+        madvise(S->map, S->map_bytes, MADV_NORMAL);
+    }
+    if(flags & NxMAP_WILLNEED) {
+        madvise(S->map, S->map_bytes, MADV_WILLNEED);
+    }
+#else
+    (void)S; (void)flags;
+#endif
+}
+
+/**
+ * @brief Add a reference to the storage.
+ */
+void NxStorage_retain(NxStorage* S) {
+    __atomic_add_fetch(&S->refcount, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Drop a reference, the last one frees the storage.
+ *
+ * Arena storages are counted like the others but never freed, they go
+ * away with NxArena_reset(), so they must be released before the reset.
+ */
+void NxStorage_release(NxStorage* S) {
+    if(__atomic_sub_fetch(&S->refcount, 1, __ATOMIC_ACQ_REL) == 0 && S->policy != NxALLOC_ARENA) {
+#ifdef __linux__
+        if(S->policy == NxALLOC_MAPPED) {
+            munmap(S->map, S->map_bytes);
+        }
+#endif
+        NxCache_free(S);
+    }
+}
+
+/**
+ * @brief Whether the buffer must not be written in place.
+ *
+ * True when more than one tensor points into the storage or when it is a
+ * read-only mapping, the writer then needs a buffer of its own.
+ */
+bool NxStorage_shared(const NxStorage* S) {
+    return S->readonly || __atomic_load_n(&S->refcount, __ATOMIC_ACQUIRE) > 1;
+}
+
+/**
+ * @brief Initialize an empty plan.
+ */
+void NxMemoryPlan_init(NxMemoryPlan* P) {
+    P->buffers = NULL;
+    P->n_buffers = 0;
+    P->capacity = 0;
+    P->peak = 0;
+    P->live = 0;
+    P->total = 0;
+    P->slab = NULL;
+}
+
+/**
+ * @brief Add a buffer of `bytes` bytes live from step `first` to step `last` (included).
+ *
+ * The steps are any increasing numbering of the operations using the
+ * buffers, two buffers sharing a step never share memory.
+ *
+ * @return (u64) the id of the buffer, for NxMemoryPlan_data().
+ */
+u64 NxMemoryPlan_add(NxMemoryPlan* P, u64 bytes, u64 first, u64 last) {
+    NxASSERT(first <= last);
+    if(P->n_buffers == P->capacity) {
+        u64 capacity = P->capacity ? 2*P->capacity : NxPLAN_INITIAL_CAPACITY;
+        NxPlanBuffer* buffers = realloc(P->buffers, capacity*sizeof (NxPlanBuffer));
+        NxASSERT(buffers != NULL);
+        P->buffers = buffers;
+        P->capacity = capacity;
+    }
+    NxPlanBuffer* B = &P->buffers[P->n_buffers];
+    B->bytes = bytes;
+    B->first = first;
+    B->last = last;
+    B->offset = 0;
+    return P->n_buffers++;
+}
+
+/**
+ * @brief Size a buffer takes in the slab, so every buffer starts NxARENA_ALIGN aligned.
+ */
+static inline u64 NxMemoryPlan_size(const NxPlanBuffer* B) {
+    return (B->bytes + NxARENA_ALIGN - 1) & ~(u64)(NxARENA_ALIGN - 1);
+}
+
+static inline bool NxMemoryPlan_overlap(const NxPlanBuffer* A, const NxPlanBuffer* B) {
+    return A->first <= B->last && B->first <= A->last;
+}
+
+/// Larger buffers first, the earlier one first among the same size.
+static int NxMemoryPlan_by_size(const void* a, const void* b) {
+    const NxPlanBuffer* A = *(NxPlanBuffer* const*)a;
+    const NxPlanBuffer* B = *(NxPlanBuffer* const*)b;
+    if(A->bytes != B->bytes) {
+        return A->bytes < B->bytes ? 1 : -1;
+    }
+    return A->first < B->first ? -1 : A->first > B->first;
+}
+
+/**
+ * @brief Give every buffer its offset in the slab and return the size of the slab.
+ *
+ * Greedy interval coloring by decreasing size: every buffer goes in the
+ * smallest gap left between the buffers already placed whose lifetime
+ * overlaps its own, or after the last of them. Placing the large buffers
+ * first keeps the small ones in their holes, the slab usually ends up at
+ * `live`, the bound no placement can beat.
+ *
+ * @param P the plan, with all of its buffers added.
+ *
+ * @return (u64) the planned peak memory, `peak`.
+ */
+u64 NxMemoryPlan_solve(NxMemoryPlan* P) {
+    u64 n = P->n_buffers, i, j, k;
+    P->peak = 0;
+    P->live = 0;
+    P->total = 0;
+    if(n == 0) {
+        return 0;
+    }
+    NxPlanBuffer** order = malloc(n*sizeof (NxPlanBuffer*));
+    NxPlanBuffer** placed = malloc(n*sizeof (NxPlanBuffer*));
+    NxPlanBuffer** overlaps = malloc(n*sizeof (NxPlanBuffer*));
+    NxASSERT(order != NULL && placed != NULL && overlaps != NULL);
+
+    NxLOOP(i, n) {
+        NxPlanBuffer* B = &P->buffers[i];
+        u64 live = 0;
+        /* The live bytes only grow when a buffer starts, so checking the first steps is enough. */
+        NxLOOP(j, n) {
+            if(P->buffers[j].first <= B->first && B->first <= P->buffers[j].last) {
+                live += NxMemoryPlan_size(&P->buffers[j]);
+            }
+        }
+        P->live = live > P->live ? live : P->live;
+        P->total += NxMemoryPlan_size(B);
+        order[i] = B;
+    }
+    qsort(order, n, sizeof (NxPlanBuffer*), NxMemoryPlan_by_size);
+
+    NxLOOP(i, n) {
+        NxPlanBuffer* B = order[i];
+        u64 size = NxMemoryPlan_size(B), count = 0;
+        /* The placed buffers live at the same time as B, by increasing offset. */
+        NxLOOP(j, i) {
+            if(NxMemoryPlan_overlap(placed[j], B)) {
+                k = count++;
+                while(k > 0 && overlaps[k-1]->offset > placed[j]->offset) {
+                    overlaps[k] = overlaps[k-1];
+                    k--;
+                }
+                overlaps[k] = placed[j];
+            }
+        }
+        u64 end = 0, best = 0, best_gap = (u64)-1;
+        NxLOOP(j, count) {
+            u64 gap = overlaps[j]->offset > end ? overlaps[j]->offset - end : 0;
+            if(gap >= size && gap < best_gap) {
+                best = end;
+                best_gap = gap;
+            }
+            u64 last = overlaps[j]->offset + NxMemoryPlan_size(overlaps[j]);
+            end = last > end ? last : end;
+        }
+        B->offset = best_gap != (u64)-1 ? best : end;
+        placed[i] = B;
+        P->peak = B->offset + size > P->peak ? B->offset + size : P->peak;
+    }
+    free(overlaps);
+    free(placed);
+    free(order);
+    return P->peak;
+}
+
+/**
+ * @brief Allocate the slab of a solved plan, replacing the previous one.
+ *
+ * The slab never comes from the current arena of the thread: it outlives
+ * the steps, which may reset that arena.
+ */
+void NxMemoryPlan_alloc(NxMemoryPlan* P) {
+    NxArena* arena = NxArena_current;
+    NxArena_current = NULL;
+    if(P->slab != NULL) {
+        NxStorage_release(P->slab);
+    }
+    P->slab = NxStorage_alloc(P->peak);
+    NxArena_current = arena;
+}
+
+/**
+ * @brief Return the memory of the buffer `id` in the slab.
+ */
+void* NxMemoryPlan_data(NxMemoryPlan* P, u64 id) {
+    NxASSERT(P->slab != NULL && id < P->n_buffers);
+    return (char*)P->slab->data + P->buffers[id].offset;
+}
+
+/**
+ * @brief Release the slab and the buffers of a plan, it is left empty.
+ */
+void NxMemoryPlan_free(NxMemoryPlan* P) {
+    if(P->slab != NULL) {
+        NxStorage_release(P->slab);
+    }
+    free(P->buffers);
+    NxMemoryPlan_init(P);
+}
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxMemory.c
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,275 @@
+#include "NxModels.h"
+#include "NxBackend.h"
+
+#include <string.h>
+
+
+/**
+ * @brief Initialize an empty model.
+ *
+ * @param model the model.
+ * @param name the name of the model, printed by NxModelSequential_train().
+ */
+void NxModelSequential_init(NxModelSequential* model, str name) {
+    memset(model, 0, sizeof (NxModelSequential));
+    model->name = name;
+    model->lr = NxMODEL_DEFAULT_LR;
+    model->epochs = NxMODEL_DEFAULT_EPOCHS;
+    NxMemoryPlan_init(&(model->plan));
+}
+
+/**
+ * @brief Drop the memory plan, the next training plans again.
+ */
+static void NxModelSequential_unplan(NxModelSequential* model) {
+    NxMemoryPlan_free(&(model->plan));
+    free(model->buffers);
+    model->buffers = NULL;
+    model->batch_size = 0;
+}
+
+/**
+ * @brief Free the layers and the memory plan of a model.
+ */
+void NxModelSequential_free(NxModelSequential* model) {
+    u64 l;
+    NxModelSequential_unplan(model);
+    NxLOOP(l, model->n_layers) {
+        NxDense_free(&(model->layers[l]));
+    }
+    free(model->layers);
+    model->layers = NULL;
+    model->n_layers = 0;
+    model->capacity = 0;
+}
+
+/**
+ * @brief Append a Dense layer, its inputs are the outputs of the last layer.
+ *
+ * @see NxDense_alloc().
+ */
+void NxModelSequential_append_Dense(NxModelSequential* model, u64 in_features, u64 out_features, NxActivation act) {
+    if(model->n_layers > 0 && model->layers[model->n_layers - 1].out_features != in_features) {
+        fprintf(stderr, "Cannot append a Dense layer of %" PRIu64 " inputs after a layer of %" PRIu64 " outputs.\n",
+                in_features, model->layers[model->n_layers - 1].out_features);
+        exit(EXIT_FAILURE);
+    }
+    if(model->n_layers == model->capacity) {
+        u64 capacity = model->capacity ? 2*model->capacity : NxMODEL_INITIAL_CAPACITY;
+        NxDense* layers = realloc(model->layers, capacity*sizeof (NxDense));
+        NxASSERT(layers != NULL);
+        model->layers = layers;
+        model->capacity = capacity;
+    }
+    NxDense* layer = &(model->layers[model->n_layers++]);
+    memset(layer, 0, sizeof (NxDense));
+    NxDense_alloc(layer, in_features, out_features, act);
+    NxModelSequential_unplan(model);
+}
+
+/**
+ * @brief Plan the memory of a training step for a batch size.
+ *
+ * With L layers the step is numbered forward then backward: layer l runs
+ * forward at step l and backward at step 2L - l, the loss is taken at
+ * step L. That gives the lifetime of every buffer:
+ *  - the inputs of the batch, from step 0 to the backward of layer 0,
+ *  - the outputs of layer l, from its forward to its own backward (they
+ *    give act') once the next layer has read them for its weights,
+ *  - the gradient of the outputs of layer l, from the backward of layer
+ *    l+1 (the loss for the last layer) to the backward of layer l, which
+ *    turns it into dZ in place,
+ *  - the gradients of the weights and bias of layer l, only during its
+ *    backward since the SGD update is applied right away.
+ *
+ * NxMemoryPlan_solve() then folds the gradients into the space of each
+ * other, and the slab is allocated once. The weights are not part of the
+ * plan, they live as long as the model.
+ *
+ * @param model the model, with all of its layers appended.
+ * @param batch_size number of samples of a step.
+ *
+ * @return (u64) the planned peak memory of a step in bytes.
+ */
+u64 NxModelSequential_plan(NxModelSequential* model, u64 batch_size) {
+    u64 L = model->n_layers, l;
+    if(L == 0 || batch_size == 0) {
+        fprintf(stderr, "Cannot plan a model of %" PRIu64 " layers for a batch of %" PRIu64 ".\n", L, batch_size);
+        exit(EXIT_FAILURE);
+    }
+    NxModelSequential_unplan(model);
+    model->buffers = malloc(L*sizeof (NxModelBuffers));
+    NxASSERT(model->buffers != NULL);
+
+    NxMemoryPlan* P = &(model->plan);
+    model->input = NxMemoryPlan_add(P, batch_size*model->layers[0].in_features*sizeof (f64), 0, 2*L);
+    NxLOOP(l, L) {
+        NxDense* layer = &(model->layers[l]);
+        NxModelBuffers* B = &(model->buffers[l]);
+        u64 in = layer->in_features, out = layer->out_features;
+        NxASSERT(layer->weights.dtype == NxFLOAT64 && layer->bias.dtype == NxFLOAT64);
+        NxASSERT(NxTensor_is_contiguous(&(layer->weights)) && NxTensor_is_contiguous(&(layer->bias)));
+        B->output = NxMemoryPlan_add(P, batch_size*out*sizeof (f64), l, 2*L - l);
+        B->grad = NxMemoryPlan_add(P, batch_size*out*sizeof (f64), 2*L - l - 1, 2*L - l);
+        B->dweights = NxMemoryPlan_add(P, in*out*sizeof (f64), 2*L - l, 2*L - l);
+        B->dbias = NxMemoryPlan_add(P, out*sizeof (f64), 2*L - l, 2*L - l);
+    }
+    NxMemoryPlan_solve(P);
+    NxMemoryPlan_alloc(P);
+    model->batch_size = batch_size;
+    return P->peak;
+}
+
+/**
+ * @brief Run one training step over the rows of a batch.
+ *
+ * Only reads and writes the planned buffers and the parameters.
+ *
+ * @return (f64) the sum of the squared errors of the batch.
+ */
+static f64 NxModelSequential_step(NxModelSequential* model, NxTensor* X, NxTensor* Y) {
+    const NxBackend* E = NxBackend_get();
+    NxMemoryPlan* P = &(model->plan);
+    u64 L = model->n_layers, in = model->layers[0].in_features, out = model->layers[L-1].out_features;
+    u64 rows = X->m, i, j, l;
+    f64 sum = 0.0;
+
+    f64* x = NxMemoryPlan_data(P, model->input);
+    NxLOOP(i, rows) {
+        NxLOOP(j, in) {
+            x[i*in + j] = NxTensor_AT(X, i, j);
+        }
+    }
+    const f64* a = x;
+    NxLOOP(l, L) {
+        f64* y = NxMemoryPlan_data(P, model->buffers[l].output);
+        NxDense_forward_f64(&(model->layers[l]), y, a, rows);
+        a = y;
+    }
+
+    /* d(0.5*mean((p - y)^2))/dp over the batch. */
+    f64* g = NxMemoryPlan_data(P, model->buffers[L-1].grad);
+    f64 scale = 1.0 / (f64)(rows*out);
+    NxLOOP(i, rows) {
+        NxLOOP(j, out) {
+            f64 d = a[i*out + j] - NxTensor_AT(Y, i, j);
+            sum += d*d;
+            g[i*out + j] = d*scale;
+        }
+    }
+
+    for(l=L; l-- > 0;) {
+        NxDense* layer = &(model->layers[l]);
+        NxModelBuffers* B = &(model->buffers[l]);
+        f64* dW = NxMemoryPlan_data(P, B->dweights);
+        f64* db = NxMemoryPlan_data(P, B->dbias);
+        f64* dX = l > 0 ? NxMemoryPlan_data(P, model->buffers[l-1].grad) : NULL;
+        const f64* input = l > 0 ? NxMemoryPlan_data(P, model->buffers[l-1].output) : x;
+        NxDense_backward_f64(layer, dX, dW, db, g, input, NxMemoryPlan_data(P, B->output), rows);
+        E->daxpy(layer->in_features*layer->out_features, -model->lr, dW, layer->weights.data);
+        E->daxpy(layer->out_features, -model->lr, db, layer->bias.data);
+        g = dX;
+    }
+    return sum;
+}
+
+/**
+ * @brief Train the model with mini-batch SGD on the mean squared error, reading the batches from a dataset.
+ *
+ * The memory of a step is planned for the batch size of the dataset
+ * (unless it already is) and reported before the first step, the last
+ * batch of an epoch may be smaller and uses the same buffers. An epoch
+ * runs until NxDataset_next() returns false, the dataset is rewound
+ * before each of the next ones. `model->epochs` passes are run with the
+ * learning rate `model->lr`, the loss of every epoch is printed and the
+ * last one is kept in `model->loss`.
+ *
+ * @param model the model.
+ * @param data batches of inputs (batch, in_features of the first layer) and
+ *        targets (batch, out_features of the last layer), f64.
+ */
+void NxModelSequential_train_dataset(NxModelSequential* model, NxDataset* data) {
+    u64 L = model->n_layers, batch_size = data->batch_size, epoch, l;
+    NxDatasetStream* X = &(data->x);
+    NxDatasetStream* Y = &(data->y);
+    bool targets = Y->count > 0 || data->resident_y != NULL;
+    if(L == 0 || !targets || X->ndim != 2 || Y->ndim != 2
+       || X->shape[1] != model->layers[0].in_features || Y->shape[1] != model->layers[L-1].out_features) {
+        fprintf(stderr, "Cannot train a model of %" PRIu64 " layers on inputs (%" PRIu64 ", %" PRIu64 ") and targets (%" PRIu64 ", %" PRIu64 ").\n",
+                L, X->rows, X->shape[1], Y->rows, Y->shape[1]);
+        exit(EXIT_FAILURE);
+    }
+    if(X->dtype != NxFLOAT64 || Y->dtype != NxFLOAT64) {
+        fprintf(stderr, "Cannot train on tensors of dtype %s and %s.\n",
+                NxDType_name(X->dtype), NxDType_name(Y->dtype));
+        exit(EXIT_FAILURE);
+    }
+    if(model->batch_size != batch_size) {
+        NxModelSequential_plan(model, batch_size);
+    }
+    /* The steps update the parameters through `data`, shared or mapped ones get a buffer first. */
+    NxLOOP(l, L) {
+        NxTensor_unshare(&(model->layers[l].weights));
+        NxTensor_unshare(&(model->layers[l].bias));
+    }
+    printf("Model %s: %" PRIu64 " layers, batch %" PRIu64 ", planned step memory %" PRIu64 " bytes in %" PRIu64 " buffers (%" PRIu64 " without reuse).\n",
+           model->name, L, batch_size, model->plan.peak, model->plan.n_buffers, model->plan.total);
+
+    NxLOOP(epoch, model->epochs) {
+        NxTensor *x, *y;
+        u64 samples = 0;
+        f64 sum = 0.0;
+        if(epoch > 0) {
+            NxDataset_rewind(data);
+        }
+        while(NxDataset_next(data, &x, &y)) {
+            sum += NxModelSequential_step(model, x, y);
+            samples += x->m;
+        }
+        model->loss = samples > 0 ? 0.5*sum / (f64)(samples*Y->shape[1]) : 0.0;
+        printf("Epoch %" PRIu64 "/%" PRIu64 " - loss: %lf\n", epoch + 1, model->epochs, model->loss);
+    }
+}
+
+/**
+ * @brief Train the model with mini-batch SGD on tensors already in memory.
+ *
+ * The rows of the tensors are wrapped in a dataset (NxDataset_wrap()),
+ * see NxModelSequential_train_dataset().
+ *
+ * @param model the model.
+ * @param x_train inputs of shape (samples, in_features of the first layer), f64.
+ * @param y_train targets of shape (samples, out_features of the last layer), f64.
+ * @param batch_size number of samples of a step.
+ */
+void NxModelSequential_train(NxModelSequential* model, NxTensor* x_train, NxTensor* y_train, u64 batch_size) {
+    NxDataset D;
+    NxDataset_wrap(&D, x_train, y_train, batch_size);
+    NxModelSequential_train_dataset(model, &D);
+    NxDataset_close(&D);
+}
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxModels.c
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,218 @@
+#include "NxReduce.h"
+#include "NxKernels.h"
+#include "NxThreadPool.h"
+
+#include <string.h>
+
+/// Number of columns accumulated at once by NxReduce_sum_over_rows().
+#define NxREDUCE_STRIP 512
+/// Number of rows summed with the vector kernels before the Kahan update.
+#define NxREDUCE_ROW_BLOCK 64
+
+static bool NxReduce_deterministic = false;
+
+/**
+ * @brief Read the mode from the environment.
+ */
+__attribute__((constructor))
+static void NxReduce_init(void) {
+    const char* env = getenv(NxREDUCE_DETERMINISTIC_ENV);
+    NxReduce_deterministic = env != NULL && strcmp(env, "1") == 0;
+}
+
+/**
+ * @brief Enable or disable the results that do not depend on the number of threads.
+ */
+void NxReduce_set_deterministic(bool deterministic) {
+    NxReduce_deterministic = deterministic;
+}
+
+/**
+ * @brief Whether the deterministic mode is enabled.
+ */
+bool NxReduce_is_deterministic(void) {
+    return NxReduce_deterministic;
+}
+
+/**
+ * @brief Number of parts a reduction over `work` elements is cut into.
+ *
+ * In deterministic mode it only depends on `work`.
+ */
+static u64 NxReduce_parts(u64 work, u64 limit) {
+    u64 parts = NxReduce_deterministic ? NxREDUCE_PARTS : NxThreadPool_get_threads();
+    u64 most = work / NxREDUCE_MIN_WORK;
+    if(most > limit) {
+        most = limit;
+    }
+    if(parts > most) {
+        parts = most;
+    }
+    return parts ? parts : 1;
+}
+
+/**
+ * @brief Pairwise sum of n contiguous elements.
+ */
+static f64 NxReduce_pairwise(const NxKernels* K, u64 n, const f64* a) {
+    if(n <= NxREDUCE_LEAF) {
+        return K->sum(n, a);
+    }
+    u64 half = n/2;
+    return NxReduce_pairwise(K, half, a) + NxReduce_pairwise(K, n - half, a + half);
+}
+
+static f64 NxReduce_flat_part(void* ctx, u64 begin, u64 end) {
+    const f64* a = ctx;
+    return NxReduce_pairwise(NxKernels_get(), end - begin, a + begin);
+}
+
+/**
+ * @brief Return the sum of n contiguous elements.
+ *
+ * @param n number of elements.
+ * @param a the elements.
+ */
+f64 NxReduce_sum(u64 n, const f64* a) {
+    u64 parts = NxReduce_parts(n, NxTHREADS_MAX);
+    if(parts == 1) {
+        return NxReduce_pairwise(NxKernels_get(), n, a);
+    }
+    return NxThreadPool_parallel_reduce(n, (n + parts - 1)/parts, NxReduce_flat_part, (void*)a);
+}
+
+/**
+ * @brief Column sums of the rows [r0, r1) of a (m, n) matrix into c.
+ *
+ * Strips of NxREDUCE_STRIP columns are walked down the rows, blocks of
+ * NxREDUCE_ROW_BLOCK rows are added with the vector kernels and folded
+ * into c with Kahan compensation.
+ */
+static void NxReduce_rows_range(const NxKernels* K, u64 r0, u64 r1, u64 n,
+                                const f64* A, i64 rs, f64* c) {
+    f64 block[NxREDUCE_STRIP], comp[NxREDUCE_STRIP];
+    u64 i, i0, j, j0;
+    for(j0=0; j0<n; j0+=NxREDUCE_STRIP) {
+        u64 w = n - j0 < NxREDUCE_STRIP ? n - j0 : NxREDUCE_STRIP;
+        f64* out = c + j0;
+        memset(out, 0, w*sizeof(f64));
+        memset(comp, 0, w*sizeof(f64));
+        for(i0=r0; i0<r1; i0+=NxREDUCE_ROW_BLOCK) {
+            u64 i1 = r1 - i0 < NxREDUCE_ROW_BLOCK ? r1 : i0 + NxREDUCE_ROW_BLOCK;
+            memcpy(block, A + (i64)i0*rs + j0, w*sizeof(f64));
+            for(i=i0+1; i<i1; i++) {
+                K->add(w, block, A + (i64)i*rs + j0, block);
+            }
+            NxLOOP(j, w) {
+                f64 y = block[j] - comp[j], t = out[j] + y;
+                comp[j] = (t - out[j]) - y;
+                out[j] = t;
+            }
+        }
+    }
+}
+
+/// Arguments of the parts of NxReduce_sum_over_rows().
+typedef struct NxReduceRows {
+    const f64* A;
+    u64 m;
+    u64 n;
+    i64 rs;
+    u64 parts;
+    f64* partial;
+} NxReduceRows;
+
+static void NxReduce_rows_part(void* ctx, u64 begin, u64 end) {
+    NxReduceRows* R = ctx;
+    u64 p;
+    for(p=begin; p<end; p++) {
+        NxReduce_rows_range(NxKernels_get(), R->m*p/R->parts, R->m*(p+1)/R->parts,
+                            R->n, R->A, R->rs, R->partial + p*R->n);
+    }
+}
+
+/**
+ * @brief Sum a (m, n) matrix over its rows: `c[j] = sum_i A[i*rs + j]`.
+ *
+ * @param m number of rows.
+ * @param n number of columns.
+ * @param A the matrix, its rows are contiguous.
+ * @param rs distance between two rows.
+ * @param c the n sums, must not alias A.
+ */
+void NxReduce_sum_over_rows(u64 m, u64 n, const f64* A, i64 rs, f64* c) {
+    const NxKernels* K = NxKernels_get();
+    u64 parts = NxReduce_parts(m*n, m), p;
+    if(parts == 1) {
+        NxReduce_rows_range(K, 0, m, n, A, rs, c);
+        return ;
+    }
+    NxReduceRows R = {A, m, n, rs, parts, malloc(parts*n*sizeof(f64))};
+    NxASSERT(R.partial != NULL);
+    NxThreadPool_parallel_for(parts, 1, NxReduce_rows_part, &R);
+    memcpy(c, R.partial, n*sizeof(f64));
+    for(p=1; p<parts; p++) {
+        K->add(n, c, R.partial + p*n, c);
+    }
+    free(R.partial);
+}
+
+/// Arguments of the parts of NxReduce_sum_over_cols().
+typedef struct NxReduceCols {
+    const f64* A;
+    u64 n;
+    i64 rs;
+    f64* c;
+} NxReduceCols;
+
+static void NxReduce_cols_part(void* ctx, u64 begin, u64 end) {
+    NxReduceCols* R = ctx;
+    const NxKernels* K = NxKernels_get();
+    u64 i;
+    for(i=begin; i<end; i++) {
+        R->c[i] = NxReduce_pairwise(K, R->n, R->A + (i64)i*R->rs);
+    }
+}
+
+/**
+ * @brief Sum a (m, n) matrix over its columns: `c[i] = sum_j A[i*rs + j]`.
+ *
+ * Every row is summed pairwise by a single thread, so the result does not
+ * depend on the number of threads.
+ *
+ * @param m number of rows.
+ * @param n number of columns.
+ * @param A the matrix, its rows are contiguous.
+ * @param rs distance between two rows.
+ * @param c the m sums, must not alias A.
+ */
+void NxReduce_sum_over_cols(u64 m, u64 n, const f64* A, i64 rs, f64* c) {
+    NxReduceCols R = {A, n, rs, c};
+    u64 parts = NxReduce_parts(m*n, m);
+    NxThreadPool_parallel_for(m, (m + parts - 1)/parts, NxReduce_cols_part, &R);
+}
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxReduce.c
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,503 @@
+#include "NxSparse.h"
+#include "NxKernels.h"
+#include "NxThreadPool.h"
+
+#include <string.h>
+
+/// Number of compressed rows (columns) of S, the entries of `ptr` minus one.
+static inline u64 NxSparseTensor_outer(const NxSparseTensor* S) {
+    return S->format == NxSPARSE_CSR ? S->m : S->n;
+}
+
+/// Size of the other dimension of S, the range of `indices`.
+static inline u64 NxSparseTensor_inner(const NxSparseTensor* S) {
+    return S->format == NxSPARSE_CSR ? S->n : S->m;
+}
+
+/**
+ * @brief Allocate the buffers of a sparse tensor.
+ *
+ * `ptr` is zeroed, `indices` and `values` are left for the caller to
+ * fill. An already allocated tensor is freed first.
+ *
+ * @param S the sparse tensor.
+ * @param m number of rows.
+ * @param n number of columns.
+ * @param nnz number of stored elements.
+ * @param format which dimension is compressed.
+ */
+void NxSparseTensor_alloc(NxSparseTensor* S, u64 m, u64 n, u64 nnz, NxSparseFormat format) {
+    if(S->allocated) {
+        NxSparseTensor_free(S);
+    }
+    S->m = m;
+    S->n = n;
+    S->nnz = nnz;
+    S->format = format;
+    S->ptr = calloc(NxSparseTensor_outer(S) + 1, sizeof (u64));
+    S->indices = malloc((nnz ? nnz : 1)*sizeof (u64));
+    S->values = malloc((nnz ? nnz : 1)*sizeof (f64));
+    NxASSERT(S->ptr != NULL && S->indices != NULL && S->values != NULL);
+    S->allocated = true;
+}
+
+/// Arguments of the parallel passes of NxSparseTensor_from_dense().
+typedef struct NxSparseDenseJob {
+    NxSparseTensor* S;
+    const f64* data;
+    i64 ro; ///< stride of the compressed dimension in the dense tensor.
+    i64 ri; ///< stride of the other dimension.
+    u64 inner;
+} NxSparseDenseJob;
+
+static void NxSparseTensor_count_range(void* ctx, u64 begin, u64 end) {
+    NxSparseDenseJob* J = ctx;
+    u64 o, i;
+    for(o=begin; o<end; o++) {
+        const f64* a = J->data + (i64)o*J->ro;
+        u64 count = 0;
+        NxLOOP(i, J->inner) {
+            count += a[(i64)i*J->ri] != 0.0;
+        }
+        J->S->ptr[o + 1] = count;
+    }
+}
+
+static void NxSparseTensor_fill_range(void* ctx, u64 begin, u64 end) {
+    NxSparseDenseJob* J = ctx;
+    u64 o, i;
+    for(o=begin; o<end; o++) {
+        const f64* a = J->data + (i64)o*J->ro;
+        u64 e = J->S->ptr[o];
+        NxLOOP(i, J->inner) {
+            f64 v = a[(i64)i*J->ri];
+            if(v != 0.0) {
+                J->S->indices[e] = i;
+                J->S->values[e] = v;
+                e++;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Build a sparse tensor from the nonzeros of a dense one.
+ *
+ * The nonzeros of every row (column) are counted then copied in two
+ * parallel passes over the dense tensor.
+ *
+ * @param S the sparse output.
+ * @param A a 2-D f64 tensor, views are read through their strides.
+ * @param format format of S.
+ */
+void NxSparseTensor_from_dense(NxSparseTensor* S, NxTensor* A, NxSparseFormat format) {
+    NxASSERT(A->allocated);
+    if(A->dtype != NxFLOAT64) {
+        fprintf(stderr, "NxSparseTensor_from_dense only supports f64 tensors, got %s.\n", NxDType_name(A->dtype));
+        exit(EXIT_FAILURE);
+    }
+    NxTensor T = {0};
+    if(A->ndim != 2 && !NxTensor_is_contiguous(A)) {
+        NxTensor_contiguous(&T, A);
+        A = &T;
+    }
+
+    NxSparseTensor_alloc(S, A->m, A->n, 0, format);
+    NxSparseDenseJob J = {
+        S, A->data,
+        format == NxSPARSE_CSR ? A->rs : A->cs,
+        format == NxSPARSE_CSR ? A->cs : A->rs,
+        NxSparseTensor_inner(S),
+    };
+    u64 outer = NxSparseTensor_outer(S), o;
+    u64 grain = NxPARALLEL_GRAIN / (J.inner ? J.inner : 1) + 1;
+    NxThreadPool_parallel_for(outer, grain, NxSparseTensor_count_range, &J);
+    NxLOOP(o, outer) {
+        S->ptr[o + 1] += S->ptr[o];
+    }
+    S->nnz = S->ptr[outer];
+    free(S->indices);
+    free(S->values);
+    S->indices = malloc((S->nnz ? S->nnz : 1)*sizeof (u64));
+    S->values = malloc((S->nnz ? S->nnz : 1)*sizeof (f64));
+    NxASSERT(S->indices != NULL && S->values != NULL);
+    NxThreadPool_parallel_for(outer, grain, NxSparseTensor_fill_range, &J);
+    NxTensor_free(&T);
+}
+
+/**
+ * @brief Build a sparse tensor from (row, column, value) triplets.
+ *
+ * The triplets may come in any order, they are sorted with two counting
+ * passes (by the inner then by the compressed index) so the cost is
+ * O(nnz + m + n). Duplicated positions are kept as separate elements,
+ * which the products add up. Zero values are stored as given.
+ *
+ * @param S the sparse output.
+ * @param m number of rows.
+ * @param n number of columns.
+ * @param nnz number of triplets.
+ * @param rows row of every triplet.
+ * @param cols column of every triplet.
+ * @param values value of every triplet.
+ * @param format format of S.
+ */
+void NxSparseTensor_from_coo(NxSparseTensor* S, u64 m, u64 n, u64 nnz, const u64* rows,
+                             const u64* cols, const f64* values, NxSparseFormat format) {
+    u64 e;
+    NxLOOP(e, nnz) {
+        if(rows[e] >= m || cols[e] >= n) {
+            fprintf(stderr, "Cannot store the element (%" PRIu64 ", %" PRIu64 ") in a (%" PRIu64 ", %" PRIu64 ") sparse tensor.\n",
+                    rows[e], cols[e], m, n);
+            exit(EXIT_FAILURE);
+        }
+    }
+    const u64* outer_index = format == NxSPARSE_CSR ? rows : cols;
+    const u64* inner_index = format == NxSPARSE_CSR ? cols : rows;
+    NxSparseTensor_alloc(S, m, n, nnz, format);
+    u64 outer = NxSparseTensor_outer(S), inner = NxSparseTensor_inner(S), i;
+
+    /* first pass: order the triplets by their inner index */
+    u64* start = calloc(inner + 1, sizeof (u64));
+    u64* order = malloc((nnz ? nnz : 1)*sizeof (u64));
+    NxASSERT(start != NULL && order != NULL);
+    NxLOOP(e, nnz) {
+        start[inner_index[e] + 1]++;
+    }
+    NxLOOP(i, inner) {
+        start[i + 1] += start[i];
+    }
+    NxLOOP(e, nnz) {
+        order[start[inner_index[e]]++] = e;
+    }
+
+    /* second pass: stable by the compressed index, so every segment ends up sorted */
+    NxLOOP(e, nnz) {
+        S->ptr[outer_index[e] + 1]++;
+    }
+    NxLOOP(i, outer) {
+        S->ptr[i + 1] += S->ptr[i];
+    }
+    u64* next = start;
+    if(outer > inner) {
+        next = realloc(start, (outer + 1)*sizeof (u64));
+        NxASSERT(next != NULL);
+    }
+    memcpy(next, S->ptr, outer*sizeof (u64));
+    NxLOOP(i, nnz) {
+        e = order[i];
+        u64 dst = next[outer_index[e]]++;
+        S->indices[dst] = inner_index[e];
+        S->values[dst] = values[e];
+    }
+    free(next);
+    free(order);
+}
+
+/**
+ * @brief Expand a sparse tensor to a dense f64 tensor.
+ *
+ * @param C the dense output of shape (m, n).
+ * @param S the sparse tensor.
+ */
+void NxSparseTensor_to_dense(NxTensor* C, NxSparseTensor* S) {
+    NxASSERT(S->allocated);
+    NxTensor_alloc_zeros(C, S->m, S->n);
+    i64 ro = S->format == NxSPARSE_CSR ? C->rs : C->cs;
+    i64 ri = S->format == NxSPARSE_CSR ? C->cs : C->rs;
+    u64 o, e;
+    NxLOOP(o, NxSparseTensor_outer(S)) {
+        for(e=S->ptr[o]; e<S->ptr[o + 1]; e++) {
+            C->data[(i64)o*ro + (i64)S->indices[e]*ri] += S->values[e];
+        }
+    }
+}
+
+/**
+ * @brief Copy a sparse tensor in another format.
+ *
+ * CSR to CSC (and back) is a counting sort of the elements by their
+ * inner index, O(nnz + m + n). Walking the source in order keeps the
+ * indices of every output segment sorted.
+ *
+ * @param C the output, must not be S.
+ * @param S the sparse tensor.
+ * @param format format of C.
+ */
+void NxSparseTensor_convert(NxSparseTensor* C, NxSparseTensor* S, NxSparseFormat format) {
+    NxASSERT(S->allocated && C != S);
+    NxSparseTensor_alloc(C, S->m, S->n, S->nnz, format);
+    u64 outer = NxSparseTensor_outer(S), inner = NxSparseTensor_inner(S), o, e;
+    if(format == S->format) {
+        memcpy(C->ptr, S->ptr, (outer + 1)*sizeof (u64));
+        memcpy(C->indices, S->indices, S->nnz*sizeof (u64));
+        memcpy(C->values, S->values, S->nnz*sizeof (f64));
+        return ;
+    }
+
+    NxLOOP(e, S->nnz) {
+        C->ptr[S->indices[e] + 1]++;
+    }
+    NxLOOP(o, inner) {
+        C->ptr[o + 1] += C->ptr[o];
+    }
+    u64* next = malloc((inner ? inner : 1)*sizeof (u64));
+    NxASSERT(next != NULL);
+    memcpy(next, C->ptr, inner*sizeof (u64));
+    NxLOOP(o, outer) {
+        for(e=S->ptr[o]; e<S->ptr[o + 1]; e++) {
+            u64 dst = next[S->indices[e]]++;
+            C->indices[dst] = o;
+            C->values[dst] = S->values[e];
+        }
+    }
+    free(next);
+}
+
+/// Arguments of the parallel chunks of NxSparse_spmm().
+typedef struct NxSparseJob {
+    const NxSparseTensor* A;
+    bool by_rows; ///< segments of A are rows of op(A), otherwise columns.
+    u64 m, n, k; ///< op(A) is (m, k), B is (k, n) and C is (m, n).
+    f64 alpha, beta;
+    const f64* B; i64 rsb, csb;
+    f64* C; i64 rsc, csc;
+} NxSparseJob;
+
+/// `beta*c`, without reading c when beta is 0.
+static inline f64 NxSparse_scaled(f64 beta, f64 c) {
+    return beta == 0.0 ? 0.0 : beta*c;
+}
+
+/**
+ * @brief Rows [begin, end) of C when the segments of A are rows of op(A)
+ * and the rows of B are contiguous.
+ *
+ * Every stored element (r, p, v) adds `alpha*v*B[p, :]` to `C[r, :]`, a
+ * vector axpy when the rows of C are contiguous too.
+ */
+static void NxSparse_rows_range(void* ctx, u64 begin, u64 end) {
+    NxSparseJob* J = ctx;
+    const NxSparseTensor* A = J->A;
+    const NxKernels* K = NxKernels_get();
+    u64 r, c, e;
+    for(r=begin; r<end; r++) {
+        f64* c_row = J->C + (i64)r*J->rsc;
+        if(J->beta != 1.0) {
+            NxLOOP(c, J->n) {
+                c_row[(i64)c*J->csc] = NxSparse_scaled(J->beta, c_row[(i64)c*J->csc]);
+            }
+        }
+        for(e=A->ptr[r]; e<A->ptr[r + 1]; e++) {
+            const f64* b = J->B + (i64)A->indices[e]*J->rsb;
+            f64 v = J->alpha*A->values[e];
+            if(J->csc == 1) {
+                K->axpy(J->n, v, b, c_row);
+                continue;
+            }
+            NxLOOP(c, J->n) {
+                c_row[(i64)c*J->csc] += v*b[c];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Columns [begin, end) of C when the segments of A are rows of
+ * op(A) and the rows of B are strided.
+ *
+ * This is the case of a transposed weight matrix: every column of B is a
+ * contiguous row of the weights, so every column of C is a sparse
+ * matrix-vector product gathering from one row that stays in cache,
+ * instead of one cache line of every row per stored element.
+ */
+static void NxSparse_gather_range(void* ctx, u64 begin, u64 end) {
+    NxSparseJob* J = ctx;
+    const NxSparseTensor* A = J->A;
+    u64 r, c, e;
+    for(c=begin; c<end; c++) {
+        const f64* b = J->B + (i64)c*J->csb;
+        f64* c_col = J->C + (i64)c*J->csc;
+        NxLOOP(r, J->m) {
+            f64 s = 0.0;
+            for(e=A->ptr[r]; e<A->ptr[r + 1]; e++) {
+                s += A->values[e]*b[(i64)A->indices[e]*J->rsb];
+            }
+            c_col[(i64)r*J->rsc] = NxSparse_scaled(J->beta, c_col[(i64)r*J->rsc]) + J->alpha*s;
+        }
+    }
+}
+
+/**
+ * @brief Columns [begin, end) of C when the segments of A are columns of op(A).
+ *
+ * Every stored element (r, p, v) adds `alpha*v*B[p, begin:end]` to
+ * `C[r, begin:end]`. The threads own disjoint columns of C so they never
+ * write the same element. When the rows of B and C are contiguous the
+ * elements run in order with an axpy over the columns, otherwise column
+ * after column so the writes stay in the one column of C in cache (the
+ * transposed gradient of a weight matrix).
+ */
+static void NxSparse_cols_range(void* ctx, u64 begin, u64 end) {
+    NxSparseJob* J = ctx;
+    const NxSparseTensor* A = J->A;
+    const NxKernels* K = NxKernels_get();
+    u64 r, p, c, e;
+    if(J->csb == 1 && J->csc == 1) {
+        NxLOOP(r, J->m) {
+            f64* c_row = J->C + (i64)r*J->rsc + (i64)begin;
+            for(c=0; c<end - begin; c++) {
+                c_row[c] = NxSparse_scaled(J->beta, c_row[c]);
+            }
+        }
+        NxLOOP(p, J->k) {
+            const f64* b = J->B + (i64)p*J->rsb + (i64)begin;
+            for(e=A->ptr[p]; e<A->ptr[p + 1]; e++) {
+                K->axpy(end - begin, J->alpha*A->values[e], b, J->C + (i64)A->indices[e]*J->rsc + (i64)begin);
+            }
+        }
+        return ;
+    }
+    for(c=begin; c<end; c++) {
+        const f64* b = J->B + (i64)c*J->csb;
+        f64* c_col = J->C + (i64)c*J->csc;
+        NxLOOP(r, J->m) {
+            c_col[(i64)r*J->rsc] = NxSparse_scaled(J->beta, c_col[(i64)r*J->rsc]);
+        }
+        NxLOOP(p, J->k) {
+            if(A->ptr[p] == A->ptr[p + 1]) {
+                continue;
+            }
+            f64 v = J->alpha*b[(i64)p*J->rsb];
+            for(e=A->ptr[p]; e<A->ptr[p + 1]; e++) {
+                c_col[(i64)A->indices[e]*J->rsc] += v*A->values[e];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Sparse times dense product `C = alpha*op(A)*B + beta*C`.
+ *
+ * op(A) is A, or its transpose when `trans` is true, which is free since
+ * a CSR matrix read as CSC is its transpose. The rows or the columns of
+ * C are split over the NxThreadPool so the threads never write the same
+ * element, the loop order follows the strides of B and C (see the range
+ * functions). Either way the work is O(nnz*n) plus the scaling of C.
+ *
+ * The dense operands are described like in NxGemm_dgemm(), so transposed
+ * or strided inputs need no copy.
+ *
+ * @param trans whether op(A) is the transpose of A.
+ * @param n number of columns of B and C.
+ * @param alpha scale of the product.
+ * @param A the sparse operand.
+ * @param B pointer to B, element (p, j) lives at `B[p*rsb + j*csb]`.
+ * @param beta scale of C, when it is 0 C is not read.
+ * @param C pointer to C, element (i, j) lives at `C[i*rsc + j*csc]`.
+ */
+void NxSparse_spmm(bool trans, u64 n, f64 alpha, NxSparseTensor* A,
+                   const f64* B, i64 rsb, i64 csb,
+                   f64 beta, f64* C, i64 rsc, i64 csc) {
+    NxASSERT(A->allocated);
+    NxSparseJob J = {
+        .A = A, .by_rows = (A->format == NxSPARSE_CSR) != trans,
+        .m = trans ? A->n : A->m, .n = n, .k = trans ? A->m : A->n,
+        .alpha = alpha, .beta = beta,
+        .B = B, .rsb = rsb, .csb = csb,
+        .C = C, .rsc = rsc, .csc = csc,
+    };
+    if(J.m == 0 || n == 0) {
+        return ;
+    }
+    NxParallelFn fn = NxSparse_cols_range;
+    u64 count = n;
+    if(J.by_rows) {
+        fn = csb == 1 ? NxSparse_rows_range : NxSparse_gather_range;
+        count = csb == 1 ? J.m : n;
+    }
+    if((A->nnz + J.m)*n < NxPARALLEL_GRAIN) {
+        fn(&J, 0, count);
+        return ;
+    }
+    NxThreadPool_parallel_for(count, NxSPARSE_GRAIN, fn, &J);
+}
+
+/**
+ * @brief Product of a sparse and a dense tensor, `C = A*B`.
+ *
+ * @param C the dense output of shape (A.m, B.n).
+ * @param A the sparse tensor.
+ * @param B a 2-D f64 tensor, views are read through their strides.
+ */
+void NxSparseTensor_matmul(NxTensor* C, NxSparseTensor* A, NxTensor* B) {
+    NxASSERT(A->allocated);
+    NxASSERT(B->allocated);
+    if(B->dtype != NxFLOAT64) {
+        fprintf(stderr, "NxSparseTensor_matmul only supports f64 tensors, got %s.\n", NxDType_name(B->dtype));
+        exit(EXIT_FAILURE);
+    }
+    if(A->n != B->m) {
+        fprintf(stderr, "Cannot multiply matrix with shape (%" PRIu64 ", %" PRIu64 ") with (%" PRIu64 ", %" PRIu64 ").\n",
+                A->m, A->n, B->m, B->n);
+        exit(EXIT_FAILURE);
+    }
+    NxTensor T = {0};
+    if(B->ndim != 2 && !NxTensor_is_contiguous(B)) {
+        NxTensor_contiguous(&T, B);
+        B = &T;
+    }
+    NxTensor_alloc(C, A->m, B->n);
+    NxSparse_spmm(false, B->n, 1.0, A, B->data, B->rs, B->cs, 0.0, C->data, C->rs, C->cs);
+    NxTensor_free(&T);
+}
+
+/**
+ * @brief Fraction of the elements of S that are stored.
+ */
+f64 NxSparseTensor_density(NxSparseTensor* S) {
+    f64 size = (f64)S->m*(f64)S->n;
+    return size > 0.0 ? (f64)S->nnz / size : 0.0;
+}
+
+/**
+ * @brief Free the buffers of a sparse tensor.
+ */
+void NxSparseTensor_free(NxSparseTensor* S) {
+    if(!S->allocated) {
+        return ;
+    }
+    free(S->ptr);
+    free(S->indices);
+    free(S->values);
+    S->ptr = NULL;
+    S->indices = NULL;
+    S->values = NULL;
+    S->nnz = 0;
+    S->allocated = false;
+}
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxSparse.c
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -1,10 +1,476 @@
 #include "NxCore.h"
 #include "NxTensor.h"
+#include "NxBackend.h"
+#include "NxKernels.h"
+#include "NxMath.h"
+#include "NxReduce.h"
+#include "NxThreadPool.h"
+#include "NxText.h"
 
 #include <time.h>
 #include <math.h>
-// #include <cblas.h>
-// #include <lapack.h>
+
+/// Number of bf16/f16 elements widened to f32 at once by the elementwise operations.
+#define NxTENSOR_HALF_BLOCK 256
+
+
+/// Side of the square tiles used to copy a strided tensor into a contiguous buffer.
+#define NxTENSOR_PACK_TILE 32
+
+/**
+ * @brief Define NxTensor_pack_T() copying a strided (m, n) matrix of T to a contiguous buffer.
+ *
+ * Rows with a unit column stride are copied with memcpy, anything else
+ * (e.g. a transposed view) is copied in tiles so both sides stay in cache.
+ */
+#define NxTENSOR_DEFINE_PACK(T)                                                          \
+static void NxTensor_pack_##T(T* dst, const T* src, u64 m, u64 n, i64 rs, i64 cs) {      \
+    u64 i, j, i0, j0;                                                                    \
+    if(cs == 1) {                                                                        \
+        NxLOOP(i, m) {                                                                   \
+            memcpy(dst + i*n, src + (i64)i*rs, n*sizeof(T));                             \
+        }                                                                                \
+        return ;                                                                         \
+    }                                                                                    \
+    for(i0=0; i0<m; i0+=NxTENSOR_PACK_TILE) {                                            \
+        u64 ie = i0 + NxTENSOR_PACK_TILE < m ? i0 + NxTENSOR_PACK_TILE : m;              \
+        for(j0=0; j0<n; j0+=NxTENSOR_PACK_TILE) {                                        \
+            u64 je = j0 + NxTENSOR_PACK_TILE < n ? j0 + NxTENSOR_PACK_TILE : n;          \
+            for(i=i0; i<ie; i++) {                                                       \
+                for(j=j0; j<je; j++) {                                                   \
+                    dst[i*n + j] = src[(i64)i*rs + (i64)j*cs];                           \
+                }                                                                        \
+            }                                                                            \
+        }                                                                                \
+    }                                                                                    \
+}
+
+NxTENSOR_DEFINE_PACK(u64)
+NxTENSOR_DEFINE_PACK(u32)
+NxTENSOR_DEFINE_PACK(u16)
+
+/**
+ * @brief Copy a strided (m, n) matrix with elements of `size` bytes to a contiguous buffer.
+ */
+static void NxTensor_pack_2d(void* dst, const void* src, u64 size, u64 m, u64 n, i64 rs, i64 cs) {
+    switch(size) {
+    case 8: NxTensor_pack_u64(dst, src, m, n, rs, cs); break;
+    case 4: NxTensor_pack_u32(dst, src, m, n, rs, cs); break;
+    default: NxTensor_pack_u16(dst, src, m, n, rs, cs); break;
+    }
+}
+
+/**
+ * @brief Whether the leading dimensions of A collapse into rows of a single stride.
+ *
+ * This is what the 2-D functions need to address A through (m, n, rs, cs),
+ * it holds for every contiguous tensor, transposed matrix and slice.
+ * The row stride is stored in rs when it is not NULL.
+ */
+static bool NxTensor_collapse(const NxTensor* A, i64* rs) {
+    i64 stride = (i64)A->n * A->cs, expected = 0;
+    bool found = false;
+    i32 k;
+    for(k=(i32)A->ndim-2; k>=0; k--) {
+        if(A->shape[k] == 1) {
+            continue;
+        }
+        if(!found) {
+            stride = A->strides[k];
+            found = true;
+        } else if(A->strides[k] != expected) {
+            return false;
+        }
+        expected = A->strides[k]*(i64)A->shape[k];
+    }
+    if(rs != NULL) {
+        *rs = stride;
+    }
+    return true;
+}
+
+/**
+ * @brief Refresh the 2-D fields (m, n, rs, cs) from the shape and strides.
+ */
+static void NxTensor_sync_2d(NxTensor* A) {
+    u32 k;
+    A->n = A->ndim > 0 ? A->shape[A->ndim - 1] : 1;
+    A->cs = A->ndim > 0 ? A->strides[A->ndim - 1] : 1;
+    A->m = 1;
+    for(k=0; k+1<A->ndim; k++) {
+        A->m *= A->shape[k];
+    }
+    if(!NxTensor_collapse(A, &A->rs)) {
+        A->rs = A->strides[A->ndim - 2];
+    }
+}
+
+/**
+ * @brief Copy the elements of A, in row-major order, to the contiguous buffer dst.
+ *
+ * A tensor which collapses to a matrix is copied in one go, otherwise the
+ * copy runs over every 2-D slab of the last two dimensions.
+ */
+static void NxTensor_pack(void* dst, NxTensor* A) {
+    u64 size = NxDType_size(A->dtype);
+    if(A->m == 0 || A->n == 0) {
+        return ;
+    }
+    if(NxTensor_collapse(A, NULL)) {
+        NxTensor_pack_2d(dst, A->raw, size, A->m, A->n, A->rs, A->cs);
+        return ;
+    }
+    u32 outer = A->ndim - 2, k;
+    u64 rows = A->shape[outer], cols = A->shape[outer + 1];
+    u64 idx[NxMAX_DIMS] = {0};
+    u64 slab, nslabs = A->m / rows;
+    NxLOOP(slab, nslabs) {
+        i64 off = 0;
+        NxLOOP(k, outer) {
+            off += (i64)idx[k]*A->strides[k];
+        }
+        NxTensor_pack_2d((char*)dst + slab*rows*cols*size, (const char*)A->raw + off*(i64)size, size,
+                         rows, cols, A->strides[outer], A->strides[outer + 1]);
+        for(k=outer; k-- > 0; ) {
+            if(++idx[k] < A->shape[k]) {
+                break;
+            }
+            idx[k] = 0;
+        }
+    }
+}
+
+/**
+ * @brief Return A when it is contiguous, otherwise pack it into T and return T.
+ *
+ * The caller frees T, which stays unallocated when A is returned.
+ */
+static NxTensor* NxTensor_packed(NxTensor* A, NxTensor* T) {
+    if(NxTensor_is_contiguous(A)) {
+        return A;
+    }
+    NxTensor_contiguous(T, A);
+    return T;
+}
+
+/**
+ * @brief Return A when it can be addressed as a (m, n) matrix, otherwise a packed copy in T.
+ */
+static NxTensor* NxTensor_matrix(NxTensor* A, NxTensor* T) {
+    if(NxTensor_collapse(A, NULL)) {
+        return A;
+    }
+    NxTensor_contiguous(T, A);
+    return T;
+}
+
+/**
+ * @brief Return A when it holds f64 elements, otherwise a contiguous f64 copy in T.
+ *
+ * The operations that only have a f64 implementation (GEMM, reductions,
+ * text output) run on the copy, the caller frees T.
+ */
+static NxTensor* NxTensor_widened(NxTensor* A, NxTensor* T) {
+    if(A->dtype == NxFLOAT64) {
+        return A;
+    }
+    NxTensor_astype(T, A, NxFLOAT64);
+    return T;
+}
+
+/**
+ * @brief Allocate C with the shape of A and the given dtype.
+ */
+static void NxTensor_alloc_as(NxTensor* C, NxTensor* A, NxDType dtype) {
+    u64 shape[NxMAX_DIMS];
+    memcpy(shape, A->shape, sizeof(shape));
+    NxLayout layout = A->layout;
+    NxTensor_alloc_nd(C, A->ndim, shape, dtype);
+    C->layout = layout;
+}
+
+/**
+ * @brief Point C at a window of the buffer of A starting `offset` elements after A->data.
+ *
+ * C takes a reference to the storage of A unless it is A itself. The
+ * layout tag is kept when the number of dimensions does not change.
+ */
+static void NxTensor_make_view_nd(NxTensor* C, NxTensor* A, u32 ndim, const u64* shape,
+                                  const i64* strides, u64 offset) {
+    NxTensor V = *A;
+    NxASSERT(ndim >= 1 && ndim <= NxMAX_DIMS);
+    V.ndim = ndim;
+    memmove(V.shape, shape, ndim*sizeof(u64));
+    memmove(V.strides, strides, ndim*sizeof(i64));
+    V.layout = ndim == A->ndim ? A->layout : NxLAYOUT_NONE;
+    V.raw = (char*)A->raw + offset*NxDType_size(A->dtype);
+    V.offset = A->offset + offset;
+    NxTensor_sync_2d(&V);
+    if(C != A) {
+        NxStorage_retain(A->storage);
+        NxTensor_free(C);
+    }
+    *C = V;
+}
+
+/**
+ * @brief Point C at a (m, n) window of the buffer of A, see NxTensor_make_view_nd().
+ */
+static void NxTensor_make_view(NxTensor* C, NxTensor* A, u64 m, u64 n, i64 rs, i64 cs, u64 offset) {
+    u64 shape[2] = {m, n};
+    i64 strides[2] = {rs, cs};
+    NxTensor_make_view_nd(C, A, 2, shape, strides, offset);
+}
+
+/**
+ * @brief Run a binary f32 kernel over bf16/f16 buffers.
+ *
+ * The operands are widened to f32 one block at a time, so the arithmetic
+ * is done in f32 and only the result is rounded back to the storage type.
+ */
+static void NxTensor_half_binary(u64 n, NxDType dtype, const u16* a, const u16* b, u16* c,
+                                 void (*op)(u64, const f32*, const f32*, f32*)) {
+    f32 fa[NxTENSOR_HALF_BLOCK], fb[NxTENSOR_HALF_BLOCK];
+    u64 i;
+    for(i=0; i<n; i+=NxTENSOR_HALF_BLOCK) {
+        u64 len = n - i < NxTENSOR_HALF_BLOCK ? n - i : NxTENSOR_HALF_BLOCK;
+        NxDType_to_f32(len, fa, a + i, dtype);
+        NxDType_to_f32(len, fb, b + i, dtype);
+        op(len, fa, fb, fa);
+        NxDType_from_f32(len, c + i, dtype, fa);
+    }
+}
+
+/**
+ * @brief Run a tensor-scalar f32 kernel over bf16/f16 buffers.
+ */
+static void NxTensor_half_scalar(u64 n, NxDType dtype, const u16* a, f32 s, u16* c,
+                                 void (*op)(u64, const f32*, f32, f32*)) {
+    f32 fa[NxTENSOR_HALF_BLOCK];
+    u64 i;
+    for(i=0; i<n; i+=NxTENSOR_HALF_BLOCK) {
+        u64 len = n - i < NxTENSOR_HALF_BLOCK ? n - i : NxTENSOR_HALF_BLOCK;
+        NxDType_to_f32(len, fa, a + i, dtype);
+        op(len, fa, s, fa);
+        NxDType_from_f32(len, c + i, dtype, fa);
+    }
+}
+
+/**
+ * @brief Run a unary f32 kernel over bf16/f16 buffers.
+ */
+static void NxTensor_half_unary(u64 n, NxDType dtype, const u16* a, u16* c,
+                                void (*op)(u64, const f32*, f32*)) {
+    f32 fa[NxTENSOR_HALF_BLOCK];
+    u64 i;
+    for(i=0; i<n; i+=NxTENSOR_HALF_BLOCK) {
+        u64 len = n - i < NxTENSOR_HALF_BLOCK ? n - i : NxTENSOR_HALF_BLOCK;
+        NxDType_to_f32(len, fa, a + i, dtype);
+        op(len, fa, fa);
+        NxDType_from_f32(len, c + i, dtype, fa);
+    }
+}
+
+/**
+ * @brief Run a unary f64 kernel over f32/bf16/f16 buffers.
+ *
+ * Used by the operations that only have a f64 kernel (the transcendental
+ * functions): the operand is widened to f64 one block at a time and the
+ * result is rounded back to the storage type.
+ */
+static void NxTensor_wide_unary(u64 n, NxDType dtype, const char* a, char* c,
+                                void (*op)(u64, const f64*, f64*)) {
+    f64 fa[NxTENSOR_HALF_BLOCK];
+    u64 size = NxDType_size(dtype), i;
+    for(i=0; i<n; i+=NxTENSOR_HALF_BLOCK) {
+        u64 len = n - i < NxTENSOR_HALF_BLOCK ? n - i : NxTENSOR_HALF_BLOCK;
+        NxDType_convert(len, fa, NxFLOAT64, a + i*size, dtype);
+        op(len, fa, fa);
+        NxDType_convert(len, c + i*size, dtype, fa, NxFLOAT64);
+    }
+}
+
+/**
+ * @brief An elementwise operation over contiguous buffers, split into chunks by NxThreadPool.
+ *
+ * Exactly one pair of kernels is set: binary (`a op b`), scalar (`a op s`)
+ * or unary (`op a`).
+ */
+typedef struct NxTensorJob {
+    NxDType dtype;
+    const char* a;
+    const char* b;
+    char* c;
+    f64 s;
+    void (*binary64)(u64, const f64*, const f64*, f64*);
+    void (*binary32)(u64, const f32*, const f32*, f32*);
+    void (*scalar64)(u64, const f64*, f64, f64*);
+    void (*scalar32)(u64, const f32*, f32, f32*);
+    void (*unary64)(u64, const f64*, f64*);
+    void (*unary32)(u64, const f32*, f32*);
+} NxTensorJob;
+
+/**
+ * @brief Run the job over the elements [begin, end).
+ */
+static void NxTensor_job_range(void* ctx, u64 begin, u64 end) {
+    NxTensorJob* J = ctx;
+    u64 size = NxDType_size(J->dtype), n = end - begin;
+    const void* a = J->a + begin*size;
+    const void* b = J->b + begin*size;
+    void* c = J->c + begin*size;
+    if(J->dtype != NxFLOAT64 && J->unary64 != NULL && J->unary32 == NULL) {
+        NxTensor_wide_unary(n, J->dtype, a, c, J->unary64);
+        return ;
+    }
+    switch(J->dtype) {
+    case NxFLOAT64:
+        if(J->binary64 != NULL) {
+            J->binary64(n, a, b, c);
+        } else if(J->scalar64 != NULL) {
+            J->scalar64(n, a, J->s, c);
+        } else {
+            J->unary64(n, a, c);
+        }
+        break;
+    case NxFLOAT32:
+        if(J->binary32 != NULL) {
+            J->binary32(n, a, b, c);
+        } else if(J->scalar32 != NULL) {
+            J->scalar32(n, a, (f32)J->s, c);
+        } else {
+            J->unary32(n, a, c);
+        }
+        break;
+    default:
+        if(J->binary32 != NULL) {
+            NxTensor_half_binary(n, J->dtype, a, b, c, J->binary32);
+        } else if(J->scalar32 != NULL) {
+            NxTensor_half_scalar(n, J->dtype, a, (f32)J->s, c, J->scalar32);
+        } else {
+            NxTensor_half_unary(n, J->dtype, a, c, J->unary32);
+        }
+        break;
+    }
+}
+
+/**
+ * @brief Run the job over the n elements, on several threads above NxPARALLEL_GRAIN elements.
+ */
+static void NxTensor_job_run(NxTensorJob* J, u64 n) {
+    NxThreadPool_parallel_for(n, NxPARALLEL_GRAIN, NxTensor_job_range, J);
+}
+
+/**
+ * @brief Allocate C like A and run the elementwise kernel matching the dtype of A and B.
+ *
+ * Strided inputs are packed first, and the input pointers are taken before
+ * C is allocated so C may be A or B even when they are views.
+ */
+static void NxTensor_binary(NxTensor* C, NxTensor* A, NxTensor* B,
+                            void (*op64)(u64, const f64*, const f64*, f64*),
+                            void (*op32)(u64, const f32*, const f32*, f32*)) {
+    if(A->dtype != B->dtype) {
+        fprintf(stderr, "Cannot operate on tensors with dtypes %s and %s.\n",
+                NxDType_name(A->dtype), NxDType_name(B->dtype));
+        exit(EXIT_FAILURE);
+    }
+    NxTensor TA = {0}, TB = {0};
+    NxTensorJob J = {.dtype = A->dtype, .binary64 = op64, .binary32 = op32};
+    NxTensor* PA = NxTensor_packed(A, &TA);
+    NxTensor* PB = NxTensor_packed(B, &TB);
+    NxStorage* HA = NxTensor_hold(C, PA, NxTensor_size(A), A->dtype);
+    NxStorage* HB = NxTensor_hold(C, PB, NxTensor_size(A), A->dtype);
+    J.a = PA->raw;
+    J.b = PB->raw;
+    NxTensor_alloc_as(C, A, A->dtype);
+    J.c = C->raw;
+    NxTensor_job_run(&J, NxTensor_size(C));
+    NxTensor_unhold(HA);
+    NxTensor_unhold(HB);
+    NxTensor_free(&TA);
+    NxTensor_free(&TB);
+}
+
+/**
+ * @brief Allocate C like A and run the tensor-scalar kernel matching the dtype of A.
+ */
+static void NxTensor_scalar(NxTensor* C, NxTensor* A, NxDTYPE s,
+                            void (*op64)(u64, const f64*, f64, f64*),
+                            void (*op32)(u64, const f32*, f32, f32*)) {
+    NxTensor TA = {0};
+    NxTensorJob J = {.dtype = A->dtype, .s = s, .scalar64 = op64, .scalar32 = op32};
+    NxTensor* PA = NxTensor_packed(A, &TA);
+    NxStorage* HA = NxTensor_hold(C, PA, NxTensor_size(A), A->dtype);
+    J.a = PA->raw;
+    NxTensor_alloc_as(C, A, A->dtype);
+    J.c = C->raw;
+    NxTensor_job_run(&J, NxTensor_size(C));
+    NxTensor_unhold(HA);
+    NxTensor_free(&TA);
+}
+
+/**
+ * @brief Allocate C like A and run the unary kernel matching the dtype of A.
+ *
+ * op32 may be NULL for the operations that only exist in f64, the other
+ * dtypes then go through op64 block by block (NxTensor_wide_unary()).
+ */
+static void NxTensor_unary(NxTensor* C, NxTensor* A,
+                           void (*op64)(u64, const f64*, f64*),
+                           void (*op32)(u64, const f32*, f32*)) {
+    NxTensor TA = {0};
+    NxTensorJob J = {.dtype = A->dtype, .unary64 = op64, .unary32 = op32};
+    NxTensor* PA = NxTensor_packed(A, &TA);
+    NxStorage* HA = NxTensor_hold(C, PA, NxTensor_size(A), A->dtype);
+    J.a = PA->raw;
+    NxTensor_alloc_as(C, A, A->dtype);
+    J.c = C->raw;
+    NxTensor_job_run(&J, NxTensor_size(C));
+    NxTensor_unhold(HA);
+    NxTensor_free(&TA);
+}
+
+/**
+ * @brief f64 `c = a + b` of a chunk through the backend daxpy, c may be a or b.
+ */
+static void NxTensor_backend_add(u64 n, const f64* a, const f64* b, f64* c) {
+    const NxBackend* E = NxBackend_get();
+    if(c == b) {
+        E->daxpy(n, 1.0, a, c);
+        return ;
+    }
+    if(c != a) {
+        memcpy(c, a, n*sizeof(f64));
+    }
+    E->daxpy(n, 1.0, b, c);
+}
+
+/**
+ * @brief f64 `c = a - b` of a chunk through the backend daxpy and dscal, c may be a or b.
+ */
+static void NxTensor_backend_sub(u64 n, const f64* a, const f64* b, f64* c) {
+    const NxBackend* E = NxBackend_get();
+    if(c == b) {
+        E->dscal(n, -1.0, c);
+        E->daxpy(n, 1.0, a, c);
+        return ;
+    }
+    if(c != a) {
+        memcpy(c, a, n*sizeof(f64));
+    }
+    E->daxpy(n, -1.0, b, c);
+}
+
+/**
+ * @brief f64 `c = s*a` of a chunk through the backend dscal, c may be a.
+ */
+static void NxTensor_backend_scale(u64 n, const f64* a, f64 s, f64* c) {
+    if(c != a) {
+        memcpy(c, a, n*sizeof(f64));
+    }
+    NxBackend_get()->dscal(n, s, c);
+}
 
 /**
  * @brief Initialize a Tensor in memory filled with Garbage.
@@ -23,18 +489,129 @@
  * @todo Rewrite code to handle Already allocated Tensors.
  */
 NxCDEF void NxTensor_alloc(NxTensor* A, u64 m, u64 n){
+    NxTensor_alloc_dtype(A, m, n, NxFLOAT64);
+}
 
-    if(!A->allocated) {
-        A->data = NxMALLOC(sizeof(NxDTYPE)*m*n);
-        NxASSERT(A->data != NULL);
-        A->m = m; A->n = n;
-        A->allocated = true;
-        return ;
+/**
+ * @brief Initialize a Tensor in memory with a given element type.
+ *
+ * Same as NxTensor_alloc() but the elements are stored as `dtype`, an
+ * already allocated tensor of another dtype or size is reallocated. A
+ * tensor sharing its storage gets a buffer of its own, the other tensors
+ * are left untouched.
+ *
+ * @param A pointer to the Tensor object that will be allocated.
+ * @param m number of rows to be allocated.
+ * @param n number of columns to be allocated.
+ * @param dtype storage type of the elements.
+ */
+NxCDEF void NxTensor_alloc_dtype(NxTensor* A, u64 m, u64 n, NxDType dtype){
+    u64 shape[2] = {m, n};
+    NxTensor_alloc_nd(A, 2, shape, dtype);
+}
+
+/**
+ * @brief Give A the shape `shape` with row-major strides over its buffer.
+ */
+static void NxTensor_set_shape_nd(NxTensor* A, u32 ndim, const u64* shape) {
+    i64 stride = 1;
+    u32 k;
+    A->ndim = ndim;
+    for(k=ndim; k-- > 0; ) {
+        A->shape[k] = shape[k];
+        A->strides[k] = stride;
+        stride *= (i64)shape[k];
     }
-    if(m*n != A->m*A->n) {
+    A->layout = NxLAYOUT_NONE;
+    NxTensor_sync_2d(A);
+}
+
+/**
+ * @brief Whether NxTensor_alloc_nd() keeps the buffer of A for `bytes` bytes of `dtype`.
+ */
+static bool NxTensor_keeps_buffer(const NxTensor* A, u64 bytes, NxDType dtype) {
+    if(NxStorage_shared(A->storage) || dtype != A->dtype) {
+        return false;
+    }
+    return A->offset == 0 ? A->storage->bytes == bytes
+                          : A->storage->bytes - A->offset*NxDType_size(dtype) >= bytes;
+}
+
+/**
+ * @brief Keep the buffer of the input A alive while the output C is allocated.
+ *
+ * An operation takes the data pointer of its inputs before allocating C,
+ * so when C is A and does not keep its buffer (it is shared, read-only
+ * mapped or of another size) the buffer would be released under the
+ * pointer. The storage of A is then retained, the caller releases it
+ * once A has been read. Nothing is held when C is not A or writes in
+ * place.
+ *
+ * @param C pointer to the output tensor.
+ * @param A pointer to the input tensor whose data is read.
+ * @param size number of elements C is allocated with.
+ * @param dtype storage type C is allocated with.
+ *
+ * @return (NxStorage*) the storage to release after the operation, NULL when none was held.
+ */
+NxCDEF NxStorage* NxTensor_hold(NxTensor* C, NxTensor* A, u64 size, NxDType dtype) {
+    if(C != A || !A->allocated || NxTensor_keeps_buffer(A, size*NxDType_size(dtype), dtype)) {
+        return NULL;
+    }
+    NxStorage_retain(A->storage);
+    return A->storage;
+}
+
+/**
+ * @brief Release the storage returned by NxTensor_hold(), if any.
+ */
+NxCDEF void NxTensor_unhold(NxStorage* S) {
+    if(S != NULL) {
+        NxStorage_release(S);
+    }
+}
+
+/**
+ * @brief Initialize a contiguous N-dimensional tensor.
+ *
+ * The strides are row-major (the last dimension is contiguous). Like
+ * NxTensor_alloc(), a tensor that is the only user of its storage keeps
+ * it for the same dtype and size, and a tensor sharing its storage (a
+ * view, a copy) gets a buffer of its own (copy-on-write). The buffer comes from the current
+ * NxArena of the thread when there is one.
+ *
+ * @param A pointer to the Tensor object that will be allocated.
+ * @param ndim number of dimensions, at most NxMAX_DIMS.
+ * @param shape size of every dimension.
+ * @param dtype storage type of the elements.
+ */
+NxCDEF void NxTensor_alloc_nd(NxTensor* A, u32 ndim, const u64* shape, NxDType dtype){
+    NxASSERT(ndim >= 1 && ndim <= NxMAX_DIMS);
+
+    u64 size = 1;
+    u32 k;
+    NxLOOP(k, ndim) {
+        size *= shape[k];
+    }
+    u64 bytes = NxDType_size(dtype)*size;
+    /*
+     * A view that is the last owner of its storage keeps writing into it when
+     * the elements fit. The operations take their input pointers before this
+     * call and C may be one of them, they hold the inputs whose buffer is
+     * replaced here with NxTensor_hold().
+     */
+    if(A->allocated && !NxTensor_keeps_buffer(A, bytes, dtype)) {
         NxTensor_free(A);
-        NxTensor_alloc(A, m, n);
     }
+    if(!A->allocated) {
+        A->storage = NxStorage_alloc(bytes);
+        A->raw = A->storage->data;
+        A->arena = A->storage->policy == NxALLOC_ARENA;
+        A->offset = 0;
+        A->dtype = dtype;
+        A->allocated = true;
+    }
+    NxTensor_set_shape_nd(A, ndim, shape);
 }
 
 /**
@@ -48,12 +625,7 @@ NxCDEF void NxTensor_alloc(NxTensor* A, u64 m, u64 n){
  */
 NxCDEF void NxTensor_alloc_zeros(NxTensor* A, u64 m, u64 n){
     NxTensor_alloc(A, m, n);
-    u64 i, j;
-    NxLOOP(i, m) {
-        NxLOOP(j, n) {
-            A->data[n*i + j] = 0.0f;
-        }
-    }
+    memset(A->data, 0, sizeof(NxDTYPE)*m*n);
 }
 
 /**
@@ -67,12 +639,7 @@ NxCDEF void NxTensor_alloc_zeros(NxTensor* A, u64 m, u64 n){
  */
 NxCDEF void NxTensor_alloc_ones(NxTensor* A, u64 m, u64 n){
     NxTensor_alloc(A, m, n);
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            A->data[NxIDX(A->n, i, j)] = 1.0f;
-        }
-    }
+    NxKernels_get()->fill(m*n, 1.0, A->data);
 }
 
 /**
@@ -188,11 +755,18 @@ NxCDEF void NxTensor_alloc_linspace(NxTensor* A, NxDTYPE start, NxDTYPE end, u64
 
 /**
  * @brief Change the data of the tensor to another
- *for
+ *
+ * The tensor releases its storage and borrows `data`, which the caller
+ * keeps owning (NxTensor_free() leaves it alone). The shape, strides and
+ * dtype are kept.
  */
 NxCDEF void NxTensor_set_data(NxTensor* A, NxDTYPE* data) {
     NxASSERT(A->allocated);
+    NxStorage_release(A->storage);
+    A->storage = NxStorage_wrap(data, A->m*A->n*NxDType_size(A->dtype));
     A->data = data;
+    A->offset = 0;
+    A->arena = false;
 }
 
 
@@ -204,14 +778,55 @@ NxCDEF void NxTensor_set_data(NxTensor* A, NxDTYPE* data) {
  */
 NxCDEF void NxTensor_copy_data(NxTensor* C, NxTensor* A) {
     NxASSERT(A->allocated);
-    NxTensor_alloc(C, A->m, A->n);
-    memcpy(C->data, A->data, NxTensor_size(A));
+    if(C == A) {
+        return ;
+    }
+    if(NxTensor_is_contiguous(A)) {
+        /* Share the storage, the first write to either tensor copies it. */
+        NxTensor_make_view_nd(C, A, A->ndim, A->shape, A->strides, 0);
+        return ;
+    }
+    void* a = A->raw;
+    NxTensor_alloc_as(C, A, A->dtype);
+    if(C->raw != a) {
+        NxTensor_pack(C->raw, A);
+    }
+}
+
+/**
+ * @brief Convert the elements of a tensor to another type.
+ *
+ * Converting to bf16 or f16 rounds to nearest (ties to even), converting
+ * back to f32 or f64 is exact. With `C == A` the tensor is converted in place.
+ *
+ * @param C pointer to the output tensor.
+ * @param A pointer to the input tensor.
+ * @param dtype the type of the elements of C.
+ *
+ * @see NxDType_convert()
+ */
+NxCDEF void NxTensor_astype(NxTensor* C, NxTensor* A, NxDType dtype) {
+    NxASSERT(A->allocated);
+
+    if(C == A) {
+        NxTensor T = {0};
+        NxTensor_astype(&T, A, dtype);
+        NxTensor_free(A);
+        *A = T;
+        return ;
+    }
+    NxTensor TA = {0};
+    NxTensor* P = NxTensor_packed(A, &TA);
+    NxTensor_alloc_as(C, A, dtype);
+    NxDType_convert(NxTensor_size(A), C->raw, dtype, P->raw, A->dtype);
+    NxTensor_free(&TA);
 }
 
 
 /**
  * @brief Perform element wize addition operation
  *
+ * The f64 tensors go through the daxpy of the active backend (NxBackend_get()).
  */
 NxCDEF void NxTensor_add_tensor(NxTensor* C, NxTensor* A, NxTensor* B){
     NxASSERT(A->allocated);
@@ -223,13 +838,13 @@ NxCDEF void NxTensor_add_tensor(NxTensor* C, NxTensor* A, NxTensor* B){
         exit(EXIT_FAILURE);
     }
 
-    NxTensor_alloc(C, A->m, A->n);
-    // cblas_dgeadd(CblasRowMajor, C->m, C->n, 1.0, A->data, A->n, 1.0, C->data, C->n);
+    NxTensor_binary(C, A, B, NxTensor_backend_add, NxKernels_get_f32()->add);
 }
 
 /**
  * @brief Perform element wize substraction operation
  *
+ * The f64 tensors go through the daxpy of the active backend (NxBackend_get()).
  */
 NxCDEF void NxTensor_sub_tensor(NxTensor* C, NxTensor* A, NxTensor* B){
     NxASSERT(A->allocated);
@@ -241,14 +856,13 @@ NxCDEF void NxTensor_sub_tensor(NxTensor* C, NxTensor* A, NxTensor* B){
         exit(EXIT_FAILURE);
     }
 
-    NxTensor_neg_(B);
-    NxTensor_alloc(C, A->m, A->n);
-    // cblas_dgeadd(CblasRowMajor, C->m, C->n, 1.0, A->data, A->n, 1.0, C->data, C->n);
+    NxTensor_binary(C, A, B, NxTensor_backend_sub, NxKernels_get_f32()->sub);
 }
 
 /**
  * @brief Perform element wize multiplication operation
  *
+ * Runs in a single pass over the flat buffers with the SIMD kernel picked at load time.
  */
 NxCDEF void NxTensor_mul_tensor(NxTensor* C, NxTensor* A, NxTensor* B){
     NxASSERT(A->allocated);
@@ -260,13 +874,13 @@ NxCDEF void NxTensor_mul_tensor(NxTensor* C, NxTensor* A, NxTensor* B){
         exit(EXIT_FAILURE);
     }
 
-    NxTensor_alloc(C, A->m, A->n);
-    // cblas_dgeadd(CblasRowMajor, C->m, C->n, 1.0, A->data, A->n, 1.0, C->data, C->n);
+    NxTensor_binary(C, A, B, NxKernels_get()->mul, NxKernels_get_f32()->mul);
 }
 
 /**
  * @brief Perform element wize division operation
  *
+ * Runs in a single pass over the flat buffers with the SIMD kernel picked at load time.
  */
 NxCDEF void NxTensor_div_tensor(NxTensor* C, NxTensor* A, NxTensor* B){
     NxASSERT(A->allocated);
@@ -278,90 +892,214 @@ NxCDEF void NxTensor_div_tensor(NxTensor* C, NxTensor* A, NxTensor* B){
         exit(EXIT_FAILURE);
     }
 
-    NxTensor_alloc(C, A->m, A->n);
-    // cblas_dgeadd(CblasRowMajor, C->m, C->n, 1.0, A->data, A->n, 1.0, C->data, C->n);
+    NxTensor_binary(C, A, B, NxKernels_get()->div, NxKernels_get_f32()->div);
 }
 
 /**
- * @brief Perform element wize addition with broadcast
+ * @brief Define NxTensor_broadcast_row_T() running op over one output row of n elements.
  *
+ * `sa` and `sb` are the strides of the operands along the row, 0 for a
+ * broadcast value. The common shapes go to the SIMD kernels: equal rows
+ * (row-vector bias), a scalar per row (column vector) on either side;
+ * anything else falls back to a strided scalar loop.
  */
-NxCDEF void NxTensor_add_tensor_boradcast(NxTensor* C, NxTensor* A, NxTensor* B, u8 axis) {
+#define NxTENSOR_DEFINE_BROADCAST_ROW(T, K)                                                   \
+static void NxTensor_broadcast_row_##T(NxBinaryOp op, u64 n, const T* a, i64 sa,             \
+                                       const T* b, i64 sb, T* c) {                           \
+    u64 j;                                                                                   \
+    if(sa == 1 && sb == 1) {                                                                 \
+        switch(op) {                                                                         \
+        case NxOP_ADD: K->add(n, a, b, c); return ;                                          \
+        case NxOP_SUB: K->sub(n, a, b, c); return ;                                          \
+        case NxOP_MUL: K->mul(n, a, b, c); return ;                                          \
+        case NxOP_DIV: K->div(n, a, b, c); return ;                                          \
+        }                                                                                    \
+    }                                                                                        \
+    if(sa == 1 && sb == 0) {                                                                 \
+        switch(op) {                                                                         \
+        case NxOP_ADD: K->add_scalar(n, a, b[0], c); return ;                                \
+        case NxOP_SUB: K->add_scalar(n, a, -b[0], c); return ;                               \
+        case NxOP_MUL: K->mul_scalar(n, a, b[0], c); return ;                                \
+        case NxOP_DIV: K->div_scalar(n, a, b[0], c); return ;                                \
+        }                                                                                    \
+    }                                                                                        \
+    if(sa == 0 && sb == 1 && op != NxOP_DIV) {                                               \
+        switch(op) {                                                                         \
+        case NxOP_ADD: K->add_scalar(n, b, a[0], c); return ;                                \
+        case NxOP_SUB: K->neg(n, b, c); K->add_scalar(n, c, a[0], c); return ;               \
+        default:       K->mul_scalar(n, b, a[0], c); return ;                                \
+        }                                                                                    \
+    }                                                                                        \
+    switch(op) {                                                                             \
+    case NxOP_ADD: NxLOOP(j, n) { c[j] = a[(i64)j*sa] + b[(i64)j*sb]; } break;               \
+    case NxOP_SUB: NxLOOP(j, n) { c[j] = a[(i64)j*sa] - b[(i64)j*sb]; } break;               \
+    case NxOP_MUL: NxLOOP(j, n) { c[j] = a[(i64)j*sa] * b[(i64)j*sb]; } break;               \
+    case NxOP_DIV: NxLOOP(j, n) { c[j] = a[(i64)j*sa] / b[(i64)j*sb]; } break;               \
+    }                                                                                        \
+}
+
+NxTENSOR_DEFINE_BROADCAST_ROW(f64, NxKernels_get())
+NxTENSOR_DEFINE_BROADCAST_ROW(f32, NxKernels_get_f32())
+
+/**
+ * @brief Perform an element wize operation with NumPy style broadcasting.
+ *
+ * The shapes are aligned on their last dimension and every dimension must
+ * either match or be 1 in one of the operands, e.g. (batch, features) with
+ * (1, features) or (features), or (batch, features) with (batch, 1). The
+ * broadcast operand is read with a zero stride so nothing is materialized,
+ * and each output row goes through NxTensor_broadcast_row_T().
+ *
+ * @param C pointer to the output tensor, allocated with the broadcast shape.
+ * @param A pointer to the first operand.
+ * @param B pointer to the second operand.
+ * @param op the operation to perform.
+ */
+NxCDEF void NxTensor_broadcast(NxTensor* C, NxTensor* A, NxTensor* B, NxBinaryOp op) {
     NxASSERT(A->allocated);
     NxASSERT(B->allocated);
 
-    (void) C;
-    (void) A;
-    (void) B;
-    (void) axis;
+    if(A->dtype != B->dtype || (A->dtype != NxFLOAT64 && A->dtype != NxFLOAT32)) {
+        fprintf(stderr, "Cannot broadcast tensors with dtypes %s and %s.\n",
+                NxDType_name(A->dtype), NxDType_name(B->dtype));
+        exit(EXIT_FAILURE);
+    }
+
+    u32 ndim = A->ndim > B->ndim ? A->ndim : B->ndim, k;
+    u64 shape[NxMAX_DIMS];
+    i64 sa[NxMAX_DIMS], sb[NxMAX_DIMS];
+    NxLOOP(k, ndim) {
+        i32 ka = (i32)k - (i32)(ndim - A->ndim), kb = (i32)k - (i32)(ndim - B->ndim);
+        u64 da = ka >= 0 ? A->shape[ka] : 1, db = kb >= 0 ? B->shape[kb] : 1;
+        if(da != db && da != 1 && db != 1) {
+            fprintf(stderr, "Cannot broadcast dimension %u of sizes %" PRIu64 " and %" PRIu64 ".\n", k, da, db);
+            exit(EXIT_FAILURE);
+        }
+        shape[k] = da > db ? da : db;
+        sa[k] = da == 1 ? 0 : A->strides[ka];
+        sb[k] = db == 1 ? 0 : B->strides[kb];
+    }
 
-    if (axis == NxAXIS_ROW) {
+    /* The output may only share its buffer with an operand of exactly its layout. */
+    NxTensor T = {0}, *out = C;
+    if(C == B || (C == A && (!NxTensor_is_contiguous(A) || A->ndim != ndim ||
+                             memcmp(A->shape, shape, ndim*sizeof(u64)) != 0))) {
+        out = &T;
+    }
+    const char* a = A->raw;
+    const char* b = B->raw;
+    NxDType dtype = A->dtype;
+    NxStorage* H = NxTensor_hold(out, A, NxTensor_size(A), dtype);
+    NxTensor_alloc_nd(out, ndim, shape, dtype);
+
+    u64 n = shape[ndim - 1], row, rows = n ? NxTensor_size(out) / n : 0;
+    u64 idx[NxMAX_DIMS] = {0};
+    i64 oa = 0, ob = 0;
+    NxLOOP(row, rows) {
+        if(dtype == NxFLOAT64) {
+            NxTensor_broadcast_row_f64(op, n, (const f64*)a + oa, sa[ndim - 1],
+                                       (const f64*)b + ob, sb[ndim - 1], out->data + row*n);
+        } else {
+            NxTensor_broadcast_row_f32(op, n, (const f32*)a + oa, sa[ndim - 1],
+                                       (const f32*)b + ob, sb[ndim - 1], out->data_f32 + row*n);
+        }
+        for(k=ndim - 1; k-- > 0; ) {
+            oa += sa[k]; ob += sb[k];
+            if(++idx[k] < shape[k]) {
+                break;
+            }
+            oa -= sa[k]*(i64)shape[k]; ob -= sb[k]*(i64)shape[k];
+            idx[k] = 0;
+        }
+    }
 
-    } else if (axis == NxAXIS_COL) {
+    NxTensor_unhold(H);
+    if(out == &T) {
+        NxTensor_free(C);
+        *C = T;
+    }
+}
 
+/**
+ * @brief Run op between A and the vector B viewed as a row (1, n) or a column (m, 1).
+ */
+static void NxTensor_broadcast_axis(NxTensor* C, NxTensor* A, NxTensor* B, u8 axis, NxBinaryOp op) {
+    u64 len = axis == NxAXIS_ROW ? A->n : A->m;
+    if(axis != NxAXIS_ROW && axis != NxAXIS_COL) {
+        fprintf(stderr, "Unknown broadcast axis %d.\n", (int)axis);
+        exit(EXIT_FAILURE);
+    }
+    if(B->m*B->n != len || (B->m != 1 && B->n != 1)) {
+        fprintf(stderr, "Cannot broadcast tensor with shape (%" PRIu64 ", %" PRIu64 ") over (%" PRIu64 ", %" PRIu64 ").\n",
+                B->m, B->n, A->m, A->n);
+        exit(EXIT_FAILURE);
+    }
+    i64 stride = B->n == 1 ? B->rs : B->cs;
+    NxTensor V = *B, T = {0};
+    V.ndim = 2;
+    V.shape[0] = axis == NxAXIS_ROW ? 1 : len;
+    V.shape[1] = axis == NxAXIS_ROW ? len : 1;
+    V.strides[0] = axis == NxAXIS_ROW ? 0 : stride;
+    V.strides[1] = axis == NxAXIS_ROW ? stride : 0;
+    NxTensor_sync_2d(&V);
+    /* V borrows the buffer of B, so B can not receive the result directly. */
+    NxTensor_broadcast(C == B ? &T : C, A, &V, op);
+    if(C == B) {
+        NxTensor_free(C);
+        *C = T;
     }
 }
 
 /**
- * @brief Perform element wize substraction with broadcast
+ * @brief Perform element wize addition with broadcast
+ *
+ * With `axis == NxAXIS_ROW` B holds one value per column of A (a bias row
+ * added to every row), with NxAXIS_COL one value per row. B may be stored
+ * as a row or a column vector, it is never copied.
  *
+ * @see NxTensor_broadcast() for general shapes.
  */
-NxCDEF void NxTensor_sub_tensor_boradcast(NxTensor* C, NxTensor* A, NxTensor* B, u8 axis) {
+NxCDEF void NxTensor_add_tensor_boradcast(NxTensor* C, NxTensor* A, NxTensor* B, u8 axis) {
     NxASSERT(A->allocated);
     NxASSERT(B->allocated);
 
-    (void) C;
-    (void) A;
-    (void) B;
-    (void) axis;
-
-    if (axis == NxAXIS_ROW) {
+    NxTensor_broadcast_axis(C, A, B, axis, NxOP_ADD);
+}
 
-    } else if (axis == NxAXIS_COL) {
+/**
+ * @brief Perform element wize substraction with broadcast
+ *
+ * @see NxTensor_add_tensor_boradcast() for the meaning of axis.
+ */
+NxCDEF void NxTensor_sub_tensor_boradcast(NxTensor* C, NxTensor* A, NxTensor* B, u8 axis) {
+    NxASSERT(A->allocated);
+    NxASSERT(B->allocated);
 
-    }
+    NxTensor_broadcast_axis(C, A, B, axis, NxOP_SUB);
 }
 
 /**
  * @brief Perform element wize multiplication with broadcast
  *
+ * @see NxTensor_add_tensor_boradcast() for the meaning of axis.
  */
 NxCDEF void NxTensor_mul_tensor_broadcast(NxTensor* C, NxTensor* A, NxTensor* B, u8 axis) {
     NxASSERT(A->allocated);
     NxASSERT(B->allocated);
 
-    (void) C;
-    (void) A;
-    (void) B;
-    (void) axis;
-
-    if (axis == NxAXIS_ROW) {
-
-    } else if (axis == NxAXIS_COL) {
-
-    }
+    NxTensor_broadcast_axis(C, A, B, axis, NxOP_MUL);
 }
 
 /**
  * @brief Perform element wize division with broadcast
  *
+ * @see NxTensor_add_tensor_boradcast() for the meaning of axis.
  */
 NxCDEF void NxTensor_div_tensor_broadcast(NxTensor* C, NxTensor* A, NxTensor* B, u8 axis) {
     NxASSERT(A->allocated);
     NxASSERT(B->allocated);
 
-    NxNOTIMPLEMENTED();
-
-    (void) C;
-    (void) A;
-    (void) B;
-    (void) axis;
-
-    if (axis == NxAXIS_ROW) {
-
-    } else if (axis == NxAXIS_COL) {
-
-    }
+    NxTensor_broadcast_axis(C, A, B, axis, NxOP_DIV);
 }
 
 /**
@@ -371,13 +1109,7 @@ NxCDEF void NxTensor_div_tensor_broadcast(NxTensor* C, NxTensor* A, NxTensor* B,
 NxCDEF void NxTensor_add_scalar(NxTensor* C, NxTensor* A, NxDTYPE B){
     NxASSERT(A->allocated);
 
-    NxTensor_alloc(C, A->m, A->n);
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            C->data[C->n*i + j] = A->data[NxIDX(A->n, i, j)] + B;
-        }
-    }
+    NxTensor_scalar(C, A, B, NxKernels_get()->add_scalar, NxKernels_get_f32()->add_scalar);
 }
 
 /**
@@ -387,29 +1119,18 @@ NxCDEF void NxTensor_add_scalar(NxTensor* C, NxTensor* A, NxDTYPE B){
 NxCDEF void NxTensor_sub_scalar(NxTensor* C, NxTensor* A, NxDTYPE B){
     NxASSERT(A->allocated);
 
-    NxTensor_alloc(C, A->m, A->n);
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            C->data[C->n*i + j] = A->data[NxIDX(A->n, i, j)] - B;
-        }
-    }
+    NxTensor_scalar(C, A, -B, NxKernels_get()->add_scalar, NxKernels_get_f32()->add_scalar);
 }
 
 /**
  * @brief Perform element wize multiplication with scalar value.
  *
+ * The f64 tensors go through the dscal of the active backend (NxBackend_get()).
  */
 NxCDEF void NxTensor_mul_scalar(NxTensor* C, NxTensor* A, NxDTYPE B){
     NxASSERT(A->allocated);
 
-    NxTensor_alloc(C, A->m, A->n);
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            C->data[C->n*i + j] = A->data[NxIDX(A->n, i, j)] * B;
-        }
-    }
+    NxTensor_scalar(C, A, B, NxTensor_backend_scale, NxKernels_get_f32()->mul_scalar);
 }
 
 /**
@@ -419,13 +1140,7 @@ NxCDEF void NxTensor_mul_scalar(NxTensor* C, NxTensor* A, NxDTYPE B){
 NxCDEF void NxTensor_div_scalar(NxTensor* C, NxTensor* A, NxDTYPE B){
     NxASSERT(A->allocated);
 
-    NxTensor_alloc(C, A->m, A->n);
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            C->data[C->n*i + j] = A->data[NxIDX(A->n, i, j)] / B;
-        }
-    }
+    NxTensor_scalar(C, A, B, NxKernels_get()->div_scalar, NxKernels_get_f32()->div_scalar);
 }
 
 /**
@@ -439,12 +1154,7 @@ NxCDEF void NxTensor_div_scalar(NxTensor* C, NxTensor* A, NxDTYPE B){
 NxCDEF void NxTensor_add_scalar_(NxTensor* A, NxDTYPE B){
     NxASSERT(A->allocated);
 
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            A->data[NxIDX(A->n, i, j)] = A->data[NxIDX(A->n, i, j)] + B;
-        }
-    }
+    NxTensor_add_scalar(A, A, B);
 }
 
 /**
@@ -458,12 +1168,7 @@ NxCDEF void NxTensor_add_scalar_(NxTensor* A, NxDTYPE B){
 NxCDEF void NxTensor_sub_scalar_(NxTensor* A, NxDTYPE B){
     NxASSERT(A->allocated);
 
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            A->data[NxIDX(A->n, i, j)] = A->data[NxIDX(A->n, i, j)] - B;
-        }
-    }
+    NxTensor_sub_scalar(A, A, B);
 }
 
 /**
@@ -477,12 +1182,11 @@ NxCDEF void NxTensor_sub_scalar_(NxTensor* A, NxDTYPE B){
 NxCDEF void NxTensor_mul_scalar_(NxTensor* A, NxDTYPE B){
     NxASSERT(A->allocated);
 
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            A->data[NxIDX(A->n, i, j)] = A->data[NxIDX(A->n, i, j)] * B;
-        }
+    if(A->dtype == NxFLOAT64 && NxTensor_is_contiguous(A) && !NxTensor_is_shared(A)) {
+        NxBackend_get()->dscal(NxTensor_size(A), B, A->data);
+        return ;
     }
+    NxTensor_mul_scalar(A, A, B);
 }
 
 /**
@@ -497,21 +1201,15 @@ NxCDEF void NxTensor_div_scalar_(NxTensor* A, NxDTYPE B){
     NxASSERT(A->allocated);
     NxASSERT(B != 0);
 
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            A->data[NxIDX(A->n, i, j)] = A->data[NxIDX(A->n, i, j)] / B;
-        }
-    }
+    NxTensor_div_scalar(A, A, B);
 }
 
 /**
  * @brief Perform Tensor Multiplication.
  *
  * This function is used to perfor the matrix multiplication operation. This function
- * uses the BLAS Subroutine `cblas_dgemm` to perform the multiplication and that for two resoans.
- * one it's very fast how this routine is implemented and second it's quite stable and don't
- * have unsual behaviors.
+ * uses the `dgemm` routine of the active backend (see NxBackend_init()) which is the
+ * native GEMM engine NxGemm_dgemm() by default, or a vendor BLAS loaded at runtime.
  *
  * First it check if the multiplication operation is valid for the supplied tensors where the
  * number of columns of the first tensor must equals the number of rows of the second tensor.
@@ -521,108 +1219,353 @@ NxCDEF void NxTensor_div_scalar_(NxTensor* A, NxDTYPE B){
  * @param A The first tensor with shape (m, n).
  * @param B The second tensor with shape (n, k).
  *
- * @see NxTensor_mul_tensor()
+ * A and B may be views (e.g. from NxTensor_transpose()), their strides are
+ * handed to the GEMM so they are never copied. C may be A or B.
+ *
+ * @see NxTensor_mul_tensor(), NxGemm_dgemm(), NxBackend_get()
  */
 NxCDEF void NxTensor_matmul_tensor(NxTensor* C, NxTensor* A, NxTensor* B){
     NxASSERT(A->allocated);
     NxASSERT(B->allocated);
 
+    if(A->dtype != B->dtype) {
+        fprintf(stderr, "Cannot multiply tensors with dtypes %s and %s.\n",
+                NxDType_name(A->dtype), NxDType_name(B->dtype));
+        exit(EXIT_FAILURE);
+    }
     if(A->n != B->m){
         fprintf(stderr, "Cannot multiply matrix with shape (%I64u, %I64u) with (%I64u, %I64u).\n",
                 A->m, A->n, B->m, B->n);
         exit(EXIT_FAILURE);
     }
 
-    NxTensor_alloc(C, A->m, B->n);
-    // cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans,
-    //             C->m, C->n, A->n, 1.0, A->data, A->n, B->data, B->n, 1.0, C->data, C->n);
+    /*
+     * The GEMM reads A and B while writing C, an aliased output goes to R
+     * first. The other dtypes are multiplied in f64 and rounded once at the end.
+     */
+    NxTensor TA = {0}, TB = {0}, WA = {0}, WB = {0}, R = {0};
+    NxDType dtype = A->dtype;
+    NxTensor* out = C == A || C == B || dtype != NxFLOAT64 ? &R : C;
+    u64 m = A->m, n = B->n, k = A->n;
+    NxTensor* PA = NxTensor_matrix(NxTensor_widened(A, &WA), &TA);
+    NxTensor* PB = NxTensor_matrix(NxTensor_widened(B, &WB), &TB);
+    NxTensor_alloc(out, m, n);
+    NxBackend_get()->dgemm(m, n, k, 1.0,
+                           PA->data, PA->rs, PA->cs,
+                           PB->data, PB->rs, PB->cs,
+                           0.0, out->data, out->rs, out->cs);
+    NxTensor_free(&TA);
+    NxTensor_free(&TB);
+    NxTensor_free(&WA);
+    NxTensor_free(&WB);
+    if(out == &R && dtype != NxFLOAT64) {
+        NxTensor_astype(C, &R, dtype);
+        NxTensor_free(&R);
+    } else if(out == &R) {
+        NxTensor_free(C);
+        *C = R;
+    }
+}
+
+/**
+ * @brief Reshape tensor to a given shape.
+ *
+ * Reshapes a tensor from it's shape to a new shape but first it
+ * checks that the new shape is the same as older shape. A contiguous
+ * tensor is reshaped as an O(1) view, a strided one is copied first.
+ *
+ * @param B pointer to the output tensor.
+ * @param A pointer to the input tensor.
+ * @param m new number of rows.
+ * @param n new number of columns.
+ *
+ * @see NxTensor_reshape_() for inplace reshaping.
+ */
+NxCDEF void NxTensor_reshape(NxTensor* B, NxTensor* A, u64 m, u64 n) {
+    NxASSERT(A->allocated);
+
+    if(m*n != A->m*A->n) {
+        fprintf(stderr, "cannot reshape tensor with shape (%I64u, %I64u) to (%I64u, %I64u)\n",
+                A->m, A->n, m, n);
+        exit(EXIT_FAILURE);
+    }
+    if(!NxTensor_is_contiguous(A)) {
+        NxTensor_contiguous(B, A);
+        A = B;
+    }
+    NxTensor_make_view(B, A, m, n, n, 1, 0);
+}
+
+/**
+ * @brief Inplace reshaping of a tensor from shape to another.
+ *
+ * Inplace Reshaping from the original tensor shape to the specified shape in the
+ * argument and it first check if the new shape match the new shape.
+ *
+ * @param A pointer to the tensor object to initialize.
+ * @param m new number of rows.
+ * @param n new number of columns
+ */
+
+NxCDEF void NxTensor_reshape_(NxTensor* A, u64 m, u64 n) {
+    NxTensor_reshape(A, A, m, n);
+}
+
+/**
+ * @brief Transpose the Tensor object.
+ *
+ * B becomes a view of A with the rows and columns (and their strides)
+ * swapped, nothing is copied. Use NxTensor_contiguous() to get a
+ * transposed copy with its own row-major buffer.
+ *
+ * @param B The transposed tensor.
+ * @param A The tensor to calculate the transpose for.
+ */
+NxCDEF void NxTensor_transpose(NxTensor* B, NxTensor* A) {
+    NxASSERT(A->allocated);
+
+    if(!NxTensor_collapse(A, NULL)) {
+        NxTensor_contiguous(B, A);
+        A = B;
+    }
+    NxTensor_make_view(B, A, A->n, A->m, A->cs, A->rs, 0);
+}
+
+/**
+ * @brief Transpose the Tensor object inplace.
+ *
+ * Perform transpose operation on the tensor A and store the resulting in the same tensor. 
+ *
+ * @param A The tensor to calculate the transpose for.
+ */
+NxCDEF void NxTensor_transpose_(NxTensor* A) {
+    NxTensor_transpose(A, A);
+}
+
+/**
+ * @brief View a block of a tensor.
+ *
+ * C becomes an O(1) view of the rows [r0, r1) and columns [c0, c1) of A.
+ *
+ * @param C pointer to the output view.
+ * @param A pointer to the input tensor.
+ * @param r0 first row.
+ * @param r1 end row (exclusive).
+ * @param c0 first column.
+ * @param c1 end column (exclusive).
+ */
+NxCDEF void NxTensor_slice(NxTensor* C, NxTensor* A, u64 r0, u64 r1, u64 c0, u64 c1) {
+    NxASSERT(A->allocated);
+
+    if(r0 > r1 || r1 > A->m || c0 > c1 || c1 > A->n) {
+        fprintf(stderr, "Cannot slice [%" PRIu64 ":%" PRIu64 ", %" PRIu64 ":%" PRIu64 "] from tensor with shape (%" PRIu64 ", %" PRIu64 ").\n",
+                r0, r1, c0, c1, A->m, A->n);
+        exit(EXIT_FAILURE);
+    }
+    if(!NxTensor_collapse(A, NULL)) {
+        NxTensor_contiguous(C, A);
+        A = C;
+    }
+    NxTensor_make_view(C, A, r1 - r0, c1 - c0, A->rs, A->cs, r0*A->rs + c0*A->cs);
+}
+
+/**
+ * @brief View the rows [r0, r1) of a tensor, e.g. a mini-batch.
+ *
+ * The view of a contiguous tensor is itself contiguous, so it goes
+ * through the flat kernels without any copy.
+ */
+NxCDEF void NxTensor_rows(NxTensor* C, NxTensor* A, u64 r0, u64 r1) {
+    NxTensor_slice(C, A, r0, r1, 0, A->n);
+}
+
+/**
+ * @brief View the columns [c0, c1) of a tensor.
+ */
+NxCDEF void NxTensor_cols(NxTensor* C, NxTensor* A, u64 c0, u64 c1) {
+    NxTensor_slice(C, A, 0, A->m, c0, c1);
+}
+
+/**
+ * @brief Whether the elements of the tensor are stored row after row without gaps.
+ */
+NxCDEF bool NxTensor_is_contiguous(NxTensor* A) {
+    i64 expected = 1;
+    u32 k;
+    for(k=A->ndim; k-- > 0; ) {
+        if(A->shape[k] == 1) {
+            continue;
+        }
+        if(A->strides[k] != expected) {
+            return false;
+        }
+        expected *= (i64)A->shape[k];
+    }
+    return true;
+}
+
+/**
+ * @brief Copy a tensor (usually a view) into a contiguous row-major buffer.
+ *
+ * The copy is done in cache sized tiles. With `C == A` the tensor is
+ * packed in place, which is a no-op when it is already contiguous.
+ *
+ * @param C pointer to the output tensor.
+ * @param A pointer to the input tensor.
+ */
+NxCDEF void NxTensor_contiguous(NxTensor* C, NxTensor* A) {
+    NxASSERT(A->allocated);
+
+    if(C == A) {
+        if(NxTensor_is_contiguous(A)) {
+            return ;
+        }
+        NxTensor T = {0};
+        NxTensor_contiguous(&T, A);
+        NxTensor_free(A);
+        *A = T;
+        return ;
+    }
+    NxTensor_copy_data(C, A);
 }
 
 /**
- * @brief Reshape tensor to a given shape.
+ * @brief Give a tensor a new N-dimensional shape with the same number of elements.
  *
- * Reshapes a tensor from it's shape to a new shape but first it
- * checks that the new shape is the same as older shape.
+ * A contiguous tensor is reshaped as an O(1) view, a strided one is copied
+ * first, e.g. a (batch*time, features) matrix to (batch, time, features).
  *
- * @param B pointer to the output tensor.
+ * @param C pointer to the output tensor.
  * @param A pointer to the input tensor.
- * @param m new number of rows.
- * @param n new number of columns.
- *
- * @see NxTensor_reshape_() for inplace reshaping.
+ * @param ndim number of dimensions, at most NxMAX_DIMS.
+ * @param shape size of every dimension.
  */
-NxCDEF void NxTensor_reshape(NxTensor* B, NxTensor* A, u64 m, u64 n) {
+NxCDEF void NxTensor_reshape_nd(NxTensor* C, NxTensor* A, u32 ndim, const u64* shape) {
     NxASSERT(A->allocated);
+    NxASSERT(ndim >= 1 && ndim <= NxMAX_DIMS);
 
-    if(m*n != A->m*A->n) {
-        fprintf(stderr, "cannot reshape tensor with shape (%I64u, %I64u) to (%I64u, %I64u)\n",
-                A->m, A->n, m, n);
+    u64 size = 1, dims[NxMAX_DIMS];
+    i64 strides[NxMAX_DIMS], stride = 1;
+    u32 k;
+    NxLOOP(k, ndim) {
+        size *= shape[k];
+    }
+    if(size != A->m*A->n) {
+        fprintf(stderr, "cannot reshape tensor with %" PRIu64 " elements to %" PRIu64 " elements.\n",
+                A->m*A->n, size);
         exit(EXIT_FAILURE);
     }
-    NxTensor_alloc(B, m, n);
-    NxTensor_set_data(B, A->data);
+    memcpy(dims, shape, ndim*sizeof(u64));
+    for(k=ndim; k-- > 0; ) {
+        strides[k] = stride;
+        stride *= (i64)dims[k];
+    }
+    if(!NxTensor_is_contiguous(A)) {
+        NxTensor_contiguous(C, A);
+        A = C;
+    }
+    NxTensor_make_view_nd(C, A, ndim, dims, strides, 0);
 }
 
 /**
- * @brief Inplace reshaping of a tensor from shape to another.
+ * @brief Reorder the dimensions of a tensor without moving any data.
  *
- * Inplace Reshaping from the original tensor shape to the specified shape in the
- * argument and it first check if the new shape match the new shape.
+ * Dimension k of C is dimension `axes[k]` of A, so the 2-D transpose is
+ * `axes = {1, 0}` and NCHW to NHWC is `axes = {0, 2, 3, 1}`. C is an O(1)
+ * view, see NxTensor_contiguous() to pack it.
  *
- * @param A pointer to the tensor object to initialize.
- * @param m new number of rows.
- * @param n new number of columns
+ * @param C pointer to the output view.
+ * @param A pointer to the input tensor.
+ * @param axes a permutation of `0 .. A->ndim-1`.
  */
-
-NxCDEF void NxTensor_reshape_(NxTensor* A, u64 m, u64 n) {
+NxCDEF void NxTensor_permute(NxTensor* C, NxTensor* A, const u32* axes) {
     NxASSERT(A->allocated);
 
-    if(m*n != A->m*A->n) {
-        fprintf(stderr, "cannot reshape tensor with shape (%I64u, %I64u) to (%I64u, %I64u).\n",
-                A->m, A->n, m, n);
-        exit(EXIT_FAILURE);
+    u64 shape[NxMAX_DIMS];
+    i64 strides[NxMAX_DIMS];
+    bool seen[NxMAX_DIMS] = {0};
+    u32 k;
+    NxLOOP(k, A->ndim) {
+        if(axes[k] >= A->ndim || seen[axes[k]]) {
+            fprintf(stderr, "Invalid permutation of a tensor with %u dimensions.\n", A->ndim);
+            exit(EXIT_FAILURE);
+        }
+        seen[axes[k]] = true;
+        shape[k] = A->shape[axes[k]];
+        strides[k] = A->strides[axes[k]];
     }
-    A->m = m; A->n = n;
+    NxTensor_make_view_nd(C, A, A->ndim, shape, strides, 0);
+    C->layout = NxLAYOUT_NONE;
 }
 
 /**
- * @brief Transpose the Tensor object.
+ * @brief View the range [start, end) of one dimension of a tensor.
  *
- * Perform transpose operation on the tensor A and store the resulting in the B tensor.
+ * Unlike NxTensor_rows() the other dimensions are kept, e.g. a mini-batch
+ * of a (batch, time, features) tensor is `NxTensor_narrow(C, A, 0, b0, b1)`.
  *
- * @param B The transposed tensor.
- * @param A The tensor to calculate the transpose for.
+ * @param C pointer to the output view.
+ * @param A pointer to the input tensor.
+ * @param axis the dimension to narrow.
+ * @param start first index.
+ * @param end end index (exclusive).
  */
-NxCDEF void NxTensor_transpose(NxTensor* B, NxTensor* A) {
+NxCDEF void NxTensor_narrow(NxTensor* C, NxTensor* A, u32 axis, u64 start, u64 end) {
     NxASSERT(A->allocated);
 
-    NxTensor_free(B);
-    NxTensor_alloc(B, A->n, A->m);
-    NxTensor_set_data(B, A->data);
+    if(axis >= A->ndim || start > end || end > A->shape[axis]) {
+        fprintf(stderr, "Cannot narrow dimension %u to [%" PRIu64 ":%" PRIu64 "].\n", axis, start, end);
+        exit(EXIT_FAILURE);
+    }
+    u64 shape[NxMAX_DIMS];
+    memcpy(shape, A->shape, sizeof(shape));
+    shape[axis] = end - start;
+    NxTensor_make_view_nd(C, A, A->ndim, shape, A->strides, start*A->strides[axis]);
 }
 
 /**
- * @brief Transpose the Tensor object inplace.
+ * @brief Convert a 4-D image tensor between the NCHW and NHWC layouts.
  *
- * Perform transpose operation on the tensor A and store the resulting in the same tensor. 
+ * The dimensions are permuted and packed with a tiled copy, C gets its
+ * own contiguous buffer tagged with the new layout. Converting to the
+ * layout A already has is a plain copy.
  *
- * @param A The tensor to calculate the transpose for.
+ * @param C pointer to the output tensor.
+ * @param A pointer to a 4-D tensor tagged NxLAYOUT_NCHW or NxLAYOUT_NHWC.
+ * @param layout NxLAYOUT_NCHW or NxLAYOUT_NHWC.
  */
-NxCDEF void NxTensor_transpose_(NxTensor* A) {
+NxCDEF void NxTensor_to_layout(NxTensor* C, NxTensor* A, NxLayout layout) {
     NxASSERT(A->allocated);
 
-    u64 temp;
-
-    temp = A->n;
-    A->n = A->m;
-    A->m = temp;
+    static const u32 to_nhwc[4] = {0, 2, 3, 1};
+    static const u32 to_nchw[4] = {0, 3, 1, 2};
+    if(A->ndim != 4 || A->layout == NxLAYOUT_NONE || layout == NxLAYOUT_NONE) {
+        fprintf(stderr, "Layout conversion needs a 4-D NCHW or NHWC tensor.\n");
+        exit(EXIT_FAILURE);
+    }
+    NxTensor V = {0};
+    if(A->layout == layout) {
+        NxTensor_make_view_nd(&V, A, A->ndim, A->shape, A->strides, 0);
+    } else {
+        NxTensor_permute(&V, A, layout == NxLAYOUT_NHWC ? to_nhwc : to_nchw);
+    }
+    if(C == A) {
+        NxTensor T = {0};
+        NxTensor_copy_data(&T, &V);
+        NxTensor_free(A);
+        *A = T;
+    } else {
+        NxTensor_copy_data(C, &V);
+    }
+    C->layout = layout;
 }
 
 /**
  * @brief Sums Tensor elements along a given axis.
  * 
  * Sums a tensor alongside given axis that have only two value `NxAXIS_ROW`,
- * and `NxAXIS_COL`.
+ * and `NxAXIS_COL`. The sums run on NxReduce (pairwise/Kahan, multi-threaded),
+ * a transposed view is summed along its contiguous direction.
  * 
  * @param C pointer to the output tensor.
  * @param A pointer to the input tensor.
@@ -630,25 +1573,52 @@ NxCDEF void NxTensor_transpose_(NxTensor* A) {
  */
 NxCDEF void NxTensor_sum_tensor(NxTensor* C, NxTensor* A, u32 axis) {
     NxASSERT(A->allocated);
+    if(A->dtype != NxFLOAT64) {
+        NxDType dtype = A->dtype;
+        NxTensor W = {0};
+        NxTensor_astype(&W, A, NxFLOAT64);
+        NxTensor_sum_tensor(&W, &W, axis);
+        NxTensor_astype(C, &W, dtype);
+        NxTensor_free(&W);
+        return ;
+    }
 
-    u64 i, j;
+    if(axis != NxAXIS_ROW && axis != NxAXIS_COL) {
+        fprintf(stderr, "Cannot sum a tensor over the axis %u.\n", axis);
+        exit(EXIT_FAILURE);
+    }
+    NxTensor T = {0}, R = {0};
+    NxTensor* out = C == A ? &R : C;
+    A = NxTensor_matrix(A, &T);
+    bool rows_unit = A->n == 1 || A->cs == 1;
+    if(!rows_unit && A->m != 1 && A->rs != 1) {
+        NxTensor_contiguous(&T, A);
+        A = &T;
+        rows_unit = true;
+    }
 
+    u64 m = A->m, n = A->n;
+    i64 rs = A->rs, cs = A->cs;
+    const f64* a = A->data;
     if(axis == NxAXIS_ROW) {
-        NxTensor_alloc_zeros(C, 1, A->n);
-        NxLOOP(i, A->m) {
-            NxLOOP(j, A->n) {
-                C->data[j] += NxTensor_AT(A, i, j);
-            }
-        }
-    } else if (axis == NxAXIS_COL) {
-        NxTensor_alloc_zeros(C, A->m, 1);
-        NxLOOP(i, A->m) {
-            NxLOOP(j, A->n) {
-                C->data[i] += NxTensor_AT(A, i, j);
-            }
+        NxTensor_alloc(out, 1, n);
+        if(rows_unit) {
+            NxReduce_sum_over_rows(m, n, a, rs, out->data);
+        } else {
+            NxReduce_sum_over_cols(n, m, a, cs, out->data);
         }
     } else {
-        exit(EXIT_FAILURE);
+        NxTensor_alloc(out, m, 1);
+        if(rows_unit) {
+            NxReduce_sum_over_cols(m, n, a, rs, out->data);
+        } else {
+            NxReduce_sum_over_rows(n, m, a, cs, out->data);
+        }
+    }
+    NxTensor_free(&T);
+    if(out == &R) {
+        NxTensor_free(C);
+        *C = R;
     }
 }
 
@@ -662,15 +1632,20 @@ NxCDEF void NxTensor_sum_tensor(NxTensor* C, NxTensor* A, u32 axis) {
 NxCDEF void NxTensor_to_string(NxTensor* A){
     NxASSERT(A->allocated);
 
+    NxTensor T = {0}, W = {0};
+    A = NxTensor_matrix(NxTensor_widened(A, &W), &T);
+
     printf("Tensor(%I64d, %I64d)\n", A->m, A->n);
     u64 i, j;
     NxLOOP(i, A->m) {
         NxLOOP(j, A->n) {
-            printf("%5.2f, ", A->data[NxIDX(A->n, i, j)]);
+            printf("%5.2f, ", NxTensor_AT(A, i, j));
         }
         printf("\n");
     }
     printf("\n");
+    NxTensor_free(&T);
+    NxTensor_free(&W);
 }
 
 /**
@@ -684,29 +1659,39 @@ NxCDEF void NxTensor_to_string(NxTensor* A){
 NxCDEF void NxTensor_to_string_raw(NxTensor* A){
     NxASSERT(A->allocated);
 
+    NxTensor T = {0}, W = {0};
+    A = NxTensor_matrix(NxTensor_widened(A, &W), &T);
+
     u64 i, j;
     NxLOOP(i, A->m) {
         NxLOOP(j, A->n) {
-            printf("%.3e ", A->data[NxIDX(A->n, i, j)]);
+            printf("%.3e ", NxTensor_AT(A, i, j));
         }
         printf("\n");
     }
     printf("\n");
+    NxTensor_free(&T);
+    NxTensor_free(&W);
 }
 
 /**
  * @brief Read a tensor from utf-8 text file.
  *
- * Read a tensor data and size from the UTF-8 text file the is writen using scientific
- * notation using `.3e` formating specifier.
+ * Read a tensor data and size from the UTF-8 text file, the number of
+ * rows and columns followed by the values in row-major order.
  *
  * The file have the following design
  * ```txt
  * 2 2
- * 1.00e+00 0.00e+00
- * 0.00e+00 1.00e+00
+ * 1 0.5
+ * -2.5e-07 1
  * ```
  *
+ * The values may be separated by spaces, new lines, commas or semicolons.
+ * The file is parsed in parallel with NxText_parse_f64s(), which returns
+ * the correctly rounded doubles, so files from NxTensor_write() read back
+ * exactly.
+ *
  * The tensor only get populated if the file does exists
  *
  * @param A pointer to the  tensor to read from file.
@@ -714,27 +1699,95 @@ NxCDEF void NxTensor_to_string_raw(NxTensor* A){
  */
 NxCDEF void NxTensor_read(NxTensor* A, str fname) {
 
-    FILE* fptr = fopen(fname, READ_MODE);
-    u64 m, n;
-    if(fptr == NULL) {
+    NxStorage* S = NxText_load(fname);
+    u64 dims[2];
+    if(S == NULL) {
         fprintf(stderr, "Cannot open file %s file does not exists.\n", fname);
         exit(EXIT_FAILURE);
     }
-    
-    fscanf(fptr, "%I64u %I64u", &m, &n);
-    NxTensor_alloc(A, m, n);
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            fscanf(fptr, "%lf", &(A->data[NxIDX(A->n, i, j)]));
-        }
+    const char* text = S->data;
+    const char* end = text + S->bytes;
+    const char* p = NxText_parse_u64s(text, end, 2, dims);
+    if(p == NULL) {
+        fprintf(stderr, "Cannot read file %s the shape is missing.\n", fname);
+        exit(EXIT_FAILURE);
     }
-    fclose(fptr);
+    NxTensor_alloc(A, dims[0], dims[1]);
+    if(!NxText_parse_f64s(p, (u64)(end - p), dims[0]*dims[1], A->data)) {
+        fprintf(stderr, "Cannot read file %s expected %" PRIu64 " numbers.\n", fname, dims[0]*dims[1]);
+        exit(EXIT_FAILURE);
+    }
+    NxStorage_release(S);
+}
+
+/**
+ * @brief Read the NxTensorFileHeader of a binary tensor file.
+ *
+ * Leaves the file at its start and returns false for the files of the
+ * first format, which have no header. Exits on a header this version of
+ * the library cannot read.
+ *
+ * @param fptr the file, at its start.
+ * @param H the header read.
+ * @param fname name of the file for the error messages.
+ *
+ * @return (bool) whether the file has a header.
+ */
+NxCDEF bool NxTensor_read_header(FILE* fptr, NxTensorFileHeader* H, str fname) {
+    if(fread(H, sizeof (NxTensorFileHeader), 1, fptr) != 1 ||
+       memcmp(H->magic, NxTENSOR_FILE_MAGIC, sizeof (H->magic)) != 0) {
+        rewind(fptr);
+        return false;
+    }
+    if(H->version > NxTENSOR_FILE_VERSION) {
+        fprintf(stderr, "Cannot read file %s written with format version %u (supported %u).\n",
+                fname, H->version, NxTENSOR_FILE_VERSION);
+        exit(EXIT_FAILURE);
+    }
+    u64 size = 1;
+    u32 k;
+    if(H->ndim < 1 || H->ndim > NxMAX_DIMS || H->dtype > NxFLOAT16 || H->codec > NxCODEC_SHUFFLE_LZ) {
+        fprintf(stderr, "Cannot read file %s the header is corrupted.\n", fname);
+        exit(EXIT_FAILURE);
+    }
+    NxLOOP(k, H->ndim) {
+        size *= H->shape[k];
+    }
+    if(H->bytes != size*NxDType_size((NxDType)H->dtype)) {
+        fprintf(stderr, "Cannot read file %s the header is corrupted.\n", fname);
+        exit(EXIT_FAILURE);
+    }
+    return true;
+}
+
+/**
+ * @brief Read the compressed data of a binary file into the allocated tensor A.
+ */
+static void NxTensor_read_compressed(NxTensor* A, NxTensorFileHeader* H, FILE* fptr, str fname) {
+    fseek(fptr, 0, SEEK_END);
+    u64 fsize = (u64)ftell(fptr);
+    if(H->offset > fsize || fseek(fptr, (long)H->offset, SEEK_SET) != 0) {
+        fprintf(stderr, "Cannot read file %s the file is truncated.\n", fname);
+        exit(EXIT_FAILURE);
+    }
+    u64 bytes = fsize - H->offset;
+    void* frame = malloc(bytes ? bytes : 1);
+    NxASSERT(frame != NULL);
+    if(fread(frame, 1, bytes, fptr) != bytes || !NxCodec_decompress(A->raw, H->bytes, frame, bytes)) {
+        fprintf(stderr, "Cannot read file %s the compressed data is corrupted.\n", fname);
+        exit(EXIT_FAILURE);
+    }
+    free(frame);
 }
 
 /**
  * @brief Read a tensor from binary file (.bin).
  *
+ * Reads the files of NxTensor_write_binary() and NxTensor_write_compressed()
+ * in any dtype as well as the headerless files of the first format (f64
+ * matrices). The data is copied into a new buffer, NxTensor_map_binary()
+ * maps it instead.
+ *
  * @param A pointer to the tensor object.
  * @param fname filename.
  */
@@ -746,6 +1799,19 @@ NxCDEF void NxTensor_read_binary(NxTensor* A, str fname){
         fprintf(stderr, "Cannot open file %s file does not exists.\n", fname);
         exit(EXIT_FAILURE);
     }
+    NxTensorFileHeader H;
+    if(NxTensor_read_header(fptr, &H, fname)) {
+        NxTensor_alloc_nd(A, H.ndim, H.shape, (NxDType)H.dtype);
+        if(H.codec != NxCODEC_NONE) {
+            NxTensor_read_compressed(A, &H, fptr, fname);
+        } else if(fseek(fptr, (long)H.offset, SEEK_SET) != 0 ||
+                  fread(A->raw, 1, H.bytes, fptr) != H.bytes) {
+            fprintf(stderr, "Cannot read file %s the file is truncated.\n", fname);
+            exit(EXIT_FAILURE);
+        }
+        fclose(fptr);
+        return ;
+    }
     fread(&m, sizeof (u64), 1, fptr);
     fread(&n, sizeof (u64), 1, fptr);
     NxTensor_alloc(A, m, n);
@@ -753,15 +1819,103 @@ NxCDEF void NxTensor_read_binary(NxTensor* A, str fname){
     fclose(fptr);
 }
 
+/**
+ * @brief Load a tensor from binary file (.bin) without copying its data.
+ *
+ * The tensor points straight into a mapping of the file, the pages are
+ * read on first touch and shared with the page cache, so a multi-GB
+ * weight file loads in constant time and costs no heap memory. With
+ * NxMAP_READ_ONLY the operations writing to A (the inplace `_` ones, the
+ * ones taking A as output) give it a heap buffer first, leaving the file
+ * intact; NxMAP_PRIVATE maps it copy-on-write so A can be updated in
+ * place. NxMAP_SEQUENTIAL, NxMAP_RANDOM and NxMAP_WILLNEED are passed to
+ * `madvise`, see NxStorage_advise().
+ *
+ * The file must have a header (NxTensor_write_binary()). It falls back to
+ * NxTensor_read_binary() where files cannot be mapped and for compressed
+ * files (NxTensor_write_compressed()), which are decompressed.
+ *
+ * @param A pointer to the tensor object.
+ * @param fname filename.
+ * @param flags combination of NxMapFlags.
+ */
+NxCDEF void NxTensor_map_binary(NxTensor* A, str fname, u32 flags){
+    FILE* fptr = fopen(fname, READ_BINARY_MODE);
+    if(fptr == NULL) {
+        fprintf(stderr, "Cannot open file %s file does not exists.\n", fname);
+        exit(EXIT_FAILURE);
+    }
+    NxTensorFileHeader H;
+    if(!NxTensor_read_header(fptr, &H, fname)) {
+        fprintf(stderr, "Cannot map file %s it has no header, write it with NxTensor_write_binary().\n", fname);
+        exit(EXIT_FAILURE);
+    }
+    fseek(fptr, 0, SEEK_END);
+    u64 fsize = (u64)ftell(fptr);
+    fclose(fptr);
+    if(H.codec != NxCODEC_NONE) {
+        NxTensor_read_binary(A, fname);
+        return ;
+    }
+    if(H.offset > fsize || fsize - H.offset < H.bytes) {
+        fprintf(stderr, "Cannot map file %s the file is truncated.\n", fname);
+        exit(EXIT_FAILURE);
+    }
+
+    NxStorage* S = NxStorage_map(fname, H.offset, H.bytes, flags);
+    if(S == NULL) {
+        NxTensor_read_binary(A, fname);
+        return ;
+    }
+    NxTensor_from_storage(A, S, 0, (NxDType)H.dtype, H.ndim, H.shape);
+    NxStorage_release(S);
+}
+
+/**
+ * @brief Make A a contiguous tensor over `bytes_offset` bytes into a storage.
+ *
+ * A takes a reference to S (the caller keeps its own), the storage must
+ * hold the elements from the offset, which is a multiple of the size of
+ * the dtype. Used to point tensors into mapped files (NxCheckpoint).
+ *
+ * @param A pointer to the tensor object.
+ * @param S the storage.
+ * @param bytes_offset position of the first element in the storage.
+ * @param dtype storage type of the elements.
+ * @param ndim number of dimensions, at most NxMAX_DIMS.
+ * @param shape size of every dimension.
+ */
+NxCDEF void NxTensor_from_storage(NxTensor* A, NxStorage* S, u64 bytes_offset, NxDType dtype,
+                                  u32 ndim, const u64* shape) {
+    NxASSERT(ndim >= 1 && ndim <= NxMAX_DIMS);
+    NxASSERT(bytes_offset % NxDType_size(dtype) == 0);
+    NxStorage_retain(S);
+    NxTensor_free(A);
+    A->storage = S;
+    A->raw = (char*)S->data + bytes_offset;
+    A->arena = S->policy == NxALLOC_ARENA;
+    A->offset = bytes_offset / NxDType_size(dtype);
+    A->dtype = dtype;
+    A->allocated = true;
+    NxTensor_set_shape_nd(A, ndim, shape);
+}
+
 /**
  * @brief Write a tensor to utf-8 text file.
  *
+ * Every value is written with the fewest digits that read back to the
+ * same double (NxText_format_f64()), so NxTensor_read() restores the
+ * tensor exactly.
+ *
  * @param A pointer to the tensor object.
  * @param fname filename.
  */
 NxCDEF void NxTensor_write(NxTensor* A, str fname) {
     NxASSERT(A->allocated);
 
+    NxTensor T = {0}, W = {0};
+    A = NxTensor_matrix(NxTensor_widened(A, &W), &T);
+
     FILE* fptr = fopen(fname, WRITE_MODE);
 
     if(fptr == NULL) {
@@ -769,24 +1923,17 @@ NxCDEF void NxTensor_write(NxTensor* A, str fname) {
         exit(EXIT_FAILURE);
     }
     fprintf(fptr, "%I64u %I64u\n", A->m, A->n);
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            fprintf(fptr, "%.3e ", A->data[NxIDX(A->n, i, j)]);
-        }
-        fprintf(fptr, "\n");
-    }
+    NxText_write_f64s(fptr, A->m, A->n, A->data, A->rs, A->cs);
     fprintf(fptr, "\n");
     fclose(fptr);
+    NxTensor_free(&T);
+    NxTensor_free(&W);
 }
 
 /**
- * @brief Write a tensor to binary file (.bin).
- * 
- * @param A pointer to the tensor object.
- * @param fname filename.
+ * @brief Write the header then the data of A, compressed with `codec`.
  */
-NxCDEF void NxTensor_write_binary(NxTensor* A, str fname){
+static void NxTensor_write_file(NxTensor* A, str fname, NxCodecType codec) {
     NxASSERT(A->allocated);
 
     FILE* fptr = fopen(fname, WRITE_BINARY_MODE);
@@ -795,10 +1942,59 @@ NxCDEF void NxTensor_write_binary(NxTensor* A, str fname){
         fprintf(stderr, "Cannot open file %s file does not exists.\n", fname);
         exit(EXIT_FAILURE);
     }
-    fwrite(&(A->m), sizeof (u64), 1, fptr);
-    fwrite(&(A->n), sizeof (u64), 1, fptr);
-    fwrite(&(A->data[0]), sizeof (NxDTYPE), A->m*A->n, fptr);
+    NxTensor T = {0};
+    NxTensor* P = NxTensor_packed(A, &T);
+    NxTensorFileHeader H = {0};
+    char pad[NxTENSOR_FILE_ALIGN] = {0};
+    memcpy(H.magic, NxTENSOR_FILE_MAGIC, sizeof (H.magic));
+    H.version = NxTENSOR_FILE_VERSION;
+    H.dtype = A->dtype;
+    H.ndim = A->ndim;
+    memcpy(H.shape, A->shape, A->ndim*sizeof (u64));
+    H.offset = (sizeof (H) + NxTENSOR_FILE_ALIGN - 1) / NxTENSOR_FILE_ALIGN * NxTENSOR_FILE_ALIGN;
+    H.bytes = NxTensor_size(A)*NxDType_size(A->dtype);
+    H.codec = codec;
+    fwrite(&H, sizeof (H), 1, fptr);
+    fwrite(pad, 1, H.offset - sizeof (H), fptr);
+    if(codec == NxCODEC_SHUFFLE_LZ) {
+        void* frame = malloc(NxCodec_bound(H.bytes));
+        NxASSERT(frame != NULL);
+        fwrite(frame, 1, NxCodec_compress(frame, P->raw, H.bytes, (u32)NxDType_size(A->dtype)), fptr);
+        free(frame);
+    } else {
+        fwrite(P->raw, 1, H.bytes, fptr);
+    }
     fclose(fptr);
+    NxTensor_free(&T);
+}
+
+/**
+ * @brief Write a tensor to binary file (.bin).
+ *
+ * The file starts with an NxTensorFileHeader recording the dtype and the
+ * shape, the contiguous data follows at the next NxTENSOR_FILE_ALIGN
+ * boundary so NxTensor_map_binary() can map it in place.
+ *
+ * @param A pointer to the tensor object.
+ * @param fname filename.
+ */
+NxCDEF void NxTensor_write_binary(NxTensor* A, str fname){
+    NxTensor_write_file(A, fname, NxCODEC_NONE);
+}
+
+/**
+ * @brief Write a tensor to a compressed binary file (.bin).
+ *
+ * Same layout as NxTensor_write_binary() with the data compressed by
+ * NxCodec (byte shuffle by the size of the dtype then LZ), block by block
+ * on the NxThreadPool. NxTensor_read_binary() and NxDataset read the file
+ * back; it cannot be mapped in place.
+ *
+ * @param A pointer to the tensor object.
+ * @param fname filename.
+ */
+NxCDEF void NxTensor_write_compressed(NxTensor* A, str fname){
+    NxTensor_write_file(A, fname, NxCODEC_SHUFFLE_LZ);
 }
 
 /**
@@ -818,15 +2014,78 @@ NxCDEF void NxTensor_write_binary(NxTensor* A, str fname){
 NxCDEF void NxTensor_free(NxTensor* A){
     if (A->allocated) {
         // NxMESSAGE("INFO", "here");
-        free(A->data);
+        NxStorage_release(A->storage);
         // NxMESSAGE("DEBUG", "here");
         A->m = 0; A->n = 0;
+        A->dtype = NxFLOAT64;
+        A->rs = 0; A->cs = 0;
+        A->ndim = 0;
+        A->layout = NxLAYOUT_NONE;
+        A->offset = 0;
+        A->storage = NULL;
+        A->arena = false;
         A->allocated = false;
     }
 }
 
+/**
+ * @brief Return how the buffer of a tensor was allocated.
+ *
+ * Tells whether the data is 64-byte aligned heap memory, backed by huge
+ * pages, carved from an NxArena or borrowed (NxTensor_set_data()). A view
+ * reports the policy of the storage it shares.
+ *
+ * @param A pointer to the tensor object.
+ *
+ * @return (NxAllocPolicy)
+ */
+NxCDEF NxAllocPolicy NxTensor_alloc_policy(NxTensor* A) {
+    if(!A->allocated) {
+        return NxALLOC_NONE;
+    }
+    if(A->arena) {
+        return NxALLOC_ARENA;
+    }
+    return A->storage->policy;
+}
+
+/**
+ * @brief Whether A must not be written in place.
+ *
+ * True when other tensors point into its storage or when it is a
+ * read-only mapping of a file (NxTensor_map_binary()).
+ */
+NxCDEF bool NxTensor_is_shared(NxTensor* A) {
+    NxASSERT(A->allocated);
+    return NxStorage_shared(A->storage);
+}
+
+/**
+ * @brief Give A a buffer of its own if its storage is shared.
+ *
+ * To call before writing through `data` (e.g. with NxTensor_AT()), the
+ * other tensors sharing the storage keep the old values. The copy is
+ * contiguous.
+ *
+ * @param A pointer to the tensor object.
+ */
+NxCDEF void NxTensor_unshare(NxTensor* A) {
+    NxASSERT(A->allocated);
+    if(!NxTensor_is_shared(A)) {
+        return ;
+    }
+    NxTensor T = {0};
+    NxTensor_alloc_as(&T, A, A->dtype);
+    NxTensor_pack(T.raw, A);
+    NxTensor_free(A);
+    *A = T;
+}
+
 /**
  * @brief Sums all the tensor values and return it.
+ *
+ * Pairwise SIMD summation spread over the NxReduce threads, see
+ * NxReduce_set_deterministic() for results independent of the threads.
  * 
  * @param A pointer to the tensor object.
  * 
@@ -835,13 +2094,31 @@ NxCDEF void NxTensor_free(NxTensor* A){
 NxDTYPE NxTensor_sum(NxTensor* A) {
     NxASSERT(A->allocated);
 
-    NxDTYPE sum = 0.0;
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            sum +=  A->data[NxIDX(A->n, i, j)];
+    NxTensor T = {0}, W = {0};
+    A = NxTensor_matrix(NxTensor_widened(A, &W), &T);
+
+    NxDTYPE sum;
+    bool rows_unit = A->n == 1 || A->cs == 1;
+    if(NxTensor_is_contiguous(A)) {
+        sum = NxReduce_sum(A->m*A->n, A->data);
+    } else if(!rows_unit && A->m != 1 && A->rs != 1) {
+        NxTensor_contiguous(&T, A);
+        sum = NxReduce_sum(T.m*T.n, T.data);
+    } else {
+        /* Sum every row (or column of a transposed view) then the partial sums. */
+        u64 k = rows_unit ? A->m : A->n;
+        f64* part = malloc(k*sizeof(f64));
+        NxASSERT(part != NULL);
+        if(rows_unit) {
+            NxReduce_sum_over_cols(A->m, A->n, A->data, A->rs, part);
+        } else {
+            NxReduce_sum_over_cols(A->n, A->m, A->data, A->cs, part);
         }
+        sum = NxReduce_sum(k, part);
+        free(part);
     }
+    NxTensor_free(&T);
+    NxTensor_free(&W);
     return sum;
 }
 
@@ -867,13 +2144,7 @@ u64 NxTensor_size(NxTensor* A) {
 NxCDEF void NxTensor_neg(NxTensor* C, NxTensor* A){
     NxASSERT(A->allocated);
 
-    NxTensor_alloc(C, A->m, A->n);
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            C->data[C->n*i + j] = -A->data[NxIDX(A->n, i, j)];
-        }
-    }
+    NxTensor_unary(C, A, NxKernels_get()->neg, NxKernels_get_f32()->neg);
 }
 
 /**
@@ -890,20 +2161,37 @@ NxCDEF void NxTensor_neg_(NxTensor* A) {
 /**
  * @brief Perform the Power operation on a tensor.
  * 
+ * The integer power is computed by repeated squaring in the SIMD kernels
+ * instead of calling `pow` for every element.
+ *
  * @param C pointer to the output tensor object.
  * @param A pointer to the input tensor object.
  * @param p the exponant of the power.
  */
 NxCDEF void NxTensor_pow(NxTensor* C, NxTensor* A, i32 p) {
     NxASSERT(A->allocated);
+    if(A->dtype != NxFLOAT64) {
+        NxDType dtype = A->dtype;
+        NxTensor W = {0};
+        NxTensor_astype(&W, A, NxFLOAT64);
+        NxTensor_pow(&W, &W, p);
+        NxTensor_astype(C, &W, dtype);
+        NxTensor_free(&W);
+        return ;
+    }
 
-    NxTensor_alloc(C, A->m, A->n);
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            C->data[NxIDX(A->n, i, j)] = pow(A->data[NxIDX(A->n, i, j)], p);
-        }
+    NxTensor T = {0};
+    NxTensor* P = NxTensor_packed(A, &T);
+    NxStorage* H = NxTensor_hold(C, P, NxTensor_size(A), NxFLOAT64);
+    const NxDTYPE* a = P->data;
+    NxTensor_alloc_as(C, A, NxFLOAT64);
+    if(p == 2) {
+        NxKernels_get()->mul(NxTensor_size(C), a, a, C->data);
+    } else {
+        NxKernels_get()->powi(NxTensor_size(C), a, p, C->data);
     }
+    NxTensor_unhold(H);
+    NxTensor_free(&T);
 }
 
 /**
@@ -915,12 +2203,7 @@ NxCDEF void NxTensor_pow(NxTensor* C, NxTensor* A, i32 p) {
 NxCDEF void NxTensor_pow_(NxTensor* A, i32 p) {
     NxASSERT(A->allocated);
 
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            A->data[NxIDX(A->n, i, j)] = pow(A->data[NxIDX(A->n, i, j)], p);
-        }
-    }
+    NxTensor_pow(A, A, p);
 }
 
 /**
@@ -939,14 +2222,27 @@ NxCDEF void NxTensor_pow_(NxTensor* A, i32 p) {
  */
 NxCDEF void NxTensor_apply(NxTensor* C, NxTensor* A, NxDTYPE(*pfunc)(NxDTYPE)) {
     NxASSERT(A->allocated);
+    if(A->dtype != NxFLOAT64) {
+        NxDType dtype = A->dtype;
+        NxTensor W = {0};
+        NxTensor_astype(&W, A, NxFLOAT64);
+        NxTensor_apply(&W, &W, pfunc);
+        NxTensor_astype(C, &W, dtype);
+        NxTensor_free(&W);
+        return ;
+    }
 
-    NxTensor_alloc(C, A->m, A->n);
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            C->data[NxIDX(A->n, i, j)] = pfunc(A->data[NxIDX(A->n, i, j)]);
-        }
+    NxTensor T = {0};
+    NxTensor* P = NxTensor_packed(A, &T);
+    NxStorage* H = NxTensor_hold(C, P, NxTensor_size(A), NxFLOAT64);
+    const NxDTYPE* a = P->data;
+    NxTensor_alloc_as(C, A, NxFLOAT64);
+    u64 i;
+    NxLOOP(i, NxTensor_size(C)) {
+        C->data[i] = pfunc(a[i]);
     }
+    NxTensor_unhold(H);
+    NxTensor_free(&T);
 }
 
 /**
@@ -966,7 +2262,7 @@ NxCDEF void NxTensor_apply_ (NxTensor* A, NxDTYPE(*pfunc)(NxDTYPE)) {
  */
 NxCDEF void NxTensor_abs(NxTensor* C, NxTensor* A) {
     NxASSERT(A->allocated);
-    NxTensor_apply(C, A, fabs);
+    NxTensor_unary(C, A, NxKernels_get()->abs, NxKernels_get_f32()->abs);
 }
 
 /**
@@ -974,7 +2270,7 @@ NxCDEF void NxTensor_abs(NxTensor* C, NxTensor* A) {
  */
 NxCDEF void NxTensor_abs_(NxTensor* A) {
     NxASSERT(A->allocated);
-    NxTensor_apply_(A, fabs);
+    NxTensor_abs(A, A);
 }
 
 /**
@@ -982,14 +2278,27 @@ NxCDEF void NxTensor_abs_(NxTensor* A) {
  */
 NxCDEF void NxTensor_sign(NxTensor* C, NxTensor* A){
     NxASSERT(A->allocated);
+    if(A->dtype != NxFLOAT64) {
+        NxDType dtype = A->dtype;
+        NxTensor W = {0};
+        NxTensor_astype(&W, A, NxFLOAT64);
+        NxTensor_sign(&W, &W);
+        NxTensor_astype(C, &W, dtype);
+        NxTensor_free(&W);
+        return ;
+    }
 
-    NxTensor_alloc(C, A->m, A->n);
-    u64 i, j;
-    NxLOOP(i, A->m) {
-        NxLOOP(j, A->n) {
-            A->data[NxIDX(A->n, i, j)] = A->data[NxIDX(A->n, i, j)] >= 0 ? 1.f : -1.0f;
-        }
+    NxTensor T = {0};
+    NxTensor* P = NxTensor_packed(A, &T);
+    NxStorage* H = NxTensor_hold(C, P, NxTensor_size(A), NxFLOAT64);
+    const NxDTYPE* a = P->data;
+    NxTensor_alloc_as(C, A, NxFLOAT64);
+    u64 i;
+    NxLOOP(i, NxTensor_size(C)) {
+        C->data[i] = a[i] >= 0 ? 1.f : -1.0f;
     }
+    NxTensor_unhold(H);
+    NxTensor_free(&T);
 }
 
 /**
@@ -1018,10 +2327,13 @@ NxCDEF void NxTensor_square_(NxTensor* A){
 
 /**
  * @brief Compute the exponential value of the tensor.
+ *
+ * Uses the vectorized NxMath_exp() instead of calling libm per element,
+ * see NxMath_set_mode() for the accuracy/speed trade-off.
  */
 NxCDEF void NxTensor_exp(NxTensor* C, NxTensor* A){
     NxASSERT(A->allocated);
-    NxTensor_apply(C, A, exp);
+    NxTensor_unary(C, A, NxMath_exp, NULL);
 }
 
 /**
@@ -1029,7 +2341,7 @@ NxCDEF void NxTensor_exp(NxTensor* C, NxTensor* A){
  */
 NxCDEF void NxTensor_exp_(NxTensor* A){
     NxASSERT(A->allocated);
-    NxTensor_apply_(A, exp);
+    NxTensor_exp(A, A);
 }
 
 /**
@@ -1037,7 +2349,7 @@ NxCDEF void NxTensor_exp_(NxTensor* A){
  */
 NxCDEF void NxTensor_log(NxTensor* C, NxTensor* A){
     NxASSERT(A->allocated);
-    NxTensor_apply(C, A, log);
+    NxTensor_unary(C, A, NxMath_log, NULL);
 }
 
 /**
@@ -1045,23 +2357,23 @@ NxCDEF void NxTensor_log(NxTensor* C, NxTensor* A){
  */
 NxCDEF void NxTensor_log_(NxTensor* A){
     NxASSERT(A->allocated);
-    NxTensor_apply_(A, log);
+    NxTensor_log(A, A);
 }
 
 /**
  * @brief Compute the logrithms with base 10 value of the tensor.
  */
-NxCDEF void NxTensor_log10  (NxTensor* C, NxTensor* A){
+NxCDEF void NxTensor_log10(NxTensor* C, NxTensor* A){
     NxASSERT(A->allocated);
-    NxTensor_apply(C, A, log10);
+    NxTensor_unary(C, A, NxMath_log10, NULL);
 }
 
 /**
  * @brief Compute the logrithms with base 10 value of the tensor inplace.
  */
-NxCDEF void NxTensor_log10_ (NxTensor* A){
+NxCDEF void NxTensor_log10_(NxTensor* A){
     NxASSERT(A->allocated);
-    NxTensor_apply_(A, log10);
+    NxTensor_log10(A, A);
 }
 
 /**
@@ -1069,7 +2381,7 @@ NxCDEF void NxTensor_log10_ (NxTensor* A){
  */
 NxCDEF void NxTensor_cos(NxTensor* C, NxTensor* A){
     NxASSERT(A->allocated);
-    NxTensor_apply(C, A, cos);
+    NxTensor_unary(C, A, NxMath_cos, NULL);
 }
 
 /**
@@ -1077,7 +2389,7 @@ NxCDEF void NxTensor_cos(NxTensor* C, NxTensor* A){
  */
 NxCDEF void NxTensor_cos_(NxTensor* A){
     NxASSERT(A->allocated);
-    NxTensor_apply_(A, cos);
+    NxTensor_cos(A, A);
 }
 
 /**
@@ -1085,7 +2397,7 @@ NxCDEF void NxTensor_cos_(NxTensor* A){
  */
 NxCDEF void NxTensor_sin(NxTensor* C, NxTensor* A){
     NxASSERT(A->allocated);
-    NxTensor_apply(C, A, sin);
+    NxTensor_unary(C, A, NxMath_sin, NULL);
 }
 
 /**
@@ -1093,7 +2405,39 @@ NxCDEF void NxTensor_sin(NxTensor* C, NxTensor* A){
  */
 NxCDEF void NxTensor_sin_(NxTensor* A){
     NxASSERT(A->allocated);
-    NxTensor_apply_(A, sin);
+    NxTensor_sin(A, A);
+}
+
+/**
+ * @brief Compute the hyperbolic tangent of the tensor.
+ */
+NxCDEF void NxTensor_tanh(NxTensor* C, NxTensor* A){
+    NxASSERT(A->allocated);
+    NxTensor_unary(C, A, NxMath_tanh, NULL);
+}
+
+/**
+ * @brief Compute the hyperbolic tangent of the tensor inplace.
+ */
+NxCDEF void NxTensor_tanh_(NxTensor* A){
+    NxASSERT(A->allocated);
+    NxTensor_tanh(A, A);
+}
+
+/**
+ * @brief Compute the logistic sigmoid `1/(1 + exp(-x))` of the tensor.
+ */
+NxCDEF void NxTensor_sigmoid(NxTensor* C, NxTensor* A){
+    NxASSERT(A->allocated);
+    NxTensor_unary(C, A, NxMath_sigmoid, NULL);
+}
+
+/**
+ * @brief Compute the logistic sigmoid of the tensor inplace.
+ */
+NxCDEF void NxTensor_sigmoid_(NxTensor* A){
+    NxASSERT(A->allocated);
+    NxTensor_sigmoid(A, A);
 }
 
 /****************************************************************************
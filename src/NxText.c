@@ -0,0 +1,577 @@
+#include "NxText.h"
+#include "NxThreadPool.h"
+
+#include <math.h>
+#include <string.h>
+
+/// Blocks of NxTEXT_WRITE_BLOCK elements formatted before they are written.
+#define NxTEXT_WRITE_BATCH 64
+/// Tokens up to this length are copied on the stack for `strtod`.
+#define NxTEXT_TOKEN_SIZE 128
+
+/// Powers of ten that are exact doubles.
+static const f64 NxText_pow10[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+#ifdef __SIZEOF_INT128__
+/// Powers of ten that fit in 64 bits.
+static const u64 NxText_pow10_u64[20] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL,
+};
+#endif
+
+/**
+ * @brief Whether c separates two numbers.
+ */
+static inline bool NxText_is_sep(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == ',' || c == ';';
+}
+
+/**
+ * @brief Load a whole text file.
+ *
+ * The file is mapped read-only when the system allows it, otherwise read
+ * into a new buffer. The text is not null-terminated, it ends at
+ * `data + bytes`. The caller releases the storage.
+ *
+ * @param fname path of the file.
+ *
+ * @return (NxStorage*) the text, NULL when the file cannot be opened.
+ */
+NxStorage* NxText_load(str fname) {
+    FILE* fptr = fopen(fname, READ_BINARY_MODE);
+    if(fptr == NULL) {
+        return NULL;
+    }
+    fseek(fptr, 0, SEEK_END);
+    u64 bytes = (u64)ftell(fptr);
+    NxStorage* S = NxStorage_map(fname, 0, bytes, NxMAP_READ_ONLY | NxMAP_SEQUENTIAL | NxMAP_WILLNEED);
+    if(S == NULL) {
+        S = NxStorage_alloc(bytes);
+        rewind(fptr);
+        if(fread(S->data, 1, bytes, fptr) != bytes) {
+            NxStorage_release(S);
+            S = NULL;
+        }
+    }
+    fclose(fptr);
+    return S;
+}
+
+/**
+ * @brief Parse `count` unsigned integers (a header) from [s, end).
+ *
+ * @return (const char*) the position after the last integer, NULL if the text does not start with them.
+ */
+const char* NxText_parse_u64s(const char* s, const char* end, u32 count, u64* out) {
+    u32 k;
+    NxLOOP(k, count) {
+        while(s < end && NxText_is_sep(*s)) {
+            s++;
+        }
+        if(s == end || *s < '0' || *s > '9') {
+            return NULL;
+        }
+        out[k] = 0;
+        for(; s < end && *s >= '0' && *s <= '9'; s++) {
+            out[k] = out[k]*10 + (u64)(*s - '0');
+        }
+    }
+    return s;
+}
+
+/**
+ * @brief Parse a number with `strtod`, copying the token to terminate it.
+ */
+static f64 NxText_parse_slow(const char* s, const char* end, const char** stop) {
+    char small[NxTEXT_TOKEN_SIZE], *buf = small, *last;
+    const char* p = s;
+    while(p < end && !NxText_is_sep(*p)) {
+        p++;
+    }
+    u64 len = (u64)(p - s);
+    if(len >= NxTEXT_TOKEN_SIZE) {
+        buf = malloc(len + 1);
+        NxASSERT(buf != NULL);
+    }
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+    f64 v = strtod(buf, &last);
+    *stop = s + (last - buf);
+    if(buf != small) {
+        free(buf);
+    }
+    return v;
+}
+
+/**
+ * @brief Parse the number at `s`, reading no further than `end`.
+ *
+ * Accepts the forms of `strtod` (sign, digits, fraction, exponent, `nan`,
+ * `inf`) and returns the same correctly rounded double. A decimal with at
+ * most 19 significant digits and a power of ten within 10^±19 is
+ * converted exactly without `strtod`: directly in double precision when
+ * the mantissa and the power are exact doubles, with a 128-bit product or
+ * quotient otherwise.
+ *
+ * @param s start of the number.
+ * @param end end of the text.
+ * @param stop set to the first character after the number, `s` when there is none.
+ *
+ * @return (f64) the value.
+ */
+f64 NxText_parse_f64(const char* s, const char* end, const char** stop) {
+    const char* p = s;
+    bool neg = false, exact = true, any = false;
+    u64 w = 0;
+    i64 e = 0;
+    u32 digits = 0;
+
+    if(p < end && (*p == '-' || *p == '+')) {
+        neg = *p == '-';
+        p++;
+    }
+    for(; p < end && *p >= '0' && *p <= '9'; p++) {
+        any = true;
+        if(digits < 19) {
+            w = w*10 + (u64)(*p - '0');
+            digits += w != 0;
+        } else {
+            exact &= *p == '0';
+            e++;
+        }
+    }
+    if(p < end && *p == '.') {
+        for(p++; p < end && *p >= '0' && *p <= '9'; p++) {
+            any = true;
+            if(digits < 19) {
+                w = w*10 + (u64)(*p - '0');
+                digits += w != 0;
+                e--;
+            } else {
+                exact &= *p == '0';
+            }
+        }
+    }
+    if(!any || (p < end && (*p == 'x' || *p == 'X'))) {
+        return NxText_parse_slow(s, end, stop);
+    }
+    if(p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool eneg = false;
+        i64 x = 0;
+        if(q < end && (*q == '-' || *q == '+')) {
+            eneg = *q == '-';
+            q++;
+        }
+        if(q < end && *q >= '0' && *q <= '9') {
+            for(; q < end && *q >= '0' && *q <= '9'; q++) {
+                if(x < 100000) {
+                    x = x*10 + (*q - '0');
+                }
+            }
+            e += eneg ? -x : x;
+            p = q;
+        }
+    }
+    *stop = p;
+
+    f64 v;
+    if(w == 0) {
+        v = 0.0;
+    } else if(exact && w <= (1ULL << 53) && e >= -22 && e <= 22) {
+        v = e < 0 ? (f64)w / NxText_pow10[-e] : (f64)w * NxText_pow10[e];
+#ifdef __SIZEOF_INT128__
+    } else if(exact && e >= 0 && e <= 19) {
+        /* The product is exact in 128 bits, the conversion rounds once. */
+        v = (f64)((unsigned __int128)w * NxText_pow10_u64[e]);
+    } else if(exact && e < 0 && e >= -19) {
+        /* With w normalized the quotient has at least 64 bits, the remainder is the sticky bit. */
+        int lz = __builtin_clzll(w);
+        unsigned __int128 num = (unsigned __int128)(w << lz) << 64, d = NxText_pow10_u64[-e];
+        unsigned __int128 q = num / d;
+        q |= (num - q*d) != 0;
+        v = ldexp((f64)q, -64 - lz);
+#endif
+    } else {
+        return NxText_parse_slow(s, end, stop);
+    }
+    return neg ? -v : v;
+}
+
+/**
+ * @brief Parse the next `n` numbers from [s, end) on the calling thread.
+ *
+ * Used to stream a text file piece by piece, see NxDataset.
+ *
+ * @return (const char*) the position after the last number, NULL when there are fewer or one is malformed.
+ */
+const char* NxText_parse_next(const char* s, const char* end, u64 n, f64* out) {
+    u64 i;
+    NxLOOP(i, n) {
+        const char* stop;
+        while(s < end && NxText_is_sep(*s)) {
+            s++;
+        }
+        if(s == end) {
+            return NULL;
+        }
+        out[i] = NxText_parse_f64(s, end, &stop);
+        if(stop == s || (stop < end && !NxText_is_sep(*stop))) {
+            return NULL;
+        }
+        s = stop;
+    }
+    return s;
+}
+
+typedef struct NxTextParseJob {
+    const char* text; ///< start of the numbers.
+    u64 len; ///< length of the text.
+    u64* first; ///< index of the first number starting in every chunk.
+    u64 n; ///< capacity of out.
+    f64* out; ///< parsed values.
+    bool bad; ///< a token is not a number.
+} NxTextParseJob;
+
+/**
+ * @brief Count the numbers starting in every chunk of [begin, end).
+ */
+static void NxText_count_chunks(void* ctx, u64 begin, u64 end) {
+    NxTextParseJob* J = ctx;
+    u64 c, i;
+    for(c=begin; c<end; c++) {
+        u64 lo = c*NxTEXT_CHUNK, hi = lo + NxTEXT_CHUNK < J->len ? lo + NxTEXT_CHUNK : J->len, count = 0;
+        bool prev = lo == 0 || NxText_is_sep(J->text[lo - 1]);
+        for(i=lo; i<hi; i++) {
+            bool sep = NxText_is_sep(J->text[i]);
+            count += prev && !sep;
+            prev = sep;
+        }
+        J->first[c + 1] = count;
+    }
+}
+
+/**
+ * @brief Parse the numbers starting in every chunk of [begin, end).
+ *
+ * A number belongs to the chunk holding its first character and may end
+ * in the next one.
+ */
+static void NxText_parse_chunks(void* ctx, u64 begin, u64 end) {
+    NxTextParseJob* J = ctx;
+    const char* text = J->text;
+    const char* stop = text + J->len;
+    u64 c;
+    for(c=begin; c<end; c++) {
+        u64 lo = c*NxTEXT_CHUNK, hi = lo + NxTEXT_CHUNK < J->len ? lo + NxTEXT_CHUNK : J->len;
+        u64 idx = J->first[c], i = lo;
+        if(lo > 0 && !NxText_is_sep(text[lo - 1])) {
+            while(i < hi && !NxText_is_sep(text[i])) {
+                i++;
+            }
+        }
+        while(i < hi) {
+            if(NxText_is_sep(text[i])) {
+                i++;
+                continue;
+            }
+            const char* last;
+            f64 v = NxText_parse_f64(text + i, stop, &last);
+            u64 next = (u64)(last - text);
+            if(next == i || (next < J->len && !NxText_is_sep(text[next]))) {
+                __atomic_store_n(&J->bad, true, __ATOMIC_RELAXED);
+                while(next < J->len && !NxText_is_sep(text[next])) {
+                    next++;
+                }
+            }
+            if(idx < J->n) {
+                J->out[idx] = v;
+            }
+            idx++;
+            i = next;
+        }
+    }
+}
+
+/**
+ * @brief Parse exactly `n` numbers from a text buffer.
+ *
+ * The text is cut into chunks of NxTEXT_CHUNK bytes parsed in parallel:
+ * a first pass counts the numbers starting in every chunk, which gives
+ * where each chunk writes, and a second pass converts them.
+ *
+ * @param text the text, not necessarily null-terminated.
+ * @param len length of the text.
+ * @param n number of values expected.
+ * @param out the values.
+ *
+ * @return (bool) false if the text does not hold exactly `n` numbers.
+ */
+bool NxText_parse_f64s(const char* text, u64 len, u64 n, f64* out) {
+    u64 chunks = (len + NxTEXT_CHUNK - 1) / NxTEXT_CHUNK, c;
+    NxTextParseJob J = {.text = text, .len = len, .n = n, .out = out, .bad = false};
+    J.first = malloc((chunks + 1)*sizeof(u64));
+    NxASSERT(J.first != NULL);
+    J.first[0] = 0;
+    NxThreadPool_parallel_for(chunks, 1, NxText_count_chunks, &J);
+    NxLOOP(c, chunks) {
+        J.first[c + 1] += J.first[c];
+    }
+    bool ok = J.first[chunks] == n;
+    if(ok) {
+        NxThreadPool_parallel_for(chunks, 1, NxText_parse_chunks, &J);
+        ok = !J.bad;
+    }
+    free(J.first);
+    return ok;
+}
+
+/**
+ * @brief Write the `nd` digits of a number whose first digit has the power 10^e10.
+ *
+ * Plain notation between 1e-4 and 1e16, scientific otherwise, like `%g`.
+ */
+static u32 NxText_layout(char* buf, bool neg, const char* digits, i32 nd, i32 e10) {
+    char* p = buf;
+    i32 k;
+    if(neg) {
+        *p++ = '-';
+    }
+    if(e10 >= -4 && e10 < 16) {
+        if(e10 < 0) {
+            *p++ = '0';
+            *p++ = '.';
+            for(k=e10 + 1; k<0; k++) {
+                *p++ = '0';
+            }
+            memcpy(p, digits, nd);
+            p += nd;
+        } else {
+            NxLOOP(k, e10 + 1) {
+                *p++ = k < nd ? digits[k] : '0';
+            }
+            if(nd > e10 + 1) {
+                *p++ = '.';
+                memcpy(p, digits + e10 + 1, nd - e10 - 1);
+                p += nd - e10 - 1;
+            }
+        }
+    } else {
+        *p++ = digits[0];
+        if(nd > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, nd - 1);
+            p += nd - 1;
+        }
+        p += sprintf(p, "e%c%02d", e10 < 0 ? '-' : '+', e10 < 0 ? -e10 : e10);
+    }
+    *p = '\0';
+    return (u32)(p - buf);
+}
+
+#ifdef __SIZEOF_INT128__
+/**
+ * @brief Round ax to `nd` significant digits, the first one having the power 10^e10.
+ *
+ * Exact with 128-bit integers: ax = m*2^be and the result is m*2^be*10^k
+ * rounded half to even. Only for the moderate values (about 1e-3 <= ax <
+ * 2^63), returns false otherwise.
+ */
+static bool NxText_round_exact(f64 ax, i32 e10, i32 nd, u64* D) {
+    int ex;
+    f64 f = frexp(ax, &ex);
+    u64 m = (u64)ldexp(f, 53);
+    i32 be = ex - 53, k = nd - 1 - e10;
+    if(k > 19 || k < -19 || be > 10 || be < -64) {
+        return false;
+    }
+    unsigned __int128 num = m, den = 1;
+    if(k >= 0) {
+        num *= NxText_pow10_u64[k];
+    } else {
+        den = NxText_pow10_u64[-k];
+    }
+    if(be >= 0) {
+        num <<= be;
+    } else {
+        den <<= -be;
+    }
+    unsigned __int128 q = num / den, r = num - q*den;
+    if(2*r > den || (2*r == den && (q & 1))) {
+        q++;
+    }
+    *D = (u64)q;
+    return true;
+}
+#endif
+
+/**
+ * @brief The `nd` significant digits of ax rounded to nearest and the power of the first one.
+ */
+static void NxText_digits(f64 ax, i32 nd, i32 e10, char* digits, i32* ce) {
+#ifdef __SIZEOF_INT128__
+    u64 D;
+    if(e10 > -4 && NxText_round_exact(ax, e10, nd, &D)) {
+        i32 k;
+        *ce = e10;
+        if(D >= NxText_pow10_u64[nd]) {
+            D /= 10;
+            (*ce)++;
+        }
+        for(k=nd; k-- > 0; D /= 10) {
+            digits[k] = (char)('0' + D % 10);
+        }
+        return ;
+    }
+#endif
+    char sci[NxTEXT_F64_SIZE];
+    snprintf(sci, sizeof(sci), "%.*e", nd - 1, ax);
+    digits[0] = sci[0];
+    memcpy(digits + 1, sci + 2, nd - 1);
+    *ce = atoi(sci + nd + 2);
+}
+
+/**
+ * @brief Write the shortest text that reads back to x.
+ *
+ * x is rounded to 15, then 16 significant digits and the first candidate
+ * that NxText_parse_f64() reads back to x is kept, 17 digits always do.
+ * The trailing zeros are dropped, so 0.1 is written `0.1` and not
+ * `0.10000000000000001`. The digits of the moderate values (1e-3 to 2^63,
+ * the usual weights) are computed exactly with 128-bit integers, the
+ * others with `snprintf`.
+ *
+ * @param buf at least NxTEXT_F64_SIZE bytes.
+ * @param x the value.
+ *
+ * @return (u32) the length of the text, without the terminating null.
+ */
+u32 NxText_format_f64(char* buf, f64 x) {
+    if(!isfinite(x) || x == 0) {
+        return (u32)snprintf(buf, NxTEXT_F64_SIZE, "%g", x);
+    }
+    f64 ax = fabs(x);
+    i32 e10 = (i32)floor(log10(ax)), nd;
+    /* log10 may be off by one next to the powers of ten. */
+    if(ax < pow(10.0, e10)) {
+        e10--;
+    } else if(ax >= pow(10.0, e10 + 1)) {
+        e10++;
+    }
+    u32 len = 0;
+    for(nd=15; nd<=17; nd++) {
+        char digits[17];
+        i32 ce, cn = nd;
+        NxText_digits(ax, nd, e10, digits, &ce);
+        while(cn > 1 && digits[cn - 1] == '0') {
+            cn--;
+        }
+        len = NxText_layout(buf, x < 0, digits, cn, ce);
+        const char* stop;
+        if(nd == 17 || NxText_parse_f64(buf, buf + len, &stop) == x) {
+            break;
+        }
+    }
+    return len;
+}
+
+typedef struct NxTextWriteJob {
+    u64 n; ///< number of columns.
+    const f64* a; ///< the matrix.
+    i64 rs; ///< row stride.
+    i64 cs; ///< column stride.
+    u64 size; ///< number of elements.
+    u64 first; ///< first block of the batch.
+    char* buf; ///< NxTEXT_WRITE_BLOCK*NxTEXT_F64_SIZE bytes per block.
+    u64* lens; ///< length of the text of every block.
+} NxTextWriteJob;
+
+/**
+ * @brief Format the blocks [begin, end) of the batch.
+ */
+static void NxText_format_blocks(void* ctx, u64 begin, u64 end) {
+    NxTextWriteJob* J = ctx;
+    u64 b, idx;
+    for(b=begin; b<end; b++) {
+        char* start = J->buf + b*NxTEXT_WRITE_BLOCK*NxTEXT_F64_SIZE, *out = start;
+        u64 lo = (J->first + b)*NxTEXT_WRITE_BLOCK;
+        u64 hi = lo + NxTEXT_WRITE_BLOCK < J->size ? lo + NxTEXT_WRITE_BLOCK : J->size;
+        u64 i = lo / J->n, j = lo % J->n;
+        for(idx=lo; idx<hi; idx++) {
+            out += NxText_format_f64(out, J->a[(i64)i*J->rs + (i64)j*J->cs]);
+            if(++j == J->n) {
+                *out++ = '\n';
+                j = 0;
+                i++;
+            } else {
+                *out++ = ' ';
+            }
+        }
+        J->lens[b] = (u64)(out - start);
+    }
+}
+
+/**
+ * @brief Write a (m, n) matrix as text, one row per line.
+ *
+ * The values are formatted with NxText_format_f64() in parallel, a batch
+ * of blocks at a time, and written in order.
+ *
+ * @param fptr the file.
+ * @param m number of rows.
+ * @param n number of columns.
+ * @param a the matrix.
+ * @param rs row stride in elements.
+ * @param cs column stride in elements.
+ */
+void NxText_write_f64s(FILE* fptr, u64 m, u64 n, const f64* a, i64 rs, i64 cs) {
+    NxTextWriteJob J = {.n = n, .a = a, .rs = rs, .cs = cs, .size = m*n};
+    u64 blocks = (J.size + NxTEXT_WRITE_BLOCK - 1) / NxTEXT_WRITE_BLOCK, b;
+    if(blocks == 0) {
+        return ;
+    }
+    u64 batch = blocks < NxTEXT_WRITE_BATCH ? blocks : NxTEXT_WRITE_BATCH;
+    u64 lens[NxTEXT_WRITE_BATCH];
+    J.buf = malloc(batch*NxTEXT_WRITE_BLOCK*NxTEXT_F64_SIZE);
+    NxASSERT(J.buf != NULL);
+    J.lens = lens;
+    for(J.first=0; J.first<blocks; J.first+=batch) {
+        u64 count = blocks - J.first < batch ? blocks - J.first : batch;
+        NxThreadPool_parallel_for(count, 1, NxText_format_blocks, &J);
+        NxLOOP(b, count) {
+            fwrite(J.buf + b*NxTEXT_WRITE_BLOCK*NxTEXT_F64_SIZE, 1, lens[b], fptr);
+        }
+    }
+    free(J.buf);
+}
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxText.c
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
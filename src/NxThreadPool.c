@@ -0,0 +1,371 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "NxThreadPool.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+/// Chunks [begin, end) still to run by one thread, the owner takes from the front and thieves from the back.
+typedef struct NxWorkRange {
+    pthread_mutex_t lock;
+    u64 begin;
+    u64 end;
+} NxWorkRange;
+
+/// The pool and the parallel loop it is running.
+static struct NxThreadPool {
+    pthread_mutex_t lock; ///< protects the fields below.
+    pthread_cond_t wake; ///< signaled when a loop starts or the pool stops.
+    pthread_cond_t done; ///< signaled when the last worker leaves the loop.
+    pthread_mutex_t submit; ///< one parallel loop at a time.
+    pthread_t workers[NxTHREADS_MAX];
+    u64 seen[NxTHREADS_MAX]; ///< generation of the pool when every worker was started.
+    u32 started; ///< number of started workers.
+    u32 threads; ///< default number of threads.
+    u64 generation; ///< incremented for every parallel loop.
+    bool stop;
+    NxParallelFn fn;
+    void* ctx;
+    u64 n;
+    u64 grain;
+    u32 participants; ///< threads of the loop, the calling thread is the thread 0.
+    u32 active; ///< workers still running the loop.
+    NxWorkRange ranges[NxTHREADS_MAX];
+} NxPool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+    .submit = PTHREAD_MUTEX_INITIALIZER,
+    .threads = 1,
+};
+
+/// Set in the loop bodies so nested loops run serially.
+static _Thread_local bool NxThreadPool_inside = false;
+
+__attribute__((constructor))
+static void NxThreadPool_init(void) {
+    u32 t;
+    NxLOOP(t, NxTHREADS_MAX) {
+        pthread_mutex_init(&NxPool.ranges[t].lock, NULL);
+    }
+    const char* env = getenv(NxTHREADS_ENV);
+    long threads = env != NULL ? strtol(env, NULL, 10) : 0;
+#ifndef _WIN32
+    if(threads <= 0) {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+#endif
+    NxThreadPool_set_threads(threads > 0 ? (u32)threads : 1);
+}
+
+/**
+ * @brief Set the default number of threads (the calling thread included).
+ *
+ * The workers are started lazily by the first loop that needs them.
+ */
+void NxThreadPool_set_threads(u32 threads) {
+    if(threads == 0) {
+        threads = 1;
+    }
+    NxPool.threads = threads < NxTHREADS_MAX ? threads : NxTHREADS_MAX;
+}
+
+/**
+ * @brief Return the default number of threads.
+ */
+u32 NxThreadPool_get_threads(void) {
+    return NxPool.threads;
+}
+
+/**
+ * @brief Take the next chunk of the range of thread id.
+ */
+static bool NxThreadPool_take(u32 id, u64* chunk) {
+    NxWorkRange* r = &NxPool.ranges[id];
+    bool found = false;
+    pthread_mutex_lock(&r->lock);
+    if(r->begin < r->end) {
+        *chunk = r->begin++;
+        found = true;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return found;
+}
+
+/**
+ * @brief Move the back half of the range of another thread to thread id.
+ */
+static bool NxThreadPool_steal(u32 id, u32 participants) {
+    u32 k;
+    for(k=1; k<participants; k++) {
+        NxWorkRange* victim = &NxPool.ranges[(id + k) % participants];
+        u64 begin = 0, end = 0;
+        pthread_mutex_lock(&victim->lock);
+        if(victim->begin < victim->end) {
+            begin = victim->begin + (victim->end - victim->begin)/2;
+            end = victim->end;
+            victim->end = begin;
+        }
+        pthread_mutex_unlock(&victim->lock);
+        if(begin < end) {
+            NxWorkRange* own = &NxPool.ranges[id];
+            pthread_mutex_lock(&own->lock);
+            own->begin = begin;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Run chunks of the current loop until no thread has any left.
+ */
+static void NxThreadPool_work(u32 id) {
+    NxParallelFn fn = NxPool.fn;
+    void* ctx = NxPool.ctx;
+    u64 n = NxPool.n, grain = NxPool.grain, chunk;
+    u32 participants = NxPool.participants;
+    for(;;) {
+        if(NxThreadPool_take(id, &chunk)) {
+            u64 begin = chunk*grain;
+            fn(ctx, begin, n - begin < grain ? n : begin + grain);
+        } else if(!NxThreadPool_steal(id, participants)) {
+            return ;
+        }
+    }
+}
+
+static void* NxThreadPool_worker(void* arg) {
+    u32 id = (u32)(uintptr_t)arg;
+    NxThreadPool_inside = true;
+    pthread_mutex_lock(&NxPool.lock);
+    u64 seen = NxPool.seen[id];
+    for(;;) {
+        while(!NxPool.stop && NxPool.generation == seen) {
+            pthread_cond_wait(&NxPool.wake, &NxPool.lock);
+        }
+        if(NxPool.stop) {
+            break;
+        }
+        seen = NxPool.generation;
+        if(id >= NxPool.participants) {
+            continue;
+        }
+        pthread_mutex_unlock(&NxPool.lock);
+        NxThreadPool_work(id);
+        pthread_mutex_lock(&NxPool.lock);
+        if(--NxPool.active == 0) {
+            pthread_cond_signal(&NxPool.done);
+        }
+    }
+    pthread_mutex_unlock(&NxPool.lock);
+    return NULL;
+}
+
+/**
+ * @brief Start workers until `threads` threads can run a loop, return how many can.
+ */
+static u32 NxThreadPool_spawn(u32 threads) {
+    while(NxPool.started + 1 < threads) {
+        u32 id = NxPool.started + 1;
+        NxPool.seen[id] = NxPool.generation;
+        if(pthread_create(&NxPool.workers[NxPool.started], NULL, NxThreadPool_worker, (void*)(uintptr_t)id) != 0) {
+            break;
+        }
+        NxPool.started++;
+    }
+    return threads < NxPool.started + 1 ? threads : NxPool.started + 1;
+}
+
+/**
+ * @brief Stop and join the workers.
+ *
+ * The next parallel loop starts them again.
+ */
+void NxThreadPool_shutdown(void) {
+    u32 t;
+    pthread_mutex_lock(&NxPool.submit);
+    pthread_mutex_lock(&NxPool.lock);
+    NxPool.stop = true;
+    pthread_cond_broadcast(&NxPool.wake);
+    pthread_mutex_unlock(&NxPool.lock);
+    NxLOOP(t, NxPool.started) {
+        pthread_join(NxPool.workers[t], NULL);
+    }
+    NxPool.started = 0;
+    NxPool.stop = false;
+    pthread_mutex_unlock(&NxPool.submit);
+}
+
+/**
+ * @brief Run fn over [0, n) in chunks of `grain` iterations on `threads` threads.
+ *
+ * fn gets whole chunks (the last one may be shorter) and must not depend
+ * on which thread runs them. It runs once over [0, n) when there is a
+ * single chunk, a single thread, or when called from a loop body.
+ *
+ * @param threads number of threads, the calling thread included.
+ * @param n number of iterations.
+ * @param grain iterations per chunk.
+ * @param fn the loop body.
+ * @param ctx argument given to fn.
+ */
+void NxThreadPool_parallel_for_n(u32 threads, u64 n, u64 grain, NxParallelFn fn, void* ctx) {
+    if(n == 0) {
+        return ;
+    }
+    if(grain == 0) {
+        grain = 1;
+    }
+    u64 chunks = (n + grain - 1)/grain;
+    if(threads > NxTHREADS_MAX) {
+        threads = NxTHREADS_MAX;
+    }
+    if(threads > chunks) {
+        threads = (u32)chunks;
+    }
+    if(threads <= 1 || NxThreadPool_inside) {
+        fn(ctx, 0, n);
+        return ;
+    }
+
+    pthread_mutex_lock(&NxPool.submit);
+    threads = NxThreadPool_spawn(threads);
+    if(threads <= 1) {
+        pthread_mutex_unlock(&NxPool.submit);
+        fn(ctx, 0, n);
+        return ;
+    }
+    u32 t;
+    pthread_mutex_lock(&NxPool.lock);
+    NxPool.fn = fn;
+    NxPool.ctx = ctx;
+    NxPool.n = n;
+    NxPool.grain = grain;
+    NxPool.participants = threads;
+    NxPool.active = threads - 1;
+    NxLOOP(t, threads) {
+        NxPool.ranges[t].begin = chunks*t/threads;
+        NxPool.ranges[t].end = chunks*(t+1)/threads;
+    }
+    NxPool.generation++;
+    pthread_cond_broadcast(&NxPool.wake);
+    pthread_mutex_unlock(&NxPool.lock);
+
+    NxThreadPool_inside = true;
+    NxThreadPool_work(0);
+    NxThreadPool_inside = false;
+
+    pthread_mutex_lock(&NxPool.lock);
+    while(NxPool.active > 0) {
+        pthread_cond_wait(&NxPool.done, &NxPool.lock);
+    }
+    pthread_mutex_unlock(&NxPool.lock);
+    pthread_mutex_unlock(&NxPool.submit);
+}
+
+/**
+ * @brief NxThreadPool_parallel_for_n() on the default number of threads.
+ */
+void NxThreadPool_parallel_for(u64 n, u64 grain, NxParallelFn fn, void* ctx) {
+    NxThreadPool_parallel_for_n(NxPool.threads, n, grain, fn, ctx);
+}
+
+/// Arguments of the chunks of a parallel reduction.
+typedef struct NxThreadPoolReduce {
+    NxParallelReduceFn fn;
+    void* ctx;
+    u64 n;
+    u64 grain;
+    f64* partial;
+} NxThreadPoolReduce;
+
+static void NxThreadPool_reduce_chunks(void* ctx, u64 begin, u64 end) {
+    NxThreadPoolReduce* R = ctx;
+    u64 c;
+    for(c=begin; c<end; c++) {
+        u64 b = c*R->grain;
+        R->partial[c] = R->fn(R->ctx, b, R->n - b < R->grain ? R->n : b + R->grain);
+    }
+}
+
+static f64 NxThreadPool_pairwise(u64 n, const f64* a) {
+    if(n <= 8) {
+        f64 sum = 0.0;
+        u64 i;
+        NxLOOP(i, n) {
+            sum += a[i];
+        }
+        return sum;
+    }
+    return NxThreadPool_pairwise(n/2, a) + NxThreadPool_pairwise(n - n/2, a + n/2);
+}
+
+/**
+ * @brief Sum the results of fn over the chunks of [0, n) computed on `threads` threads.
+ *
+ * Every chunk of `grain` iterations gives one partial result and the
+ * partial results are summed pairwise in the order of the chunks, so the
+ * result only depends on n and grain, not on the number of threads.
+ *
+ * @param threads number of threads, the calling thread included.
+ * @param n number of iterations.
+ * @param grain iterations per chunk.
+ * @param fn returns the partial result of a chunk.
+ * @param ctx argument given to fn.
+ */
+f64 NxThreadPool_parallel_reduce_n(u32 threads, u64 n, u64 grain, NxParallelReduceFn fn, void* ctx) {
+    if(n == 0) {
+        return 0.0;
+    }
+    if(grain == 0) {
+        grain = 1;
+    }
+    u64 chunks = (n + grain - 1)/grain;
+    f64 stack[NxTHREADS_MAX];
+    NxThreadPoolReduce R = {fn, ctx, n, grain, chunks <= NxTHREADS_MAX ? stack : malloc(chunks*sizeof(f64))};
+    NxASSERT(R.partial != NULL);
+    NxThreadPool_parallel_for_n(threads, chunks, 1, NxThreadPool_reduce_chunks, &R);
+    f64 sum = NxThreadPool_pairwise(chunks, R.partial);
+    if(R.partial != stack) {
+        free(R.partial);
+    }
+    return sum;
+}
+
+/**
+ * @brief NxThreadPool_parallel_reduce_n() on the default number of threads.
+ */
+f64 NxThreadPool_parallel_reduce(u64 n, u64 grain, NxParallelReduceFn fn, void* ctx) {
+    return NxThreadPool_parallel_reduce_n(NxPool.threads, n, grain, fn, ctx);
+}
+
+/****************************************************************************
+ * Copyright (C) 2023 by Moaz Mohammed El-Essawey                           *
+ *                                                                          *
+ * This file is part of Nexum Library.                                      *
+ *                                                                          *
+ *   Nexum is free software: you can redistribute it and/or modify it       *
+ *   under the terms of the GNU Lesser General Public License as published  *
+ *   by the Free Software Foundation, either version 3 of the License, or   *
+ *   (at your option) any later version.                                    *
+ *                                                                          *
+ *   Box is distributed in the hope that it will be useful,                 *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+/**
+ * @file NxThreadPool.c
+ * @author Moaz El-Essawey.
+ * @date 11 July 2023.
+ */
@@ -0,0 +1,659 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "Nexum.h"
+
+static u32 failures = 0;
+
+#define NxCHECK(cond) do {                                                  \
+        if(!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                     \
+        }                                                                   \
+    } while(0)
+
+/**
+ * @brief The inplace operations on a read-only mapped tensor write to a new buffer, the file is left intact.
+ */
+static void test_map_binary_inplace(void) {
+    str fname = "/tmp/nexum_test_map.bin";
+    NxTensor A = {0}, B = {0}, C = {0};
+    u64 i;
+
+    NxTensor_alloc_arange(&A, 0.0, 64.0, 1.0);
+    NxTensor_write_binary(&A, fname);
+
+    NxTensor_map_binary(&B, fname, NxMAP_READ_ONLY);
+    NxCHECK(NxTensor_is_shared(&B));
+    NxTensor_add_scalar_(&B, 1.0);
+    NxCHECK(!NxTensor_is_shared(&B));
+    NxLOOP(i, 64) {
+        NxCHECK(B.data[i] == (f64)i + 1.0);
+    }
+
+    NxTensor_map_binary(&B, fname, NxMAP_READ_ONLY);
+    NxTensor_mul_tensor(&B, &B, &B);
+    NxLOOP(i, 64) {
+        NxCHECK(B.data[i] == (f64)(i*i));
+    }
+
+    NxTensor_map_binary(&B, fname, NxMAP_READ_ONLY);
+    NxTensor_abs_(&B);
+    NxTensor_pow_(&B, 3);
+    NxLOOP(i, 64) {
+        NxCHECK(B.data[i] == (f64)(i*i*i));
+    }
+
+    NxExpr E;
+    NxExpr_init(&E);
+    NxTensor_map_binary(&B, fname, NxMAP_READ_ONLY);
+    u32 x = NxExpr_tensor(&E, &B);
+    NxExpr_assign(&E, &B, NxExpr_add(&E, NxExpr_mul(&E, x, NxExpr_const(&E, 2.0)), x));
+    NxLOOP(i, 64) {
+        NxCHECK(B.data[i] == 3.0*(f64)i);
+    }
+
+    NxTensor_map_binary(&C, fname, NxMAP_READ_ONLY);
+    NxLOOP(i, 64) {
+        NxCHECK(C.data[i] == (f64)i);
+    }
+
+    NxTensor_free(&A);
+    NxTensor_free(&B);
+    NxTensor_free(&C);
+    remove(fname);
+}
+
+/**
+ * @brief An arena tensor is written in place again once its views are freed.
+ */
+static void test_arena_inplace(void) {
+    NxArena R;
+    NxTensor A = {0}, V = {0};
+
+    NxArena_init(&R);
+    NxArena* previous = NxArena_set_current(&R);
+    NxTensor_alloc_ones(&A, 8, 8);
+    NxCHECK(NxTensor_alloc_policy(&A) == NxALLOC_ARENA);
+    NxTensor_copy_data(&V, &A);
+    NxCHECK(NxTensor_is_shared(&A));
+    NxTensor_free(&V);
+    NxCHECK(!NxTensor_is_shared(&A));
+
+    NxDTYPE* data = A.data;
+    NxTensor_add_scalar_(&A, 1.0);
+    NxCHECK(A.data == data);
+    NxCHECK(A.data[63] == 2.0);
+
+    NxTensor_free(&A);
+    NxArena_set_current(previous);
+    NxArena_free(&R);
+}
+
+/**
+ * @brief The product may be written over either operand.
+ *
+ * The inner dimension is larger than NxGEMM_KC so the GEMM reads the
+ * operands again after writing a first block of the output.
+ */
+static void test_matmul_aliased(void) {
+    const u64 N = 2*NxGEMM_KC + 8;
+    NxTensor A = {0}, B = {0}, C = {0};
+    u64 i;
+
+    NxTensor_alloc_arange(&A, 0.0, (NxDTYPE)(N*N), 1.0);
+    NxTensor_reshape_(&A, N, N);
+    NxTensor_alloc_zeros(&B, N, N);
+    NxLOOP(i, N) {
+        B.data[N*i + i] = 2.0;
+    }
+    NxTensor_matmul_tensor(&C, &A, &B);
+
+    NxTensor_matmul_tensor(&A, &A, &B);
+    NxLOOP(i, N*N) {
+        NxCHECK(A.data[i] == C.data[i]);
+    }
+    NxTensor_matmul_tensor(&B, &C, &B);
+    NxLOOP(i, N*N) {
+        NxCHECK(B.data[i] == 4.0*(f64)i);
+    }
+
+    NxTensor_free(&A);
+    NxTensor_free(&B);
+    NxTensor_free(&C);
+}
+
+/**
+ * @brief The main compute paths take f32 tensors and give f32 results.
+ */
+static void test_f32_dispatch(void) {
+    NxTensor A = {0}, B = {0}, C = {0};
+    u64 i;
+
+    NxTensor_alloc_arange(&A, 0.0, 16.0, 1.0);
+    NxTensor_reshape_(&A, 4, 4);
+    NxTensor_astype(&A, &A, NxFLOAT32);
+    NxTensor_matmul_tensor(&C, &A, &A);
+    NxCHECK(C.dtype == NxFLOAT32);
+    NxCHECK(C.data_f32[5] == 4.0f*1.0f + 5.0f*5.0f + 6.0f*9.0f + 7.0f*13.0f);
+    NxCHECK(NxTensor_sum(&A) == 120.0);
+
+    NxTensor_sum_tensor(&B, &A, NxAXIS_ROW);
+    NxCHECK(B.dtype == NxFLOAT32 && B.n == 4);
+    NxCHECK(B.data_f32[0] == 24.0f);
+
+    NxTensor_exp(&B, &A);
+    NxCHECK(B.dtype == NxFLOAT32);
+    NxLOOP(i, 16) {
+        NxCHECK(fabsf(B.data_f32[i] - expf((f32)i)) <= 1e-6f*expf((f32)i));
+    }
+
+    NxTensor_free(&A);
+    NxTensor_free(&B);
+    NxTensor_free(&C);
+}
+
+/**
+ * @brief Training writes to a buffer of its own for mapped or shared weights.
+ */
+static void test_model_shared_weights(void) {
+    str fname = "/tmp/nexum_test_weights.bin";
+    NxModelSequential model;
+    NxTensor X = {0}, Y = {0}, W = {0}, B = {0};
+    u64 i;
+
+    NxModelSequential_init(&model, "shared");
+    NxModelSequential_append_Dense(&model, 4, 2, NxActivation_None);
+    NxDense* layer = &(model.layers[0]);
+    NxTensor_alloc_ones(&W, 4, 2);
+    NxTensor_write_binary(&W, fname);
+    NxTensor_map_binary(&(layer->weights), fname, NxMAP_READ_ONLY);
+    NxTensor_copy_data(&B, &(layer->bias));
+
+    NxTensor_alloc_ones(&X, 8, 4);
+    NxTensor_alloc_zeros(&Y, 8, 2);
+    NxModelSequential_train(&model, &X, &Y, 4);
+
+    NxCHECK(layer->weights.data[0] < 1.0);
+    NxTensor_map_binary(&W, fname, NxMAP_READ_ONLY);
+    NxLOOP(i, 8) {
+        NxCHECK(W.data[i] == 1.0);
+    }
+    NxCHECK(B.data[0] != layer->bias.data[0]);
+
+    NxModelSequential_free(&model);
+    NxTensor_free(&X);
+    NxTensor_free(&Y);
+    NxTensor_free(&W);
+    NxTensor_free(&B);
+    remove(fname);
+}
+
+/**
+ * @brief The f64 add, sub and scale give the same results through the backend, written over either operand.
+ */
+static void test_backend_axpy(void) {
+    NxTensor A = {0}, B = {0}, C = {0};
+    u64 i;
+
+    NxCHECK(NxBackend_get() != NULL && NxBackend_get()->daxpy != NULL);
+    NxTensor_alloc_arange(&A, 0.0, 64.0, 1.0);
+    NxTensor_alloc_ones(&B, 8, 8);
+    NxTensor_reshape_(&A, 8, 8);
+
+    NxTensor_sub_tensor(&C, &A, &B);
+    NxLOOP(i, 64) {
+        NxCHECK(C.data[i] == (f64)i - 1.0);
+    }
+    NxTensor_sub_tensor(&B, &A, &B);
+    NxLOOP(i, 64) {
+        NxCHECK(B.data[i] == (f64)i - 1.0);
+    }
+    NxTensor_add_tensor(&B, &A, &B);
+    NxLOOP(i, 64) {
+        NxCHECK(B.data[i] == 2.0*(f64)i - 1.0);
+    }
+    NxTensor_mul_scalar(&C, &A, 3.0);
+    NxTensor_add_tensor(&A, &A, &A);
+    NxLOOP(i, 64) {
+        NxCHECK(C.data[i] == 3.0*(f64)i);
+        NxCHECK(A.data[i] == 2.0*(f64)i);
+    }
+
+    NxTensor_free(&A);
+    NxTensor_free(&B);
+    NxTensor_free(&C);
+}
+
+/**
+ * @brief Training on a dataset streamed from files gives the same model as training on the tensors.
+ */
+static void test_model_train_dataset(void) {
+    str x_file = "/tmp/nexum_test_x.bin", y_file = "/tmp/nexum_test_y.bin";
+    NxModelSequential A, B;
+    NxTensor X = {0}, Y = {0};
+    NxDataset D;
+    u64 i;
+
+    NxModelSequential_init(&A, "tensors");
+    NxModelSequential_init(&B, "dataset");
+    NxModelSequential_append_Dense(&A, 3, 2, NxActivation_None);
+    NxModelSequential_append_Dense(&B, 3, 2, NxActivation_None);
+    NxTensor_copy_data(&(B.layers[0].weights), &(A.layers[0].weights));
+    NxTensor_copy_data(&(B.layers[0].bias), &(A.layers[0].bias));
+    A.epochs = B.epochs = 2;
+
+    NxTensor_alloc_rand(&X, 10, 3);
+    NxTensor_alloc_rand(&Y, 10, 2);
+    NxTensor_write_binary(&X, x_file);
+    NxTensor_write_binary(&Y, y_file);
+
+    NxModelSequential_train(&A, &X, &Y, 4);
+    NxDataset_open(&D, &x_file, &y_file, 1, 4, NxDATASET_BUFFERS);
+    NxModelSequential_train_dataset(&B, &D);
+    NxCHECK(D.stats.samples == 20);
+    NxDataset_close(&D);
+
+    NxCHECK(A.loss == B.loss);
+    NxLOOP(i, 6) {
+        NxCHECK(A.layers[0].weights.data[i] == B.layers[0].weights.data[i]);
+    }
+
+    NxModelSequential_free(&A);
+    NxModelSequential_free(&B);
+    NxTensor_free(&X);
+    NxTensor_free(&Y);
+    remove(x_file);
+    remove(y_file);
+}
+
+/**
+ * @brief A layer written as text reads back in the same order, whatever the strides and dtype of its weights.
+ */
+static void test_dense_write(void) {
+    str fname = "/tmp/nexum_test_dense.txt";
+    NxDense L = {0}, R = {0};
+    NxTensor W = {0}, T = {0};
+    u64 i, j;
+
+    NxDense_alloc(&L, 3, 2, NxActivation_None);
+    NxTensor_alloc_arange(&W, 0.0, 6.0, 1.0);
+    NxTensor_reshape_(&W, 3, 2);
+    NxTensor_transpose(&T, &W);
+    NxTensor_transpose(&(L.weights), &W);
+    NxCHECK(!NxTensor_is_contiguous(&(L.weights)));
+    NxDense_write(&L, fname);
+    NxDense_read(&R, fname);
+    NxLOOP(i, 2) {
+        NxLOOP(j, 3) {
+            NxCHECK(NxTensor_AT(&(R.weights), i, j) == NxTensor_AT(&T, i, j));
+        }
+    }
+
+    NxTensor_astype(&(L.weights), &(L.weights), NxFLOAT32);
+    NxDense_write(&L, fname);
+    NxDense_read(&R, fname);
+    NxCHECK(R.weights.dtype == NxFLOAT64);
+    NxLOOP(i, 2) {
+        NxLOOP(j, 3) {
+            NxCHECK(NxTensor_AT(&(R.weights), i, j) == NxTensor_AT(&T, i, j));
+        }
+    }
+
+    NxDense_free(&L);
+    NxDense_free(&R);
+    NxTensor_free(&W);
+    NxTensor_free(&T);
+    remove(fname);
+}
+
+/**
+ * @brief Whether opening the checkpoint fname exits with EXIT_FAILURE, tried in a child process.
+ */
+static bool test_checkpoint_rejected(str fname) {
+    pid_t pid = fork();
+    if(pid == 0) {
+        NxCheckpoint C;
+        freopen("/dev/null", "w", stderr);
+        NxCheckpoint_open(&C, fname, NxMAP_READ_ONLY);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_FAILURE;
+}
+
+/**
+ * @brief Rewrite the file fname keeping its first `bytes` bytes, with the byte at `flip` inverted.
+ */
+static void test_checkpoint_damage(str fname, str copy, u64 bytes, u64 flip) {
+    FILE* in = fopen(fname, "rb");
+    FILE* out = fopen(copy, "wb");
+    u64 i;
+    NxLOOP(i, bytes) {
+        int c = fgetc(in);
+        fputc(i == flip ? c ^ 0xff : c, out);
+    }
+    fclose(in);
+    fclose(out);
+}
+
+/**
+ * @brief Tensors of every dtype read back from a checkpoint, a truncated or corrupted file is rejected.
+ */
+static void test_checkpoint_roundtrip(void) {
+    str fname = "/tmp/nexum_test.ckpt", copy = "/tmp/nexum_test_damaged.ckpt";
+    str names[] = {"f64", "f32", "bf16", "f16", "transposed"};
+    NxTensor T[5] = {{0}}, R = {0}, W = {0};
+    NxTensor* tensors[5] = {&T[0], &T[1], &T[2], &T[3], &T[4]};
+    NxDType dtypes[4] = {NxFLOAT64, NxFLOAT32, NxBFLOAT16, NxFLOAT16};
+    NxCheckpoint C;
+    u64 i, k;
+
+    NxLOOP(k, 4) {
+        NxTensor_alloc_arange(&T[k], 0.0, (NxDTYPE)(12 + k), 1.0);
+        NxTensor_astype(&T[k], &T[k], dtypes[k]);
+    }
+    NxTensor_alloc_arange(&W, 0.0, 12.0, 1.0);
+    NxTensor_reshape_(&W, 3, 4);
+    NxTensor_transpose(&T[4], &W);
+    NxCheckpoint_save(fname, 5, names, tensors);
+
+    NxCheckpoint_open(&C, fname, NxMAP_READ_ONLY);
+    NxCHECK(C.count == 5);
+    NxCHECK(NxCheckpoint_verify(&C));
+    NxCHECK(NxCheckpoint_find(&C, "missing") < 0);
+    NxCHECK(!NxCheckpoint_get(&C, "missing", &R));
+    NxLOOP(k, 4) {
+        NxCHECK(NxCheckpoint_get(&C, names[k], &R));
+        NxCHECK(R.dtype == dtypes[k] && NxTensor_size(&R) == 12 + k);
+        NxCHECK(memcmp(R.raw, T[k].raw, NxTensor_size(&R)*NxDType_size(R.dtype)) == 0);
+    }
+    NxCHECK(NxCheckpoint_get(&C, "transposed", &R));
+    NxCHECK(R.m == 4 && R.n == 3);
+    NxLOOP(i, 4) {
+        NxLOOP(k, 3) {
+            NxCHECK(NxTensor_AT(&R, i, k) == NxTensor_AT(&T[4], i, k));
+        }
+    }
+    u64 fsize = C.header->file_size;
+    u64 index = (u64)((const char*)C.entries - (const char*)C.header);
+    u64 data = C.entries[0].offset;
+    NxCheckpoint_close(&C);
+    NxCHECK(R.data[1] == 4.0);
+
+    test_checkpoint_damage(fname, copy, fsize - 1, fsize);
+    NxCHECK(test_checkpoint_rejected(copy));
+    test_checkpoint_damage(fname, copy, fsize, 0);
+    NxCHECK(test_checkpoint_rejected(copy));
+    test_checkpoint_damage(fname, copy, fsize, index + 1);
+    NxCHECK(test_checkpoint_rejected(copy));
+    test_checkpoint_damage(fname, copy, fsize, data + 3);
+    NxCheckpoint_open(&C, copy, NxMAP_READ_ONLY);
+    NxCHECK(!NxCheckpoint_verify(&C));
+    NxCheckpoint_close(&C);
+
+    NxLOOP(k, 5) {
+        NxTensor_free(&T[k]);
+    }
+    NxTensor_free(&R);
+    NxTensor_free(&W);
+    remove(fname);
+    remove(copy);
+}
+
+/**
+ * @brief Compressible and random data decode back to the same bytes, by frame and by block.
+ *
+ * The random blocks do not compress and are stored as they are, the
+ * sizes end in a partial block and in a partial element.
+ */
+static void test_codec_roundtrip(void) {
+    const u64 sizes[] = {0, 5, 8*1000 + 3, 2*NxCODEC_BLOCK + 8*123 + 5};
+    const u32 elem_sizes[] = {1, 4, 8};
+    u64 max = sizes[3], state = 0x9e3779b97f4a7c15ULL, i, k, b;
+    char* smooth = malloc(max);
+    char* noise = malloc(max);
+    char* frame = malloc(NxCodec_bound(max));
+    char* out = malloc(max);
+    char* block = malloc(NxCODEC_BLOCK);
+    char* scratch = malloc(NxCODEC_BLOCK);
+    NxASSERT(smooth && noise && frame && out && block && scratch);
+
+    NxLOOP(i, max / sizeof(f64)) {
+        f64 v = 1.0 + (f64)i*1e-3;
+        memcpy(smooth + i*sizeof(f64), &v, sizeof(f64));
+    }
+    memset(smooth + max / sizeof(f64)*sizeof(f64), 7, max % sizeof(f64));
+    NxLOOP(i, max) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        noise[i] = (char)(state >> 56);
+    }
+
+    NxLOOP(k, sizeof(sizes)/sizeof(sizes[0])) {
+        NxLOOP(i, sizeof(elem_sizes)/sizeof(elem_sizes[0])) {
+            const char* inputs[2] = {smooth, noise};
+            u32 d;
+            NxLOOP(d, 2) {
+                u64 bytes = sizes[k];
+                u64 frame_bytes = NxCodec_compress(frame, inputs[d], bytes, elem_sizes[i]);
+                NxCHECK(frame_bytes <= NxCodec_bound(bytes));
+                NxCHECK(NxCodec_check(frame, frame_bytes));
+                memset(out, 0, max);
+                NxCHECK(NxCodec_decompress(out, bytes, frame, frame_bytes));
+                NxCHECK(memcmp(out, inputs[d], bytes) == 0);
+                if(d == 0 && elem_sizes[i] == 8 && bytes > 1000) {
+                    NxCHECK(frame_bytes < bytes / 2);
+                }
+
+                NxCodecFrame F;
+                memcpy(&F, frame, sizeof(F));
+                const u64* ends = (const u64*)(frame + sizeof(F));
+                NxLOOP(b, F.blocks) {
+                    u64 start = b*F.block_size;
+                    u64 size = bytes - start < F.block_size ? bytes - start : F.block_size;
+                    if(d == 1) {
+                        NxCHECK(ends[b] - (b > 0 ? ends[b-1] : 0) == size);
+                    }
+                    NxCHECK(NxCodec_decompress_block(block, frame, b, scratch));
+                    NxCHECK(memcmp(block, inputs[d] + start, size) == 0);
+                }
+            }
+        }
+    }
+
+    u64 bytes = sizes[3];
+    u64 frame_bytes = NxCodec_compress(frame, smooth, bytes, 8);
+    NxCHECK(!NxCodec_decompress(out, bytes - 1, frame, frame_bytes));
+    NxCHECK(!NxCodec_check(frame, sizeof(NxCodecFrame) - 1));
+    frame[0] ^= 0xff;
+    NxCHECK(!NxCodec_check(frame, frame_bytes));
+
+    free(smooth);
+    free(noise);
+    free(frame);
+    free(out);
+    free(block);
+    free(scratch);
+}
+
+/// Leaves of the network of test_graph_record().
+typedef struct TestGraphLeaves {
+    NxTensor X; ///< inputs, (4, 3).
+    NxTensor W; ///< weights, (2, 3).
+    NxTensor b; ///< bias, (2, 1).
+    NxTensor C; ///< constant, (4, 2).
+    NxTensor K; ///< projection of the targets, (2, 3).
+    NxTensor Y; ///< targets, (4, 2).
+} TestGraphLeaves;
+
+/**
+ * @brief Record a small network that gives work to every pass of NxGraph_optimize(), return the id of its loss.
+ *
+ * The targets go through a branch without gradient, whose fused node
+ * takes the buffer of its product in place.
+ */
+static u64 test_graph_record(NxComputationalGraph* G, TestGraphLeaves* T) {
+    u64 x = NxGraph_input(G, &T->X);
+    u64 w = NxGraph_parameter(G, &T->W);
+    u64 bias = NxGraph_parameter(G, &T->b);
+    u64 c = NxGraph_constant(G, &T->C);
+    u64 k = NxGraph_input(G, &T->K);
+    u64 y = NxGraph_input(G, &T->Y);
+    NxGraph_relu(G, x);
+    u64 h = NxGraph_dense(G, x, w, bias, NxActivation_Tanh);
+    u64 mask = NxGraph_scale(G, NxGraph_exp(G, c), 0.5);
+    u64 z = NxGraph_mul(G, h, mask);
+    u64 e = NxGraph_sigmoid(G, NxGraph_add(G, NxGraph_scale(G, z, 2.0), h));
+    u64 p = NxGraph_elu(G, NxGraph_sub(G, e, NxGraph_square(G, z)), 0.3);
+    u64 t = NxGraph_tanh(G, NxGraph_add(G, NxGraph_matmul_nt(G, x, k), y));
+    return NxGraph_mse(G, p, t);
+}
+
+/**
+ * @brief Loss of test_graph_record() computed eagerly, with the gradients of W and b when dW is not NULL.
+ */
+static f64 test_graph_loss(TestGraphLeaves* T, NxTensor* dW, NxTensor* db) {
+    NxComputationalGraph G;
+    NxGraph_alloc(&G);
+    u64 loss = test_graph_record(&G, T);
+    f64 value = NxGraph_value(&G, loss)->data[0];
+    if(dW != NULL) {
+        NxGraph_backward(&G, loss, false);
+        NxTensor_contiguous(dW, NxGraph_grad(&G, T->W.id));
+        NxTensor_contiguous(db, NxGraph_grad(&G, T->b.id));
+    }
+    NxGraph_free(&G);
+    return value;
+}
+
+/**
+ * @brief The tape gradients match finite differences, and the optimized graph gives the same loss and gradients.
+ */
+static void test_graph_gradients(void) {
+    const f64 h = 1e-6;
+    TestGraphLeaves T = {0};
+    NxTensor dW = {0}, db = {0};
+    NxTensor* params[2] = {&T.W, &T.b};
+    NxTensor* grads[2] = {&dW, &db};
+    NxComputationalGraph G;
+    u64 i, k, round;
+
+    NxTensor_alloc_randn(&T.X, 4, 3);
+    NxTensor_alloc_randn(&T.W, 2, 3);
+    NxTensor_alloc_randn(&T.b, 2, 1);
+    NxTensor_alloc_randn(&T.C, 4, 2);
+    NxTensor_alloc_randn(&T.K, 2, 3);
+    NxTensor_alloc_randn(&T.Y, 4, 2);
+
+    test_graph_loss(&T, &dW, &db);
+    NxLOOP(k, 2) {
+        NxLOOP(i, NxTensor_size(params[k])) {
+            f64 v = params[k]->data[i];
+            params[k]->data[i] = v + h;
+            f64 up = test_graph_loss(&T, NULL, NULL);
+            params[k]->data[i] = v - h;
+            f64 down = test_graph_loss(&T, NULL, NULL);
+            params[k]->data[i] = v;
+            f64 g = grads[k]->data[i];
+            NxCHECK(fabs((up - down) / (2.0*h) - g) <= 1e-6*(1.0 + fabs(g)));
+        }
+    }
+
+    NxGraph_alloc(&G);
+    G.deferred = true;
+    u64 loss = test_graph_record(&G, &T);
+    NxCHECK(!NxTensor_is_shared(&T.W) && !NxTensor_is_shared(&T.b));
+    NxGraph_optimize(&G, &loss, 1);
+    bool linear = false, fused = false, folded = false, inplace = false, pruned = false;
+    NxLOOP(i, G.count) {
+        NxGraphNode* node = &G.nodes[i];
+        linear |= !node->dead && node->op == NxGRAPH_LINEAR;
+        fused |= !node->dead && node->op == NxGRAPH_FUSED;
+        folded |= !node->dead && node->op == NxGRAPH_CONSTANT && node->source == NULL;
+        inplace |= !node->dead && node->inplace != 0;
+        pruned |= node->dead && node->op == NxGRAPH_RELU;
+    }
+    NxCHECK(linear && fused && folded && inplace && pruned);
+
+    NxLOOP(round, 3) {
+        f64 expected = test_graph_loss(&T, &dW, &db);
+        NxGraph_run(&G);
+        f64 value = NxGraph_value(&G, loss)->data[0];
+        NxCHECK(fabs(value - expected) <= 1e-12*(1.0 + fabs(expected)));
+        NxGraph_zero_grad(&G);
+        NxGraph_backward(&G, loss, false);
+        NxLOOP(k, 2) {
+            NxTensor* g = NxGraph_grad(&G, params[k]->id);
+            NxLOOP(i, NxTensor_size(params[k])) {
+                f64 r = grads[k]->data[i];
+                NxCHECK(fabs(g->data[i] - r) <= 1e-12*(1.0 + fabs(r)));
+            }
+        }
+        /* The update is in place, the graph reads the new values without a copy. */
+        NxDTYPE* data = T.W.data;
+        NxTensor_sub_tensor(&T.W, &T.W, &dW);
+        NxTensor_sub_tensor(&T.b, &T.b, &db);
+        NxCHECK(T.W.data == data);
+    }
+
+    NxGraph_free(&G);
+    NxTensor_free(&T.X);
+    NxTensor_free(&T.W);
+    NxTensor_free(&T.b);
+    NxTensor_free(&T.C);
+    NxTensor_free(&T.K);
+    NxTensor_free(&T.Y);
+    NxTensor_free(&dW);
+    NxTensor_free(&db);
+}
+
+/**
+ * @brief Quantizing a layer again replaces its buffers, the leak checker sees the old ones freed.
+ */
+static void test_dense_q8_requantize(void) {
+    NxDense L = {0};
+    NxDenseQ8 Q = {0};
+    NxTensor X = {0}, Y = {0};
+
+    NxDense_alloc(&L, 8, 4, NxActivation_None);
+    NxDenseQ8_quantize(&Q, &L);
+    NxTensor_mul_scalar_(&(L.weights), 2.0);
+    NxDenseQ8_quantize(&Q, &L);
+    NxCHECK(Q.initialized && Q.in_features == 8 && Q.out_features == 4);
+
+    NxTensor_alloc_ones(&X, 2, 8);
+    NxDenseQ8_forward(&Q, &Y, &X);
+    NxCHECK(Y.m == 2 && Y.n == 4);
+
+    NxDenseQ8_free(&Q);
+    NxDense_free(&L);
+    NxTensor_free(&X);
+    NxTensor_free(&Y);
+}
+
+int main(void) {
+    test_map_binary_inplace();
+    test_arena_inplace();
+    test_matmul_aliased();
+    test_f32_dispatch();
+    test_model_shared_weights();
+    test_backend_axpy();
+    test_model_train_dataset();
+    test_dense_write();
+    test_checkpoint_roundtrip();
+    test_codec_roundtrip();
+    test_graph_gradients();
+    test_dense_q8_requantize();
+
+    if(failures != 0) {
+        fprintf(stderr, "%u checks failed.\n", failures);
+        return 1;
+    }
+    printf("All tests passed.\n");
+    return 0;
+}